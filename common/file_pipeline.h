@@ -0,0 +1,447 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cerrno>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+#include "bounded_queue.h"
+#include "uring.h"
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+//文件流水线（仅Linux）：读取、计算、写出三个阶段重叠执行，而不是读完一段、算完、写完再读下一段。
+//
+//   文件按单元（如容器的一个分块）处理，depth个缓冲区在各阶段之间轮转：空闲 → 读取 → 计算 → 写出 → 空闲；
+//   I/O线程用io_uring同时保持多个读写请求在途，缓冲区预先登记为固定缓冲区（READ_FIXED/WRITE_FIXED），
+//   内核不支持io_uring时改用pread/pwrite，读写在I/O线程上同步进行，但仍与计算重叠；
+//   阶段之间用有界无锁队列（BoundedQueue）传递缓冲区编号：计算线程在eventfd（信号量模式）上休眠，
+//   计算完成时写另一个eventfd，io_uring模式下I/O线程对它挂一个读请求，于是I/O线程只需等待完成队列；
+//   读完的单元按编号顺序交给计算线程，只用一个计算线程时各单元按文件顺序处理（SM3这类串行计算）。
+//
+//Job需提供：
+//   uint64_t units() const                                    单元数
+//   size_t in_capacity() const、size_t out_capacity() const    单元输入、输出的最大字节数
+//   void input(uint64_t i, uint64_t& offset, size_t& len) const    单元i在输入文件中的位置
+//   bool process(uint64_t i, const uint8_t* in, size_t len, uint8_t* out, uint64_t& out_offset, size_t& out_len)
+//        计算单元i，输出写到out，out_len为0表示不写出；返回false时中止流水线。
+//        多个计算线程会并发调用process。
+
+enum class PipelineStatus {
+    Ok,
+    IoError,  //读写失败或输入文件比预期短
+    Aborted   //process返回false
+};
+
+struct PipelineOptions {
+    static const unsigned MAX_DEPTH = 4096;
+
+    unsigned depth;    //同时在途的单元数（缓冲区个数），0按1、超过MAX_DEPTH按MAX_DEPTH
+    unsigned workers;  //计算线程数，0表示硬件线程数
+    bool use_uring;    //为false时直接使用pread/pwrite
+
+    PipelineOptions() : depth(16), workers(0), use_uring(true) {}
+};
+
+template <class Job>
+class FilePipeline {
+private:
+    static const uint64_t READ = 1, WRITE = 2, EVENT = 3;
+    static const unsigned STOP = ~0u;
+    static const size_t PAGE = 4096;
+
+    static unsigned clamp_depth(unsigned d) {
+        return d == 0 ? 1 : d > PipelineOptions::MAX_DEPTH ? PipelineOptions::MAX_DEPTH : d;
+    }
+
+    struct Slot {
+        uint8_t* in;
+        uint8_t* out;
+        uint64_t unit;
+        uint64_t offset;      //输入位置
+        size_t len;           //输入长度
+        size_t done;          //已读或已写的字节数
+        uint64_t out_offset;
+        size_t out_len;
+        bool ok;              //process的返回值
+        bool bad;             //读取失败
+    };
+
+    Job& job;
+    int in_fd;
+    int out_fd;
+    PipelineOptions opt;
+
+    struct FreeDeleter {
+        void operator()(uint8_t* p) const {
+            free(p);
+        }
+    };
+
+    std::unique_ptr<uint8_t, FreeDeleter> memory;  //先于ring声明：ring关闭（取消在途请求）之后才释放
+    size_t slot_bytes;
+    std::vector<Slot> slots;
+    std::vector<unsigned> free_slots;
+    std::vector<int> ready;   //ready[单元 % depth]：已读完、等待按顺序交给计算线程的缓冲区
+    BoundedQueue<unsigned> work;
+    BoundedQueue<unsigned> done;
+    int work_efd;             //信号量模式，每个待计算的单元计1
+    int done_efd;             //有计算完成的单元
+    std::vector<std::thread> workers;
+
+    uint64_t next_read;       //下一个要读的单元
+    uint64_t next_dispatch;   //下一个要交给计算线程的单元
+    uint64_t completed;
+    unsigned in_use;
+    PipelineStatus status;
+
+    uint64_t event_value;     //io_uring对done_efd的读请求写到这里
+    IoUring ring;
+    bool uring;
+    bool fixed;
+
+    static void post(int efd) {
+        uint64_t one = 1;
+        while (write(efd, &one, 8) < 0 && errno == EINTR) {
+        }
+    }
+    static void wait_fd(int efd) {
+        uint64_t v;
+        while (read(efd, &v, 8) < 0 && errno == EINTR) {
+        }
+    }
+
+    void worker_loop() {
+        for (;;) {
+            wait_fd(work_efd);
+            unsigned s;
+            while (!work.try_pop(s)) {
+                std::this_thread::yield();
+            }
+            if (s == STOP) {
+                return;
+            }
+            Slot& sl = slots[s];
+            sl.ok = job.process(sl.unit, sl.in, sl.len, sl.out, sl.out_offset, sl.out_len);
+            while (!done.try_push(s)) {
+                std::this_thread::yield();
+            }
+            post(done_efd);
+        }
+    }
+
+    void fail(PipelineStatus st) {
+        if (status == PipelineStatus::Ok) {
+            status = st;
+        }
+    }
+
+    void release(unsigned s) {
+        free_slots.push_back(s);
+        in_use--;
+    }
+
+    //取一个空闲缓冲区开始读下一个单元
+    bool start_read(unsigned& s) {
+        if (status != PipelineStatus::Ok || next_read >= job.units() || free_slots.empty()) {
+            return false;
+        }
+        s = free_slots.back();
+        free_slots.pop_back();
+        in_use++;
+        Slot& sl = slots[s];
+        sl.unit = next_read++;
+        job.input(sl.unit, sl.offset, sl.len);
+        sl.done = 0;
+        sl.bad = false;
+        return true;
+    }
+
+    //读完的单元按编号顺序交给计算线程；出错后不再计算，直接回收
+    void mark_read(unsigned s) {
+        ready[slots[s].unit % opt.depth] = (int)s;
+        while (next_dispatch < next_read && ready[next_dispatch % opt.depth] >= 0) {
+            unsigned r = (unsigned)ready[next_dispatch % opt.depth];
+            ready[next_dispatch % opt.depth] = -1;
+            next_dispatch++;
+            if (slots[r].bad || status != PipelineStatus::Ok) {
+                release(r);
+                continue;
+            }
+            while (!work.try_push(r)) {
+                std::this_thread::yield();
+            }
+            post(work_efd);
+        }
+    }
+
+    void submit_read(unsigned s) {
+        Slot& sl = slots[s];
+        io_uring_sqe* sqe = ring.get_sqe();
+        IoUring::prep_rw(sqe, fixed ? IORING_OP_READ_FIXED : IORING_OP_READ, in_fd, sl.in + sl.done,
+            (unsigned)(sl.len - sl.done), sl.offset + sl.done, READ << 32 | s, fixed ? (int)s : -1);
+    }
+
+    void submit_write(unsigned s) {
+        Slot& sl = slots[s];
+        io_uring_sqe* sqe = ring.get_sqe();
+        IoUring::prep_rw(sqe, fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, out_fd, sl.out + sl.done,
+            (unsigned)(sl.out_len - sl.done), sl.out_offset + sl.done, WRITE << 32 | s, fixed ? (int)s : -1);
+    }
+
+    void arm_event() {
+        io_uring_sqe* sqe = ring.get_sqe();
+        IoUring::prep_rw(sqe, IORING_OP_READ, done_efd, &event_value, 8, 0, EVENT << 32);
+    }
+
+    //取出计算完成的单元：有输出的提交写出（或同步写出），没有输出的直接回收
+    void drain_done() {
+        unsigned s;
+        while (done.try_pop(s)) {
+            Slot& sl = slots[s];
+            if (!sl.ok) {
+                fail(PipelineStatus::Aborted);
+            }
+            if (sl.ok && sl.out_len > 0 && status == PipelineStatus::Ok) {
+                sl.done = 0;
+                if (uring) {
+                    submit_write(s);
+                    continue;
+                }
+                if (!pwrite_full(sl.out, sl.out_len, sl.out_offset)) {
+                    fail(PipelineStatus::IoError);
+                }
+            }
+            if (sl.ok) {
+                completed++;
+            }
+            release(s);
+        }
+    }
+
+    bool pread_full(uint8_t* p, size_t len, uint64_t offset) {
+        while (len > 0) {
+            ssize_t r = pread(in_fd, p, len, (off_t)offset);
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            if (r <= 0) {
+                return false;
+            }
+            p += r;
+            len -= (size_t)r;
+            offset += (uint64_t)r;
+        }
+        return true;
+    }
+
+    bool pwrite_full(const uint8_t* p, size_t len, uint64_t offset) {
+        while (len > 0) {
+            ssize_t r = pwrite(out_fd, p, len, (off_t)offset);
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            if (r <= 0) {
+                return false;
+            }
+            p += r;
+            len -= (size_t)r;
+            offset += (uint64_t)r;
+        }
+        return true;
+    }
+
+    //pread/pwrite：读取在I/O线程上同步进行，没有可读的单元时等待计算完成
+    void run_sync() {
+        for (;;) {
+            drain_done();
+            unsigned s;
+            if (start_read(s)) {
+                Slot& sl = slots[s];
+                if (!pread_full(sl.in, sl.len, sl.offset)) {
+                    sl.bad = true;
+                    fail(PipelineStatus::IoError);
+                }
+                mark_read(s);
+                continue;
+            }
+            if (in_use == 0) {
+                return;
+            }
+            wait_fd(done_efd);
+        }
+    }
+
+    void on_cqe(const io_uring_cqe& cqe) {
+        uint64_t kind = cqe.user_data >> 32;
+        unsigned s = (unsigned)(cqe.user_data & 0xffffffffu);
+        if (kind == EVENT) {
+            arm_event();
+            drain_done();
+            return;
+        }
+        Slot& sl = slots[s];
+        if (kind == READ) {
+            if (cqe.res <= 0) {
+                //0表示文件比预期短
+                sl.bad = true;
+                fail(PipelineStatus::IoError);
+                mark_read(s);
+                return;
+            }
+            sl.done += (size_t)cqe.res;
+            if (sl.done < sl.len) {
+                submit_read(s);  //短读：继续读剩余部分
+            }
+            else {
+                mark_read(s);
+            }
+            return;
+        }
+        if (cqe.res <= 0) {
+            fail(PipelineStatus::IoError);
+            release(s);
+            return;
+        }
+        sl.done += (size_t)cqe.res;
+        if (sl.done < sl.out_len) {
+            submit_write(s);
+            return;
+        }
+        completed++;
+        release(s);
+    }
+
+    //io_uring：所有读写与计算完成通知都经由完成队列，I/O线程只在io_uring_enter中等待
+    void run_uring() {
+        arm_event();
+        for (;;) {
+            unsigned s;
+            while (start_read(s)) {
+                if (slots[s].len == 0) {
+                    mark_read(s);
+                }
+                else {
+                    submit_read(s);
+                }
+            }
+            if (in_use == 0) {
+                return;
+            }
+            int r = ring.submit_and_wait(1);
+            if (r < 0 && r != -EINTR) {
+                //无法继续提交：等计算线程交回缓冲区后结束，在途的读写随ring关闭而取消
+                fail(PipelineStatus::IoError);
+                return;
+            }
+            io_uring_cqe cqe;
+            while (ring.pop_cqe(cqe)) {
+                on_cqe(cqe);
+            }
+        }
+    }
+
+public:
+    FilePipeline(Job& j, int input_fd, int output_fd, const PipelineOptions& o = PipelineOptions())
+        : job(j), in_fd(input_fd), out_fd(output_fd), opt(o), slot_bytes(0),
+          work(clamp_depth(o.depth) + 64), done(clamp_depth(o.depth) + 64), work_efd(-1), done_efd(-1),
+          next_read(0), next_dispatch(0), completed(0), in_use(0), status(PipelineStatus::Ok), event_value(0),
+          uring(false), fixed(false) {
+        opt.depth = clamp_depth(opt.depth);
+        if (opt.workers == 0) {
+            opt.workers = std::thread::hardware_concurrency();
+        }
+        if (opt.workers == 0) {
+            opt.workers = 1;
+        }
+    }
+
+    FilePipeline(const FilePipeline&) = delete;
+    FilePipeline& operator=(const FilePipeline&) = delete;
+
+    //处理全部单元；返回前所有计算线程已退出。缓冲区总大小溢出或分配失败时返回IoError
+    PipelineStatus run() {
+        //单元大小由Job决定：对齐、相加与乘以depth都不能回绕
+        const size_t limit = SIZE_MAX / 4 / opt.depth;
+        if (job.in_capacity() > limit || job.out_capacity() > limit) {
+            return PipelineStatus::IoError;
+        }
+        size_t in_cap = (job.in_capacity() + 63) & ~(size_t)63;
+        slot_bytes = (in_cap + job.out_capacity() + PAGE - 1) & ~(PAGE - 1);
+        if (slot_bytes == 0) {
+            slot_bytes = PAGE;
+        }
+        memory.reset((uint8_t*)aligned_alloc(PAGE, slot_bytes * opt.depth));
+        if (!memory) {
+            return PipelineStatus::IoError;
+        }
+        std::vector<iovec> iov;
+        try {
+            slots.resize(opt.depth);
+            ready.assign(opt.depth, -1);
+            iov.resize(opt.depth);
+            free_slots.reserve(opt.depth);
+        }
+        catch (const std::bad_alloc&) {
+            return PipelineStatus::IoError;
+        }
+        work_efd = eventfd(0, EFD_SEMAPHORE | EFD_CLOEXEC);
+        done_efd = eventfd(0, EFD_CLOEXEC);
+        if (work_efd < 0 || done_efd < 0) {
+            if (work_efd >= 0) close(work_efd);
+            if (done_efd >= 0) close(done_efd);
+            return PipelineStatus::IoError;
+        }
+        for (unsigned s = 0; s < opt.depth; s++) {
+            slots[s].in = memory.get() + s * slot_bytes;
+            slots[s].out = slots[s].in + in_cap;
+            iov[s].iov_base = slots[s].in;
+            iov[s].iov_len = slot_bytes;
+            free_slots.push_back(opt.depth - 1 - s);
+        }
+
+        //每个缓冲区同时最多一个读或写请求，另加一个eventfd读请求
+        uring = opt.use_uring && ring.init(2 * opt.depth + 2);
+        fixed = uring && ring.register_buffers(iov.data(), opt.depth);
+
+        for (unsigned w = 0; w < opt.workers; w++) {
+            workers.emplace_back(&FilePipeline::worker_loop, this);
+        }
+        if (uring) {
+            run_uring();
+        }
+        else {
+            run_sync();
+        }
+        //交给计算线程的单元已全部交回（in_use为0），或io_uring出错时等待剩余的计算结束
+        const unsigned stop = STOP;
+        for (unsigned w = 0; w < opt.workers; w++) {
+            while (!work.try_push(stop)) {
+                std::this_thread::yield();
+            }
+            post(work_efd);
+        }
+        for (auto& t : workers) {
+            t.join();
+        }
+        close(work_efd);
+        close(done_efd);
+        if (status == PipelineStatus::Ok && completed != job.units()) {
+            status = PipelineStatus::IoError;
+        }
+        return status;
+    }
+
+    //本次是否使用了io_uring与登记的固定缓冲区
+    bool used_uring() const {
+        return uring;
+    }
+    bool used_fixed_buffers() const {
+        return fixed;
+    }
+};
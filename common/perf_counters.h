@@ -0,0 +1,383 @@
+#pragma once
+//可选的硬件性能计数器插桩：按内核（SM4单块/多分组、GHASH、SM3压缩、Merkle建树）与阶段统计
+//cycles、instructions、L1D读缺失、分支预测失败，程序结束时输出汇总。
+//
+//   编译时定义CRYPTO_PERF启用，否则CRYPTO_PERF_SCOPE/CRYPTO_PERF_PHASE只对参数求值后丢弃（不产生未使用参数的警告），热路径上没有任何开销；
+//   每个线程第一次进入插桩点时用perf_event_open打开一个计数器组（组内计数器同时调度，比值可直接比较），
+//   只统计用户态，插桩点自身的read系统调用不计入被测内核；
+//   硬件计数器不可用（虚拟机、perf_event_paranoid过高）时退回软件事件task-clock与上下文切换次数，
+//   task-clock包含插桩点自身的系统调用时间，只适合粗粒度的比较；
+//   环境变量CRYPTO_PERF_RAW="名称:0x编码,..."追加原始事件，例如各执行端口的uops计数；
+//   环境变量CRYPTO_PERF_OUT指定汇总输出文件，默认输出到stderr。
+//
+//嵌套的插桩点分别计数（外层包含内层），例如merkle.build包含其中的sm3.compress。
+//每次进出插桩点各有一次read系统调用（约1微秒），单块级别的插桩会显著拉长运行时间，
+//但只统计用户态的计数不受影响。
+
+#ifdef CRYPTO_PERF
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace crypto_perf {
+
+static const int MAX_EVENTS = 8;
+
+struct EventSpec {
+    std::string name;
+    uint32_t type;
+    uint64_t config;
+};
+
+//一个（内核，阶段）的累计值
+struct Totals {
+    const char* kernel;
+    int phase;
+    uint64_t calls;
+    uint64_t value[MAX_EVENTS];
+};
+
+//全局汇总：各线程退出时（或输出汇总时）把本线程的累计值并入
+class Registry {
+    std::mutex lock;
+    std::vector<std::string> phases;
+    std::vector<std::string> events;
+    std::vector<Totals> totals;
+    bool reported;
+
+public:
+    Registry() : phases(1, "default"), reported(false) {}
+
+    //程序结束时若尚未输出过则自动输出一次
+    ~Registry() {
+        if (!reported && !totals.empty()) {
+            const char* path = getenv("CRYPTO_PERF_OUT");
+            FILE* f = path ? fopen(path, "w") : nullptr;
+            report(f ? f : stderr);
+            if (f) {
+                fclose(f);
+            }
+        }
+    }
+
+    int phase_id(const std::string& name) {
+        std::lock_guard<std::mutex> g(lock);
+        for (size_t i = 0; i < phases.size(); i++) {
+            if (phases[i] == name) {
+                return (int)i;
+            }
+        }
+        phases.push_back(name);
+        return (int)phases.size() - 1;
+    }
+
+    //记录实际打开的事件名（各线程打开结果相同，以第一个线程为准）
+    void set_events(const std::vector<std::string>& names) {
+        std::lock_guard<std::mutex> g(lock);
+        if (events.empty()) {
+            events = names;
+        }
+    }
+
+    void merge(const std::vector<Totals>& local) {
+        std::lock_guard<std::mutex> g(lock);
+        for (const Totals& t : local) {
+            Totals* dst = nullptr;
+            for (Totals& d : totals) {
+                if (d.phase == t.phase && strcmp(d.kernel, t.kernel) == 0) {
+                    dst = &d;
+                    break;
+                }
+            }
+            if (!dst) {
+                totals.push_back(t);
+                continue;
+            }
+            dst->calls += t.calls;
+            for (int e = 0; e < MAX_EVENTS; e++) {
+                dst->value[e] += t.value[e];
+            }
+        }
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> g(lock);
+        totals.clear();
+    }
+
+    //按阶段、内核输出总量与每次调用的平均值；有cycles与instructions时给出IPC
+    void report(FILE* f) {
+        std::lock_guard<std::mutex> g(lock);
+        reported = true;
+        if (totals.empty()) {
+            fprintf(f, "[perf] 没有插桩记录\n");
+            return;
+        }
+        if (events.empty()) {
+            fprintf(f, "[perf] 无法打开性能计数器（检查/proc/sys/kernel/perf_event_paranoid），只统计调用次数\n");
+        }
+        int cyc = -1, ins = -1;
+        for (size_t e = 0; e < events.size(); e++) {
+            if (events[e] == "cycles") cyc = (int)e;
+            if (events[e] == "instructions") ins = (int)e;
+        }
+        fprintf(f, "[perf] %-28s %-14s %12s", "阶段", "内核", "调用次数");
+        for (auto& name : events) {
+            fprintf(f, " %16s", (name + "/次").c_str());
+        }
+        fprintf(f, "%s\n", cyc >= 0 && ins >= 0 ? "      IPC" : "");
+        for (size_t p = 0; p < phases.size(); p++) {
+            for (const Totals& t : totals) {
+                if (t.phase != (int)p) {
+                    continue;
+                }
+                fprintf(f, "[perf] %-28s %-14s %12llu", phases[p].c_str(), t.kernel, (unsigned long long)t.calls);
+                for (size_t e = 0; e < events.size(); e++) {
+                    fprintf(f, " %16.1f", (double)t.value[e] / t.calls);
+                }
+                if (cyc >= 0 && ins >= 0) {
+                    fprintf(f, " %8.2f", t.value[cyc] ? (double)t.value[ins] / t.value[cyc] : 0.0);
+                }
+                fprintf(f, "\n");
+            }
+        }
+    }
+};
+
+inline Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+//当前线程所处的阶段
+inline int& current_phase() {
+    thread_local int phase = 0;
+    return phase;
+}
+
+//默认事件与CRYPTO_PERF_RAW中的原始事件
+inline std::vector<EventSpec> hardware_events() {
+    std::vector<EventSpec> ev;
+#ifdef __linux__
+    ev.push_back({ "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES });
+    ev.push_back({ "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS });
+    ev.push_back({ "L1D-read-miss", PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) });
+    ev.push_back({ "branch-miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES });
+    const char* raw = getenv("CRYPTO_PERF_RAW");
+    std::string list = raw ? raw : "";
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string item = list.substr(pos, end - pos);
+        size_t colon = item.find(':');
+        if (colon != std::string::npos) {
+            ev.push_back({ item.substr(0, colon), PERF_TYPE_RAW, strtoull(item.c_str() + colon + 1, nullptr, 0) });
+        }
+        pos = end + 1;
+    }
+#endif
+    return ev;
+}
+
+inline std::vector<EventSpec> software_events() {
+    std::vector<EventSpec> ev;
+#ifdef __linux__
+    ev.push_back({ "task-clock-ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK });
+    ev.push_back({ "ctx-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES });
+#endif
+    return ev;
+}
+
+//每个线程一个计数器组，线程退出时并入全局汇总
+class ThreadCounters {
+    int fds[MAX_EVENTS];
+    int n;
+    std::vector<Totals> local;
+    Totals* last;
+
+#ifdef __linux__
+    static int open_event(const EventSpec& s, int group) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = s.type;
+        attr.config = s.config;
+        attr.disabled = group < 0 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+    }
+
+    //组长失败的事件跳过，组员失败（PMU计数器不够等）也跳过
+    bool open_group(const std::vector<EventSpec>& specs, std::vector<std::string>& names) {
+        for (const EventSpec& s : specs) {
+            if (n == MAX_EVENTS) {
+                break;
+            }
+            int fd = open_event(s, n == 0 ? -1 : fds[0]);
+            if (fd < 0) {
+                continue;
+            }
+            fds[n++] = fd;
+            names.push_back(s.name);
+        }
+        return n > 0;
+    }
+#endif
+
+public:
+    ThreadCounters() : n(0), last(nullptr) {
+        std::vector<std::string> names;
+#ifdef __linux__
+        if (!open_group(hardware_events(), names)) {
+            open_group(software_events(), names);
+        }
+        if (n > 0) {
+            ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+        registry().set_events(names);
+    }
+
+    ~ThreadCounters() {
+        flush();
+        for (int i = 0; i < n; i++) {
+#ifdef __linux__
+            close(fds[i]);
+#endif
+        }
+    }
+
+    ThreadCounters(const ThreadCounters&) = delete;
+    ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+    //读取组内全部计数器的当前值
+    void read_values(uint64_t v[MAX_EVENTS]) const {
+        memset(v, 0, sizeof(uint64_t) * MAX_EVENTS);
+#ifdef __linux__
+        if (n == 0) {
+            return;
+        }
+        uint64_t buf[1 + MAX_EVENTS];
+        if (read(fds[0], buf, sizeof(buf)) > 0) {
+            uint64_t nr = buf[0] < (uint64_t)n ? buf[0] : (uint64_t)n;
+            memcpy(v, buf + 1, sizeof(uint64_t) * nr);
+        }
+#endif
+    }
+
+    void add(const char* kernel, const uint64_t start[MAX_EVENTS], const uint64_t end[MAX_EVENTS]) {
+        int phase = current_phase();
+        //同一内核连续调用时直接命中上一次的条目
+        if (!last || last->kernel != kernel || last->phase != phase) {
+            last = nullptr;
+            for (Totals& t : local) {
+                if (t.kernel == kernel && t.phase == phase) {
+                    last = &t;
+                    break;
+                }
+            }
+            if (!last) {
+                Totals t;
+                memset(&t, 0, sizeof(t));
+                t.kernel = kernel;
+                t.phase = phase;
+                local.push_back(t);
+                last = &local.back();
+            }
+        }
+        last->calls++;
+        for (int e = 0; e < n; e++) {
+            last->value[e] += end[e] - start[e];
+        }
+    }
+
+    //把本线程的累计值并入全局汇总并清零
+    void flush() {
+        registry().merge(local);
+        local.clear();
+        last = nullptr;
+    }
+};
+
+inline ThreadCounters& thread_counters() {
+    thread_local ThreadCounters c;
+    return c;
+}
+
+//插桩点：构造时读取计数器，析构时把差值计入（内核，当前阶段）
+class Scope {
+    const char* kernel;
+    uint64_t start[MAX_EVENTS];
+
+public:
+    explicit Scope(const char* name) : kernel(name) {
+        thread_counters().read_values(start);
+    }
+    ~Scope() {
+        uint64_t end[MAX_EVENTS];
+        ThreadCounters& c = thread_counters();
+        c.read_values(end);
+        c.add(kernel, start, end);
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+
+//阶段：作用域内当前线程的插桩计入该阶段，结束时恢复原阶段
+class Phase {
+    int prev;
+
+public:
+    explicit Phase(const std::string& name) : prev(current_phase()) {
+        current_phase() = registry().phase_id(name);
+    }
+    ~Phase() {
+        current_phase() = prev;
+    }
+    Phase(const Phase&) = delete;
+    Phase& operator=(const Phase&) = delete;
+};
+
+//输出汇总（调用线程自己的累计值先并入；其他线程须已退出或已flush）
+inline void report(FILE* f = stderr) {
+    thread_counters().flush();
+    registry().report(f);
+}
+
+inline void reset() {
+    thread_counters().flush();
+    registry().reset();
+}
+
+}
+
+#define CRYPTO_PERF_CONCAT2(a, b) a##b
+#define CRYPTO_PERF_CONCAT(a, b) CRYPTO_PERF_CONCAT2(a, b)
+#define CRYPTO_PERF_SCOPE(kernel) ::crypto_perf::Scope CRYPTO_PERF_CONCAT(crypto_perf_scope_, __LINE__)(kernel)
+#define CRYPTO_PERF_PHASE(name) ::crypto_perf::Phase CRYPTO_PERF_CONCAT(crypto_perf_phase_, __LINE__)(name)
+
+#else
+
+#define CRYPTO_PERF_SCOPE(kernel) ((void)(kernel))
+#define CRYPTO_PERF_PHASE(name) ((void)(name))
+
+#endif
@@ -0,0 +1,451 @@
+#pragma once
+//常驻的运行时遥测：按操作（SM4单块/多分组、GCM加解密、GMAC、SM3、Merkle建树与证明）累计
+//调用次数、字节数、分组数、验证失败次数，以及HDR式的延迟直方图，按需取快照或输出文本。
+//
+//   编译时定义CRYPTO_TELEMETRY启用，否则CRYPTO_TELEMETRY_*宏展开为空，生成的代码与没有遥测时相同；
+//   每个线程写自己的计数槽（按缓存行对齐，线程之间不共享缓存行），热路径上没有锁和原子读改写，
+//   只是普通的加法后relaxed写回，快照时再把各线程的槽加在一起；线程退出时其计数并入全局；
+//   延迟用TSC计时（非x86退回steady_clock），直方图按对数分段、每段16个线性子桶，相对误差约6%；
+//   SM4单块与多分组只计数不计时（计时本身与单块加密的开销相当），报文级操作都计时；
+//   环境变量CRYPTO_TELEMETRY_OUT指定文件时，程序结束时把文本输出写入该文件。
+//
+//嵌套的操作分别计数，例如gcm.encrypt内部的密钥流也计入sm4.blocks。
+
+#ifdef CRYPTO_TELEMETRY
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CRYPTO_TELEMETRY_TSC
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CRYPTO_TELEMETRY_TSC
+#endif
+
+namespace crypto_telemetry {
+
+static const int MAX_OPS = 64;
+static const int SUB_BITS = 4;
+static const int SUB_COUNT = 1 << SUB_BITS;
+//值小于16时每个值一个桶，之后每个2的幂区间16个桶，覆盖全部64位
+static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+inline uint64_t now_ticks() {
+#ifdef CRYPTO_TELEMETRY_TSC
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline int highest_bit(uint64_t v) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return (int)idx;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+inline int bucket_of(uint64_t v) {
+    if (v < (uint64_t)SUB_COUNT) {
+        return (int)v;
+    }
+    int msb = highest_bit(v);
+    return ((msb - SUB_BITS + 1) << SUB_BITS) + (int)((v >> (msb - SUB_BITS)) & (SUB_COUNT - 1));
+}
+
+//桶的下界与宽度（单位与记录时相同）
+inline void bucket_range(int i, uint64_t& lower, uint64_t& width) {
+    if (i < SUB_COUNT) {
+        lower = (uint64_t)i;
+        width = 1;
+        return;
+    }
+    int msb = (i >> SUB_BITS) + SUB_BITS - 1;
+    lower = (uint64_t)(SUB_COUNT + (i & (SUB_COUNT - 1))) << (msb - SUB_BITS);
+    width = 1ull << (msb - SUB_BITS);
+}
+
+//一个线程、一个操作的计数槽；只有所属线程写入，其他线程只读
+struct alignas(64) OpSlot {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> blocks;
+    std::atomic<uint64_t> failures;
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> ticks_sum;
+    std::atomic<uint64_t> ticks_max;
+    std::atomic<uint64_t> buckets[BUCKETS];
+
+    OpSlot() : calls(0), bytes(0), blocks(0), failures(0), samples(0), ticks_sum(0), ticks_max(0) {
+        for (auto& b : buckets) {
+            b.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+//单写者的累加：不需要lock前缀，读者看到的总是某个完整的旧值或新值
+inline void bump(std::atomic<uint64_t>& a, uint64_t v) {
+    a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+//某个操作在快照时刻的汇总
+struct OpSnapshot {
+    std::string name;
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t blocks;
+    uint64_t failures;
+    uint64_t samples;           //计时的调用次数
+    double sum_ns;
+    double max_ns;
+    std::vector<std::pair<double, uint64_t>> histogram;  //非空桶：（桶上界ns，计数）
+
+    //分位数（ns），取所在桶的上界；没有计时样本时为0
+    double quantile(double q) const {
+        if (samples == 0) {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(q * (double)samples);
+        if (rank >= samples) {
+            rank = samples - 1;
+        }
+        uint64_t seen = 0;
+        for (auto& b : histogram) {
+            seen += b.second;
+            if (seen > rank) {
+                return b.first < max_ns ? b.first : max_ns;
+            }
+        }
+        return max_ns;
+    }
+
+    double mean_ns() const {
+        return samples ? sum_ns / samples : 0;
+    }
+};
+
+class Registry;
+inline Registry& registry();
+
+//每个线程的计数槽表，按操作编号懒分配
+class ThreadSlots {
+public:
+    std::atomic<OpSlot*> slots[MAX_OPS];
+
+    ThreadSlots();
+    ~ThreadSlots();
+    ThreadSlots(const ThreadSlots&) = delete;
+    ThreadSlots& operator=(const ThreadSlots&) = delete;
+
+    OpSlot& slot(int op) {
+        OpSlot* s = slots[op].load(std::memory_order_relaxed);
+        if (!s) {
+            s = new OpSlot();
+            slots[op].store(s, std::memory_order_release);
+        }
+        return *s;
+    }
+};
+
+//全局注册表：操作名、存活线程的槽表、已退出线程的累计
+class Registry {
+    std::mutex lock;
+    std::string names[MAX_OPS];
+    std::atomic<int> count;
+    std::vector<ThreadSlots*> live;
+    ThreadSlots retired;
+    //TSC与纳秒的换算：从注册表创建起的两段时间之比，不需要专门的校准等待
+    uint64_t base_ticks;
+    std::chrono::steady_clock::time_point base_time;
+
+    static void add_slot(OpSlot& dst, const OpSlot& src) {
+        bump(dst.calls, src.calls.load(std::memory_order_relaxed));
+        bump(dst.bytes, src.bytes.load(std::memory_order_relaxed));
+        bump(dst.blocks, src.blocks.load(std::memory_order_relaxed));
+        bump(dst.failures, src.failures.load(std::memory_order_relaxed));
+        bump(dst.samples, src.samples.load(std::memory_order_relaxed));
+        bump(dst.ticks_sum, src.ticks_sum.load(std::memory_order_relaxed));
+        uint64_t m = src.ticks_max.load(std::memory_order_relaxed);
+        if (m > dst.ticks_max.load(std::memory_order_relaxed)) {
+            dst.ticks_max.store(m, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < BUCKETS; i++) {
+            uint64_t c = src.buckets[i].load(std::memory_order_relaxed);
+            if (c) {
+                bump(dst.buckets[i], c);
+            }
+        }
+    }
+
+public:
+    Registry() : count(0), base_ticks(now_ticks()), base_time(std::chrono::steady_clock::now()) {}
+
+    //按名字取操作编号，同名操作（例如不同命名空间中包含的同一源文件）共用编号；超出上限时返回-1
+    int op_id(const char* name) {
+        std::lock_guard<std::mutex> g(lock);
+        int n = count.load(std::memory_order_relaxed);
+        for (int i = 0; i < n; i++) {
+            if (names[i] == name) {
+                return i;
+            }
+        }
+        if (n == MAX_OPS) {
+            return -1;
+        }
+        names[n] = name;
+        count.store(n + 1, std::memory_order_release);
+        return n;
+    }
+
+    void attach(ThreadSlots* t) {
+        std::lock_guard<std::mutex> g(lock);
+        live.push_back(t);
+    }
+
+    //线程退出：计数并入retired，槽表从存活列表移除
+    void detach(ThreadSlots* t) {
+        std::lock_guard<std::mutex> g(lock);
+        for (int i = 0; i < MAX_OPS; i++) {
+            OpSlot* s = t->slots[i].load(std::memory_order_acquire);
+            if (s) {
+                add_slot(retired.slot(i), *s);
+            }
+        }
+        for (size_t i = 0; i < live.size(); i++) {
+            if (live[i] == t) {
+                live[i] = live.back();
+                live.pop_back();
+                break;
+            }
+        }
+    }
+
+    double ns_per_tick() {
+#ifdef CRYPTO_TELEMETRY_TSC
+        uint64_t ticks = now_ticks() - base_ticks;
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - base_time).count();
+        return ticks ? ns / (double)ticks : 0;
+#else
+        return 1.0;
+#endif
+    }
+
+    //汇总所有线程（含已退出线程）的计数；只列出有调用记录的操作
+    std::vector<OpSnapshot> snapshot() {
+        double scale = ns_per_tick();
+        std::lock_guard<std::mutex> g(lock);
+        std::vector<OpSnapshot> out;
+        int n = count.load(std::memory_order_acquire);
+        for (int op = 0; op < n; op++) {
+            OpSlot total;
+            auto collect = [&](ThreadSlots* t) {
+                OpSlot* s = t->slots[op].load(std::memory_order_acquire);
+                if (s) {
+                    add_slot(total, *s);
+                }
+            };
+            collect(&retired);
+            for (ThreadSlots* t : live) {
+                collect(t);
+            }
+            OpSnapshot snap;
+            snap.name = names[op];
+            snap.calls = total.calls.load(std::memory_order_relaxed);
+            if (snap.calls == 0) {
+                continue;
+            }
+            snap.bytes = total.bytes.load(std::memory_order_relaxed);
+            snap.blocks = total.blocks.load(std::memory_order_relaxed);
+            snap.failures = total.failures.load(std::memory_order_relaxed);
+            snap.samples = total.samples.load(std::memory_order_relaxed);
+            snap.sum_ns = total.ticks_sum.load(std::memory_order_relaxed) * scale;
+            snap.max_ns = total.ticks_max.load(std::memory_order_relaxed) * scale;
+            for (int i = 0; i < BUCKETS; i++) {
+                uint64_t c = total.buckets[i].load(std::memory_order_relaxed);
+                if (c) {
+                    uint64_t lower, width;
+                    bucket_range(i, lower, width);
+                    snap.histogram.emplace_back((double)(lower + width) * scale, c);
+                }
+            }
+            out.push_back(std::move(snap));
+        }
+        return out;
+    }
+};
+
+inline ThreadSlots::ThreadSlots() {
+    for (auto& s : slots) {
+        s.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+inline ThreadSlots::~ThreadSlots() {
+    for (auto& s : slots) {
+        delete s.load(std::memory_order_relaxed);
+    }
+}
+
+//文本输出，格式与Prometheus的文本exposition兼容：计数器 + 带分位数的summary
+inline void write_text(FILE* f, const std::vector<OpSnapshot>& ops) {
+    static const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+    fprintf(f, "# TYPE crypto_calls_total counter\n");
+    for (auto& s : ops) {
+        fprintf(f, "crypto_calls_total{op=\"%s\"} %llu\n", s.name.c_str(), (unsigned long long)s.calls);
+    }
+    fprintf(f, "# TYPE crypto_bytes_total counter\n");
+    for (auto& s : ops) {
+        fprintf(f, "crypto_bytes_total{op=\"%s\"} %llu\n", s.name.c_str(), (unsigned long long)s.bytes);
+    }
+    fprintf(f, "# TYPE crypto_blocks_total counter\n");
+    for (auto& s : ops) {
+        fprintf(f, "crypto_blocks_total{op=\"%s\"} %llu\n", s.name.c_str(), (unsigned long long)s.blocks);
+    }
+    fprintf(f, "# TYPE crypto_failures_total counter\n");
+    for (auto& s : ops) {
+        fprintf(f, "crypto_failures_total{op=\"%s\"} %llu\n", s.name.c_str(), (unsigned long long)s.failures);
+    }
+    fprintf(f, "# TYPE crypto_latency_ns summary\n");
+    for (auto& s : ops) {
+        if (s.samples == 0) {
+            continue;
+        }
+        for (double q : QUANTILES) {
+            fprintf(f, "crypto_latency_ns{op=\"%s\",quantile=\"%g\"} %.0f\n", s.name.c_str(), q, s.quantile(q));
+        }
+        fprintf(f, "crypto_latency_ns_sum{op=\"%s\"} %.0f\n", s.name.c_str(), s.sum_ns);
+        fprintf(f, "crypto_latency_ns_count{op=\"%s\"} %llu\n", s.name.c_str(), (unsigned long long)s.samples);
+    }
+}
+
+//程序结束时若设置了CRYPTO_TELEMETRY_OUT则输出一次（主线程的thread_local先于它析构）
+struct ExitDump {
+    ~ExitDump();
+};
+
+//注册表不析构：其他线程的thread_local可能在静态对象析构之后才退出
+inline Registry& registry() {
+    static Registry* r = new Registry();
+    static ExitDump dump;
+    return *r;
+}
+
+inline ThreadSlots& attached_slots() {
+    struct Attached : ThreadSlots {
+        Attached() {
+            registry().attach(this);
+        }
+        ~Attached() {
+            registry().detach(this);
+        }
+    };
+    thread_local Attached t;
+    return t;
+}
+
+//热路径上只读一个平凡的thread_local指针，不经过带构造函数的thread_local的初始化检查
+inline ThreadSlots& thread_slots() {
+    thread_local ThreadSlots* cached = nullptr;
+    if (!cached) {
+        cached = &attached_slots();
+    }
+    return *cached;
+}
+
+inline std::vector<OpSnapshot> snapshot() {
+    return registry().snapshot();
+}
+
+inline void write_text(FILE* f = stdout) {
+    write_text(f, snapshot());
+}
+
+inline ExitDump::~ExitDump() {
+    const char* path = getenv("CRYPTO_TELEMETRY_OUT");
+    FILE* f = path ? fopen(path, "w") : nullptr;
+    if (f) {
+        write_text(f, registry().snapshot());
+        fclose(f);
+    }
+}
+
+//只计数
+inline void count(int op, uint64_t bytes, uint64_t blocks) {
+    if (op < 0) {
+        return;
+    }
+    OpSlot& s = thread_slots().slot(op);
+    bump(s.calls, 1);
+    bump(s.bytes, bytes);
+    bump(s.blocks, blocks);
+}
+
+//计数并计时：构造时读TSC，析构时计入直方图；fail()记验证失败
+class Scope {
+    int op;
+    uint64_t nbytes;
+    uint64_t nblocks;
+    uint64_t nfailed;
+    uint64_t start;
+
+public:
+    Scope(int id, uint64_t bytes, uint64_t blocks)
+        : op(id), nbytes(bytes), nblocks(blocks), nfailed(0), start(now_ticks()) {}
+    ~Scope() {
+        uint64_t ticks = now_ticks() - start;
+        if (op < 0) {
+            return;
+        }
+        OpSlot& s = thread_slots().slot(op);
+        bump(s.calls, 1);
+        bump(s.bytes, nbytes);
+        bump(s.blocks, nblocks);
+        bump(s.failures, nfailed);
+        bump(s.samples, 1);
+        bump(s.ticks_sum, ticks);
+        if (ticks > s.ticks_max.load(std::memory_order_relaxed)) {
+            s.ticks_max.store(ticks, std::memory_order_relaxed);
+        }
+        bump(s.buckets[bucket_of(ticks)], 1);
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    //批量接口一次调用可能有多个报文验证失败
+    void fail(uint64_t n = 1) {
+        nfailed += n;
+    }
+};
+
+}
+
+//每个插桩点的操作编号在第一次经过时查一次，之后只是函数内静态变量的读取
+#define CRYPTO_TELEMETRY_OP(name) \
+    ([]() { static const int crypto_telemetry_id = ::crypto_telemetry::registry().op_id(name); return crypto_telemetry_id; }())
+#define CRYPTO_TELEMETRY_SCOPE(var, name, bytes, blocks) \
+    ::crypto_telemetry::Scope var(CRYPTO_TELEMETRY_OP(name), (uint64_t)(bytes), (uint64_t)(blocks))
+#define CRYPTO_TELEMETRY_FAIL(var, n) var.fail(n)
+#define CRYPTO_TELEMETRY_COUNT(name, bytes, blocks) \
+    ::crypto_telemetry::count(CRYPTO_TELEMETRY_OP(name), (uint64_t)(bytes), (uint64_t)(blocks))
+
+#else
+
+#define CRYPTO_TELEMETRY_SCOPE(var, name, bytes, blocks) ((void)0)
+#define CRYPTO_TELEMETRY_FAIL(var, n) ((void)0)
+#define CRYPTO_TELEMETRY_COUNT(name, bytes, blocks) ((void)0)
+
+#endif
@@ -0,0 +1,275 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+//所有批量加密路径共用的工作窃取线程池：工作线程只在构造时创建一次，
+//多个并行任务同时提交时共享同一组线程，不会按调用各自起线程而超额占用CPU。
+//
+//   每个工作线程一个双端队列：本线程从尾部取（后进先出，刚拆出的子区间数据还在缓存中），
+//   其他线程从头部窃取（先进先出，偷到的是较大的区间）；
+//   parallel_for按需二分：取到的区间大于grain时把右半部分放回队列供窃取，左半部分继续拆分，
+//   grain按缓存大小的数据量选取（见CHUNK_BYTES），负载不均时由窃取自动平衡；
+//   工作线程内部再调用parallel_for（嵌套）时，等待期间本线程继续执行队列中的任务，不会死锁；
+//   外部线程调用时只等待不参与执行，池的线程数就是同时运行的计算线程数；
+//   pin为true时工作线程i绑定到CPU i（仅Linux）。
+//
+//任务体不应抛出异常。
+class ThreadPool {
+public:
+    //一个任务处理的数据量：约为L2缓存大小，分块内CTR写出的数据在GHASH时仍在缓存中
+    static const size_t CHUNK_BYTES = 256 * 1024;
+
+private:
+    struct Group {
+        std::atomic<size_t> pending;
+        std::mutex lock;
+        std::condition_variable done;
+    };
+
+    struct Task {
+        void (*run)(void* body, size_t lo, size_t hi);
+        void* body;
+        size_t lo;
+        size_t hi;
+        size_t grain;
+        Group* group;
+    };
+
+    //每个队列独占缓存行，避免相邻工作线程的锁互相干扰
+    struct alignas(64) Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued;        //所有队列中的任务总数
+    std::atomic<size_t> next_queue;    //外部提交时轮流选择队列
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+    bool stopping;
+
+    //当前线程所属的池与队列编号，外部线程为nullptr
+    static ThreadPool*& current_pool() {
+        thread_local ThreadPool* pool = nullptr;
+        return pool;
+    }
+    static size_t& current_index() {
+        thread_local size_t index = 0;
+        return index;
+    }
+
+    bool is_worker() const {
+        return current_pool() == this;
+    }
+
+    void push(const Task& t) {
+        size_t q = is_worker() ? current_index() : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        {
+            std::lock_guard<std::mutex> g(queues[q]->lock);
+            queues[q]->tasks.push_back(t);
+        }
+        queued.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> g(sleep_lock);
+        }
+        wake.notify_one();
+    }
+
+    //先取本线程队列的尾部，再依次从其他队列的头部窃取
+    bool take(size_t self, Task& t) {
+        if (queued.load() == 0) {
+            return false;
+        }
+        size_t n = queues.size();
+        for (size_t k = 0; k < n; k++) {
+            size_t q = (self + k) % n;
+            std::lock_guard<std::mutex> g(queues[q]->lock);
+            std::deque<Task>& d = queues[q]->tasks;
+            if (d.empty()) {
+                continue;
+            }
+            if (k == 0) {
+                t = d.back();
+                d.pop_back();
+            }
+            else {
+                t = d.front();
+                d.pop_front();
+            }
+            queued.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    void execute(Task t) {
+        while (t.hi - t.lo > t.grain) {
+            size_t mid = t.lo + (t.hi - t.lo) / 2;
+            Task right = t;
+            right.lo = mid;
+            t.group->pending.fetch_add(1);
+            push(right);
+            t.hi = mid;
+        }
+        t.run(t.body, t.lo, t.hi);
+        //计数在锁内减到0：等待方拿到锁后才返回并销毁Group，此后这里不会再访问它
+        std::lock_guard<std::mutex> g(t.group->lock);
+        if (t.group->pending.fetch_sub(1) == 1) {
+            t.group->done.notify_all();
+        }
+    }
+
+    void worker_loop(size_t index, bool pin) {
+        current_pool() = this;
+        current_index() = index;
+#ifdef __linux__
+        if (pin) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(index % CPU_SETSIZE, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+#else
+        (void)pin;
+#endif
+        for (;;) {
+            Task t;
+            if (take(index, t)) {
+                execute(t);
+                continue;
+            }
+            std::unique_lock<std::mutex> g(sleep_lock);
+            if (stopping) {
+                return;
+            }
+            if (queued.load() == 0) {
+                wake.wait(g);
+            }
+        }
+    }
+
+    //等待一组任务完成：工作线程边等边执行任务，外部线程阻塞等待
+    void wait(Group& group) {
+        if (is_worker()) {
+            size_t self = current_index();
+            while (group.pending.load() > 0) {
+                Task t;
+                if (take(self, t)) {
+                    execute(t);
+                }
+                else {
+                    std::this_thread::yield();
+                }
+            }
+            std::lock_guard<std::mutex> g(group.lock);
+            return;
+        }
+        std::unique_lock<std::mutex> g(group.lock);
+        group.done.wait(g, [&]() { return group.pending.load() == 0; });
+    }
+
+    template <class F>
+    static void invoke(void* body, size_t lo, size_t hi) {
+        (*static_cast<F*>(body))(lo, hi);
+    }
+
+    //环境变量CRYPTO_THREADS：整个字符串须为十进制数（不接受符号与空白），否则忽略（返回0）；过大时取MAX_WORKERS
+    static unsigned env_threads() {
+        const char* env = getenv("CRYPTO_THREADS");
+        if (env == nullptr || *env < '0' || *env > '9') {
+            return 0;
+        }
+        char* end = nullptr;
+        unsigned long v = strtoul(env, &end, 10);
+        if (*end != '\0') {
+            return 0;
+        }
+        return v > MAX_WORKERS ? MAX_WORKERS : (unsigned)v;
+    }
+
+public:
+    //线程数上限，超过时按上限创建
+    static const unsigned MAX_WORKERS = 1024;
+
+    //workers为0时取硬件线程数（环境变量CRYPTO_THREADS可覆盖，无效时忽略）
+    explicit ThreadPool(unsigned nworkers = 0, bool pin = false) : queued(0), next_queue(0), stopping(false) {
+        if (nworkers == 0) {
+            nworkers = env_threads();
+        }
+        if (nworkers == 0) {
+            nworkers = std::thread::hardware_concurrency();
+        }
+        if (nworkers == 0) {
+            nworkers = 1;
+        }
+        if (nworkers > MAX_WORKERS) {
+            nworkers = MAX_WORKERS;
+        }
+        for (unsigned i = 0; i < nworkers; i++) {
+            queues.emplace_back(new Queue());
+        }
+        for (unsigned i = 0; i < nworkers; i++) {
+            workers.emplace_back(&ThreadPool::worker_loop, this, (size_t)i, pin);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> g(sleep_lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& w : workers) {
+            w.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //工作线程数，即同时运行的计算线程数
+    unsigned size() const {
+        return (unsigned)workers.size();
+    }
+
+    //进程内共享的默认线程池，第一次使用时创建
+    static ThreadPool& global() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    //对[begin, end)并行执行body(lo, hi)，每段不超过grain个元素；返回时全部完成
+    template <class F>
+    void parallel_for(size_t begin, size_t end, size_t grain, F&& body) {
+        if (begin >= end) {
+            return;
+        }
+        if (grain == 0) {
+            grain = 1;
+        }
+        if (end - begin <= grain) {
+            body(begin, end);
+            return;
+        }
+        using Body = typename std::remove_reference<F>::type;
+        Group group;
+        group.pending.store(1);
+        Task t = { &ThreadPool::invoke<Body>, (void*)&body, begin, end, grain, &group };
+        push(t);
+        wait(group);
+    }
+};
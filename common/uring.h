@@ -0,0 +1,189 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+//最小的io_uring封装：直接使用io_uring_setup/io_uring_enter/io_uring_register系统调用，不依赖liburing。
+//
+//   提交队列（SQ）与完成队列（CQ）是与内核共享的环形缓冲区：用户态写入SQE后推进SQ尾指针，
+//   内核推进CQ尾指针，用户态读完CQE后推进CQ头指针；尾指针用release写、对方的指针用acquire读；
+//   登记缓冲区（register_buffers）后，READ_FIXED/WRITE_FIXED不再需要每次固定与解除固定用户页；
+//   内核不支持（较老内核、容器内被seccomp禁止）时init()返回false，调用方改用pread/pwrite。
+//
+//仅Linux；同一个IoUring对象只能由一个线程使用。
+class IoUring {
+#ifdef __linux__
+private:
+    int fd;
+    void* sq_ptr;
+    size_t sq_size;
+    void* cq_ptr;
+    size_t cq_size;
+    io_uring_sqe* sqes;
+    size_t sqes_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+
+    unsigned pending;  //已填写、尚未交给内核的SQE数
+
+    void release() {
+        if (sqes) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_ptr && cq_ptr != sq_ptr) {
+            munmap(cq_ptr, cq_size);
+        }
+        if (sq_ptr) {
+            munmap(sq_ptr, sq_size);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        fd = -1;
+        sq_ptr = cq_ptr = nullptr;
+        sqes = nullptr;
+    }
+
+public:
+    IoUring() : fd(-1), sq_ptr(nullptr), sq_size(0), cq_ptr(nullptr), cq_size(0), sqes(nullptr), sqes_size(0),
+        pending(0) {}
+
+    ~IoUring() {
+        release();
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    //创建entries项的队列；失败返回false
+    bool init(unsigned entries) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (fd < 0) {
+            return false;
+        }
+        sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            sq_size = cq_size = (sq_size > cq_size ? sq_size : cq_size);
+        }
+        sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) {
+            sq_ptr = nullptr;
+            release();
+            return false;
+        }
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            cq_ptr = sq_ptr;
+        }
+        else {
+            cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cq_ptr == MAP_FAILED) {
+                cq_ptr = nullptr;
+                release();
+                return false;
+            }
+        }
+        sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        void* s = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) {
+            release();
+            return false;
+        }
+        sqes = (io_uring_sqe*)s;
+
+        uint8_t* sq = (uint8_t*)sq_ptr;
+        uint8_t* cq = (uint8_t*)cq_ptr;
+        sq_head = (unsigned*)(sq + p.sq_off.head);
+        sq_tail = (unsigned*)(sq + p.sq_off.tail);
+        sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+        sq_array = (unsigned*)(sq + p.sq_off.array);
+        cq_head = (unsigned*)(cq + p.cq_off.head);
+        cq_tail = (unsigned*)(cq + p.cq_off.tail);
+        cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    //登记固定缓冲区，之后用buf_index引用；失败（如RLIMIT_MEMLOCK不足）返回false
+    bool register_buffers(const iovec* iov, unsigned n) {
+        return syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov, n) == 0;
+    }
+
+    //取一个空闲SQE并清零；SQ已满时返回nullptr
+    io_uring_sqe* get_sqe() {
+        unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        unsigned tail = *sq_tail + pending;
+        if (tail - head > *sq_mask) {
+            return nullptr;
+        }
+        unsigned idx = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sq_array[idx] = idx;
+        pending++;
+        return sqe;
+    }
+
+    //buf_index < 0 时为普通读写
+    static void prep_rw(io_uring_sqe* sqe, uint8_t op, int file, void* buf, unsigned len, uint64_t offset,
+        uint64_t user_data, int buf_index = -1) {
+        sqe->opcode = op;
+        sqe->fd = file;
+        sqe->addr = (uint64_t)(uintptr_t)buf;
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->user_data = user_data;
+        if (buf_index >= 0) {
+            sqe->buf_index = (uint16_t)buf_index;
+        }
+    }
+
+    //提交已填写的SQE，并等待至少min_complete个完成；返回负的errno表示失败
+    int submit_and_wait(unsigned min_complete) {
+        unsigned n = pending;
+        if (n) {
+            __atomic_store_n(sq_tail, *sq_tail + n, __ATOMIC_RELEASE);
+            pending = 0;
+        }
+        if (n == 0 && min_complete == 0) {
+            return 0;
+        }
+        int r = (int)syscall(__NR_io_uring_enter, fd, n, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0,
+            nullptr, 0);
+        return r < 0 ? -errno : r;
+    }
+
+    //取出一个完成事件；没有时返回false
+    bool pop_cqe(io_uring_cqe& out) {
+        unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        out = cqes[head & *cq_mask];
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+#else
+public:
+    bool init(unsigned) {
+        return false;
+    }
+#endif
+};
@@ -0,0 +1,92 @@
+#pragma once
+//USDT静态探针：在热路径的入口与出口放置探针点，供bpftrace/perf/SystemTap在运行中的进程上挂接，
+//例如统计每次GCM解密的延迟分布，不需要重新编译，也不需要在程序里加计时代码。
+//
+//   探针点编译为一条nop，参数说明（寄存器/栈位置）写在ELF的.note.stapsdt段中，
+//   没有挂接时不执行任何额外指令（参数只要求在该位置可取到，通常已在寄存器中）；
+//   有<sys/sdt.h>（systemtap-sdt-dev）时使用其DTRACE_PROBEn；
+//   没有时在x86-64 ELF上用与其相同格式的内联汇编生成探针说明，其他平台展开为空；
+//   定义CRYPTO_NO_USDT可完全去掉探针。
+//
+//所有探针的provider均为crypto，参数一律按64位整数传递。ctx为密钥上下文（GCM/SM3对象）的地址，
+//同一个KeyCache句柄对应同一个ctx，key_cache_load探针给出密钥ID字符串与ctx的对应关系：
+//
+//   bpftrace -e 'usdt:./prog:crypto:gcm_decrypt_entry { @s[tid] = nsecs; }
+//                usdt:./prog:crypto:gcm_decrypt_return /@s[tid]/ { @ns = hist(nsecs - @s[tid]); delete(@s[tid]); }'
+
+#if defined(CRYPTO_NO_USDT)
+
+#define CRYPTO_USDT_NOOP
+
+#elif defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define CRYPTO_USDT_SDT
+#endif
+#endif
+
+#if !defined(CRYPTO_USDT_NOOP) && !defined(CRYPTO_USDT_SDT) && (defined(__GNUC__) || defined(__clang__)) && \
+    defined(__ELF__) && defined(__x86_64__)
+#define CRYPTO_USDT_ASM
+#endif
+
+#if defined(CRYPTO_USDT_SDT)
+
+#define CRYPTO_USDT0(name) DTRACE_PROBE(crypto, name)
+#define CRYPTO_USDT1(name, a) DTRACE_PROBE1(crypto, name, (uint64_t)(a))
+#define CRYPTO_USDT2(name, a, b) DTRACE_PROBE2(crypto, name, (uint64_t)(a), (uint64_t)(b))
+#define CRYPTO_USDT3(name, a, b, c) DTRACE_PROBE3(crypto, name, (uint64_t)(a), (uint64_t)(b), (uint64_t)(c))
+#define CRYPTO_USDT4(name, a, b, c, d) \
+    DTRACE_PROBE4(crypto, name, (uint64_t)(a), (uint64_t)(b), (uint64_t)(c), (uint64_t)(d))
+
+#elif defined(CRYPTO_USDT_ASM)
+
+#include <cstdint>
+
+//与sys/sdt.h相同的布局：nop的地址、.stapsdt.base的地址（用于预链接后的重定位）、信号量（不用，为0）、
+//provider、探针名、参数说明；参数说明为"8@操作数"，操作数由"nor"约束取寄存器、立即数或内存
+#define CRYPTO_USDT_ASM_PROBE(name, args, ...) \
+    __asm__ __volatile__( \
+        "990: nop\n" \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+        ".balign 4\n" \
+        ".4byte 992f-991f, 994f-993f, 3\n" \
+        "991: .asciz \"stapsdt\"\n" \
+        "992: .balign 4\n" \
+        "993: .8byte 990b\n" \
+        ".8byte _.stapsdt.base\n" \
+        ".8byte 0\n" \
+        ".asciz \"crypto\"\n" \
+        ".asciz \"" #name "\"\n" \
+        ".asciz \"" args "\"\n" \
+        "994: .balign 4\n" \
+        ".popsection\n" \
+        ".ifndef _.stapsdt.base\n" \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+        ".weak _.stapsdt.base\n" \
+        ".hidden _.stapsdt.base\n" \
+        "_.stapsdt.base: .space 1\n" \
+        ".size _.stapsdt.base, 1\n" \
+        ".popsection\n" \
+        ".endif\n" \
+        : : __VA_ARGS__)
+
+#define CRYPTO_USDT0(name) CRYPTO_USDT_ASM_PROBE(name, "", )
+#define CRYPTO_USDT1(name, a) CRYPTO_USDT_ASM_PROBE(name, "8@%0", "nor"((uint64_t)(a)))
+#define CRYPTO_USDT2(name, a, b) \
+    CRYPTO_USDT_ASM_PROBE(name, "8@%0 8@%1", "nor"((uint64_t)(a)), "nor"((uint64_t)(b)))
+#define CRYPTO_USDT3(name, a, b, c) \
+    CRYPTO_USDT_ASM_PROBE(name, "8@%0 8@%1 8@%2", "nor"((uint64_t)(a)), "nor"((uint64_t)(b)), "nor"((uint64_t)(c)))
+#define CRYPTO_USDT4(name, a, b, c, d) \
+    CRYPTO_USDT_ASM_PROBE(name, "8@%0 8@%1 8@%2 8@%3", "nor"((uint64_t)(a)), "nor"((uint64_t)(b)), \
+        "nor"((uint64_t)(c)), "nor"((uint64_t)(d)))
+
+#else
+
+#define CRYPTO_USDT0(name) ((void)0)
+#define CRYPTO_USDT1(name, a) ((void)0)
+#define CRYPTO_USDT2(name, a, b) ((void)0)
+#define CRYPTO_USDT3(name, a, b, c) ((void)0)
+#define CRYPTO_USDT4(name, a, b, c, d) ((void)0)
+
+#endif
@@ -0,0 +1,209 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include "SM4-CCM.h"
+
+using namespace std;
+using namespace chrono;
+
+//辅助函数：打印十六进制数据
+void print_hex(const string& label, const uint8_t* data, size_t len) {
+    cout << label << ": ";
+    for (size_t i = 0; i < len; i++) {
+        cout << hex << setw(2) << setfill('0') << (int)data[i];
+    }
+    cout << dec << endl;
+}
+
+//辅助函数：十六进制字符串转字节数组
+vector<uint8_t> from_hex(const string& s) {
+    vector<uint8_t> out(s.size() / 2);
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = (uint8_t)stoi(s.substr(2 * i, 2), nullptr, 16);
+    }
+    return out;
+}
+
+//按SP 800-38C逐步实现的参考CCM：先串行CBC-MAC，再串行CTR，用于对照交错实现
+void reference_ccm(const SM4& sm4, const vector<uint8_t>& nonce, const vector<uint8_t>& aad,
+    const vector<uint8_t>& pt, size_t tag_len, vector<uint8_t>& ct, uint8_t tag[16]) {
+    size_t L = 15 - nonce.size();
+    vector<uint8_t> b(16, 0);
+    b[0] = (uint8_t)((aad.empty() ? 0 : 0x40) | ((tag_len - 2) / 2) << 3 | (L - 1));
+    memcpy(&b[1], nonce.data(), nonce.size());
+    for (size_t i = 0; i < L && i < 8; i++) {
+        b[15 - i] = (uint8_t)((uint64_t)pt.size() >> (8 * i));
+    }
+    if (!aad.empty()) {
+        size_t a = aad.size();
+        if (a < 0xff00) {
+            b.push_back((uint8_t)(a >> 8));
+            b.push_back((uint8_t)a);
+        }
+        else {
+            b.push_back(0xff);
+            b.push_back(0xfe);
+            for (int i = 3; i >= 0; i--) b.push_back((uint8_t)(a >> (8 * i)));
+        }
+        b.insert(b.end(), aad.begin(), aad.end());
+        b.resize((b.size() + 15) / 16 * 16, 0);
+    }
+    b.insert(b.end(), pt.begin(), pt.end());
+    b.resize((b.size() + 15) / 16 * 16, 0);
+
+    uint8_t Y[16] = { 0 };
+    for (size_t off = 0; off < b.size(); off += 16) {
+        for (int k = 0; k < 16; k++) Y[k] ^= b[off + k];
+        sm4.encrypt_block(Y, Y);
+    }
+    uint8_t A[16] = { 0 }, S[16];
+    A[0] = (uint8_t)(L - 1);
+    memcpy(A + 1, nonce.data(), nonce.size());
+    ct.resize(pt.size());
+    for (size_t i = 0; i <= (pt.size() + 15) / 16; i++) {
+        for (size_t k = 0; k < L && k < 8; k++) A[15 - k] = (uint8_t)((uint64_t)i >> (8 * k));
+        sm4.encrypt_block(A, S);
+        if (i == 0) {
+            for (size_t k = 0; k < tag_len; k++) tag[k] = Y[k] ^ S[k];
+            continue;
+        }
+        for (size_t k = 0; k < 16 && (i - 1) * 16 + k < pt.size(); k++) {
+            ct[(i - 1) * 16 + k] = pt[(i - 1) * 16 + k] ^ S[k];
+        }
+    }
+}
+
+//RFC 8998 SM4-CCM测试向量
+bool test_vector() {
+    vector<uint8_t> key = from_hex("0123456789abcdeffedcba9876543210");
+    vector<uint8_t> iv = from_hex("00001234567800000000abcd");
+    vector<uint8_t> aad = from_hex("feedfacedeadbeeffeedfacedeadbeefabaddad2");
+    vector<uint8_t> pt = from_hex(
+        "aaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbccccccccccccccccdddddddddddddddd"
+        "eeeeeeeeeeeeeeeeffffffffffffffffeeeeeeeeeeeeeeeeaaaaaaaaaaaaaaaa");
+    vector<uint8_t> ct_expect = from_hex(
+        "48af93501fa62adbcd414cce6034d895dda1bf8f132f042098661572e7483094"
+        "fd12e518ce062c98acee28d95df4416bed31a2f04476c18bb40c84a74b97dc5b");
+    vector<uint8_t> tag_expect = from_hex("16842d4fa186f56ab33256971fa110f4");
+    CCM ccm;
+    ccm.set_key(key.data());
+    vector<uint8_t> ct(pt.size()), dec(pt.size());
+    uint8_t tag[16];
+    ccm.encrypt(iv.data(), iv.size(), pt.data(), pt.size(), aad.data(), aad.size(), ct.data(), tag);
+    print_hex("密文", ct.data(), ct.size());
+    print_hex("标签", tag, 16);
+    bool ok = ct == ct_expect && memcmp(tag, tag_expect.data(), 16) == 0;
+    ok = ok && ccm.decrypt(iv.data(), iv.size(), ct.data(), ct.size(), aad.data(), aad.size(), tag, dec.data());
+    ok = ok && dec == pt;
+    cout << "SM4-CCM RFC 8998 测试向量: " << (ok ? "通过" : "失败") << endl;
+    return ok;
+}
+
+//随机参数（nonce长度、标签长度、AAD与明文长度、原地加解密）与参考实现对照
+bool test_random() {
+    mt19937 rng(2025);
+    bool ok = true;
+    for (int iter = 0; iter < 500 && ok; iter++) {
+        uint8_t key[16];
+        for (auto& b : key) b = (uint8_t)rng();
+        size_t tag_len = 4 + 2 * (rng() % 7);
+        CCM ccm;
+        ccm.set_key(key, tag_len);
+        SM4 sm4;
+        sm4.set_key(key);
+        vector<uint8_t> nonce(7 + rng() % 7), aad(rng() % 3 == 0 ? 0 : rng() % 100), pt(rng() % 300);
+        for (auto& b : nonce) b = (uint8_t)rng();
+        for (auto& b : aad) b = (uint8_t)rng();
+        for (auto& b : pt) b = (uint8_t)rng();
+
+        vector<uint8_t> ref_ct;
+        uint8_t ref_tag[16];
+        reference_ccm(sm4, nonce, aad, pt, tag_len, ref_ct, ref_tag);
+
+        vector<uint8_t> buf = pt;
+        uint8_t tag[16];
+        ccm.encrypt(nonce.data(), nonce.size(), buf.data(), buf.size(), aad.data(), aad.size(), buf.data(), tag);
+        ok = buf == ref_ct && memcmp(tag, ref_tag, tag_len) == 0;
+        ok = ok && ccm.decrypt(nonce.data(), nonce.size(), buf.data(), buf.size(), aad.data(), aad.size(),
+            tag, buf.data());
+        ok = ok && buf == pt;
+    }
+    cout << "随机参数与参考实现对照（含原地加解密）: " << (ok ? "通过" : "失败") << endl;
+    return ok;
+}
+
+//批量接口：与逐个调用结果比较，篡改报文被拒绝，并比较报文速率
+bool test_batch() {
+    const size_t PACKETS = 1024;
+    mt19937 rng(7);
+    uint8_t key[16];
+    for (auto& b : key) b = (uint8_t)rng();
+    CCM ccm;
+    ccm.set_key(key);
+
+    vector<vector<uint8_t>> nonce(PACKETS), aad(PACKETS), pt(PACKETS);
+    vector<vector<uint8_t>> ct_single(PACKETS), ct_batch(PACKETS), dec(PACKETS);
+    vector<vector<uint8_t>> tag_single(PACKETS, vector<uint8_t>(16)), tag_batch(PACKETS, vector<uint8_t>(16));
+    for (size_t i = 0; i < PACKETS; i++) {
+        nonce[i].resize(12);
+        aad[i].resize(rng() % 33);
+        pt[i].resize(16 + rng() % (256 - 16 + 1));
+        for (auto& b : nonce[i]) b = (uint8_t)rng();
+        for (auto& b : aad[i]) b = (uint8_t)rng();
+        for (auto& b : pt[i]) b = (uint8_t)rng();
+        ct_single[i].resize(pt[i].size());
+        ct_batch[i].resize(pt[i].size());
+        dec[i].resize(pt[i].size());
+    }
+
+    auto start = high_resolution_clock::now();
+    for (size_t i = 0; i < PACKETS; i++) {
+        ccm.encrypt(nonce[i].data(), 12, pt[i].data(), pt[i].size(), aad[i].data(), aad[i].size(),
+            ct_single[i].data(), tag_single[i].data());
+    }
+    double t_single = duration<double, micro>(high_resolution_clock::now() - start).count();
+
+    vector<CcmPacket> pkts(PACKETS);
+    for (size_t i = 0; i < PACKETS; i++) {
+        pkts[i] = { nonce[i].data(), 12, aad[i].data(), aad[i].size(), pt[i].data(), pt[i].size(),
+            ct_batch[i].data(), tag_batch[i].data(), false };
+    }
+    start = high_resolution_clock::now();
+    ccm.encrypt_batch(pkts.data(), PACKETS);
+    double t_batch = duration<double, micro>(high_resolution_clock::now() - start).count();
+
+    bool ok = ct_single == ct_batch && tag_single == tag_batch;
+
+    //篡改第3、7个报文后批量解密
+    ct_batch[3][0] ^= 1;
+    tag_batch[7][5] ^= 1;
+    for (size_t i = 0; i < PACKETS; i++) {
+        pkts[i] = { nonce[i].data(), 12, aad[i].data(), aad[i].size(), ct_batch[i].data(), ct_batch[i].size(),
+            dec[i].data(), tag_batch[i].data(), false };
+    }
+    size_t valid = ccm.decrypt_batch(pkts.data(), PACKETS);
+    ok = ok && valid == PACKETS - 2 && !pkts[3].valid && !pkts[7].valid;
+    for (size_t i = 0; i < PACKETS && ok; i++) {
+        if (i == 3 || i == 7) {
+            ok = dec[i] == vector<uint8_t>(dec[i].size(), 0);
+        }
+        else {
+            ok = dec[i] == pt[i];
+        }
+    }
+    cout << "批量CCM与逐个调用一致、篡改报文被拒绝: " << (ok ? "是" : "否") << endl;
+    cout << "逐个加密: " << PACKETS / t_single << " Mpkt/s，批量加密: " << PACKETS / t_batch << " Mpkt/s" << endl;
+    return ok;
+}
+
+int main() {
+    bool ok = test_vector();
+    ok = test_random() && ok;
+    ok = test_batch() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "SM4-optimized.h"
+
+//批量CCM接口中的单个报文描述
+struct CcmPacket {
+    const uint8_t* nonce; //7~13字节
+    size_t nonce_len;
+    const uint8_t* aad;
+    size_t aad_len;
+    const uint8_t* in;
+    size_t len;
+    uint8_t* out;
+    uint8_t* tag;         //tag_len字节：加密时写出，解密时读入比对
+    bool valid;           //加密：参数是否合法；解密：参数合法且标签验证通过
+};
+
+//SM4-CCM（NIST SP 800-38C / RFC 8998）
+//CBC-MAC链是串行的，但与CTR相互独立：每一步把一个CBC-MAC分组和一个CTR分组
+//合并为一次两分组内核调用，让CTR填满MAC链在流水线中空出的位置。
+//批量接口同时推进多条报文的MAC链，一次内核调用最多喂入KERNEL_SLOTS个分组
+class CCM {
+private:
+    SM4 sm4;
+    size_t tag_len;
+
+    static const size_t CHAINS = 4;                //批量模式下同时推进的报文数
+    static const size_t KERNEL_SLOTS = 2 * CHAINS; //每条报文每次贡献一个MAC分组和一个CTR分组
+
+    //计数器分组A_i = flags(L-1) || N || i（i占L字节，大端）
+    static void generate_ctr(const uint8_t* nonce, size_t nonce_len, uint64_t counter, uint8_t ctr[16]) {
+        size_t L = 15 - nonce_len;
+        ctr[0] = (uint8_t)(L - 1);
+        memcpy(ctr + 1, nonce, nonce_len);
+        for (size_t i = 0; i < L; i++) {
+            ctr[15 - i] = i < 8 ? (uint8_t)(counter >> (8 * i)) : 0;
+        }
+    }
+
+    //安全擦除，防止编译器优化掉
+    static void secure_zero(void* p, size_t n) {
+        volatile uint8_t* v = (volatile uint8_t*)p;
+        while (n--) {
+            *v++ = 0;
+        }
+    }
+
+    //常数时间比较标签
+    static bool tag_equal(const uint8_t* a, const uint8_t* b, size_t n) {
+        uint8_t diff = 0;
+        for (size_t i = 0; i < n; i++) {
+            diff |= a[i] ^ b[i];
+        }
+        return diff == 0;
+    }
+
+    //检查nonce长度、标签长度与明文长度是否满足CCM的格式要求
+    bool params_ok(size_t nonce_len, size_t len) const {
+        if (nonce_len < 7 || nonce_len > 13) {
+            return false;
+        }
+        size_t L = 15 - nonce_len;
+        return L >= 8 || ((uint64_t)len >> (8 * L)) == 0;
+    }
+
+    //一条报文的CCM状态：MAC输入序列为B0 || 编码后的AAD || pad || P || pad，
+    //CTR序列为A0（用于加密标签）, A1, A2...
+    struct Chain {
+        CcmPacket* p;
+        const uint8_t* plain;  //MAC读取明文的位置：加密为输入，解密为CTR刚写出的输出
+        uint8_t b0[16];
+        uint8_t hdr[10];       //AAD长度编码
+        size_t hlen;
+        size_t aad_blocks, data_blocks;
+        size_t m, c;           //下一个MAC分组 / 下一个计数器
+        uint8_t Y[16];         //CBC-MAC链值
+        uint8_t s0[16];        //E(A0)
+
+        void init(CcmPacket* pkt, size_t tag_len, bool decrypting) {
+            p = pkt;
+            plain = decrypting ? pkt->out : pkt->in;
+            size_t L = 15 - pkt->nonce_len;
+            b0[0] = (uint8_t)((pkt->aad_len > 0 ? 0x40 : 0) | ((tag_len - 2) / 2) << 3 | (L - 1));
+            memcpy(b0 + 1, pkt->nonce, pkt->nonce_len);
+            for (size_t i = 0; i < L; i++) {
+                b0[15 - i] = i < 8 ? (uint8_t)((uint64_t)pkt->len >> (8 * i)) : 0;
+            }
+            uint64_t a = pkt->aad_len;
+            if (a == 0) {
+                hlen = 0;
+            }
+            else if (a < 0xff00) {
+                hdr[0] = (uint8_t)(a >> 8);
+                hdr[1] = (uint8_t)a;
+                hlen = 2;
+            }
+            else if ((a >> 32) == 0) {
+                hdr[0] = 0xff;
+                hdr[1] = 0xfe;
+                for (int i = 0; i < 4; i++) {
+                    hdr[2 + i] = (uint8_t)(a >> (24 - 8 * i));
+                }
+                hlen = 6;
+            }
+            else {
+                hdr[0] = 0xff;
+                hdr[1] = 0xff;
+                for (int i = 0; i < 8; i++) {
+                    hdr[2 + i] = (uint8_t)(a >> (56 - 8 * i));
+                }
+                hlen = 10;
+            }
+            aad_blocks = (hlen + pkt->aad_len + 15) / 16;
+            data_blocks = (pkt->len + 15) / 16;
+            m = 0;
+            c = 0;
+            memset(Y, 0, 16);
+        }
+
+        size_t mac_blocks() const {
+            return 1 + aad_blocks + data_blocks;
+        }
+        size_t ctr_blocks() const {
+            return 1 + data_blocks;
+        }
+        bool done() const {
+            return m == mac_blocks() && c == ctr_blocks();
+        }
+
+        //取第m个MAC输入分组
+        void mac_block(uint8_t blk[16]) const {
+            if (m == 0) {
+                memcpy(blk, b0, 16);
+                return;
+            }
+            if (m <= aad_blocks) {
+                size_t off = (m - 1) * 16;
+                for (size_t k = 0; k < 16; k++) {
+                    size_t pos = off + k;
+                    if (pos < hlen) {
+                        blk[k] = hdr[pos];
+                    }
+                    else if (pos - hlen < p->aad_len) {
+                        blk[k] = p->aad[pos - hlen];
+                    }
+                    else {
+                        blk[k] = 0;
+                    }
+                }
+                return;
+            }
+            size_t off = (m - 1 - aad_blocks) * 16;
+            size_t n = p->len - off < 16 ? p->len - off : 16;
+            memcpy(blk, plain + off, n);
+            memset(blk + n, 0, 16 - n);
+        }
+    };
+
+    //推进一组报文直到全部完成。
+    //加密：CTR不超前于MAC（原地加密时MAC须先读到明文），第j个明文分组的MAC与A_{j+1}同批；
+    //解密：MAC不超前于CTR（MAC需要CTR解出的明文），CTR始终领先一个分组。
+    void run(CcmPacket* p, size_t count, bool decrypting) const {
+        Chain chains[CHAINS];
+        size_t active[CHAINS];
+        size_t nactive = 0, next = 0;
+        uint8_t in[KERNEL_SLOTS * 16], out[KERNEL_SLOTS * 16];
+        size_t slot_chain[KERNEL_SLOTS];
+        bool slot_mac[KERNEL_SLOTS];
+        for (;;) {
+            //补充空出的MAC链
+            while (nactive < CHAINS && next < count) {
+                CcmPacket& pkt = p[next++];
+                if (!params_ok(pkt.nonce_len, pkt.len)) {
+                    pkt.valid = false;
+                    continue;
+                }
+                size_t k = 0;
+                bool used[CHAINS] = {};
+                for (size_t a = 0; a < nactive; a++) {
+                    used[active[a]] = true;
+                }
+                while (used[k]) {
+                    k++;
+                }
+                chains[k].init(&pkt, tag_len, decrypting);
+                active[nactive++] = k;
+            }
+            if (nactive == 0) {
+                break;
+            }
+
+            //收集本次内核调用的分组
+            size_t used = 0;
+            for (size_t a = 0; a < nactive; a++) {
+                Chain& ch = chains[active[a]];
+                bool take_mac = ch.m < ch.mac_blocks() &&
+                    (!decrypting || ch.m <= ch.aad_blocks || ch.m - ch.aad_blocks < ch.c);
+                if (take_mac) {
+                    uint8_t* blk = in + 16 * used;
+                    ch.mac_block(blk);
+                    for (int k = 0; k < 16; k++) {
+                        blk[k] ^= ch.Y[k];
+                    }
+                    slot_chain[used] = active[a];
+                    slot_mac[used] = true;
+                    used++;
+                }
+                size_t m_after = ch.m + (take_mac ? 1 : 0);
+                bool take_ctr = ch.c < ch.ctr_blocks() &&
+                    (decrypting || ch.c == 0 || ch.aad_blocks + ch.c < m_after);
+                if (take_ctr) {
+                    generate_ctr(ch.p->nonce, ch.p->nonce_len, ch.c, in + 16 * used);
+                    slot_chain[used] = active[a];
+                    slot_mac[used] = false;
+                    used++;
+                }
+            }
+            sm4.encrypt_blocks(in, out, used);
+
+            //分发结果
+            for (size_t s = 0; s < used; s++) {
+                Chain& ch = chains[slot_chain[s]];
+                const uint8_t* ks = out + 16 * s;
+                if (slot_mac[s]) {
+                    memcpy(ch.Y, ks, 16);
+                    ch.m++;
+                }
+                else {
+                    if (ch.c == 0) {
+                        memcpy(ch.s0, ks, 16);
+                    }
+                    else {
+                        size_t off = (ch.c - 1) * 16;
+                        size_t n = ch.p->len - off < 16 ? ch.p->len - off : 16;
+                        for (size_t k = 0; k < n; k++) {
+                            ch.p->out[off + k] = ch.p->in[off + k] ^ ks[k];
+                        }
+                    }
+                    ch.c++;
+                }
+            }
+
+            //完成的报文：生成或校验标签，并移出活动集合
+            for (size_t a = 0; a < nactive;) {
+                Chain& ch = chains[active[a]];
+                if (!ch.done()) {
+                    a++;
+                    continue;
+                }
+                uint8_t t[16];
+                for (size_t k = 0; k < tag_len; k++) {
+                    t[k] = ch.Y[k] ^ ch.s0[k];
+                }
+                if (decrypting) {
+                    ch.p->valid = tag_equal(t, ch.p->tag, tag_len);
+                    if (!ch.p->valid) {
+                        //验证失败不输出任何明文
+                        secure_zero(ch.p->out, ch.p->len);
+                    }
+                }
+                else {
+                    memcpy(ch.p->tag, t, tag_len);
+                    ch.p->valid = true;
+                }
+                secure_zero(t, sizeof(t));
+                secure_zero(&ch, sizeof(ch));
+                active[a] = active[--nactive];
+            }
+        }
+        secure_zero(in, sizeof(in));
+        secure_zero(out, sizeof(out));
+    }
+
+public:
+    CCM() : tag_len(16) {}
+
+    //设置密钥与标签长度（4~16之间的偶数字节）
+    bool set_key(const uint8_t key[16], size_t tlen = 16) {
+        if (tlen < 4 || tlen > 16 || tlen % 2 != 0) {
+            return false;
+        }
+        sm4.set_key(key);
+        tag_len = tlen;
+        return true;
+    }
+
+    size_t tag_size() const {
+        return tag_len;
+    }
+
+    //加密：参数不合法（nonce长度、明文过长）时返回false
+    bool encrypt(const uint8_t* nonce, size_t nonce_len, const uint8_t* plaintext, size_t len,
+        const uint8_t* aad, size_t aad_len, uint8_t* ciphertext, uint8_t* tag) const {
+        CcmPacket pkt = { nonce, nonce_len, aad, aad_len, plaintext, len, ciphertext, tag, false };
+        run(&pkt, 1, false);
+        return pkt.valid;
+    }
+
+    //解密：标签验证失败时输出被清零并返回false
+    bool decrypt(const uint8_t* nonce, size_t nonce_len, const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len, const uint8_t* tag, uint8_t* plaintext) const {
+        CcmPacket pkt = { nonce, nonce_len, aad, aad_len, ciphertext, len, plaintext,
+            const_cast<uint8_t*>(tag), false };
+        run(&pkt, 1, true);
+        return pkt.valid;
+    }
+
+    //批量加密：多条报文的MAC链交错推进，填满多分组内核
+    void encrypt_batch(CcmPacket* pkts, size_t count) const {
+        run(pkts, count, false);
+    }
+
+    //批量解密：返回验证通过的报文数，失败报文的输出被清零
+    size_t decrypt_batch(CcmPacket* pkts, size_t count) const {
+        run(pkts, count, true);
+        size_t ok = 0;
+        for (size_t i = 0; i < count; i++) {
+            ok += pkts[i].valid ? 1 : 0;
+        }
+        return ok;
+    }
+};
@@ -65,9 +65,21 @@ private:
     uint32_t T(uint32_t x) {
         //将32位值拆分为4个字节，分别查表后组合
         return T_table[(x >> 24) & 0xFF] ^
-            (T_table[(x >> 16) & 0xFF] >> 8) ^
-            (T_table[(x >> 8) & 0xFF] >> 16) ^
-            (T_table[x & 0xFF] >> 24);
+            rotl(T_table[(x >> 16) & 0xFF], 24) ^
+            rotl(T_table[(x >> 8) & 0xFF], 16) ^
+            rotl(T_table[x & 0xFF], 8);
+    }
+
+    //密钥扩展用的线性变换L'
+    static uint32_t L_key(uint32_t x) {
+        return x ^ rotl(x, 13) ^ rotl(x, 23);
+    }
+
+    //密钥扩展的合成置换T'，S盒后接L'
+    static uint32_t T_key(uint32_t x) {
+        uint32_t y = (uint32_t)sbox((x >> 24) & 0xff) << 24 | (uint32_t)sbox((x >> 16) & 0xff) << 16 |
+            (uint32_t)sbox((x >> 8) & 0xff) << 8 | (uint32_t)sbox(x & 0xff);
+        return L_key(y);
     }
 
     //优化的轮函数F
@@ -96,8 +108,8 @@ public:
         k[3] = mk[3] ^ FK[3];
 
         for (int i = 0; i < 32; i++) {
-            //密钥扩展也使用优化的T函数
-            k[i + 4] = k[i] ^ T(k[i + 1] ^ k[i + 2] ^ k[i + 3] ^ CK[i]);
+            //密钥扩展使用L'，不能复用加密轮函数的T-table
+            k[i + 4] = k[i] ^ T_key(k[i + 1] ^ k[i + 2] ^ k[i + 3] ^ CK[i]);
             rk[i] = k[i + 4];
         }
     }
@@ -158,9 +170,9 @@ private:
                     z[j] ^= v[j];
                 }
             }
-            //移位
+            //V右移一位：字节0为最高位，进位从低下标字节移入高下标字节
             uint8_t carry = 0;
-            for (int j = 15; j >= 0; j--) {
+            for (int j = 0; j < 16; j++) {
                 uint8_t b = v[j] & 1;
                 v[j] = (v[j] >> 1) | (carry << 7);
                 carry = b;
@@ -218,7 +230,7 @@ public:
         const uint8_t* aad, size_t aad_len, uint8_t* ciphertext, uint8_t tag[16]) {
         //生成初始计数器块
         uint8_t ctr0[16];
-        generate_ctr(nonce, 0, ctr0);
+        generate_ctr(nonce, 1, ctr0);
 
         //加密计数器块得到J0
         uint8_t J0[16];
@@ -227,7 +239,7 @@ public:
         //CTR模式加密
         for (size_t i = 0; i < plaintext_len; i += 16) {
             uint8_t ctr[16];
-            generate_ctr(nonce, i / 16 + 1, ctr);
+            generate_ctr(nonce, i / 16 + 2, ctr);
 
             uint8_t keystream[16];
             sm4.encrypt_block(ctr, keystream);
@@ -283,7 +295,7 @@ public:
         const uint8_t* aad, size_t aad_len, const uint8_t tag[16], uint8_t* plaintext) {
         //生成初始计数器块
         uint8_t ctr0[16];
-        generate_ctr(nonce, 0, ctr0);
+        generate_ctr(nonce, 1, ctr0);
 
         //加密计数器块得到J0
         uint8_t J0[16];
@@ -292,7 +304,7 @@ public:
         //CTR模式解密
         for (size_t i = 0; i < ciphertext_len; i += 16) {
             uint8_t ctr[16];
-            generate_ctr(nonce, i / 16 + 1, ctr);
+            generate_ctr(nonce, i / 16 + 2, ctr);
 
             uint8_t keystream[16];
             sm4.encrypt_block(ctr, keystream);
@@ -362,6 +374,8 @@ void print_hex(const string& label, const uint8_t* data, size_t len) {
     cout << dec << endl;
 }
 
+//作为库被其他程序包含时（如基准测试）定义SM4_GCM_NO_MAIN以去掉演示用的main
+#ifndef SM4_GCM_NO_MAIN
 int main() {
     //测试向量
     uint8_t key[16] = {
@@ -426,4 +440,5 @@ int main() {
     }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
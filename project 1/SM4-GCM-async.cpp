@@ -0,0 +1,177 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <atomic>
+#include <latch>
+#include <exception>
+#include "SM4-GCM-async.h"
+
+using namespace std;
+using namespace chrono;
+
+//不返回结果的协程：创建后立即运行到第一个co_await，结束时自行销毁
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() {
+            return {};
+        }
+        suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            terminate();
+        }
+    };
+};
+
+static shared_ptr<const GCM> make_key(uint8_t seed) {
+    uint8_t key[16];
+    for (int i = 0; i < 16; i++) {
+        key[i] = (uint8_t)(seed * 17 + i);
+    }
+    shared_ptr<GCM> gcm = make_shared<GCM>();
+    gcm->set_key(key);
+    return gcm;
+}
+
+//一个协程：加密、与同步接口比较、解密往返、篡改后拒绝、SM3摘要
+Detached check_one(SealSession& session, const GCM& gcm, size_t len, atomic<int>& bad, latch& done) {
+    vector<uint8_t> msg(len);
+    for (size_t i = 0; i < len; i++) {
+        msg[i] = (uint8_t)(i * 13 + len);
+    }
+    uint8_t aad[7] = { 'h', 'e', 'a', 'd', 'e', 'r', (uint8_t)len };
+    const uint8_t* a = (len & 1) ? aad : nullptr;
+    size_t a_len = (len & 1) ? sizeof(aad) : 0;
+
+    SealedMessage m = co_await seal(session, msg.data(), msg.size(), a, a_len);
+    vector<uint8_t> ct(len);
+    uint8_t tag[16];
+    gcm.encrypt(m.nonce, msg.data(), len, a, a_len, ct.data(), tag);
+    bool ok = m.ciphertext == ct && memcmp(m.tag, tag, 16) == 0;
+
+    OpenedMessage o = co_await unseal(session, m, a, a_len);
+    ok = ok && o.ok && o.plaintext == msg;
+
+    m.tag[len % 16] ^= 1;
+    OpenedMessage forged = co_await unseal(session, m, a, a_len);
+    ok = ok && !forged.ok && forged.plaintext.empty();
+
+    array<uint8_t, 32> d = co_await digest(session.scheduler(), msg.data(), msg.size());
+    uint8_t expect[32];
+    SM3::hash(msg.data(), msg.size(), expect);
+    ok = ok && memcmp(d.data(), expect, 32) == 0;
+
+    if (!ok) {
+        bad++;
+    }
+    done.count_down();
+}
+
+//多个会话（两个密钥）的请求混在同一批中，结果与同步接口逐字节一致
+bool test_correctness() {
+    const int COROUTINES = 600;
+    BatchScheduler sched(64, microseconds(200));
+    shared_ptr<const GCM> k1 = make_key(1), k2 = make_key(2);
+    const uint8_t p1[4] = { 0, 0, 0, 1 }, p2[4] = { 0, 0, 0, 2 };
+    SealSession s1(sched, k1, p1), s2(sched, k2, p2);
+    atomic<int> bad(0);
+    latch done(COROUTINES);
+    for (int i = 0; i < COROUTINES; i++) {
+        if (i % 3 == 0) {
+            check_one(s2, *k2, (size_t)(i % 200), bad, done);
+        }
+        else {
+            check_one(s1, *k1, (size_t)(i % 200), bad, done);
+        }
+    }
+    done.wait();
+
+    //单个协程凑不满一批，等待window后分发
+    latch one(1);
+    check_one(s1, *k1, 33, bad, one);
+    one.wait();
+
+    BatchScheduler::Stats st = sched.stats();
+    bool ok = bad == 0 && st.requests == 4 * (COROUTINES + 1) && st.timed_batches > 0;
+    cout << "请求 " << st.requests << "，批次 " << st.batches << "（攒满 " << st.full_batches << "，超时 "
+         << st.timed_batches << "）" << endl;
+    cout << "协程接口与同步接口结果一致、篡改后拒绝: " << (ok ? "是" : "否") << endl;
+    return ok;
+}
+
+Detached seal_loop(SealSession& session, const uint8_t* msg, size_t len, int count, latch& done) {
+    for (int i = 0; i < count; i++) {
+        SealedMessage m = co_await seal(session, msg, len);
+        (void)m;
+    }
+    done.count_down();
+}
+
+//每个协程逐条加密len字节的报文：与逐请求调用encrypt()对比吞吐
+bool test_speed(size_t len) {
+    const int COROUTINES = 1024;
+    const int PER_COROUTINE = (int)(6400 / len);
+    const int REQUESTS = COROUTINES * PER_COROUTINE;
+    vector<uint8_t> msg(len, 0x5a);
+    shared_ptr<const GCM> key = make_key(3);
+
+    uint8_t nonce[12] = { 0 }, tag[16];
+    vector<uint8_t> ct(len);
+    //同样的报文直接按1024条一批调用encrypt_batch()，即协程前端所能达到的上限
+    vector<uint8_t> out(len * COROUTINES), tags(16 * COROUTINES);
+    vector<GcmPacket> packets(COROUTINES);
+    for (int c = 0; c < COROUTINES; c++) {
+        packets[c] = { nonce, nullptr, 0, msg.data(), len, &out[len * c], &tags[16 * c], false };
+    }
+    BatchScheduler sched(64, microseconds(50));
+    const uint8_t prefix[4] = { 0, 0, 0, 3 };
+    SealSession session(sched, key, prefix);
+
+    //三种方式交替各运行若干轮，取各自最快的一轮
+    const int ROUNDS = 3;
+    double t_sync = 1e30, t_batch = 1e30, t_async = 1e30;
+    for (int round = 0; round < ROUNDS; round++) {
+        auto start = high_resolution_clock::now();
+        for (int i = 0; i < REQUESTS; i++) {
+            nonce[11] = (uint8_t)i;
+            key->encrypt(nonce, msg.data(), len, nullptr, 0, ct.data(), tag);
+        }
+        t_sync = min(t_sync, duration<double, nano>(high_resolution_clock::now() - start).count() / REQUESTS);
+
+        start = high_resolution_clock::now();
+        for (int i = 0; i < PER_COROUTINE; i++) {
+            key->encrypt_batch(packets.data(), packets.size());
+        }
+        t_batch = min(t_batch, duration<double, nano>(high_resolution_clock::now() - start).count() / REQUESTS);
+
+        latch done(COROUTINES);
+        start = high_resolution_clock::now();
+        for (int c = 0; c < COROUTINES; c++) {
+            seal_loop(session, msg.data(), len, PER_COROUTINE, done);
+        }
+        done.wait();
+        t_async = min(t_async, duration<double, nano>(high_resolution_clock::now() - start).count() / REQUESTS);
+    }
+
+    BatchScheduler::Stats st = sched.stats();
+    cout << len << "字节报文：逐请求encrypt() " << t_sync << " ns/请求，直接调用encrypt_batch() " << t_batch
+         << " ns/请求，" << COROUTINES << "个协程co_await seal() " << t_async << " ns/请求（平均每批 "
+         << (double)st.requests / st.batches << " 条）" << endl;
+    cout << "co_await seal()相对逐请求encrypt(): " << (t_async < t_sync ? "快 " : "慢 ")
+         << (int)(100 * (t_sync > t_async ? t_sync - t_async : t_async - t_sync) / t_sync) << "%" << endl;
+    return st.requests == (uint64_t)REQUESTS * ROUNDS;
+}
+
+int main() {
+    bool ok = test_correctness();
+    ok = test_speed(64) && ok;
+    ok = test_speed(512) && ok;
+    return ok ? 0 : 1;
+}
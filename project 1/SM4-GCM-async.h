@@ -0,0 +1,442 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "SM4-GCM-optimized.h"
+#include "../common/thread_pool.h"
+#include "../common/usdt.h"
+#ifndef SM3_NO_MAIN
+#define SM3_NO_MAIN
+#endif
+#include "../project4/SM3-optimized.h"
+
+//协程前端（C++20）：每个协程一次只处理一条小报文，
+//  SealedMessage m = co_await seal(session, msg, len);
+//调度器把各协程的请求收集起来，攒够max_batch条或最早的请求已等待window时一起交给批量内核
+//（GCM::encrypt_batch/decrypt_batch按密钥分组，SM3用多路SM3::hash_many），完成后恢复各协程。
+//
+//   请求描述符就在协程帧中（co_await的临时对象），提交只是在锁内把指针放入队列，不分配内存；
+//   分发与恢复都在调度器的分发线程上进行，协程恢复后再次co_await时直接进入下一批；
+//   构造时传入线程池时，大批次的内核计算按组分到线程池上，恢复仍在分发线程上按提交顺序进行；
+//   输入缓冲区在co_await完成之前必须保持有效。
+class BatchScheduler;
+
+//会话：一个密钥上下文与一个nonce序列。nonce = 4字节前缀 || 8字节计数器（大端），
+//同一密钥的不同会话必须使用不同的前缀
+class SealSession {
+private:
+    std::shared_ptr<const GCM> gcm;
+    BatchScheduler& sched;
+    uint8_t prefix[4];
+    std::atomic<uint64_t> counter;
+
+    friend class SealAwaiter;
+    friend class OpenAwaiter;
+
+public:
+    //key可以直接使用KeyCache<GCM>::Handle
+    SealSession(BatchScheduler& scheduler, std::shared_ptr<const GCM> key, const uint8_t nonce_prefix[4])
+        : gcm(std::move(key)), sched(scheduler), counter(0) {
+        memcpy(prefix, nonce_prefix, 4);
+    }
+
+    SealSession(const SealSession&) = delete;
+    SealSession& operator=(const SealSession&) = delete;
+
+    BatchScheduler& scheduler() const {
+        return sched;
+    }
+
+    //取下一个nonce，并发调用时各次结果互不相同
+    void next_nonce(uint8_t nonce[12]) {
+        uint64_t n = counter.fetch_add(1, std::memory_order_relaxed);
+        memcpy(nonce, prefix, 4);
+        for (int k = 0; k < 8; k++) {
+            nonce[4 + k] = (uint8_t)(n >> (56 - 8 * k));
+        }
+    }
+};
+
+struct SealedMessage {
+    uint8_t nonce[12];
+    std::vector<uint8_t> ciphertext;
+    uint8_t tag[16];
+};
+
+struct OpenedMessage {
+    bool ok;                          //标签验证是否通过
+    std::vector<uint8_t> plaintext;   //验证失败时为空
+};
+
+//挂起在调度器中的一条请求
+struct AsyncRequest {
+    enum Kind { Seal, Open, Digest };
+
+    Kind kind;
+    const GCM* gcm;
+    const uint8_t* in;
+    size_t len;
+    const uint8_t* aad;
+    size_t aad_len;
+    uint8_t nonce[12];
+    uint8_t tag[16];  //Seal时输出，Open时为待验证标签
+    std::vector<uint8_t> out;
+    std::array<uint8_t, 32> digest;
+    bool ok;
+    std::coroutine_handle<> waiter;
+};
+
+class BatchScheduler {
+public:
+    struct Stats {
+        uint64_t requests;
+        uint64_t batches;
+        uint64_t full_batches;   //因攒够max_batch条而分发的批次
+        uint64_t timed_batches;  //因等待超过window而分发的批次
+    };
+
+private:
+    //一次内核调用处理的报文数上限，也是分到线程池上的任务粒度
+    static const size_t KERNEL_GROUP = 64;
+
+    //同一密钥、同一方向的一段连续请求
+    struct Job {
+        AsyncRequest::Kind kind;
+        AsyncRequest* const* reqs;
+        size_t count;
+    };
+
+    size_t max_batch;
+    std::chrono::steady_clock::duration window;
+    ThreadPool* pool;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::vector<AsyncRequest*> pending;
+    std::chrono::steady_clock::time_point oldest;  //pending中最早一条的提交时间
+    bool flush_now;
+    bool stopping;
+    Stats st;
+    std::thread dispatcher;
+
+    static void run_job(const Job& job) {
+        if (job.kind == AsyncRequest::Digest) {
+            const uint8_t* msgs[KERNEL_GROUP];
+            size_t lens[KERNEL_GROUP];
+            uint8_t digests[32 * KERNEL_GROUP];
+            for (size_t i = 0; i < job.count; i++) {
+                msgs[i] = job.reqs[i]->in;
+                lens[i] = job.reqs[i]->len;
+            }
+            SM3::hash_many(msgs, lens, job.count, digests);
+            for (size_t i = 0; i < job.count; i++) {
+                memcpy(job.reqs[i]->digest.data(), digests + 32 * i, 32);
+                job.reqs[i]->ok = true;
+            }
+            return;
+        }
+        //只有一条时批量内核没有可以交错的报文，直接走单条消息的路径
+        if (job.count == 1) {
+            AsyncRequest* r = job.reqs[0];
+            r->out.resize(r->len);
+            if (job.kind == AsyncRequest::Seal) {
+                r->gcm->encrypt(r->nonce, r->in, r->len, r->aad, r->aad_len, r->out.data(), r->tag);
+                r->ok = true;
+            }
+            else {
+                r->ok = r->gcm->decrypt(r->nonce, r->in, r->len, r->aad, r->aad_len, r->tag, r->out.data(),
+                    DecryptMode::VerifyFirst);
+            }
+            if (!r->ok) {
+                r->out.clear();
+            }
+            return;
+        }
+        GcmPacket packets[KERNEL_GROUP];
+        for (size_t i = 0; i < job.count; i++) {
+            AsyncRequest* r = job.reqs[i];
+            r->out.resize(r->len);
+            packets[i] = { r->nonce, r->aad, r->aad_len, r->in, r->len, r->out.data(), r->tag, false };
+        }
+        if (job.kind == AsyncRequest::Seal) {
+            job.reqs[0]->gcm->encrypt_batch(packets, job.count);
+        }
+        else {
+            job.reqs[0]->gcm->decrypt_batch(packets, job.count);
+        }
+        for (size_t i = 0; i < job.count; i++) {
+            AsyncRequest* r = job.reqs[i];
+            r->ok = packets[i].valid;
+            if (!r->ok) {
+                r->out.clear();
+            }
+        }
+    }
+
+    //按方向与密钥排序后切成内核调用，计算完成后按提交顺序恢复协程
+    void dispatch(std::vector<AsyncRequest*>& batch) {
+        CRYPTO_USDT2(async_dispatch_entry, this, batch.size());
+        auto before = [](const AsyncRequest* a, const AsyncRequest* b) {
+            if (a->kind != b->kind) {
+                return a->kind < b->kind;
+            }
+            return std::less<const GCM*>()(a->gcm, b->gcm);
+        };
+        //常见情况是整批同一方向、同一密钥，已经有序时不复制也不排序
+        std::vector<AsyncRequest*> sorted;
+        if (!std::is_sorted(batch.begin(), batch.end(), before)) {
+            sorted = batch;
+            std::stable_sort(sorted.begin(), sorted.end(), before);
+        }
+        const std::vector<AsyncRequest*>& order = sorted.empty() ? batch : sorted;
+        std::vector<Job> jobs;
+        for (size_t i = 0; i < order.size();) {
+            size_t j = i + 1;
+            while (j < order.size() && j - i < KERNEL_GROUP && order[j]->kind == order[i]->kind &&
+                   order[j]->gcm == order[i]->gcm) {
+                j++;
+            }
+            jobs.push_back({ order[i]->kind, order.data() + i, j - i });
+            i = j;
+        }
+        //不用线程池且整批已经有序（分组顺序即提交顺序）时，每组算完立即恢复该组的协程，
+        //不必等整批算完：报文、输出与协程帧仍在缓存中
+        if (!pool && sorted.empty()) {
+            for (const Job& job : jobs) {
+                run_job(job);
+                for (size_t k = 0; k < job.count; k++) {
+                    job.reqs[k]->waiter.resume();
+                }
+            }
+            CRYPTO_USDT2(async_dispatch_return, this, batch.size());
+            return;
+        }
+        if (pool && jobs.size() > 1) {
+            pool->parallel_for(0, jobs.size(), 1, [&](size_t lo, size_t hi) {
+                for (size_t k = lo; k < hi; k++) {
+                    run_job(jobs[k]);
+                }
+            });
+        }
+        else {
+            for (const Job& job : jobs) {
+                run_job(job);
+            }
+        }
+        CRYPTO_USDT2(async_dispatch_return, this, batch.size());
+        for (AsyncRequest* r : batch) {
+            r->waiter.resume();
+        }
+    }
+
+    void dispatcher_loop() {
+        std::vector<AsyncRequest*> batch;
+        std::unique_lock<std::mutex> g(lock);
+        for (;;) {
+            while (pending.empty() && !stopping) {
+                wake.wait(g);
+            }
+            if (pending.empty()) {
+                return;
+            }
+            std::chrono::steady_clock::time_point deadline = oldest + window;
+            while (pending.size() < max_batch && !flush_now && !stopping &&
+                   wake.wait_until(g, deadline) != std::cv_status::timeout) {
+            }
+            if (pending.size() >= max_batch) {
+                st.full_batches++;
+            }
+            else if (!flush_now && !stopping) {
+                st.timed_batches++;
+            }
+            st.batches++;
+            flush_now = false;
+            batch.swap(pending);
+            g.unlock();
+            dispatch(batch);
+            batch.clear();
+            g.lock();
+        }
+    }
+
+public:
+    //max_batch：攒够多少条立即分发；window：最早一条请求最多等待多久；
+    //pool非空时大批次的内核计算在线程池上并行
+    explicit BatchScheduler(size_t max_batch = 64,
+        std::chrono::steady_clock::duration window = std::chrono::microseconds(50), ThreadPool* pool = nullptr)
+        : max_batch(max_batch ? max_batch : 1), window(window), pool(pool), flush_now(false), stopping(false),
+          st() {
+        dispatcher = std::thread(&BatchScheduler::dispatcher_loop, this);
+    }
+
+    //分发剩余的请求后退出；析构时不应再有新的提交
+    ~BatchScheduler() {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        dispatcher.join();
+    }
+
+    BatchScheduler(const BatchScheduler&) = delete;
+    BatchScheduler& operator=(const BatchScheduler&) = delete;
+
+    //提交后请求归调度器所有，直到其协程被恢复
+    void submit(AsyncRequest* r) {
+        bool notify;
+        {
+            std::lock_guard<std::mutex> g(lock);
+            if (pending.empty()) {
+                oldest = std::chrono::steady_clock::now();
+            }
+            pending.push_back(r);
+            st.requests++;
+            //只在分发线程可能需要改变等待方式时唤醒：第一条请求（开始计时）与攒满一批
+            notify = pending.size() == 1 || pending.size() == max_batch;
+        }
+        if (notify) {
+            wake.notify_one();
+        }
+    }
+
+    //不再等待，立即分发已提交的请求
+    void flush() {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            flush_now = true;
+        }
+        wake.notify_one();
+    }
+
+    Stats stats() {
+        std::lock_guard<std::mutex> g(lock);
+        return st;
+    }
+};
+
+//co_await的临时对象：请求描述符随协程帧存在，恢复时返回结果
+class SealAwaiter {
+private:
+    AsyncRequest req;
+    BatchScheduler& sched;
+
+public:
+    SealAwaiter(SealSession& s, const uint8_t* msg, size_t len, const uint8_t* aad, size_t aad_len)
+        : req(), sched(s.sched) {
+        req.kind = AsyncRequest::Seal;
+        req.gcm = s.gcm.get();
+        req.in = msg;
+        req.len = len;
+        req.aad = aad;
+        req.aad_len = aad_len;
+        s.next_nonce(req.nonce);
+    }
+    SealAwaiter(const SealAwaiter&) = delete;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    //提交之后可能立即在分发线程上被恢复，这里不能再访问*this
+    void await_suspend(std::coroutine_handle<> h) {
+        req.waiter = h;
+        sched.submit(&req);
+    }
+    SealedMessage await_resume() {
+        SealedMessage m;
+        memcpy(m.nonce, req.nonce, 12);
+        memcpy(m.tag, req.tag, 16);
+        m.ciphertext = std::move(req.out);
+        return m;
+    }
+};
+
+class OpenAwaiter {
+private:
+    AsyncRequest req;
+    BatchScheduler& sched;
+
+public:
+    OpenAwaiter(SealSession& s, const SealedMessage& m, const uint8_t* aad, size_t aad_len) : req(), sched(s.sched) {
+        req.kind = AsyncRequest::Open;
+        req.gcm = s.gcm.get();
+        req.in = m.ciphertext.data();
+        req.len = m.ciphertext.size();
+        req.aad = aad;
+        req.aad_len = aad_len;
+        memcpy(req.nonce, m.nonce, 12);
+        memcpy(req.tag, m.tag, 16);
+    }
+    OpenAwaiter(const OpenAwaiter&) = delete;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> h) {
+        req.waiter = h;
+        sched.submit(&req);
+    }
+    OpenedMessage await_resume() {
+        OpenedMessage m;
+        m.ok = req.ok;
+        m.plaintext = std::move(req.out);
+        return m;
+    }
+};
+
+class DigestAwaiter {
+private:
+    AsyncRequest req;
+    BatchScheduler& sched;
+
+public:
+    DigestAwaiter(BatchScheduler& s, const uint8_t* data, size_t len) : req(), sched(s) {
+        req.kind = AsyncRequest::Digest;
+        req.gcm = nullptr;
+        req.in = data;
+        req.len = len;
+    }
+    DigestAwaiter(const DigestAwaiter&) = delete;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> h) {
+        req.waiter = h;
+        sched.submit(&req);
+    }
+    std::array<uint8_t, 32> await_resume() {
+        return req.digest;
+    }
+};
+
+//加密一条报文，nonce取自会话
+inline SealAwaiter seal(SealSession& session, const uint8_t* msg, size_t len, const uint8_t* aad = nullptr,
+    size_t aad_len = 0) {
+    return SealAwaiter(session, msg, len, aad, aad_len);
+}
+
+inline SealAwaiter seal(SealSession& session, const std::vector<uint8_t>& msg) {
+    return SealAwaiter(session, msg.data(), msg.size(), nullptr, 0);
+}
+
+//解密并验证一条报文
+inline OpenAwaiter unseal(SealSession& session, const SealedMessage& m, const uint8_t* aad = nullptr,
+    size_t aad_len = 0) {
+    return OpenAwaiter(session, m, aad, aad_len);
+}
+
+//SM3摘要
+inline DigestAwaiter digest(BatchScheduler& sched, const uint8_t* data, size_t len) {
+    return DigestAwaiter(sched, data, len);
+}
@@ -0,0 +1,258 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <cctype>
+#include <climits>
+#include <random>
+#include "SM4-GCM-container.h"
+
+using namespace std;
+using namespace chrono;
+
+//分块加密容器命令行工具：
+//   enc  <密钥hex> <输入> <输出> [分块大小] [线程数]
+//   dec  <密钥hex> <输入> <输出> [线程数]
+//   read <密钥hex> <容器> <偏移> <长度>      明文写到标准输出
+//   --self-test                              自测演示（在当前目录生成约32MB的临时文件）
+//分块大小、偏移、长度为十进制数，可带K/M/G后缀；线程数为十进制数；其他写法打印用法并返回2
+
+//十进制数，可带K/M/G后缀（1024进制）；空串、其他字符或溢出时返回false
+static bool parse_size(const string& s, size_t& v) {
+    size_t n = s.size();
+    unsigned shift = 0;
+    if (n > 0) {
+        char u = (char)toupper((unsigned char)s.back());
+        shift = u == 'K' ? 10 : u == 'M' ? 20 : u == 'G' ? 30 : 0;
+        n -= shift ? 1 : 0;
+    }
+    if (n == 0) {
+        return false;
+    }
+    size_t x = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!isdigit((unsigned char)s[i]) || x > (SIZE_MAX - 9) / 10) {
+            return false;
+        }
+        x = x * 10 + (size_t)(s[i] - '0');
+    }
+    if (x > (SIZE_MAX >> shift)) {
+        return false;
+    }
+    v = x << shift;
+    return true;
+}
+
+//不带后缀的十进制数，不超过UINT_MAX
+static bool parse_count(const string& s, unsigned& v) {
+    size_t x;
+    if (s.empty() || !isdigit((unsigned char)s.back()) || !parse_size(s, x) || x > UINT_MAX) {
+        return false;
+    }
+    v = (unsigned)x;
+    return true;
+}
+
+//偶数个十六进制字符；含其他字符时返回false
+static bool from_hex(const string& s, vector<uint8_t>& out) {
+    if (s.size() % 2 != 0) {
+        return false;
+    }
+    for (char c : s) {
+        if (!isxdigit((unsigned char)c)) {
+            return false;
+        }
+    }
+    out.resize(s.size() / 2);
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = (uint8_t)stoi(s.substr(2 * i, 2), nullptr, 16);
+    }
+    return true;
+}
+
+const char* status_name(ContainerStatus s) {
+    switch (s) {
+    case ContainerStatus::Ok: return "成功";
+    case ContainerStatus::IoError: return "读写失败";
+    case ContainerStatus::BadFormat: return "格式错误";
+    case ContainerStatus::AuthFailed: return "认证失败";
+    case ContainerStatus::OutOfRange: return "区间越界";
+    }
+    return "未知错误";
+}
+
+//读写整个文件，演示中用于构造与篡改容器
+vector<uint8_t> read_all(const string& path) {
+    ifstream f(path, ios::binary);
+    return vector<uint8_t>((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+}
+void write_all(const string& path, const vector<uint8_t>& data) {
+    ofstream f(path, ios::binary | ios::trunc);
+    f.write((const char*)data.data(), data.size());
+}
+
+int demo() {
+    const string plain_path = "container_demo.bin";
+    const string enc_path = "container_demo.sm4c";
+    const string dec_path = "container_demo.out";
+    const size_t SIZE = 32 * 1024 * 1024 + 12345;
+    const uint32_t CHUNK = 64 * 1024;
+
+    mt19937 rng(2025);
+    uint8_t key[16];
+    for (auto& b : key) b = (uint8_t)rng();
+    vector<uint8_t> data(SIZE);
+    for (auto& b : data) b = (uint8_t)rng();
+    write_all(plain_path, data);
+
+    GcmContainer c;
+    c.set_key(key);
+    bool ok = true;
+
+    auto start = high_resolution_clock::now();
+    ContainerStatus s = c.encrypt_file(plain_path, enc_path, CHUNK);
+    double t_enc = duration<double, milli>(high_resolution_clock::now() - start).count();
+    start = high_resolution_clock::now();
+    s = s == ContainerStatus::Ok ? c.decrypt_file(enc_path, dec_path) : s;
+    double t_dec = duration<double, milli>(high_resolution_clock::now() - start).count();
+    bool round = s == ContainerStatus::Ok && read_all(dec_path) == data;
+    cout << "整体加密/解密往返: " << (round ? "通过" : "失败") << "（" << status_name(s) << "）" << endl;
+    cout << "整体加密 " << t_enc << " ms，整体解密 " << t_dec << " ms" << endl;
+    ok = ok && round;
+
+    //随机区间读取，包括跨分块、恰好在分块边界和最后一个不满的分块
+    ContainerReader reader;
+    bool seek_ok = reader.open(c, enc_path) == ContainerStatus::Ok && reader.size() == SIZE;
+    vector<uint8_t> buf(3 * CHUNK);
+    for (int i = 0; i < 200 && seek_ok; i++) {
+        size_t len = rng() % buf.size();
+        uint64_t off = rng() % (SIZE - len + 1);
+        if (i == 0) off = SIZE - len;
+        if (i == 1) off = CHUNK;
+        seek_ok = reader.read(off, len, buf.data()) == ContainerStatus::Ok &&
+            memcmp(buf.data(), data.data() + off, len) == 0;
+    }
+    seek_ok = seek_ok && reader.read(SIZE - 10, 11, buf.data()) == ContainerStatus::OutOfRange;
+    cout << "随机区间读取: " << (seek_ok ? "通过" : "失败") << endl;
+    ok = ok && seek_ok;
+
+    start = high_resolution_clock::now();
+    const int READS = 1000;
+    for (int i = 0; i < READS; i++) {
+        reader.read(rng() % (SIZE - 4096), 4096, buf.data());
+    }
+    double t_seek = duration<double, micro>(high_resolution_clock::now() - start).count() / READS;
+    cout << "随机读取4KB平均耗时: " << t_seek << " us（整体解密的 1/" << (int)(t_dec * 1000 / t_seek) << "）" << endl;
+
+    //篡改检测：交换两个分块、截断末尾分块、改动头部长度、改动密文
+    vector<uint8_t> file = read_all(enc_path);
+    size_t rec = CHUNK + 16;
+    auto expect_fail = [&](const vector<uint8_t>& f, const char* name) {
+        write_all(enc_path, f);
+        ContainerStatus st = c.decrypt_file(enc_path, dec_path);
+        cout << name << ": " << status_name(st) << endl;
+        return st != ContainerStatus::Ok;
+    };
+    vector<uint8_t> swapped = file;
+    swap_ranges(swapped.begin() + ContainerHeader::SIZE, swapped.begin() + ContainerHeader::SIZE + rec,
+        swapped.begin() + ContainerHeader::SIZE + rec);
+    ok = expect_fail(swapped, "交换分块0和1") && ok;
+
+    //删去最后一块并把头部长度改为整块数，使文件长度自洽
+    uint64_t full = (SIZE / CHUNK) * CHUNK;
+    vector<uint8_t> truncated(file.begin(), file.begin() + ContainerHeader::SIZE + (SIZE / CHUNK) * rec);
+    truncated.insert(truncated.end(), file.end() - 32, file.end());
+    ContainerHeader::put_be(truncated.data() + 16, full, 8);
+    ok = expect_fail(truncated, "截断末尾分块") && ok;
+
+    vector<uint8_t> flipped = file;
+    flipped[ContainerHeader::SIZE + 5 * rec + 100] ^= 1;
+    ok = expect_fail(flipped, "改动分块5的密文") && ok;
+
+    ContainerReader tampered;
+    bool local = tampered.open(c, enc_path) == ContainerStatus::Ok &&
+        tampered.read(0, 4096, buf.data()) == ContainerStatus::Ok &&
+        tampered.read(5 * CHUNK, 16, buf.data()) == ContainerStatus::AuthFailed;
+    cout << "篡改只影响所在分块的读取: " << (local ? "是" : "否") << endl;
+    ok = ok && local;
+
+    remove(plain_path.c_str());
+    remove(enc_path.c_str());
+    remove(dec_path.c_str());
+    return ok ? 0 : 1;
+}
+
+static int usage(const char* argv0) {
+    cerr << "用法: " << argv0 << " enc <32位十六进制密钥> <输入> <输出> [分块大小] [线程数]" << endl;
+    cerr << "      " << argv0 << " dec <32位十六进制密钥> <输入> <输出> [线程数]" << endl;
+    cerr << "      " << argv0 << " read <32位十六进制密钥> <容器> <偏移> <长度>" << endl;
+    cerr << "      " << argv0 << " --self-test" << endl;
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 2 && string(argv[1]) == "--self-test") {
+        return demo();
+    }
+    vector<uint8_t> key;
+    if (argc < 5 || strlen(argv[2]) != 32 || !from_hex(argv[2], key)) {
+        return usage(argv[0]);
+    }
+    string cmd = argv[1];
+    GcmContainer c;
+    c.set_key(key.data());
+    ContainerStatus s;
+    if (cmd == "enc" && argc <= 7) {
+        size_t chunk = 64 * 1024;
+        unsigned threads = 0;
+        if ((argc > 5 && !parse_size(argv[5], chunk)) || chunk == 0 || chunk > UINT32_MAX ||
+            (argc > 6 && !parse_count(argv[6], threads))) {
+            return usage(argv[0]);
+        }
+        s = c.encrypt_file(argv[3], argv[4], (uint32_t)chunk, threads);
+    }
+    else if (cmd == "dec" && argc <= 6) {
+        unsigned threads = 0;
+        if (argc > 5 && !parse_count(argv[5], threads)) {
+            return usage(argv[0]);
+        }
+        s = c.decrypt_file(argv[3], argv[4], threads);
+        if (s != ContainerStatus::Ok) {
+            remove(argv[4]); //不保留未完成验证的明文
+        }
+    }
+    else if (cmd == "read" && argc == 6) {
+        size_t off, len;
+        if (!parse_size(argv[4], off) || !parse_size(argv[5], len)) {
+            return usage(argv[0]);
+        }
+        ContainerReader reader;
+        s = reader.open(c, argv[3]);
+        //先按明文长度检查区间，再分段读取输出，缓冲区不随请求的长度增长
+        if (s == ContainerStatus::Ok && (off > reader.size() || len > reader.size() - off)) {
+            s = ContainerStatus::OutOfRange;
+        }
+        vector<uint8_t> buf(s == ContainerStatus::Ok ? min(len, (size_t)1 << 20) : 0);
+        while (s == ContainerStatus::Ok && len > 0) {
+            size_t n = min(len, buf.size());
+            s = reader.read(off, n, buf.data());
+            if (s == ContainerStatus::Ok) {
+                cout.write((const char*)buf.data(), n);
+            }
+            off += n;
+            len -= n;
+        }
+    }
+    else {
+        return usage(argv[0]);
+    }
+    if (s != ContainerStatus::Ok) {
+        cerr << status_name(s) << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,447 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "SM4-GCM-optimized.h"
+#include "../common/thread_pool.h"
+
+//分块可随机访问的SM4-GCM加密容器
+//
+//文件布局（整数均为大端）：
+//   头部 40字节：magic "SM4GCMCT" | version u32 | chunk_size u32 | 明文长度 u64 | nonce_base 12字节 | 保留 u32
+//   分块 i：密文（除最后一块外均为chunk_size字节）|| 16字节标签
+//   尾部 32字节：magic "SM4GCMCF" | 分块数 u64 | 16字节标签
+//
+//第i块的nonce = nonce_base后8字节异或i，AAD = 头部 || i || final标志（最后一块为1）。
+//头部参与每一块的认证，分块交换位置、删去末尾分块或改动明文长度都会使标签验证失败；
+//尾部标签为GMAC(头部 || 各块标签)，用于整体解密时确认对象完整。
+//读取任意区间只需读入并验证覆盖该区间的分块。
+
+enum class ContainerStatus {
+    Ok,
+    IoError,     //文件无法打开或读写失败
+    BadFormat,   //magic、版本或文件长度与头部不符
+    AuthFailed,  //分块或尾部标签验证失败
+    OutOfRange   //读取区间超出明文长度
+};
+
+struct ContainerHeader {
+    static const size_t SIZE = 40;
+    static const uint32_t VERSION = 1;
+
+    uint32_t chunk_size;
+    uint64_t plain_len;
+    uint8_t nonce_base[12];
+    uint8_t bytes[SIZE]; //序列化结果，同时作为分块AAD的一部分
+
+    static void put_be(uint8_t* p, uint64_t v, int n) {
+        for (int i = 0; i < n; i++) {
+            p[i] = (uint8_t)(v >> (8 * (n - 1 - i)));
+        }
+    }
+    static uint64_t get_be(const uint8_t* p, int n) {
+        uint64_t v = 0;
+        for (int i = 0; i < n; i++) {
+            v = v << 8 | p[i];
+        }
+        return v;
+    }
+
+    void serialize() {
+        memcpy(bytes, "SM4GCMCT", 8);
+        put_be(bytes + 8, VERSION, 4);
+        put_be(bytes + 12, chunk_size, 4);
+        put_be(bytes + 16, plain_len, 8);
+        memcpy(bytes + 24, nonce_base, 12);
+        put_be(bytes + 36, 0, 4);
+    }
+
+    bool parse(const uint8_t in[SIZE]) {
+        memcpy(bytes, in, SIZE);
+        if (memcmp(bytes, "SM4GCMCT", 8) != 0 || get_be(bytes + 8, 4) != VERSION) {
+            return false;
+        }
+        chunk_size = (uint32_t)get_be(bytes + 12, 4);
+        plain_len = get_be(bytes + 16, 8);
+        memcpy(nonce_base, bytes + 24, 12);
+        return chunk_size > 0 && get_be(bytes + 36, 4) == 0;
+    }
+
+    //空对象也有一个长度为0的分块，保证final标志总能被认证
+    uint64_t chunk_count() const {
+        return plain_len == 0 ? 1 : (plain_len + chunk_size - 1) / chunk_size;
+    }
+    size_t chunk_len(uint64_t i) const {
+        uint64_t rest = plain_len - i * chunk_size;
+        return (size_t)(rest < chunk_size ? rest : chunk_size);
+    }
+    uint64_t chunk_offset(uint64_t i) const {
+        return SIZE + i * ((uint64_t)chunk_size + 16);
+    }
+    uint64_t file_size() const {
+        return SIZE + plain_len + 16 * chunk_count() + 32;
+    }
+    //连续count个分块的明文缓冲区大小：除最后一块外都是整块，不会超过明文总长度，
+    //头部中的分块大小即使被篡改成很大的值也不会导致按分块大小分配内存
+    size_t batch_bytes(size_t count) const {
+        uint64_t full = (uint64_t)count * chunk_size;
+        return (size_t)(full < plain_len ? full : plain_len);
+    }
+};
+
+class GcmContainer {
+private:
+    GCM gcm;
+    GMAC gmac;
+    ThreadPool* pool;  //为空时使用进程共享的线程池
+
+    static const size_t TAG_SIZE = 16;
+    static const size_t FOOTER_SIZE = 32;
+    static const size_t AAD_SIZE = ContainerHeader::SIZE + 9;
+    static const size_t CHUNKS_PER_THREAD = 8; //每批每个线程处理的分块数
+
+    friend class ContainerReader;
+
+    static void chunk_nonce(const ContainerHeader& h, uint64_t i, uint8_t nonce[12]) {
+        memcpy(nonce, h.nonce_base, 12);
+        for (int k = 0; k < 8; k++) {
+            nonce[4 + k] ^= (uint8_t)(i >> (56 - 8 * k));
+        }
+    }
+
+    static void chunk_aad(const ContainerHeader& h, uint64_t i, uint8_t aad[AAD_SIZE]) {
+        memcpy(aad, h.bytes, ContainerHeader::SIZE);
+        ContainerHeader::put_be(aad + ContainerHeader::SIZE, i, 8);
+        aad[AAD_SIZE - 1] = (i + 1 == h.chunk_count()) ? 1 : 0;
+    }
+
+    //安全擦除，防止编译器优化掉
+    static void secure_zero(void* p, size_t n) {
+        volatile uint8_t* v = (volatile uint8_t*)p;
+        while (n--) {
+            *v++ = 0;
+        }
+    }
+
+    //常数时间比较标签
+    static bool tag_equal(const uint8_t a[16], const uint8_t b[16]) {
+        uint8_t diff = 0;
+        for (int i = 0; i < 16; i++) {
+            diff |= a[i] ^ b[i];
+        }
+        return diff == 0;
+    }
+
+    ThreadPool& workers() const {
+        return pool ? *pool : ThreadPool::global();
+    }
+
+    //threads为0时取线程池的线程数
+    unsigned resolve_threads(unsigned threads) const {
+        if (threads == 0) {
+            threads = workers().size();
+        }
+        return threads == 0 ? 1 : threads;
+    }
+
+    //处理从first开始的count个连续分块，在线程池上最多分成threads个任务
+    //加密：plain为连续明文，records为连续的（密文||标签）记录；解密方向相反
+    bool crypt_chunks(const ContainerHeader& h, uint64_t first, size_t count, uint8_t* plain, uint8_t* records,
+        bool encrypting, unsigned threads) const {
+        std::vector<char> ok(count, 1);
+        workers().parallel_for(0, count, (count + threads - 1) / threads, [&](size_t lo, size_t hi) {
+            for (size_t j = lo; j < hi; j++) {
+                uint8_t* p = plain + j * (size_t)h.chunk_size;
+                uint8_t* r = records + j * ((size_t)h.chunk_size + TAG_SIZE);
+                if (encrypting) {
+                    seal_chunk(h, first + j, p, r);
+                }
+                else if (!open_chunk(h, first + j, r, p)) {
+                    ok[j] = 0;
+                }
+            }
+        });
+        for (char c : ok) {
+            if (!c) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //尾部：分块数 || GMAC(头部 || 各块标签)，nonce取分块下标用不到的全1
+    void footer_nonce(const ContainerHeader& h, uint8_t nonce[12]) const {
+        chunk_nonce(h, UINT64_MAX, nonce);
+    }
+
+    void footer_mac(const ContainerHeader& h, const uint8_t* tags, uint8_t mac_out[TAG_SIZE]) const {
+        uint8_t nonce[12];
+        footer_nonce(h, nonce);
+        GMAC mac = gmac;
+        mac.init(nonce);
+        mac.update(h.bytes, ContainerHeader::SIZE);
+        mac.update(tags, (size_t)h.chunk_count() * TAG_SIZE);
+        mac.final(mac_out);
+    }
+
+    //records中连续count条记录的标签依次送入GMAC
+    static void absorb_tags(GMAC& mac, const ContainerHeader& h, uint64_t first, size_t count,
+        const uint8_t* records) {
+        for (size_t j = 0; j < count; j++) {
+            size_t n = h.chunk_len(first + j);
+            mac.update(records + j * ((size_t)h.chunk_size + TAG_SIZE) + n, TAG_SIZE);
+        }
+    }
+
+public:
+    GcmContainer() : pool(nullptr) {}
+
+    void set_key(const uint8_t key[16]) {
+        gcm.set_key(key);
+        gmac.set_key(key);
+    }
+
+    //指定执行分块加解密的线程池（须比容器对象活得久）
+    void set_pool(ThreadPool& p) {
+        pool = &p;
+    }
+
+    //新容器的头部，nonce_base随机生成
+    static ContainerHeader make_header(uint64_t len, uint32_t chunk_size) {
+        ContainerHeader h;
+        h.chunk_size = chunk_size;
+        h.plain_len = len;
+        std::random_device rd;
+        for (auto& b : h.nonce_base) {
+            b = (uint8_t)rd();
+        }
+        h.serialize();
+        return h;
+    }
+
+    //以下单块接口供自行安排读写的调用方使用（如tools/crypto_pipe.cpp的io_uring流水线）
+
+    //加密第i块：plain为该块明文，record输出密文||标签（chunk_len(i) + 16字节），不能与plain重叠
+    void seal_chunk(const ContainerHeader& h, uint64_t i, const uint8_t* plain, uint8_t* record) const {
+        uint8_t nonce[12], aad[AAD_SIZE];
+        chunk_nonce(h, i, nonce);
+        chunk_aad(h, i, aad);
+        size_t n = h.chunk_len(i);
+        gcm.encrypt(nonce, plain, n, aad, AAD_SIZE, record, record + n);
+    }
+
+    //验证并解密第i块，验证失败时返回false且plain被清零
+    bool open_chunk(const ContainerHeader& h, uint64_t i, const uint8_t* record, uint8_t* plain) const {
+        uint8_t nonce[12], aad[AAD_SIZE];
+        chunk_nonce(h, i, nonce);
+        chunk_aad(h, i, aad);
+        size_t n = h.chunk_len(i);
+        return gcm.decrypt(nonce, record, n, aad, AAD_SIZE, record + n, plain);
+    }
+
+    //由各块标签（按下标依次拼接，共chunk_count()个）生成32字节尾部
+    void make_footer(const ContainerHeader& h, const uint8_t* tags, uint8_t footer[32]) const {
+        memcpy(footer, "SM4GCMCF", 8);
+        ContainerHeader::put_be(footer + 8, h.chunk_count(), 8);
+        footer_mac(h, tags, footer + 16);
+    }
+
+    bool check_footer(const ContainerHeader& h, const uint8_t* tags, const uint8_t footer[32]) const {
+        uint8_t expect[TAG_SIZE];
+        footer_mac(h, tags, expect);
+        return memcmp(footer, "SM4GCMCF", 8) == 0 && ContainerHeader::get_be(footer + 8, 8) == h.chunk_count() &&
+            tag_equal(expect, footer + 16);
+    }
+
+    //加密长度为len的输入流，chunk_size为分块明文大小，threads为0时取线程池的线程数
+    ContainerStatus encrypt_stream(std::istream& in, uint64_t len, std::ostream& out,
+        uint32_t chunk_size = 64 * 1024, unsigned threads = 0) const {
+        if (chunk_size == 0) {
+            return ContainerStatus::BadFormat;
+        }
+        threads = resolve_threads(threads);
+        ContainerHeader h = make_header(len, chunk_size);
+        out.write((const char*)h.bytes, ContainerHeader::SIZE);
+
+        uint8_t nonce[12];
+        footer_nonce(h, nonce);
+        GMAC mac = gmac;
+        mac.init(nonce);
+        mac.update(h.bytes, ContainerHeader::SIZE);
+
+        uint64_t total = h.chunk_count();
+        size_t batch = threads * CHUNKS_PER_THREAD;
+        std::vector<uint8_t> plain(h.batch_bytes(batch));
+        std::vector<uint8_t> records(h.batch_bytes(batch) + batch * TAG_SIZE);
+        for (uint64_t first = 0; first < total; first += batch) {
+            size_t count = (size_t)(total - first < batch ? total - first : batch);
+            size_t bytes = 0;
+            for (size_t j = 0; j < count; j++) {
+                bytes += h.chunk_len(first + j);
+            }
+            if (bytes > 0 && !in.read((char*)plain.data(), bytes)) {
+                return ContainerStatus::IoError;
+            }
+            crypt_chunks(h, first, count, plain.data(), records.data(), true, threads);
+            absorb_tags(mac, h, first, count, records.data());
+            //除最后一块外记录长度固定，批内记录在缓冲区中连续
+            out.write((const char*)records.data(), bytes + count * TAG_SIZE);
+        }
+
+        uint8_t footer[FOOTER_SIZE];
+        memcpy(footer, "SM4GCMCF", 8);
+        ContainerHeader::put_be(footer + 8, total, 8);
+        mac.final(footer + 16);
+        out.write((const char*)footer, FOOTER_SIZE);
+        secure_zero(plain.data(), plain.size());
+        return out ? ContainerStatus::Ok : ContainerStatus::IoError;
+    }
+
+    //整体解密：逐批并行验证并解密，最后校验尾部；
+    //只有验证通过的分块才会写入out，返回非Ok时调用方应丢弃已写出的部分
+    ContainerStatus decrypt_stream(std::istream& in, uint64_t file_size, std::ostream& out,
+        unsigned threads = 0) const {
+        threads = resolve_threads(threads);
+        uint8_t hb[ContainerHeader::SIZE];
+        ContainerHeader h;
+        if (!in.read((char*)hb, ContainerHeader::SIZE)) {
+            return ContainerStatus::IoError;
+        }
+        if (!h.parse(hb) || h.file_size() != file_size) {
+            return ContainerStatus::BadFormat;
+        }
+
+        uint8_t nonce[12];
+        footer_nonce(h, nonce);
+        GMAC mac = gmac;
+        mac.init(nonce);
+        mac.update(h.bytes, ContainerHeader::SIZE);
+
+        uint64_t total = h.chunk_count();
+        size_t batch = threads * CHUNKS_PER_THREAD;
+        std::vector<uint8_t> plain(h.batch_bytes(batch));
+        std::vector<uint8_t> records(h.batch_bytes(batch) + batch * TAG_SIZE);
+        for (uint64_t first = 0; first < total; first += batch) {
+            size_t count = (size_t)(total - first < batch ? total - first : batch);
+            size_t bytes = 0;
+            for (size_t j = 0; j < count; j++) {
+                bytes += h.chunk_len(first + j);
+            }
+            if (!in.read((char*)records.data(), bytes + count * TAG_SIZE)) {
+                return ContainerStatus::IoError;
+            }
+            if (!crypt_chunks(h, first, count, plain.data(), records.data(), false, threads)) {
+                secure_zero(plain.data(), plain.size());
+                return ContainerStatus::AuthFailed;
+            }
+            absorb_tags(mac, h, first, count, records.data());
+            out.write((const char*)plain.data(), bytes);
+        }
+        secure_zero(plain.data(), plain.size());
+
+        uint8_t footer[FOOTER_SIZE], expect[TAG_SIZE];
+        if (!in.read((char*)footer, FOOTER_SIZE)) {
+            return ContainerStatus::IoError;
+        }
+        mac.final(expect);
+        if (memcmp(footer, "SM4GCMCF", 8) != 0 || ContainerHeader::get_be(footer + 8, 8) != total ||
+            !tag_equal(expect, footer + 16)) {
+            return ContainerStatus::AuthFailed;
+        }
+        return out ? ContainerStatus::Ok : ContainerStatus::IoError;
+    }
+
+    ContainerStatus encrypt_file(const std::string& in_path, const std::string& out_path,
+        uint32_t chunk_size = 64 * 1024, unsigned threads = 0) const {
+        std::ifstream in(in_path, std::ios::binary | std::ios::ate);
+        std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+        if (!in || !out) {
+            return ContainerStatus::IoError;
+        }
+        uint64_t len = (uint64_t)in.tellg();
+        in.seekg(0);
+        return encrypt_stream(in, len, out, chunk_size, threads);
+    }
+
+    ContainerStatus decrypt_file(const std::string& in_path, const std::string& out_path,
+        unsigned threads = 0) const {
+        std::ifstream in(in_path, std::ios::binary | std::ios::ate);
+        std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+        if (!in || !out) {
+            return ContainerStatus::IoError;
+        }
+        uint64_t size = (uint64_t)in.tellg();
+        in.seekg(0);
+        return decrypt_stream(in, size, out, threads);
+    }
+};
+
+//随机访问读取：打开时只读头部并检查文件长度，之后每次读取只触及覆盖区间的分块
+class ContainerReader {
+private:
+    const GcmContainer* container;
+    std::ifstream file;
+    ContainerHeader h;
+    std::vector<uint8_t> plain, records;
+
+public:
+    ContainerReader() : container(nullptr) {}
+
+    ContainerStatus open(const GcmContainer& c, const std::string& path) {
+        container = &c;
+        file.open(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            return ContainerStatus::IoError;
+        }
+        uint64_t size = (uint64_t)file.tellg();
+        uint8_t hb[ContainerHeader::SIZE];
+        file.seekg(0);
+        if (!file.read((char*)hb, ContainerHeader::SIZE)) {
+            return ContainerStatus::BadFormat;
+        }
+        if (!h.parse(hb) || h.file_size() != size) {
+            return ContainerStatus::BadFormat;
+        }
+        return ContainerStatus::Ok;
+    }
+
+    //明文总长度
+    uint64_t size() const {
+        return h.plain_len;
+    }
+
+    //读取明文[offset, offset+len)：覆盖区间的分块一次性读入后并行验证解密
+    ContainerStatus read(uint64_t offset, size_t len, uint8_t* out, unsigned threads = 0) {
+        if (offset > h.plain_len || len > h.plain_len - offset) {
+            return ContainerStatus::OutOfRange;
+        }
+        if (len == 0) {
+            return ContainerStatus::Ok;
+        }
+        uint64_t first = offset / h.chunk_size;
+        uint64_t last = (offset + len - 1) / h.chunk_size;
+        size_t count = (size_t)(last - first + 1);
+        size_t bytes = 0;
+        for (size_t j = 0; j < count; j++) {
+            bytes += h.chunk_len(first + j);
+        }
+        plain.resize(bytes);
+        records.resize(bytes + count * GcmContainer::TAG_SIZE);
+        file.clear();
+        file.seekg((std::streamoff)h.chunk_offset(first));
+        if (!file.read((char*)records.data(), bytes + count * GcmContainer::TAG_SIZE)) {
+            return ContainerStatus::IoError;
+        }
+        threads = container->resolve_threads(threads);
+        bool ok = container->crypt_chunks(h, first, count, plain.data(), records.data(), false, threads);
+        if (ok) {
+            memcpy(out, plain.data() + (offset - first * h.chunk_size), len);
+        }
+        GcmContainer::secure_zero(plain.data(), plain.size());
+        return ok ? ContainerStatus::Ok : ContainerStatus::AuthFailed;
+    }
+};
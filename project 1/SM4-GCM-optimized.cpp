@@ -0,0 +1,383 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <array>
+#include "SM4-GCM-optimized.h"
+
+using namespace std;
+using namespace chrono;
+
+//辅助函数：打印十六进制数据
+void print_hex(const string& label, const uint8_t* data, size_t len) {
+    cout << label << ": ";
+    for (size_t i = 0; i < len; i++) {
+        cout << hex << setw(2) << setfill('0') << (int)data[i];
+    }
+    cout << dec << endl;
+}
+
+//辅助函数：十六进制字符串转字节数组
+vector<uint8_t> from_hex(const string& s) {
+    vector<uint8_t> out(s.size() / 2);
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = (uint8_t)stoi(s.substr(2 * i, 2), nullptr, 16);
+    }
+    return out;
+}
+
+//标准测试向量：GB/T 32907 SM4与RFC 8998 SM4-GCM
+bool test_vectors() {
+    bool ok = true;
+    vector<uint8_t> key = from_hex("0123456789abcdeffedcba9876543210");
+    SM4 sm4;
+    sm4.set_key(key.data());
+    uint8_t out[16];
+    sm4.encrypt_block(key.data(), out);
+    bool sm4_ok = memcmp(out, from_hex("681edf34d206965e86b3e94f536e4246").data(), 16) == 0;
+    cout << "SM4 标准测试向量: " << (sm4_ok ? "通过" : "失败") << endl;
+    ok = ok && sm4_ok;
+
+    vector<uint8_t> iv = from_hex("00001234567800000000abcd");
+    vector<uint8_t> aad = from_hex("feedfacedeadbeeffeedfacedeadbeefabaddad2");
+    vector<uint8_t> pt = from_hex(
+        "aaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbccccccccccccccccdddddddddddddddd"
+        "eeeeeeeeeeeeeeeeffffffffffffffffeeeeeeeeeeeeeeeeaaaaaaaaaaaaaaaa");
+    vector<uint8_t> ct_expect = from_hex(
+        "17f399f08c67d5ee19d0dc9969c4bb7d5fd46fd3756489069157b282bb200735"
+        "d82710ca5c22f0ccfa7cbf93d496ac15a56834cbcf98c397b4024a2691233b8d");
+    vector<uint8_t> tag_expect = from_hex("83de3541e4c2b58177e065a9bf7b62ec");
+    GCM gcm;
+    gcm.set_key(key.data());
+    vector<uint8_t> ct(pt.size());
+    uint8_t tag[16];
+    gcm.encrypt(iv.data(), pt.data(), pt.size(), aad.data(), aad.size(), ct.data(), tag);
+    bool gcm_ok = ct == ct_expect && memcmp(tag, tag_expect.data(), 16) == 0;
+    cout << "SM4-GCM RFC 8998 测试向量: " << (gcm_ok ? "通过" : "失败") << endl;
+    return ok && gcm_ok;
+}
+
+//批量接口测试：与逐个调用的结果逐字节比较，并比较报文速率
+bool test_batch() {
+    const size_t PACKETS = 1024;
+    mt19937 rng(2025);
+    uint8_t key[16];
+    for (auto& b : key) b = (uint8_t)rng();
+    GCM gcm;
+    gcm.set_key(key);
+
+    //64~1500字节的报文，AAD长度0~32
+    vector<vector<uint8_t>> nonce(PACKETS), aad(PACKETS), pt(PACKETS);
+    vector<vector<uint8_t>> ct_single(PACKETS), ct_batch(PACKETS), dec(PACKETS);
+    vector<vector<uint8_t>> tag_single(PACKETS, vector<uint8_t>(16)), tag_batch(PACKETS, vector<uint8_t>(16));
+    for (size_t i = 0; i < PACKETS; i++) {
+        nonce[i].resize(12);
+        aad[i].resize(rng() % 33);
+        pt[i].resize(64 + rng() % (1500 - 64 + 1));
+        for (auto& b : nonce[i]) b = (uint8_t)rng();
+        for (auto& b : aad[i]) b = (uint8_t)rng();
+        for (auto& b : pt[i]) b = (uint8_t)rng();
+        ct_single[i].resize(pt[i].size());
+        ct_batch[i].resize(pt[i].size());
+        dec[i].resize(pt[i].size());
+    }
+
+    vector<GcmPacket> packets(PACKETS);
+    for (size_t i = 0; i < PACKETS; i++) {
+        packets[i] = { nonce[i].data(), aad[i].data(), aad[i].size(), pt[i].data(), pt[i].size(),
+            ct_batch[i].data(), tag_batch[i].data(), false };
+    }
+    //两种方式交替各运行若干轮，取各自最快的一轮
+    double single_us = 1e30, batch_us = 1e30;
+    for (int round = 0; round < 5; round++) {
+        auto start = high_resolution_clock::now();
+        for (size_t i = 0; i < PACKETS; i++) {
+            gcm.encrypt(nonce[i].data(), pt[i].data(), pt[i].size(), aad[i].data(), aad[i].size(),
+                ct_single[i].data(), tag_single[i].data());
+        }
+        auto end = high_resolution_clock::now();
+        single_us = min(single_us, duration_cast<nanoseconds>(end - start).count() / 1000.0);
+
+        start = high_resolution_clock::now();
+        gcm.encrypt_batch(packets.data(), PACKETS);
+        end = high_resolution_clock::now();
+        batch_us = min(batch_us, duration_cast<nanoseconds>(end - start).count() / 1000.0);
+    }
+
+    bool same = true;
+    for (size_t i = 0; i < PACKETS; i++) {
+        same = same && ct_single[i] == ct_batch[i] && tag_single[i] == tag_batch[i];
+    }
+    cout << "批量加密与逐个加密结果一致: " << (same ? "是" : "否") << endl;
+
+    //篡改部分报文后批量解密
+    ct_batch[3][0] ^= 0x01;
+    tag_batch[7][15] ^= 0x80;
+    for (size_t i = 0; i < PACKETS; i++) {
+        packets[i] = { nonce[i].data(), aad[i].data(), aad[i].size(), ct_batch[i].data(), ct_batch[i].size(),
+            dec[i].data(), tag_batch[i].data(), false };
+    }
+    size_t valid = gcm.decrypt_batch(packets.data(), PACKETS);
+    bool dec_ok = valid == PACKETS - 2 && !packets[3].valid && !packets[7].valid;
+    for (size_t i = 0; i < PACKETS; i++) {
+        if (packets[i].valid) {
+            dec_ok = dec_ok && dec[i] == pt[i];
+        }
+    }
+    cout << "批量解密: " << valid << "/" << PACKETS << " 通过验证，篡改报文被拒绝: "
+        << (dec_ok ? "是" : "否") << endl;
+
+    cout << fixed << setprecision(1);
+    cout << "逐个加密: " << single_us << " us (" << PACKETS / single_us * 1e6 << " 报文/秒)" << endl;
+    cout << "批量加密: " << batch_us << " us (" << PACKETS / batch_us * 1e6 << " 报文/秒)" << endl;
+    cout << defaultfloat;
+    return same && dec_ok;
+}
+
+//多线程接口测试：不同线程数下密文和标签都应与单线程结果一致
+bool test_parallel() {
+    const size_t LEN = 8 * 1024 * 1024 + 13;
+    mt19937 rng(2026);
+    uint8_t key[16], nonce[12];
+    for (auto& b : key) b = (uint8_t)rng();
+    for (auto& b : nonce) b = (uint8_t)rng();
+    vector<uint8_t> aad(45), pt(LEN), ct(LEN), ct_par(LEN), dec(LEN);
+    for (auto& b : aad) b = (uint8_t)rng();
+    for (auto& b : pt) b = (uint8_t)rng();
+    GCM gcm;
+    gcm.set_key(key);
+
+    uint8_t tag[16], tag_par[16];
+    auto start = high_resolution_clock::now();
+    gcm.encrypt(nonce, pt.data(), LEN, aad.data(), aad.size(), ct.data(), tag);
+    auto end = high_resolution_clock::now();
+    double serial_ms = duration_cast<microseconds>(end - start).count() / 1000.0;
+    cout << fixed << setprecision(3);
+    cout << "单线程加密 " << LEN / 1024 / 1024 << " MB: " << serial_ms << " ms" << endl;
+
+    bool ok = true;
+    for (unsigned threads : { 1u, 2u, 4u, 8u, 0u }) {
+        start = high_resolution_clock::now();
+        gcm.encrypt_parallel(nonce, pt.data(), LEN, aad.data(), aad.size(), ct_par.data(), tag_par, threads);
+        end = high_resolution_clock::now();
+        bool same = ct_par == ct && memcmp(tag, tag_par, 16) == 0;
+        bool valid = gcm.decrypt_parallel(nonce, ct_par.data(), LEN, aad.data(), aad.size(), tag_par,
+            dec.data(), threads) && dec == pt;
+        cout << "任务数 " << (threads == 0 ? string("按256KB切分") : to_string(threads)) << "（线程池 "
+            << ThreadPool::global().size() << " 线程）: " << duration_cast<microseconds>(end - start).count() / 1000.0
+            << " ms，结果一致: " << (same && valid ? "是" : "否") << endl;
+        ok = ok && same && valid;
+    }
+    cout << defaultfloat;
+    return ok;
+}
+
+//线程池：多个线程同时在同一个池上提交并行任务，以及任务内部嵌套的parallel_for
+bool test_pool() {
+    const size_t LEN = 1024 * 1024 + 7;
+    const int CALLS = 16;
+    ThreadPool pool(4);
+    uint8_t key[16] = { 7 }, nonce[12] = { 9 };
+    vector<uint8_t> pt(LEN, 0x3c), ct(LEN);
+    GCM gcm;
+    gcm.set_key(key);
+    uint8_t tag[16];
+    gcm.encrypt(nonce, pt.data(), LEN, nullptr, 0, ct.data(), tag);
+
+    //4个外部线程并发提交，结果都应与单线程一致
+    atomic<bool> ok(true);
+    auto start = high_resolution_clock::now();
+    vector<thread> clients;
+    for (int c = 0; c < 4; c++) {
+        clients.emplace_back([&]() {
+            vector<uint8_t> out(LEN);
+            uint8_t t[16];
+            for (int i = 0; i < CALLS; i++) {
+                gcm.encrypt_parallel(nonce, pt.data(), LEN, nullptr, 0, out.data(), t, pool);
+                if (out != ct || memcmp(t, tag, 16) != 0) {
+                    ok = false;
+                }
+            }
+        });
+    }
+    for (auto& th : clients) {
+        th.join();
+    }
+    double ms = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+
+    //嵌套：外层按报文并行，每个报文内部再并行
+    vector<vector<uint8_t>> outs(8, vector<uint8_t>(LEN));
+    vector<array<uint8_t, 16>> tags(8);
+    pool.parallel_for(0, outs.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++) {
+            gcm.encrypt_parallel(nonce, pt.data(), LEN, nullptr, 0, outs[i].data(), tags[i].data(), pool);
+        }
+    });
+    for (size_t i = 0; i < outs.size(); i++) {
+        ok = ok && outs[i] == ct && memcmp(tags[i].data(), tag, 16) == 0;
+    }
+    cout << "4个线程并发提交 " << 4 * CALLS << " 次1MB并行加密（共享4线程的池）: " << ms << " ms，嵌套并行结果一致: "
+        << (ok ? "是" : "否") << endl;
+    return ok;
+}
+
+//解密模式测试：三种模式结果一致；验证失败时输出缓冲区不含未认证明文
+bool test_decrypt_modes() {
+    const size_t LEN = 1500;
+    const int ROUNDS = 2000;
+    mt19937 rng(2027);
+    uint8_t key[16], nonce[12], tag[16];
+    for (auto& b : key) b = (uint8_t)rng();
+    for (auto& b : nonce) b = (uint8_t)rng();
+    vector<uint8_t> aad(20), pt(LEN), ct(LEN), out(LEN);
+    for (auto& b : aad) b = (uint8_t)rng();
+    for (auto& b : pt) b = (uint8_t)rng();
+    GCM gcm;
+    gcm.set_key(key);
+    gcm.encrypt(nonce, pt.data(), LEN, aad.data(), aad.size(), ct.data(), tag);
+    vector<uint8_t> forged = ct;
+    forged[LEN / 2] ^= 0x40;
+
+    bool ok = true;
+    const pair<DecryptMode, const char*> modes[] = {
+        { DecryptMode::Standard, "Standard" },
+        { DecryptMode::VerifyFirst, "VerifyFirst" },
+        { DecryptMode::Stitched, "Stitched" }
+    };
+    cout << fixed << setprecision(3);
+    for (const auto& m : modes) {
+        bool valid = gcm.decrypt(nonce, ct.data(), LEN, aad.data(), aad.size(), tag, out.data(), m.first)
+            && out == pt;
+        //输出缓冲区先填入标记值，伪造报文被拒绝后检查其中没有明文
+        fill(out.begin(), out.end(), 0xAA);
+        bool rejected = !gcm.decrypt(nonce, forged.data(), LEN, aad.data(), aad.size(), tag, out.data(), m.first);
+        bool clean = true;
+        for (size_t i = 0; i < LEN; i++) {
+            uint8_t expect = (m.first == DecryptMode::Standard) ? 0x00 : 0xAA;
+            clean = clean && out[i] == expect;
+        }
+        auto start = high_resolution_clock::now();
+        for (int r = 0; r < ROUNDS; r++) {
+            gcm.decrypt(nonce, forged.data(), LEN, aad.data(), aad.size(), tag, out.data(), m.first);
+        }
+        auto end = high_resolution_clock::now();
+        cout << m.second << ": 正常解密" << (valid ? "成功" : "失败") << "，伪造报文"
+            << (rejected && clean ? "被拒绝且无明文泄露" : "处理错误") << "，拒绝一个1500字节报文耗时 "
+            << duration_cast<nanoseconds>(end - start).count() / 1000.0 / ROUNDS << " us" << endl;
+        ok = ok && valid && rejected && clean;
+    }
+    cout << defaultfloat;
+    return ok;
+}
+
+//GMAC测试：一次性与任意分段的流式结果一致，且等于明文为空时的GCM标签
+bool test_gmac() {
+    const size_t LEN = 1024 * 1024 + 7;
+    mt19937 rng(2028);
+    uint8_t key[16], nonce[12];
+    for (auto& b : key) b = (uint8_t)rng();
+    for (auto& b : nonce) b = (uint8_t)rng();
+    vector<uint8_t> data(LEN);
+    for (auto& b : data) b = (uint8_t)rng();
+
+    GCM gcm;
+    gcm.set_key(key);
+    GMAC gmac;
+    gmac.set_key(key);
+
+    uint8_t tag_gcm[16], tag_one[16], tag_stream[16];
+    gcm.encrypt(nonce, nullptr, 0, data.data(), LEN, nullptr, tag_gcm);
+    gmac.compute(nonce, data.data(), LEN, tag_one);
+    gmac.init(nonce);
+    for (size_t off = 0; off < LEN;) {
+        size_t n = rng() % 300;
+        if (n > LEN - off) n = LEN - off;
+        gmac.update(data.data() + off, n);
+        off += n;
+    }
+    gmac.final(tag_stream);
+    bool ok = memcmp(tag_gcm, tag_one, 16) == 0 && memcmp(tag_one, tag_stream, 16) == 0
+        && gmac.verify(nonce, data.data(), LEN, tag_one);
+    cout << "GMAC一次性/流式/GCM空明文标签一致: " << (ok ? "是" : "否") << endl;
+
+    const int ROUNDS = 20;
+    auto start = high_resolution_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        gmac.compute(nonce, data.data(), LEN, tag_one);
+    }
+    auto end = high_resolution_clock::now();
+    double sec = duration_cast<nanoseconds>(end - start).count() / 1e9;
+    cout << "GMAC吞吐量: " << fixed << setprecision(1) << LEN * ROUNDS / sec / 1e6 << " MB/s" << endl;
+    cout << defaultfloat;
+    return ok;
+}
+
+int main() {
+    //测试向量
+    uint8_t key[16] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+        0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    uint8_t nonce[12] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b
+    };
+    uint8_t aad[] = "Additional authenticated data";
+    size_t aad_len = strlen((char*)aad);
+    uint8_t plaintext[] = "SM4-GCM";
+    size_t plaintext_len = strlen((char*)plaintext);
+
+    vector<uint8_t> ciphertext(plaintext_len);
+    uint8_t tag[16];
+    vector<uint8_t> decrypted(plaintext_len + 1, 0);
+
+    GCM gcm;
+    gcm.set_key(key);
+
+    auto start = high_resolution_clock::now();
+    gcm.encrypt(nonce, plaintext, plaintext_len, aad, aad_len, ciphertext.data(), tag);
+    auto end = high_resolution_clock::now();
+    auto duration = duration_cast<microseconds>(end - start);
+    cout << "加密耗时: " << fixed << setprecision(3) << duration.count() / 1000.0 << " ms" << endl;
+    cout << defaultfloat;
+
+    print_hex("Key", key, 16);
+    print_hex("Nonce", nonce, 12);
+    cout << "AAD: " << aad << " (length: " << aad_len << ")" << endl;
+    cout << "Plaintext: " << plaintext << " (length: " << plaintext_len << ")" << endl;
+    print_hex("Ciphertext", ciphertext.data(), ciphertext.size());
+    print_hex("Tag", tag, 16);
+
+    bool valid = gcm.decrypt(nonce, ciphertext.data(), ciphertext.size(),
+        aad, aad_len, tag, decrypted.data());
+    cout << "Decrypted (" << (valid ? "valid" : "invalid tag") << "): " << (char*)decrypted.data() << endl;
+
+    ciphertext[0] ^= 0x01; //篡改密文
+    valid = gcm.decrypt(nonce, ciphertext.data(), ciphertext.size(),
+        aad, aad_len, tag, decrypted.data());
+    cout << "Tampered: " << (valid ? "valid - ERROR" : "invalid tag - CORRECT") << endl << endl;
+
+    bool ok = test_vectors();
+    cout << endl;
+    ok = test_batch() && ok;
+    cout << endl;
+    ok = test_parallel() && ok;
+    ok = test_pool() && ok;
+    cout << endl;
+    ok = test_decrypt_modes() && ok;
+    cout << endl;
+    ok = test_gmac() && ok;
+#ifdef CRYPTO_TELEMETRY
+    //以上所有调用的遥测汇总
+    cout << endl;
+    fflush(stdout);
+    crypto_telemetry::write_text(stdout);
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1129 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "SM4-optimized.h"
+#include "../common/thread_pool.h"
+#include "../common/usdt.h"
+
+//架构检测：x86-64下提供PCLMULQDQ实现的GHASH，运行时按CPU特性选择
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define GCM_CLMUL_ARCH
+#define GCM_TARGET_CLMUL __attribute__((target("pclmul,ssse3")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#define GCM_CLMUL_ARCH
+#define GCM_TARGET_CLMUL
+#endif
+
+//GF(2^128)元素：hi为分组前8字节、lo为后8字节（均按大端解释）
+struct GF128 {
+    uint64_t hi;
+    uint64_t lo;
+};
+
+//GHASH密钥上下文：H、4-bit Shoup表以及H的幂
+class GHash {
+private:
+    GF128 H;
+    GF128 Htable[16];  //Htable[i] = i·H（4-bit Shoup表，软件路径使用）
+    GF128 Hpow[8];     //Hpow[i] = H^(i+1)，聚合约减使用
+    bool use_clmul;
+
+    static inline uint64_t load_be64(const uint8_t* p) {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++) {
+            v = (v << 8) | p[i];
+        }
+        return v;
+    }
+    static inline void store_be64(uint8_t* p, uint64_t v) {
+        for (int i = 7; i >= 0; i--) {
+            p[i] = (uint8_t)v;
+            v >>= 8;
+        }
+    }
+
+    //volatile写入清零，不会被优化掉
+    static void wipe(GF128* p, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            volatile uint64_t* hi = &p[i].hi;
+            volatile uint64_t* lo = &p[i].lo;
+            *hi = 0;
+            *lo = 0;
+        }
+    }
+
+    //V = V·x（右移一位并按R = 0xe1||0^120约减）
+    static inline void reduce1bit(GF128& v) {
+        uint64_t t = 0xe100000000000000ULL & (0 - (v.lo & 1));
+        v.lo = (v.hi << 63) | (v.lo >> 1);
+        v.hi = (v.hi >> 1) ^ t;
+    }
+
+    //4-bit查表乘法：X = X·H
+    void gmult_4bit(GF128& X) const {
+        static const uint64_t rem_4bit[16] = {
+            0x0000ULL << 48, 0x1C20ULL << 48, 0x3840ULL << 48, 0x2460ULL << 48,
+            0x7080ULL << 48, 0x6CA0ULL << 48, 0x48C0ULL << 48, 0x54E0ULL << 48,
+            0xE100ULL << 48, 0xFD20ULL << 48, 0xD940ULL << 48, 0xC560ULL << 48,
+            0x9180ULL << 48, 0x8DA0ULL << 48, 0xA9C0ULL << 48, 0xB5E0ULL << 48
+        };
+        //从最后一个字节开始，每次处理半个字节
+        uint8_t x[16];
+        store_be64(x, X.hi);
+        store_be64(x + 8, X.lo);
+        int cnt = 15;
+        size_t nlo = x[15];
+        size_t nhi = nlo >> 4;
+        nlo &= 0xf;
+        GF128 Z = Htable[nlo];
+        while (true) {
+            size_t rem = (size_t)Z.lo & 0xf;
+            Z.lo = (Z.hi << 60) | (Z.lo >> 4);
+            Z.hi = (Z.hi >> 4) ^ rem_4bit[rem];
+            Z.hi ^= Htable[nhi].hi;
+            Z.lo ^= Htable[nhi].lo;
+            if (--cnt < 0) {
+                break;
+            }
+            nlo = x[cnt];
+            nhi = nlo >> 4;
+            nlo &= 0xf;
+            rem = (size_t)Z.lo & 0xf;
+            Z.lo = (Z.hi << 60) | (Z.lo >> 4);
+            Z.hi = (Z.hi >> 4) ^ rem_4bit[rem];
+            Z.hi ^= Htable[nlo].hi;
+            Z.lo ^= Htable[nlo].lo;
+        }
+        X = Z;
+    }
+
+#ifdef GCM_CLMUL_ARCH
+    static bool cpu_has_clmul() {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 1)) != 0 && (info[2] & (1 << 9)) != 0;
+#else
+        return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+#endif
+    }
+
+    //128x128位无约减乘法，结果为256位(hi:lo)
+    GCM_TARGET_CLMUL static inline void clmul_wide(__m128i a, __m128i b, __m128i& lo, __m128i& hi) {
+        __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+        __m128i t1 = _mm_clmulepi64_si128(a, b, 0x10);
+        __m128i t2 = _mm_clmulepi64_si128(a, b, 0x01);
+        __m128i t3 = _mm_clmulepi64_si128(a, b, 0x11);
+        t1 = _mm_xor_si128(t1, t2);
+        lo = _mm_xor_si128(t0, _mm_slli_si128(t1, 8));
+        hi = _mm_xor_si128(t3, _mm_srli_si128(t1, 8));
+    }
+
+    //256位乘积左移一位（比特反射）后模x^128+x^7+x^2+x+1约减
+    GCM_TARGET_CLMUL static inline __m128i clmul_reduce(__m128i lo, __m128i hi) {
+        __m128i t7 = _mm_srli_epi32(lo, 31);
+        __m128i t8 = _mm_srli_epi32(hi, 31);
+        lo = _mm_slli_epi32(lo, 1);
+        hi = _mm_slli_epi32(hi, 1);
+        __m128i t9 = _mm_srli_si128(t7, 12);
+        t8 = _mm_slli_si128(t8, 4);
+        t7 = _mm_slli_si128(t7, 4);
+        lo = _mm_or_si128(lo, t7);
+        hi = _mm_or_si128(hi, t8);
+        hi = _mm_or_si128(hi, t9);
+
+        t7 = _mm_slli_epi32(lo, 31);
+        t8 = _mm_slli_epi32(lo, 30);
+        t9 = _mm_slli_epi32(lo, 25);
+        t7 = _mm_xor_si128(t7, t8);
+        t7 = _mm_xor_si128(t7, t9);
+        t8 = _mm_srli_si128(t7, 4);
+        t7 = _mm_slli_si128(t7, 12);
+        lo = _mm_xor_si128(lo, t7);
+
+        __m128i t2 = _mm_srli_epi32(lo, 1);
+        __m128i t4 = _mm_srli_epi32(lo, 2);
+        __m128i t5 = _mm_srli_epi32(lo, 7);
+        t2 = _mm_xor_si128(t2, t4);
+        t2 = _mm_xor_si128(t2, t5);
+        t2 = _mm_xor_si128(t2, t8);
+        lo = _mm_xor_si128(lo, t2);
+        return _mm_xor_si128(hi, lo);
+    }
+
+    GCM_TARGET_CLMUL static inline __m128i to_m128(const GF128& a) {
+        return _mm_set_epi64x((long long)a.hi, (long long)a.lo);
+    }
+    GCM_TARGET_CLMUL static inline GF128 from_m128(__m128i v) {
+        GF128 r;
+        r.lo = (uint64_t)_mm_cvtsi128_si64(v);
+        r.hi = (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v));
+        return r;
+    }
+    //分组按大端载入：字节序整体反转后与GF128表示一致
+    GCM_TARGET_CLMUL static inline __m128i load_block(const uint8_t* p) {
+        const __m128i bswap = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+        return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), bswap);
+    }
+
+    GCM_TARGET_CLMUL static GF128 mul_clmul(const GF128& a, const GF128& b) {
+        __m128i lo, hi;
+        clmul_wide(to_m128(a), to_m128(b), lo, hi);
+        return from_m128(clmul_reduce(lo, hi));
+    }
+
+    //X' = (X ^ B_0)·H^n ^ B_1·H^(n-1) ^ ... ^ B_(n-1)·H，1 <= n <= 8，只做一次约减
+    GCM_TARGET_CLMUL static inline __m128i fold_clmul(__m128i x, const uint8_t* const* blocks, size_t n,
+        const __m128i* hp) {
+        __m128i lo, hi, l, h;
+        clmul_wide(_mm_xor_si128(x, load_block(blocks[0])), hp[n - 1], lo, hi);
+        for (size_t k = 1; k < n; k++) {
+            clmul_wide(load_block(blocks[k]), hp[n - 1 - k], l, h);
+            lo = _mm_xor_si128(lo, l);
+            hi = _mm_xor_si128(hi, h);
+        }
+        return clmul_reduce(lo, hi);
+    }
+
+    //CLMUL路径：每8个分组只做一次约减（聚合约减），H^1~H^8取自预计算的幂表
+    GCM_TARGET_CLMUL void update_blocks_clmul(GF128& X, const uint8_t* data, size_t nblocks) const {
+        __m128i x = to_m128(X);
+        __m128i hp[8];
+        for (int k = 0; k < 8; k++) {
+            hp[k] = to_m128(Hpow[k]);
+        }
+        size_t i = 0;
+        for (; i + 8 <= nblocks; i += 8) {
+            //X' = (X ^ B0)·H^8 ^ B1·H^7 ^ ... ^ B7·H
+            __m128i lo, hi, l, h;
+            clmul_wide(_mm_xor_si128(x, load_block(data + 16 * i)), hp[7], lo, hi);
+            for (int k = 1; k < 8; k++) {
+                clmul_wide(load_block(data + 16 * (i + k)), hp[7 - k], l, h);
+                lo = _mm_xor_si128(lo, l);
+                hi = _mm_xor_si128(hi, h);
+            }
+            x = clmul_reduce(lo, hi);
+        }
+        //不足8个的尾部同样只约减一次
+        if (i < nblocks) {
+            const uint8_t* tail[8];
+            for (size_t k = 0; i + k < nblocks; k++) {
+                tail[k] = data + 16 * (i + k);
+            }
+            x = fold_clmul(x, tail, nblocks - i, hp);
+        }
+        X = from_m128(x);
+    }
+
+    GCM_TARGET_CLMUL void update_gathered_clmul(GF128& X, const uint8_t* const* blocks, size_t n) const {
+        __m128i x = to_m128(X);
+        __m128i hp[8];
+        for (int k = 0; k < 8; k++) {
+            hp[k] = to_m128(Hpow[k]);
+        }
+        for (size_t i = 0; i < n; i += AGGREGATE) {
+            x = fold_clmul(x, blocks + i, n - i < AGGREGATE ? n - i : AGGREGATE, hp);
+        }
+        X = from_m128(x);
+    }
+#endif
+
+public:
+    //CLMUL路径每次约减聚合的分组数（幂表的长度）
+    static const size_t AGGREGATE = 8;
+
+    GHash() : use_clmul(false) {
+        memset(&H, 0, sizeof(H));
+        memset(Htable, 0, sizeof(Htable));
+        memset(Hpow, 0, sizeof(Hpow));
+    }
+
+    //析构时擦除H及其派生表，它们与密钥同样敏感
+    ~GHash() {
+        wipe(&H, 1);
+        wipe(Htable, 16);
+        wipe(Hpow, 8);
+    }
+
+    //通用乘法（逐位实现，常数时间），用于预计算和少量合并运算
+    static GF128 mul_generic(const GF128& x, const GF128& y) {
+        GF128 z = { 0, 0 };
+        GF128 v = y;
+        for (int i = 0; i < 128; i++) {
+            uint64_t bit = (i < 64) ? (x.hi >> (63 - i)) & 1 : (x.lo >> (127 - i)) & 1;
+            uint64_t mask = 0 - bit;
+            z.hi ^= v.hi & mask;
+            z.lo ^= v.lo & mask;
+            reduce1bit(v);
+        }
+        return z;
+    }
+
+    //任意两元素相乘，可用时走CLMUL
+    GF128 mul(const GF128& x, const GF128& y) const {
+#ifdef GCM_CLMUL_ARCH
+        if (use_clmul) {
+            return mul_clmul(x, y);
+        }
+#endif
+        return mul_generic(x, y);
+    }
+
+    //由H = E(K, 0^128)建立查表与幂表
+    void init(const uint8_t h[16]) {
+        H.hi = load_be64(h);
+        H.lo = load_be64(h + 8);
+#ifdef GCM_CLMUL_ARCH
+        use_clmul = cpu_has_clmul();
+#endif
+        //Htable[8] = H，Htable[4] = H·x，Htable[2] = H·x^2，Htable[1] = H·x^3，其余为线性组合
+        GF128 v = H;
+        Htable[0].hi = 0;
+        Htable[0].lo = 0;
+        Htable[8] = v;
+        reduce1bit(v);
+        Htable[4] = v;
+        reduce1bit(v);
+        Htable[2] = v;
+        reduce1bit(v);
+        Htable[1] = v;
+        for (int i = 2; i < 16; i <<= 1) {
+            for (int j = 1; j < i; j++) {
+                Htable[i + j].hi = Htable[i].hi ^ Htable[j].hi;
+                Htable[i + j].lo = Htable[i].lo ^ Htable[j].lo;
+            }
+        }
+        Hpow[0] = H;
+        for (int i = 1; i < 8; i++) {
+            Hpow[i] = mul(Hpow[i - 1], H);
+        }
+    }
+
+    const GF128& h() const {
+        return H;
+    }
+
+    //预计算平方表：sq[k] = H^(2^k)，k < count
+    void squares(GF128* sq, int count) const {
+        sq[0] = H;
+        for (int k = 1; k < count; k++) {
+            sq[k] = mul(sq[k - 1], sq[k - 1]);
+        }
+    }
+
+    //由平方表求H^n（n < 2^count）
+    GF128 pow(const GF128* sq, uint64_t n) const {
+        GF128 r = { 0, 0 };
+        bool first = true;
+        for (int k = 0; n != 0; k++, n >>= 1) {
+            if ((n & 1) == 0) {
+                continue;
+            }
+            r = first ? sq[k] : mul(r, sq[k]);
+            first = false;
+        }
+        //H^0 = 1，在比特反射表示下为最高位
+        if (first) {
+            r.hi = 0x8000000000000000ULL;
+        }
+        return r;
+    }
+
+    //X = X·H
+    void mul_h(GF128& X) const {
+#ifdef GCM_CLMUL_ARCH
+        if (use_clmul) {
+            X = mul_clmul(X, H);
+            return;
+        }
+#endif
+        gmult_4bit(X);
+    }
+
+    //吸收nblocks个完整分组：X = (X ^ B_i)·H
+    void update_blocks(GF128& X, const uint8_t* data, size_t nblocks) const {
+        CRYPTO_PERF_SCOPE("ghash");
+#ifdef GCM_CLMUL_ARCH
+        if (use_clmul) {
+            update_blocks_clmul(X, data, nblocks);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < nblocks; i++) {
+            X.hi ^= load_be64(data + 16 * i);
+            X.lo ^= load_be64(data + 16 * i + 8);
+            gmult_4bit(X);
+        }
+    }
+
+    //吸收n个分组，第i个分组的地址为blocks[i]，各分组可以来自不同的缓冲区；
+    //CLMUL路径每AGGREGATE个分组一次约减，供多个短缓冲区（AAD、补零的尾部、长度分组）拼成的序列使用
+    void update_gathered(GF128& X, const uint8_t* const* blocks, size_t n) const {
+        CRYPTO_PERF_SCOPE("ghash");
+#ifdef GCM_CLMUL_ARCH
+        if (use_clmul) {
+            update_gathered_clmul(X, blocks, n);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < n; i++) {
+            X.hi ^= load_be64(blocks[i]);
+            X.lo ^= load_be64(blocks[i] + 8);
+            gmult_4bit(X);
+        }
+    }
+
+    //吸收任意长度数据，末尾不足16字节补零（与GCM中AAD/密文的填充规则一致）
+    void update(GF128& X, const uint8_t* data, size_t len) const {
+        size_t full = len / 16;
+        update_blocks(X, data, full);
+        size_t rem = len % 16;
+        if (rem != 0) {
+            uint8_t block[16] = { 0 };
+            memcpy(block, data + 16 * full, rem);
+            update_blocks(X, block, 1);
+        }
+    }
+
+    //吸收长度分组：64位AAD比特长度||64位密文比特长度
+    void update_lengths(GF128& X, uint64_t aad_len, uint64_t ct_len) const {
+        X.hi ^= aad_len * 8;
+        X.lo ^= ct_len * 8;
+        mul_h(X);
+    }
+
+    static void to_bytes(const GF128& X, uint8_t out[16]) {
+        store_be64(out, X.hi);
+        store_be64(out + 8, X.lo);
+    }
+    static GF128 from_bytes(const uint8_t in[16]) {
+        GF128 r;
+        r.hi = load_be64(in);
+        r.lo = load_be64(in + 8);
+        return r;
+    }
+};
+
+//解密模式
+enum class DecryptMode {
+    Standard,     //CTR解密与GHASH一遍完成后比较标签，验证失败时清零输出
+    VerifyFirst,  //先对密文做GHASH并比较标签，通过后才生成密钥流，伪造报文只消耗GHASH的开销
+    Stitched      //GHASH与CTR在同一遍中交替进行，明文先写入临时缓冲区，验证通过后才提交到输出
+};
+
+//批量接口的报文描述符
+struct GcmPacket {
+    const uint8_t* nonce;  //12字节Nonce
+    const uint8_t* aad;    //附加认证数据
+    size_t aad_len;
+    const uint8_t* in;     //加密时为明文，解密时为密文
+    size_t len;
+    uint8_t* out;          //加密时为密文，解密时为明文
+    uint8_t* tag;          //加密时输出标签，解密时为待验证标签
+    bool valid;            //decrypt_batch的验证结果
+};
+
+//SM4-GCM认证加密（SP 800-38D，96位IV：J0 = IV||0^31||1）
+class GCM {
+private:
+    SM4 sm4;
+    GHash gh;
+
+    //CTR一次送入多分组内核的分组数
+    static const size_t CTR_LANES = 8;
+    //批量接口中每组交错处理的报文数
+    static const size_t BATCH_GROUP = 16;
+
+    //计数器生成
+    static void generate_ctr(const uint8_t nonce[12], uint32_t counter, uint8_t ctr[16]) {
+        memcpy(ctr, nonce, 12);
+        ctr[12] = (counter >> 24) & 0xff;
+        ctr[13] = (counter >> 16) & 0xff;
+        ctr[14] = (counter >> 8) & 0xff;
+        ctr[15] = counter & 0xff;
+    }
+
+    //CTR模式：第一个数据分组使用计数器counter（整条消息从2开始）；
+    //ej0非空时J0 = 计数器1与第一批数据分组一起送入内核
+    void ctr_xor(const uint8_t nonce[12], uint32_t counter, const uint8_t* in, uint8_t* out, size_t len,
+        uint8_t* ej0) const {
+        uint8_t ctr[CTR_LANES * 16];
+        uint8_t ks[CTR_LANES * 16];
+        size_t nblocks = (len + 15) / 16;
+        size_t done = 0;
+        bool first = ej0 != nullptr;
+        while (first || done < nblocks) {
+            size_t lane = 0;
+            if (first) {
+                generate_ctr(nonce, 1, ctr);
+                lane = 1;
+            }
+            size_t take = nblocks - done;
+            if (take > CTR_LANES - lane) {
+                take = CTR_LANES - lane;
+            }
+            for (size_t i = 0; i < take; i++) {
+                generate_ctr(nonce, counter++, ctr + 16 * (lane + i));
+            }
+            sm4.encrypt_blocks(ctr, ks, lane + take);
+            if (first) {
+                memcpy(ej0, ks, 16);
+                first = false;
+            }
+            size_t off = done * 16;
+            size_t bytes = (take * 16 < len - off) ? take * 16 : len - off;
+            const uint8_t* k = ks + 16 * lane;
+            for (size_t j = 0; j < bytes; j++) {
+                out[off + j] = in[off + j] ^ k[j];
+            }
+            done += take;
+        }
+    }
+
+    //标签 = GHASH(AAD||pad||C||pad||len) ^ E(K, J0)
+    void compute_tag(const uint8_t* aad, size_t aad_len, const uint8_t* ct, size_t ct_len,
+        const uint8_t ej0[16], uint8_t tag[16]) const {
+        GF128 X = { 0, 0 };
+        gh.update(X, aad, aad_len);
+        gh.update(X, ct, ct_len);
+        gh.update_lengths(X, aad_len, ct_len);
+        GHash::to_bytes(X, tag);
+        for (int i = 0; i < 16; i++) {
+            tag[i] ^= ej0[i];
+        }
+    }
+
+    //Stitched模式中GHASH与CTR交替处理的小段长度
+    static const size_t STITCH_SLICE = 4 * 1024;
+    //Stitched模式每个线程保留的临时缓冲区上限
+    static const size_t STITCH_SCRATCH_KEEP = 1 << 20;
+
+    //清零敏感数据，volatile写防止被编译器优化掉
+    static void secure_zero(void* p, size_t n) {
+        volatile uint8_t* v = (volatile uint8_t*)p;
+        while (n--) {
+            *v++ = 0;
+        }
+    }
+
+    //常数时间比较标签
+    static bool tag_equal(const uint8_t a[16], const uint8_t b[16]) {
+        uint8_t diff = 0;
+        for (int i = 0; i < 16; i++) {
+            diff |= a[i] ^ b[i];
+        }
+        return diff == 0;
+    }
+
+    //批量接口的遥测：一批报文的总字节数与分组数
+    static size_t batch_bytes(const GcmPacket* p, size_t count) {
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            n += p[i].len;
+        }
+        return n;
+    }
+
+    static size_t batch_blocks(const GcmPacket* p, size_t count) {
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            n += (p[i].len + 15) / 16;
+        }
+        return n;
+    }
+
+    //一个报文的GHASH：AAD||pad||C||pad||len。完整分组直接引用原缓冲区，补零的尾部与长度分组写入临时分组，
+    //分组地址凑满GHash::AGGREGATE个才约减一次，AAD、密文尾部与长度分组不再各自单独约减；
+    //密文中成整组的部分直接走update_blocks
+    GF128 ghash_packet(const uint8_t* aad, size_t aad_len, const uint8_t* ct, size_t ct_len) const {
+        const size_t G = GHash::AGGREGATE;
+        uint8_t pad[3][16];   //AAD尾部、密文尾部、长度分组
+        const uint8_t* blocks[G];
+        size_t used = 0;
+        GF128 X = { 0, 0 };
+        auto push = [&](const uint8_t* blk) {
+            blocks[used++] = blk;
+            if (used == G) {
+                gh.update_gathered(X, blocks, G);
+                used = 0;
+            }
+        };
+        auto absorb = [&](const uint8_t* data, size_t len, uint8_t* tail) {
+            size_t full = len / 16;
+            size_t i = 0;
+            while (i < full) {
+                if (used == 0 && full - i >= G) {
+                    size_t run = (full - i) / G * G;
+                    gh.update_blocks(X, data + 16 * i, run);
+                    i += run;
+                    continue;
+                }
+                push(data + 16 * i);
+                i++;
+            }
+            if (len % 16 != 0) {
+                memset(tail, 0, 16);
+                memcpy(tail, data + 16 * full, len % 16);
+                push(tail);
+            }
+        };
+        absorb(aad, aad_len, pad[0]);
+        absorb(ct, ct_len, pad[1]);
+        uint64_t abits = (uint64_t)aad_len * 8, cbits = (uint64_t)ct_len * 8;
+        for (int k = 0; k < 8; k++) {
+            pad[2][k] = (uint8_t)(abits >> (56 - 8 * k));
+            pad[2][8 + k] = (uint8_t)(cbits >> (56 - 8 * k));
+        }
+        push(pad[2]);
+        if (used > 0) {
+            gh.update_gathered(X, blocks, used);
+        }
+        return X;
+    }
+
+    //out = in ^ ks，n <= 16；整分组按两个64位字异或，避免逐字节的短循环
+    static inline void xor_block(const uint8_t* in, const uint8_t* ks, uint8_t* out, size_t n) {
+        if (n == 16) {
+            uint64_t a[2], k[2];
+            memcpy(a, in, 16);
+            memcpy(k, ks, 16);
+            a[0] ^= k[0];
+            a[1] ^= k[1];
+            memcpy(out, a, 16);
+            return;
+        }
+        for (size_t j = 0; j < n; j++) {
+            out[j] = in[j] ^ ks[j];
+        }
+    }
+
+    //批量接口的一批计数器块：拼满CTR_LANES个时直接走CTR_LANES路交错内核（比SM4::LANES路的
+    //encrypt_blocks多一倍独立分组，查表延迟隐藏得更好），报文较短时单条消息的路径凑不满这么多分组
+    void encrypt_ctr_slots(const uint8_t* ctr, uint8_t* ks, size_t used) const {
+        if (used == CTR_LANES) {
+            sm4.encrypt_lanes<CTR_LANES>(ctr, ks);
+        }
+        else {
+            sm4.encrypt_blocks(ctr, ks, used);
+        }
+    }
+
+    //多报文交错CTR：把各报文的J0与数据计数器块拼入同一批，填满多分组内核
+    void ctr_interleaved(GcmPacket* p, size_t n, uint8_t (*ej0)[16]) const {
+        uint8_t ctr[CTR_LANES * 16];
+        uint8_t ks[CTR_LANES * 16];
+        size_t slot_pkt[CTR_LANES];
+        size_t slot_blk[CTR_LANES];
+        size_t used = 0;
+        auto flush = [&]() {
+            encrypt_ctr_slots(ctr, ks, used);
+            for (size_t s = 0; s < used; s++) {
+                GcmPacket& pk = p[slot_pkt[s]];
+                const uint8_t* k = ks + 16 * s;
+                if (slot_blk[s] == 0) {
+                    memcpy(ej0[slot_pkt[s]], k, 16);
+                    continue;
+                }
+                size_t off = (slot_blk[s] - 1) * 16;
+                size_t bytes = (pk.len - off < 16) ? pk.len - off : 16;
+                xor_block(pk.in + off, k, pk.out + off, bytes);
+            }
+            used = 0;
+        };
+        for (size_t i = 0; i < n; i++) {
+            //块0对应J0（计数器1），块b对应计数器b+1
+            size_t blocks = (p[i].len + 15) / 16 + 1;
+            for (size_t b = 0; b < blocks; b++) {
+                generate_ctr(p[i].nonce, (uint32_t)(b + 1), ctr + 16 * used);
+                slot_pkt[used] = i;
+                slot_blk[used] = b;
+                if (++used == CTR_LANES) {
+                    flush();
+                }
+            }
+        }
+        if (used > 0) {
+            flush();
+        }
+    }
+
+    //只生成数据分组的密钥流（J0已单独求出），跳过验证失败的报文
+    void ctr_interleaved_data(GcmPacket* p, size_t n) const {
+        uint8_t ctr[CTR_LANES * 16];
+        uint8_t ks[CTR_LANES * 16];
+        size_t slot_pkt[CTR_LANES];
+        size_t slot_off[CTR_LANES];
+        size_t used = 0;
+        auto flush = [&]() {
+            encrypt_ctr_slots(ctr, ks, used);
+            for (size_t s = 0; s < used; s++) {
+                GcmPacket& pk = p[slot_pkt[s]];
+                size_t off = slot_off[s];
+                size_t bytes = (pk.len - off < 16) ? pk.len - off : 16;
+                xor_block(pk.in + off, ks + 16 * s, pk.out + off, bytes);
+            }
+            used = 0;
+        };
+        for (size_t i = 0; i < n; i++) {
+            if (!p[i].valid) {
+                continue;
+            }
+            for (size_t off = 0; off < p[i].len; off += 16) {
+                generate_ctr(p[i].nonce, (uint32_t)(off / 16 + 2), ctr + 16 * used);
+                slot_pkt[used] = i;
+                slot_off[used] = off;
+                if (++used == CTR_LANES) {
+                    flush();
+                }
+            }
+        }
+        if (used > 0) {
+            flush();
+        }
+    }
+
+    //并行GCM：按块切分后每个分块的部分GHASH，blocks为该分块的分组数
+    struct Partial {
+        GF128 Y;
+        uint64_t blocks;
+    };
+
+    struct ParallelJob {
+        const uint8_t* nonce;
+        const uint8_t* in;
+        uint8_t* out;
+        size_t len;
+        size_t chunk_bytes;
+        bool encrypting;      //加密时对输出做GHASH，解密时对输入做GHASH
+        const GF128* sq;      //H^(2^k)平方表
+    };
+
+    //并行路径中每个分块再细分成小段，CTR写出的密文在缓存中仍热时立即做GHASH
+    static const size_t PARALLEL_SLICE = 16 * 1024;
+
+    Partial process_chunk(const ParallelJob& job, size_t index) const {
+        size_t off = index * job.chunk_bytes;
+        size_t bytes = (job.len - off < job.chunk_bytes) ? job.len - off : job.chunk_bytes;
+        Partial p = { { 0, 0 }, (bytes + 15) / 16 };
+        for (size_t s = 0; s < bytes; s += PARALLEL_SLICE) {
+            size_t n = (bytes - s < PARALLEL_SLICE) ? bytes - s : PARALLEL_SLICE;
+            size_t pos = off + s;
+            ctr_xor(job.nonce, (uint32_t)(2 + pos / 16), job.in + pos, job.out + pos, n, nullptr);
+            gh.update(p.Y, job.encrypting ? job.out + pos : job.in + pos, n);
+        }
+        return p;
+    }
+
+    //分治：左右两半作为两个任务交给线程池（嵌套调用是安全的），都完成后在递归树的节点上两两合并
+    //Y = Y_左·H^(右半分组数) ^ Y_右，合并深度为log2(分块数)，各层的合并也在不同线程上并行
+    Partial process_range(ThreadPool& pool, const ParallelJob& job, size_t lo, size_t hi) const {
+        if (hi - lo == 1) {
+            return process_chunk(job, lo);
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        Partial half[2];
+        pool.parallel_for(0, 2, 1, [&](size_t a, size_t b) {
+            for (size_t k = a; k < b; k++) {
+                half[k] = k == 0 ? process_range(pool, job, lo, mid) : process_range(pool, job, mid, hi);
+            }
+        });
+        Partial r;
+        r.Y = gh.mul(half[0].Y, gh.pow(job.sq, half[1].blocks));
+        r.Y.hi ^= half[1].Y.hi;
+        r.Y.lo ^= half[1].Y.lo;
+        r.blocks = half[0].blocks + half[1].blocks;
+        return r;
+    }
+
+    //并行CTR+GHASH，返回标签
+    //按ThreadPool::CHUNK_BYTES切分为任务交给线程池，max_tasks非0时任务数不超过它；
+    //各分块的部分GHASH沿分治树两两合并（见process_range），最后 X = GHASH(AAD)·H^(密文分组数) ^ Y_密文
+    void parallel_crypt(ThreadPool& pool, unsigned max_tasks, const uint8_t nonce[12], const uint8_t* in, uint8_t* out,
+        size_t len, const uint8_t* aad, size_t aad_len, bool encrypting, uint8_t tag[16]) const {
+        size_t nchunks = (len + ThreadPool::CHUNK_BYTES - 1) / ThreadPool::CHUNK_BYTES;
+        if (max_tasks != 0 && nchunks > max_tasks) {
+            nchunks = max_tasks;
+        }
+        uint8_t ej0[16];
+        if (nchunks <= 1) {
+            ctr_xor(nonce, 2, in, out, len, ej0);
+            compute_tag(aad, aad_len, encrypting ? out : in, len, ej0, tag);
+            return;
+        }
+        //分块大小按16字节对齐，保证每个分块从完整分组开始
+        size_t chunk_bytes = ((len + nchunks - 1) / nchunks + 15) & ~(size_t)15;
+        nchunks = (len + chunk_bytes - 1) / chunk_bytes;
+
+        GF128 sq[64];
+        gh.squares(sq, 64);
+        ParallelJob job = { nonce, in, out, len, chunk_bytes, encrypting, sq };
+        Partial body = process_range(pool, job, 0, nchunks);
+
+        GF128 X = { 0, 0 };
+        gh.update(X, aad, aad_len);
+        X = gh.mul(X, gh.pow(sq, body.blocks));
+        X.hi ^= body.Y.hi;
+        X.lo ^= body.Y.lo;
+        gh.update_lengths(X, aad_len, len);
+
+        uint8_t j0[16];
+        generate_ctr(nonce, 1, j0);
+        sm4.encrypt_block(j0, ej0);
+        GHash::to_bytes(X, tag);
+        for (int i = 0; i < 16; i++) {
+            tag[i] ^= ej0[i];
+        }
+    }
+
+    //按模式解密并验证标签，见decrypt()
+    bool decrypt_mode(const uint8_t nonce[12], const uint8_t* ciphertext, size_t ciphertext_len,
+        const uint8_t* aad, size_t aad_len, const uint8_t tag[16], uint8_t* plaintext, DecryptMode mode) const {
+        uint8_t ej0[16];
+        uint8_t computed_tag[16];
+        switch (mode) {
+        case DecryptMode::VerifyFirst: {
+            //只加密J0一个分组，其余开销全部在GHASH
+            uint8_t j0[16];
+            generate_ctr(nonce, 1, j0);
+            sm4.encrypt_block(j0, ej0);
+            compute_tag(aad, aad_len, ciphertext, ciphertext_len, ej0, computed_tag);
+            if (!tag_equal(computed_tag, tag)) {
+                return false;
+            }
+            ctr_xor(nonce, 2, ciphertext, plaintext, ciphertext_len, nullptr);
+            return true;
+        }
+        case DecryptMode::Stitched: {
+            //临时缓冲区按线程复用，避免每次调用分配内存；长于STITCH_SCRATCH_KEEP的消息单独分配、用完释放，
+            //每个线程保留的缓冲区不超过这个大小
+            thread_local std::vector<uint8_t> cached;
+            std::vector<uint8_t> large;
+            uint8_t* scratch;
+            if (ciphertext_len > STITCH_SCRATCH_KEEP) {
+                large.resize(ciphertext_len);
+                scratch = large.data();
+            }
+            else {
+                if (cached.size() < ciphertext_len) {
+                    cached.resize(ciphertext_len);
+                }
+                scratch = cached.data();
+            }
+            GF128 X = { 0, 0 };
+            gh.update(X, aad, aad_len);
+            size_t off = 0;
+            do {
+                size_t n = (ciphertext_len - off < STITCH_SLICE) ? ciphertext_len - off : STITCH_SLICE;
+                ctr_xor(nonce, (uint32_t)(2 + off / 16), ciphertext + off, scratch + off, n,
+                    off == 0 ? ej0 : nullptr);
+                gh.update(X, ciphertext + off, n);
+                off += n;
+            } while (off < ciphertext_len);
+            gh.update_lengths(X, aad_len, ciphertext_len);
+            GHash::to_bytes(X, computed_tag);
+            for (int i = 0; i < 16; i++) {
+                computed_tag[i] ^= ej0[i];
+            }
+            bool ok = tag_equal(computed_tag, tag);
+            if (ok && ciphertext_len > 0) {
+                memcpy(plaintext, scratch, ciphertext_len);
+            }
+            secure_zero(scratch, ciphertext_len);
+            return ok;
+        }
+        default:
+            ctr_xor(nonce, 2, ciphertext, plaintext, ciphertext_len, ej0);
+            compute_tag(aad, aad_len, ciphertext, ciphertext_len, ej0, computed_tag);
+            if (!tag_equal(computed_tag, tag)) {
+                secure_zero(plaintext, ciphertext_len);
+                return false;
+            }
+            return true;
+        }
+    }
+
+public:
+    //初始化密钥
+    void set_key(const uint8_t key[16]) {
+        CRYPTO_TELEMETRY_SCOPE(tm, "gcm.set_key", 16, 1);
+        CRYPTO_USDT1(gcm_set_key_entry, this);
+        sm4.set_key(key);
+        uint8_t zero[16] = { 0 };
+        uint8_t H[16];
+        sm4.encrypt_block(zero, H); //H = SM4(K, 0^128)
+        gh.init(H);
+        CRYPTO_USDT1(gcm_set_key_return, this);
+    }
+
+    //加密并生成标签
+    void encrypt(const uint8_t nonce[12], const uint8_t* plaintext, size_t plaintext_len,
+        const uint8_t* aad, size_t aad_len, uint8_t* ciphertext, uint8_t tag[16]) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "gcm.encrypt", plaintext_len, (plaintext_len + 15) / 16);
+        CRYPTO_USDT3(gcm_encrypt_entry, this, plaintext_len, aad_len);
+        uint8_t ej0[16];
+        ctr_xor(nonce, 2, plaintext, ciphertext, plaintext_len, ej0);
+        compute_tag(aad, aad_len, ciphertext, plaintext_len, ej0, tag);
+        CRYPTO_USDT2(gcm_encrypt_return, this, plaintext_len);
+    }
+
+    //解密并验证标签（Standard模式）
+    bool decrypt(const uint8_t nonce[12], const uint8_t* ciphertext, size_t ciphertext_len,
+        const uint8_t* aad, size_t aad_len, const uint8_t tag[16], uint8_t* plaintext) const {
+        return decrypt(nonce, ciphertext, ciphertext_len, aad, aad_len, tag, plaintext, DecryptMode::Standard);
+    }
+
+    //按指定模式解密并验证标签，验证失败时plaintext中不会留下未经认证的明文
+    bool decrypt(const uint8_t nonce[12], const uint8_t* ciphertext, size_t ciphertext_len,
+        const uint8_t* aad, size_t aad_len, const uint8_t tag[16], uint8_t* plaintext, DecryptMode mode) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "gcm.decrypt", ciphertext_len, (ciphertext_len + 15) / 16);
+        CRYPTO_USDT4(gcm_decrypt_entry, this, ciphertext_len, aad_len, (int)mode);
+        bool ok = decrypt_mode(nonce, ciphertext, ciphertext_len, aad, aad_len, tag, plaintext, mode);
+        CRYPTO_USDT3(gcm_decrypt_return, this, ciphertext_len, ok);
+        if (!ok) {
+            CRYPTO_TELEMETRY_FAIL(tm, 1);
+        }
+        return ok;
+    }
+
+    //批量加密：多个小报文共用一次调用，CTR跨报文交错填满多分组内核，GHASH每报文聚合约减
+    void encrypt_batch(GcmPacket* packets, size_t count) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "gcm.encrypt_batch", batch_bytes(packets, count), batch_blocks(packets, count));
+        CRYPTO_USDT2(gcm_encrypt_batch_entry, this, count);
+        uint8_t ej0[BATCH_GROUP][16];
+        for (size_t base = 0; base < count; base += BATCH_GROUP) {
+            size_t n = (count - base < BATCH_GROUP) ? count - base : BATCH_GROUP;
+            GcmPacket* p = packets + base;
+            ctr_interleaved(p, n, ej0);
+            for (size_t i = 0; i < n; i++) {
+                GHash::to_bytes(ghash_packet(p[i].aad, p[i].aad_len, p[i].out, p[i].len), p[i].tag);
+                for (int k = 0; k < 16; k++) {
+                    p[i].tag[k] ^= ej0[i][k];
+                }
+                p[i].valid = true;
+            }
+        }
+        CRYPTO_USDT2(gcm_encrypt_batch_return, this, count);
+    }
+
+    //批量解密：先对密文做交错GHASH，再只为标签正确的报文生成密钥流
+    //返回验证通过的报文数，未通过的报文valid为false且其输出缓冲区不被写入
+    size_t decrypt_batch(GcmPacket* packets, size_t count) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "gcm.decrypt_batch", batch_bytes(packets, count), batch_blocks(packets, count));
+        CRYPTO_USDT2(gcm_decrypt_batch_entry, this, count);
+        GF128 X[BATCH_GROUP];
+        size_t ok = 0;
+        for (size_t base = 0; base < count; base += BATCH_GROUP) {
+            size_t n = (count - base < BATCH_GROUP) ? count - base : BATCH_GROUP;
+            GcmPacket* p = packets + base;
+            for (size_t i = 0; i < n; i++) {
+                X[i] = ghash_packet(p[i].aad, p[i].aad_len, p[i].in, p[i].len);
+            }
+            //E(K, J0)与密钥流在同一批内核调用中生成，这里先单独求出用于验证
+            uint8_t j0[BATCH_GROUP * 16];
+            uint8_t ej[BATCH_GROUP * 16];
+            for (size_t i = 0; i < n; i++) {
+                generate_ctr(p[i].nonce, 1, j0 + 16 * i);
+            }
+            sm4.encrypt_blocks(j0, ej, n);
+            for (size_t i = 0; i < n; i++) {
+                uint8_t computed[16];
+                GHash::to_bytes(X[i], computed);
+                for (int k = 0; k < 16; k++) {
+                    computed[k] ^= ej[16 * i + k];
+                }
+                p[i].valid = tag_equal(computed, p[i].tag);
+                if (p[i].valid) {
+                    ok++;
+                }
+            }
+            ctr_interleaved_data(p, n);
+        }
+        CRYPTO_USDT3(gcm_decrypt_batch_return, this, count, ok);
+        CRYPTO_TELEMETRY_FAIL(tm, count - ok);
+        return ok;
+    }
+
+    //多线程加密：各任务负责一段连续分组的密钥流与部分GHASH，结果与encrypt()逐字节一致
+    //在进程共享的线程池上执行，threads非0时最多切分为threads个任务；消息较短时退化为单线程路径
+    void encrypt_parallel(const uint8_t nonce[12], const uint8_t* plaintext, size_t plaintext_len,
+        const uint8_t* aad, size_t aad_len, uint8_t* ciphertext, uint8_t tag[16], unsigned threads = 0) const {
+        encrypt_parallel(nonce, plaintext, plaintext_len, aad, aad_len, ciphertext, tag, ThreadPool::global(), threads);
+    }
+
+    //在指定线程池上多线程加密
+    void encrypt_parallel(const uint8_t nonce[12], const uint8_t* plaintext, size_t plaintext_len,
+        const uint8_t* aad, size_t aad_len, uint8_t* ciphertext, uint8_t tag[16], ThreadPool& pool,
+        unsigned max_tasks = 0) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "gcm.encrypt_parallel", plaintext_len, (plaintext_len + 15) / 16);
+        CRYPTO_USDT3(gcm_encrypt_entry, this, plaintext_len, aad_len);
+        parallel_crypt(pool, max_tasks, nonce, plaintext, ciphertext, plaintext_len, aad, aad_len, true, tag);
+        CRYPTO_USDT2(gcm_encrypt_return, this, plaintext_len);
+    }
+
+    //多线程解密并验证标签
+    bool decrypt_parallel(const uint8_t nonce[12], const uint8_t* ciphertext, size_t ciphertext_len,
+        const uint8_t* aad, size_t aad_len, const uint8_t tag[16], uint8_t* plaintext, unsigned threads = 0) const {
+        return decrypt_parallel(nonce, ciphertext, ciphertext_len, aad, aad_len, tag, plaintext, ThreadPool::global(),
+            threads);
+    }
+
+    //在指定线程池上多线程解密并验证标签
+    bool decrypt_parallel(const uint8_t nonce[12], const uint8_t* ciphertext, size_t ciphertext_len,
+        const uint8_t* aad, size_t aad_len, const uint8_t tag[16], uint8_t* plaintext, ThreadPool& pool,
+        unsigned max_tasks = 0) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "gcm.decrypt_parallel", ciphertext_len, (ciphertext_len + 15) / 16);
+        CRYPTO_USDT4(gcm_decrypt_entry, this, ciphertext_len, aad_len, (int)DecryptMode::Standard);
+        uint8_t computed_tag[16];
+        parallel_crypt(pool, max_tasks, nonce, ciphertext, plaintext, ciphertext_len, aad, aad_len, false,
+            computed_tag);
+        bool ok = tag_equal(computed_tag, tag);
+        if (!ok) {
+            CRYPTO_TELEMETRY_FAIL(tm, 1);
+            secure_zero(plaintext, ciphertext_len);
+        }
+        CRYPTO_USDT3(gcm_decrypt_return, this, ciphertext_len, ok);
+        return ok;
+    }
+};
+
+//SM4-GMAC：只认证不加密，tag = GHASH(A||pad||len(A)||0) ^ E(K, J0)
+//与GCM在明文为空时的标签相同，但不经过CTR，数据直接流式送入GHASH内核
+class GMAC {
+private:
+    SM4 sm4;
+    GHash gh;          //H及其幂表缓存在密钥上下文中
+    //流式状态
+    GF128 X;
+    uint8_t buffer[16];   //不足一个分组的尾部数据
+    size_t buffered;
+    uint64_t total_len;
+    uint8_t ej0[16];
+
+    //清零敏感数据，volatile写防止被编译器优化掉
+    static void secure_zero(void* p, size_t n) {
+        volatile uint8_t* v = (volatile uint8_t*)p;
+        while (n--) {
+            *v++ = 0;
+        }
+    }
+
+    static bool tag_equal(const uint8_t a[16], const uint8_t b[16]) {
+        uint8_t diff = 0;
+        for (int i = 0; i < 16; i++) {
+            diff |= a[i] ^ b[i];
+        }
+        return diff == 0;
+    }
+
+    void encrypt_j0(const uint8_t nonce[12], uint8_t out[16]) const {
+        uint8_t j0[16];
+        memcpy(j0, nonce, 12);
+        j0[12] = 0;
+        j0[13] = 0;
+        j0[14] = 0;
+        j0[15] = 1;
+        sm4.encrypt_block(j0, out);
+    }
+
+public:
+    GMAC() : X{ 0, 0 }, buffered(0), total_len(0) {
+        memset(buffer, 0, sizeof(buffer));
+        memset(ej0, 0, sizeof(ej0));
+    }
+
+    //标签掩码E(K, J0)、GHASH累加值与消息尾部不留在内存中
+    ~GMAC() {
+        secure_zero(ej0, sizeof(ej0));
+        secure_zero(&X, sizeof(X));
+        secure_zero(buffer, sizeof(buffer));
+        secure_zero(&total_len, sizeof(total_len));
+    }
+
+    void set_key(const uint8_t key[16]) {
+        sm4.set_key(key);
+        uint8_t zero[16] = { 0 };
+        uint8_t H[16];
+        sm4.encrypt_block(zero, H);
+        gh.init(H);
+    }
+
+    //一次性计算标签
+    void compute(const uint8_t nonce[12], const uint8_t* data, size_t len, uint8_t tag[16]) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "gmac.compute", len, (len + 15) / 16);
+        uint8_t e[16];
+        encrypt_j0(nonce, e);
+        GF128 x = { 0, 0 };
+        gh.update(x, data, len);
+        gh.update_lengths(x, len, 0);
+        GHash::to_bytes(x, tag);
+        for (int i = 0; i < 16; i++) {
+            tag[i] ^= e[i];
+        }
+        secure_zero(e, sizeof(e));
+    }
+
+    //一次性验证标签（常数时间比较）
+    bool verify(const uint8_t nonce[12], const uint8_t* data, size_t len, const uint8_t tag[16]) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "gmac.verify", len, (len + 15) / 16);
+        uint8_t computed[16];
+        compute(nonce, data, len, computed);
+        bool ok = tag_equal(computed, tag);
+        if (!ok) {
+            CRYPTO_TELEMETRY_FAIL(tm, 1);
+        }
+        return ok;
+    }
+
+    //流式接口：init → update若干次 → final
+    void init(const uint8_t nonce[12]) {
+        X.hi = 0;
+        X.lo = 0;
+        buffered = 0;
+        total_len = 0;
+        encrypt_j0(nonce, ej0);
+    }
+
+    void update(const uint8_t* data, size_t len) {
+        total_len += len;
+        //先补满缓冲区中的残余分组
+        if (buffered > 0) {
+            size_t take = (16 - buffered < len) ? 16 - buffered : len;
+            memcpy(buffer + buffered, data, take);
+            buffered += take;
+            data += take;
+            len -= take;
+            if (buffered < 16) {
+                return;
+            }
+            gh.update_blocks(X, buffer, 1);
+            buffered = 0;
+        }
+        //完整分组直接从调用者内存送入GHASH
+        size_t full = len / 16;
+        gh.update_blocks(X, data, full);
+        buffered = len - 16 * full;
+        memcpy(buffer, data + 16 * full, buffered);
+    }
+
+    void final(uint8_t tag[16]) {
+        if (buffered > 0) {
+            memset(buffer + buffered, 0, 16 - buffered);
+            gh.update_blocks(X, buffer, 1);
+        }
+        gh.update_lengths(X, total_len, 0);
+        GHash::to_bytes(X, tag);
+        for (int i = 0; i < 16; i++) {
+            tag[i] ^= ej0[i];
+        }
+        //标签生成后掩码与中间状态不再需要，下一条消息由init重新计算
+        secure_zero(ej0, sizeof(ej0));
+        secure_zero(&X, sizeof(X));
+        secure_zero(buffer, sizeof(buffer));
+        buffered = 0;
+        total_len = 0;
+    }
+};
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <iomanip>
 #include <string>
+#include <cstring>
 #include <chrono>  // 新增：用于时间计算
 
 using namespace std;
@@ -57,6 +58,11 @@ private:
         return x ^ rotl(x, 2) ^ rotl(x, 10) ^ rotl(x, 18) ^ rotl(x, 24);
     }
 
+    //密钥扩展用的线性变换L'
+    static uint32_t L_key(uint32_t x) {
+        return x ^ rotl(x, 13) ^ rotl(x, 23);
+    }
+
     //轮函数F
     static uint32_t F(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3, uint32_t rk) {
         return x0 ^ L(byte_sub(x1 ^ x2 ^ x3 ^ rk));
@@ -78,7 +84,7 @@ public:
         k[3] = mk[3] ^ FK[3];
 
         for (int i = 0; i < 32; i++) {
-            k[i + 4] = k[i] ^ L(byte_sub(k[i + 1] ^ k[i + 2] ^ k[i + 3] ^ CK[i]));
+            k[i + 4] = k[i] ^ L_key(byte_sub(k[i + 1] ^ k[i + 2] ^ k[i + 3] ^ CK[i]));
             rk[i] = k[i + 4];
         }
     }
@@ -139,9 +145,9 @@ private:
                     z[j] ^= v[j];
                 }
             }
-            //移位
+            //V右移一位：字节0为最高位，进位从低下标字节移入高下标字节
             uint8_t carry = 0;
-            for (int j = 15; j >= 0; j--) {
+            for (int j = 0; j < 16; j++) {
                 uint8_t b = v[j] & 1;
                 v[j] = (v[j] >> 1) | (carry << 7);
                 carry = b;
@@ -193,14 +199,14 @@ public:
         const uint8_t* aad, size_t aad_len, uint8_t* ciphertext, uint8_t tag[16]) {
         //生成初始计数器块
         uint8_t ctr0[16];
-        generate_ctr(nonce, 0, ctr0);
+        generate_ctr(nonce, 1, ctr0);
         //加密计数器块得到J0
         uint8_t J0[16];
         sm4.encrypt_block(ctr0, J0);
         //CTR模式加密
         for (size_t i = 0; i < plaintext_len; i += 16) {
             uint8_t ctr[16];
-            generate_ctr(nonce, i / 16 + 1, ctr);
+            generate_ctr(nonce, i / 16 + 2, ctr);
 
             uint8_t keystream[16];
             sm4.encrypt_block(ctr, keystream);
@@ -249,14 +255,14 @@ public:
         const uint8_t* aad, size_t aad_len, const uint8_t tag[16], uint8_t* plaintext) {
         //生成初始计数器块
         uint8_t ctr0[16];
-        generate_ctr(nonce, 0, ctr0);
+        generate_ctr(nonce, 1, ctr0);
         //加密计数器块得到J0
         uint8_t J0[16];
         sm4.encrypt_block(ctr0, J0);
         //CTR模式解密
         for (size_t i = 0; i < ciphertext_len; i += 16) {
             uint8_t ctr[16];
-            generate_ctr(nonce, i / 16 + 1, ctr);
+            generate_ctr(nonce, i / 16 + 2, ctr);
             uint8_t keystream[16];
             sm4.encrypt_block(ctr, keystream);
             size_t block_len = (ciphertext_len - i < 16) ? ciphertext_len - i : 16;
@@ -317,6 +323,8 @@ void print_hex(const string& label, const uint8_t* data, size_t len) {
     cout << dec << endl;
 }
 
+//作为库被其他程序包含时（如基准测试）定义SM4_GCM_NO_MAIN以去掉演示用的main
+#ifndef SM4_GCM_NO_MAIN
 int main() {
     //测试向量
     uint8_t key[16] = {
@@ -376,4 +384,5 @@ int main() {
         cout << "Tampered decrypted (invalid tag - CORRECT): " << (char*)decrypted.data() << endl;
     }
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -4,6 +4,14 @@
 #include <cassert>
 #include <chrono>
 #include <immintrin.h>  // AESNI指令集头文件
+#ifdef _MSC_VER
+#include <stdlib.h>
+#else
+//GCC/Clang：_byteswap_ulong为MSVC内建函数，_mm_extract_epi32需要SSE4.1
+#define _byteswap_ulong __builtin_bswap32
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
 
 // S盒
 const uint8_t S_BOX[256] = {
@@ -40,7 +48,7 @@ const uint32_t CK[32] = {
     0x50575e65, 0x6c737a81, 0x888f969d, 0xa4abb2b9,
     0xc0c7ced5, 0xdce3eaf1, 0xf8ff060d, 0x141b2229,
     0x30373e45, 0x4c535a61, 0x686f767d, 0x848b9299,
-    0xa0a7aef5, 0xbcc3cad1, 0xd8dfe6ed, 0xf4fb0209,
+    0xa0a7aeb5, 0xbcc3cad1, 0xd8dfe6ed, 0xf4fb0209,
     0x10171e25, 0x2c333a41, 0x484f565d, 0x646b7279
 };
 
@@ -93,7 +101,17 @@ uint32_t nonlinearTransform(uint32_t x) {
 }
 
 /**
- * 使用AESNI优化的密钥扩展，利用向量寄存器一次处理多个字，加速子密钥生成
+ * 密钥扩展用的合成置换T'（S盒替换+线性变换L'(B) = B ^ (B <<< 13) ^ (B <<< 23)），
+ * 与加密轮函数的L不同
+ */
+uint32_t keyTransform(uint32_t x) {
+    uint32_t y = (static_cast<uint32_t>(S_BOX[(x >> 24) & 0xFF]) << 24) | (static_cast<uint32_t>(S_BOX[(x >> 16) & 0xFF]) << 16)
+        | (static_cast<uint32_t>(S_BOX[(x >> 8) & 0xFF]) << 8) | S_BOX[x & 0xFF];
+    return y ^ ROTL32(y, 13) ^ ROTL32(y, 23);
+}
+
+/**
+ * 使用AESNI优化的密钥扩展，主密钥与FK的异或在向量寄存器中完成
  */
 void keyExpansionAESNI(const uint32_t key[4], uint32_t rk[32]) {
     assert(key != nullptr && rk != nullptr);
@@ -102,66 +120,13 @@ void keyExpansionAESNI(const uint32_t key[4], uint32_t rk[32]) {
     __m128i fk_vec = _mm_loadu_si128((const __m128i*)FK);
     // 初始化密钥寄存器：K[i] = key[i] ^ FK[i]
     __m128i K = _mm_xor_si128(key_vec, fk_vec);
-    _mm_storeu_si128((__m128i*)rk, K);  // 存储初始密钥
-    // 加载轮常量到向量寄存器
-    __m128i ck_low = _mm_loadu_si128((const __m128i*) & CK[0]);
-    __m128i ck_mid1 = _mm_loadu_si128((const __m128i*) & CK[4]);
-    __m128i ck_mid2 = _mm_loadu_si128((const __m128i*) & CK[8]);
-    __m128i ck_high = _mm_loadu_si128((const __m128i*) & CK[12]);
-    // 循环生成子密钥，每次处理4个轮常量（利用AESNI向量并行性）
-    for (int i = 0; i < 32; i += 4) {
-        // 提取当前需要的轮常量
-        __m128i ck_vec;
-        if (i < 16) {
-            if (i < 8) {
-                ck_vec = (i < 4) ? ck_low : ck_mid1;
-            }
-            else {
-                ck_vec = ck_mid2;
-            }
-        }
-        else {
-            ck_vec = ck_high;
-        }
-        // 提取K[i+1], K[i+2], K[i+3]
-        __m128i K1 = _mm_shuffle_epi32(K, _MM_SHUFFLE(0, 3, 2, 1));
-        __m128i K2 = _mm_shuffle_epi32(K, _MM_SHUFFLE(1, 0, 3, 2));
-        __m128i K3 = _mm_shuffle_epi32(K, _MM_SHUFFLE(2, 1, 0, 3));
-        // 计算 K[i+1]^K[i+2]^K[i+3]^CK[i]
-        __m128i temp = _mm_xor_si128(K1, K2);
-        temp = _mm_xor_si128(temp, K3);
-        temp = _mm_xor_si128(temp, ck_vec);
-        // 存储临时值用于非线性变换
-        uint32_t temp_words[4];
-        _mm_storeu_si128((__m128i*)temp_words, temp);
-        // 对每个字应用非线性变换
-        __m128i trans_vec;
-        uint32_t trans_words[4];
-        for (int j = 0; j < 4; j++) {
-            if (i + j < 32) {
-                trans_words[j] = nonlinearTransform(temp_words[j]);
-            }
-            else {
-                trans_words[j] = 0;  // 超出范围的部分不用处理
-            }
-        }
-        trans_vec = _mm_loadu_si128((const __m128i*)trans_words);
-        // 计算新的子密钥: K[i+4] = K[i] ^ nonlinearTransform(...)
-        __m128i new_K = _mm_xor_si128(K, trans_vec);
-        // 存储生成的子密钥
-        if (i < 28) {  // 确保不越界
-            _mm_storeu_si128((__m128i*) & rk[i + 4], new_K);
-        }
-        else {
-            // 处理最后几个子密钥
-            uint32_t last_words[4];
-            _mm_storeu_si128((__m128i*)last_words, new_K);
-            for (int j = 0; j < 4 && i + 4 + j < 32; j++) {
-                rk[i + 4 + j] = last_words[j];
-            }
-        }
-        // 更新密钥寄存器
-        K = new_K;
+    uint32_t k[4];
+    _mm_storeu_si128((__m128i*)k, K);
+    // 每个子密钥依赖前三个子密钥，无法在向量寄存器内并行，逐个计算
+    // （K[i+4] = K[i] ^ keyTransform(K[i+1]^K[i+2]^K[i+3]^CK[i])）
+    for (int i = 0; i < 32; ++i) {
+        k[i % 4] ^= keyTransform(k[(i + 1) % 4] ^ k[(i + 2) % 4] ^ k[(i + 3) % 4] ^ CK[i]);
+        rk[i] = k[i % 4];
     }
 }
 
@@ -250,6 +215,8 @@ void wordsToBytes(const uint32_t words[4], uint8_t bytes[16]) {
 }
 
 // -------------------------- 测试代码 --------------------------
+//作为库被其他程序包含时（如基准测试）定义SM4_NO_MAIN以去掉演示用的main
+#ifndef SM4_NO_MAIN
 int main() {
 
     // 初始化T-table
@@ -311,3 +278,7 @@ int main() {
     std::cout << "AESNI优化版本平均时间: " << avg_aesni << " 微秒/次\n";
     return 0;
 }
+#endif
+#ifndef _MSC_VER
+#pragma GCC pop_options
+#endif
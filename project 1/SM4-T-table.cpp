@@ -39,7 +39,7 @@ const uint32_t CK[32] = {
     0x50575e65, 0x6c737a81, 0x888f969d, 0xa4abb2b9,
     0xc0c7ced5, 0xdce3eaf1, 0xf8ff060d, 0x141b2229,
     0x30373e45, 0x4c535a61, 0x686f767d, 0x848b9299,
-    0xa0a7aef5, 0xbcc3cad1, 0xd8dfe6ed, 0xf4fb0209,
+    0xa0a7aeb5, 0xbcc3cad1, 0xd8dfe6ed, 0xf4fb0209,
     0x10171e25, 0x2c333a41, 0x484f565d, 0x646b7279
 };
 
@@ -96,6 +96,16 @@ uint32_t nonlinearTransform(uint32_t x) {
         T3[x & 0xFF];
 }
 
+/**
+ * 密钥扩展用的合成置换T'（S盒替换+线性变换L'(B) = B ^ (B <<< 13) ^ (B <<< 23)），
+ * 与加密轮函数的L不同
+ */
+uint32_t keyTransform(uint32_t x) {
+    uint32_t y = (static_cast<uint32_t>(S_BOX[(x >> 24) & 0xFF]) << 24) | (static_cast<uint32_t>(S_BOX[(x >> 16) & 0xFF]) << 16)
+        | (static_cast<uint32_t>(S_BOX[(x >> 8) & 0xFF]) << 8) | S_BOX[x & 0xFF];
+    return y ^ ROTL32(y, 13) ^ ROTL32(y, 23);
+}
+
 // -------------------------- 密钥扩展与加解密 --------------------------
 /**
  * 生成32个子密钥
@@ -109,9 +119,9 @@ void keyExpansion(const uint32_t key[4], uint32_t rk[32]) {
     K[1] = key[1] ^ FK[1];
     K[2] = key[2] ^ FK[2];
     K[3] = key[3] ^ FK[3];
-    // 迭代生成子密钥（SM4密钥扩展公式：K[i+4] = K[i] ^ nonlinearTransform(K[i+1]^K[i+2]^K[i+3]^CK[i])）
+    // 迭代生成子密钥（SM4密钥扩展公式：K[i+4] = K[i] ^ keyTransform(K[i+1]^K[i+2]^K[i+3]^CK[i])）
     for (int i = 0; i < 32; ++i) {
-        rk[i] = K[i % 4] ^ nonlinearTransform(K[(i + 1) % 4] ^ K[(i + 2) % 4] ^ K[(i + 3) % 4] ^ CK[i]);
+        rk[i] = K[i % 4] ^ keyTransform(K[(i + 1) % 4] ^ K[(i + 2) % 4] ^ K[(i + 3) % 4] ^ CK[i]);
         K[i % 4] = rk[i];  // 更新寄存器
     }
 }
@@ -175,6 +185,8 @@ void wordsToBytes(const uint32_t words[4], uint8_t bytes[16]) {
 }
 
 // -------------------------- 测试代码 --------------------------
+//作为库被其他程序包含时（如基准测试）定义SM4_NO_MAIN以去掉演示用的main
+#ifndef SM4_NO_MAIN
 int main() {
     // 初始化T-table
     initTTable();
@@ -242,4 +254,5 @@ int main() {
 
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
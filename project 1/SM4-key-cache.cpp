@@ -0,0 +1,119 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include "SM4-key-cache.h"
+
+using namespace std;
+using namespace chrono;
+
+//演示用密钥库：密钥由ID确定性地派生，ID形如"key-<n>"，n < 1000
+bool demo_loader(const string& id, uint8_t key[16]) {
+    if (id.compare(0, 4, "key-") != 0) {
+        return false;
+    }
+    int n = stoi(id.substr(4));
+    if (n < 0 || n >= 1000) {
+        return false;
+    }
+    for (int i = 0; i < 16; i++) {
+        key[i] = (uint8_t)(n * 31 + i * 7);
+    }
+    return true;
+}
+
+//缓存句柄加密的结果与每次重新set_key的结果一致
+bool test_correctness() {
+    KeyCache<> cache(64, demo_loader, 4);
+    uint8_t nonce[12] = { 1, 2, 3 };
+    uint8_t pt[100], ct1[100], ct2[100], tag1[16], tag2[16];
+    memset(pt, 0x5a, sizeof(pt));
+    bool ok = true;
+    for (int round = 0; round < 3; round++) {
+        for (int n = 0; n < 200; n += 7) {
+            string id = "key-" + to_string(n);
+            KeyCache<>::Handle h = cache.get(id);
+            uint8_t key[16];
+            demo_loader(id, key);
+            GCM fresh;
+            fresh.set_key(key);
+            h->encrypt(nonce, pt, sizeof(pt), nullptr, 0, ct1, tag1);
+            fresh.encrypt(nonce, pt, sizeof(pt), nullptr, 0, ct2, tag2);
+            ok = ok && memcmp(ct1, ct2, sizeof(ct1)) == 0 && memcmp(tag1, tag2, 16) == 0;
+        }
+    }
+    ok = ok && !cache.get("no-such-key") && cache.size() <= 64;
+
+    //淘汰后仍持有的句柄依然可用
+    KeyCache<> tiny(1, demo_loader, 1);
+    KeyCache<>::Handle held = tiny.get("key-1");
+    tiny.get("key-2");
+    held->encrypt(nonce, pt, sizeof(pt), nullptr, 0, ct1, tag1);
+    ok = ok && tiny.size() == 1 && tiny.stats().evictions == 1;
+
+    KeyCache<>::Stats st = cache.stats();
+    cout << "命中 " << st.hits << "，未命中 " << st.misses << "，淘汰 " << st.evictions << endl;
+    cout << "缓存句柄与每次set_key结果一致、淘汰后句柄可用: " << (ok ? "是" : "否") << endl;
+    return ok;
+}
+
+//每请求set_key与查缓存的开销对比，以及多线程并发查找
+bool test_speed() {
+    const int REQUESTS = 200000;
+    const int KEYS = 100;
+    uint8_t nonce[12] = { 0 };
+    uint8_t pt[64] = { 0 }, ct[64], tag[16];
+
+    auto start = high_resolution_clock::now();
+    for (int i = 0; i < REQUESTS; i++) {
+        uint8_t key[16];
+        demo_loader("key-" + to_string(i % KEYS), key);
+        GCM gcm;
+        gcm.set_key(key);
+        gcm.encrypt(nonce, pt, sizeof(pt), nullptr, 0, ct, tag);
+    }
+    double t_setkey = duration<double, nano>(high_resolution_clock::now() - start).count() / REQUESTS;
+
+    KeyCache<> cache(1024, demo_loader);
+    start = high_resolution_clock::now();
+    for (int i = 0; i < REQUESTS; i++) {
+        KeyCache<>::Handle h = cache.get("key-" + to_string(i % KEYS));
+        h->encrypt(nonce, pt, sizeof(pt), nullptr, 0, ct, tag);
+    }
+    double t_cache = duration<double, nano>(high_resolution_clock::now() - start).count() / REQUESTS;
+    cout << "64字节请求：每次set_key " << t_setkey << " ns/请求，查缓存 " << t_cache << " ns/请求" << endl;
+
+    //4个线程并发查找与淘汰（容量小于密钥数）
+    KeyCache<> shared(50, demo_loader, 8);
+    vector<thread> pool;
+    atomic<bool> ok(true);
+    for (int t = 0; t < 4; t++) {
+        pool.emplace_back([&, t]() {
+            uint8_t c[64], g[16];
+            for (int i = 0; i < 20000; i++) {
+                KeyCache<>::Handle h = shared.get("key-" + to_string((i * 7 + t) % 80));
+                if (!h) {
+                    ok = false;
+                    continue;
+                }
+                h->encrypt(nonce, pt, sizeof(pt), nullptr, 0, c, g);
+            }
+        });
+    }
+    for (auto& th : pool) {
+        th.join();
+    }
+    KeyCache<>::Stats st = shared.stats();
+    bool good = ok && st.hits + st.misses == 80000 && shared.size() <= 56;
+    cout << "多线程并发查找: " << (good ? "通过" : "失败") << "（淘汰 " << st.evictions << " 次）" << endl;
+    return good;
+}
+
+int main() {
+    bool ok = test_correctness();
+    ok = test_speed() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "SM4-GCM-optimized.h"
+#include "../common/usdt.h"
+
+//按密钥ID缓存已完成密钥扩展的上下文（默认GCM：SM4轮密钥、H、Shoup表与H的幂），
+//每个密钥只做一次set_key，而不是每个请求一次。
+//
+//   分片LRU：ID按哈希分到各分片，每个分片一把锁，减少并发查找时的锁竞争；
+//   句柄为shared_ptr<const Ctx>，可以跨线程使用；淘汰或吊销只是把上下文移出缓存，
+//   正在使用的句柄仍然有效，最后一个句柄释放时上下文析构并擦除密钥材料。
+//
+//Ctx需提供set_key(const uint8_t key[16])，GCM、GMAC、SM4均可。
+template <class Ctx = GCM>
+class KeyCache {
+public:
+    using Handle = std::shared_ptr<const Ctx>;
+    //未命中时按ID取得原始密钥，返回false表示ID不存在
+    using Loader = std::function<bool(const std::string& key_id, uint8_t key[16])>;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+    };
+
+private:
+    //LRU链表头部为最近使用，索引指向链表节点
+    struct Shard {
+        std::mutex lock;
+        std::list<std::pair<std::string, Handle>> lru;
+        std::unordered_map<std::string, typename std::list<std::pair<std::string, Handle>>::iterator> index;
+    };
+
+    std::vector<Shard> shards;
+    size_t per_shard;
+    Loader loader;
+    std::atomic<uint64_t> hits, misses, evictions;
+
+    Shard& shard_of(const std::string& id) {
+        return shards[std::hash<std::string>()(id) % shards.size()];
+    }
+
+    static void secure_zero(void* p, size_t n) {
+        volatile uint8_t* v = (volatile uint8_t*)p;
+        while (n--) {
+            *v++ = 0;
+        }
+    }
+
+    static Handle make_handle(const uint8_t key[16]) {
+        std::shared_ptr<Ctx> ctx = std::make_shared<Ctx>();
+        ctx->set_key(key);
+        return ctx;
+    }
+
+    //在持有分片锁时插入；已存在则保留已有的句柄（并发未命中时只保留一份）
+    Handle insert_locked(Shard& s, const std::string& id, Handle h) {
+        auto it = s.index.find(id);
+        if (it != s.index.end()) {
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            return it->second->second;
+        }
+        s.lru.emplace_front(id, std::move(h));
+        s.index[id] = s.lru.begin();
+        while (s.lru.size() > per_shard) {
+            CRYPTO_USDT1(key_cache_evict, s.lru.back().second.get());
+            s.index.erase(s.lru.back().first);
+            s.lru.pop_back();
+            evictions++;
+        }
+        return s.lru.front().second;
+    }
+
+public:
+    //capacity为总容量，按分片平均分配（每片至少1项）
+    KeyCache(size_t capacity, Loader load, size_t nshards = 16)
+        : shards(nshards == 0 ? 1 : nshards), loader(std::move(load)), hits(0), misses(0), evictions(0) {
+        per_shard = (capacity + shards.size() - 1) / shards.size();
+        if (per_shard == 0) {
+            per_shard = 1;
+        }
+    }
+
+    //查找句柄，未命中时通过loader取密钥并完成密钥扩展；ID不存在时返回空句柄
+    //密钥扩展在分片锁外进行，不会阻塞同一分片上的其他查找
+    Handle get(const std::string& id) {
+        Shard& s = shard_of(id);
+        {
+            std::lock_guard<std::mutex> g(s.lock);
+            auto it = s.index.find(id);
+            if (it != s.index.end()) {
+                s.lru.splice(s.lru.begin(), s.lru, it->second);
+                hits++;
+                return it->second->second;
+            }
+        }
+        misses++;
+        uint8_t key[16];
+        if (!loader || !loader(id, key)) {
+            secure_zero(key, sizeof(key));
+            return Handle();
+        }
+        Handle h = make_handle(key);
+        secure_zero(key, sizeof(key));
+        CRYPTO_USDT2(key_cache_load, id.c_str(), h.get());
+        std::lock_guard<std::mutex> g(s.lock);
+        return insert_locked(s, id, std::move(h));
+    }
+
+    //直接放入一个密钥（覆盖同ID的旧上下文）
+    Handle put(const std::string& id, const uint8_t key[16]) {
+        Handle h = make_handle(key);
+        CRYPTO_USDT2(key_cache_load, id.c_str(), h.get());
+        Shard& s = shard_of(id);
+        std::lock_guard<std::mutex> g(s.lock);
+        auto it = s.index.find(id);
+        if (it != s.index.end()) {
+            s.lru.erase(it->second);
+            s.index.erase(it);
+        }
+        return insert_locked(s, id, std::move(h));
+    }
+
+    //吊销：移出缓存，之后的get会重新加载
+    void erase(const std::string& id) {
+        Shard& s = shard_of(id);
+        std::lock_guard<std::mutex> g(s.lock);
+        auto it = s.index.find(id);
+        if (it != s.index.end()) {
+            s.lru.erase(it->second);
+            s.index.erase(it);
+        }
+    }
+
+    void clear() {
+        for (auto& s : shards) {
+            std::lock_guard<std::mutex> g(s.lock);
+            s.index.clear();
+            s.lru.clear();
+        }
+    }
+
+    size_t size() {
+        size_t n = 0;
+        for (auto& s : shards) {
+            std::lock_guard<std::mutex> g(s.lock);
+            n += s.lru.size();
+        }
+        return n;
+    }
+
+    Stats stats() const {
+        return { hits.load(), misses.load(), evictions.load() };
+    }
+};
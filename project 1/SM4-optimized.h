@@ -0,0 +1,215 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "../common/perf_counters.h"
+#include "../common/telemetry.h"
+
+//SM4分组密码（T-table + 多分组交错优化版）
+//密钥扩展按GB/T 32907使用L'变换，可通过标准测试向量验证
+class SM4 {
+private:
+    static constexpr uint32_t FK[4] = {
+        0xA3B1BAC6, 0x56AA3350, 0x677D9197, 0xB27022DC
+    };
+    static constexpr uint32_t CK[32] = {
+        0x00070e15, 0x1c232a31, 0x383f464d, 0x545b6269,
+        0x70777e85, 0x8c939aa1, 0xa8afb6bd, 0xc4cbd2d9,
+        0xe0e7eef5, 0xfc030a11, 0x181f262d, 0x343b4249,
+        0x50575e65, 0x6c737a81, 0x888f969d, 0xa4abb2b9,
+        0xc0c7ced5, 0xdce3eaf1, 0xf8ff060d, 0x141b2229,
+        0x30373e45, 0x4c535a61, 0x686f767d, 0x848b9299,
+        0xa0a7aeb5, 0xbcc3cad1, 0xd8dfe6ed, 0xf4fb0209,
+        0x10171e25, 0x2c333a41, 0x484f565d, 0x646b7279
+    };
+    static constexpr uint8_t S_BOX[256] = {
+        0xd6, 0x90, 0xe9, 0xfe, 0xcc, 0xe1, 0x3d, 0xb7, 0x16, 0xb6, 0x14, 0xc2, 0x28, 0xfb, 0x2c, 0x05,
+        0x2b, 0x67, 0x9a, 0x76, 0x2a, 0xbe, 0x04, 0xc3, 0xaa, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99,
+        0x9c, 0x42, 0x50, 0xf4, 0x91, 0xef, 0x98, 0x7a, 0x33, 0x54, 0x0b, 0x43, 0xed, 0xcf, 0xac, 0x62,
+        0xe4, 0xb3, 0x1c, 0xa9, 0xc9, 0x08, 0xe8, 0x95, 0x80, 0xdf, 0x94, 0xfa, 0x75, 0x8f, 0x3f, 0xa6,
+        0x47, 0x07, 0xa7, 0xfc, 0xf3, 0x73, 0x17, 0xba, 0x83, 0x59, 0x3c, 0x19, 0xe6, 0x85, 0x4f, 0xa8,
+        0x68, 0x6b, 0x81, 0xb2, 0x71, 0x64, 0xda, 0x8b, 0xf8, 0xeb, 0x0f, 0x4b, 0x70, 0x56, 0x9d, 0x35,
+        0x1e, 0x24, 0x0e, 0x5e, 0x63, 0x58, 0xd1, 0xa2, 0x25, 0x22, 0x7c, 0x3b, 0x01, 0x21, 0x78, 0x87,
+        0xd4, 0x00, 0x46, 0x57, 0x9f, 0xd3, 0x27, 0x52, 0x4c, 0x36, 0x02, 0xe7, 0xa0, 0xc4, 0xc8, 0x9e,
+        0xea, 0xbf, 0x8a, 0xd2, 0x40, 0xc7, 0x38, 0xb5, 0xa3, 0xf7, 0xf2, 0xce, 0xf9, 0x61, 0x15, 0xa1,
+        0xe0, 0xae, 0x5d, 0xa4, 0x9b, 0x34, 0x1a, 0x55, 0xad, 0x93, 0x32, 0x30, 0xf5, 0x8c, 0xb1, 0xe3,
+        0x1d, 0xf6, 0xe2, 0x2e, 0x82, 0x66, 0xca, 0x60, 0xc0, 0x29, 0x23, 0xab, 0x0d, 0x53, 0x4e, 0x6f,
+        0xd5, 0xdb, 0x37, 0x45, 0xde, 0xfd, 0x8e, 0x2f, 0x03, 0xff, 0x6a, 0x72, 0x6d, 0x6c, 0x5b, 0x51,
+        0x8d, 0x1b, 0xaf, 0x92, 0xbb, 0xdd, 0xbc, 0x7f, 0x11, 0xd9, 0x5c, 0x41, 0x1f, 0x10, 0x5a, 0xd8,
+        0x0a, 0xc1, 0x31, 0x88, 0xa5, 0xcd, 0x7b, 0xbd, 0x2d, 0x74, 0xd0, 0x12, 0xb8, 0xe5, 0xb4, 0xb0,
+        0x89, 0x69, 0x97, 0x4a, 0x0c, 0x96, 0x77, 0x7e, 0x65, 0xb9, 0xf1, 0x09, 0xc5, 0x6e, 0xc6, 0x84,
+        0x18, 0xf0, 0x7d, 0xec, 0x3a, 0xdc, 0x4d, 0x20, 0x79, 0xee, 0x5f, 0x3e, 0xd7, 0xcb, 0x39, 0x48
+    };
+
+    uint32_t rk[32]; //轮密钥
+
+    //T-table：T0[b] = L(S(b) << 24)，T1~T3为T0循环右移8/16/24位
+    struct Tables {
+        uint32_t T0[256], T1[256], T2[256], T3[256];
+        Tables() {
+            for (int i = 0; i < 256; i++) {
+                uint32_t t = L((uint32_t)S_BOX[i] << 24);
+                T0[i] = t;
+                T1[i] = rotl(t, 24);
+                T2[i] = rotl(t, 16);
+                T3[i] = rotl(t, 8);
+            }
+        }
+    };
+    static const Tables& tables() {
+        static const Tables t;
+        return t;
+    }
+
+    //循环左移
+    static inline uint32_t rotl(uint32_t x, int n) {
+        return (x << n) | (x >> (32 - n));
+    }
+    //线性变换L（轮函数）
+    static inline uint32_t L(uint32_t x) {
+        return x ^ rotl(x, 2) ^ rotl(x, 10) ^ rotl(x, 18) ^ rotl(x, 24);
+    }
+    //线性变换L'（密钥扩展）
+    static inline uint32_t L_key(uint32_t x) {
+        return x ^ rotl(x, 13) ^ rotl(x, 23);
+    }
+    //字节替换τ
+    static inline uint32_t byte_sub(uint32_t x) {
+        return (uint32_t)S_BOX[x >> 24] << 24 | (uint32_t)S_BOX[(x >> 16) & 0xff] << 16 |
+            (uint32_t)S_BOX[(x >> 8) & 0xff] << 8 | (uint32_t)S_BOX[x & 0xff];
+    }
+    //查表实现的合成置换T = L·τ
+    static inline uint32_t T(const Tables& t, uint32_t x) {
+        return t.T0[x >> 24] ^ t.T1[(x >> 16) & 0xff] ^ t.T2[(x >> 8) & 0xff] ^ t.T3[x & 0xff];
+    }
+
+    static inline uint32_t load_be32(const uint8_t* p) {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+    }
+    static inline void store_be32(uint8_t* p, uint32_t v) {
+        p[0] = (uint8_t)(v >> 24);
+        p[1] = (uint8_t)(v >> 16);
+        p[2] = (uint8_t)(v >> 8);
+        p[3] = (uint8_t)v;
+    }
+
+    //单分组32轮迭代，解密时轮密钥逆序使用
+    void crypt_block(const uint8_t in[16], uint8_t out[16], bool decrypt) const {
+        const Tables& t = tables();
+        uint32_t x0 = load_be32(in), x1 = load_be32(in + 4);
+        uint32_t x2 = load_be32(in + 8), x3 = load_be32(in + 12);
+        int step = decrypt ? -1 : 1;
+        for (int i = 0; i < 32; i += 4) {
+            int r = decrypt ? 31 - i : i;
+            //四轮展开，通过变量重命名代替寄存器轮转
+            x0 ^= T(t, x1 ^ x2 ^ x3 ^ rk[r]);
+            x1 ^= T(t, x2 ^ x3 ^ x0 ^ rk[r + step]);
+            x2 ^= T(t, x3 ^ x0 ^ x1 ^ rk[r + 2 * step]);
+            x3 ^= T(t, x0 ^ x1 ^ x2 ^ rk[r + 3 * step]);
+        }
+        //反序变换
+        store_be32(out, x3);
+        store_be32(out + 4, x2);
+        store_be32(out + 8, x1);
+        store_be32(out + 12, x0);
+    }
+
+public:
+    //分组交错路数：多分组内核一次推进的独立分组数
+    static const size_t LANES = 4;
+
+    SM4() {
+        memset(rk, 0, sizeof(rk));
+    }
+
+    //析构时擦除轮密钥（volatile写入，不会被优化掉）
+    ~SM4() {
+        volatile uint32_t* v = rk;
+        for (int i = 0; i < 32; i++) {
+            v[i] = 0;
+        }
+    }
+
+    //密钥扩展
+    void set_key(const uint8_t key[16]) {
+        uint32_t k0 = load_be32(key) ^ FK[0];
+        uint32_t k1 = load_be32(key + 4) ^ FK[1];
+        uint32_t k2 = load_be32(key + 8) ^ FK[2];
+        uint32_t k3 = load_be32(key + 12) ^ FK[3];
+        for (int i = 0; i < 32; i += 4) {
+            k0 ^= L_key(byte_sub(k1 ^ k2 ^ k3 ^ CK[i]));
+            rk[i] = k0;
+            k1 ^= L_key(byte_sub(k2 ^ k3 ^ k0 ^ CK[i + 1]));
+            rk[i + 1] = k1;
+            k2 ^= L_key(byte_sub(k3 ^ k0 ^ k1 ^ CK[i + 2]));
+            rk[i + 2] = k2;
+            k3 ^= L_key(byte_sub(k0 ^ k1 ^ k2 ^ CK[i + 3]));
+            rk[i + 3] = k3;
+        }
+    }
+
+    //加密单块
+    void encrypt_block(const uint8_t in[16], uint8_t out[16]) const {
+        CRYPTO_PERF_SCOPE("sm4.block");
+        CRYPTO_TELEMETRY_COUNT("sm4.encrypt", 16, 1);
+        crypt_block(in, out, false);
+    }
+
+    //解密单块（轮密钥逆序使用）
+    void decrypt_block(const uint8_t in[16], uint8_t out[16]) const {
+        CRYPTO_PERF_SCOPE("sm4.block");
+        CRYPTO_TELEMETRY_COUNT("sm4.decrypt", 16, 1);
+        crypt_block(in, out, true);
+    }
+
+    //N路交错加密：N个相互独立的分组同时推进，
+    //让各分组的查表与异或在流水线中重叠，隐藏单分组轮函数的串行依赖
+    template <size_t N>
+    void encrypt_lanes(const uint8_t* in, uint8_t* out) const {
+        const Tables& t = tables();
+        uint32_t x0[N], x1[N], x2[N], x3[N];
+        for (size_t l = 0; l < N; l++) {
+            const uint8_t* p = in + 16 * l;
+            x0[l] = load_be32(p);
+            x1[l] = load_be32(p + 4);
+            x2[l] = load_be32(p + 8);
+            x3[l] = load_be32(p + 12);
+        }
+        for (int i = 0; i < 32; i += 4) {
+            for (size_t l = 0; l < N; l++) x0[l] ^= T(t, x1[l] ^ x2[l] ^ x3[l] ^ rk[i]);
+            for (size_t l = 0; l < N; l++) x1[l] ^= T(t, x2[l] ^ x3[l] ^ x0[l] ^ rk[i + 1]);
+            for (size_t l = 0; l < N; l++) x2[l] ^= T(t, x3[l] ^ x0[l] ^ x1[l] ^ rk[i + 2]);
+            for (size_t l = 0; l < N; l++) x3[l] ^= T(t, x0[l] ^ x1[l] ^ x2[l] ^ rk[i + 3]);
+        }
+        for (size_t l = 0; l < N; l++) {
+            uint8_t* q = out + 16 * l;
+            store_be32(q, x3[l]);
+            store_be32(q + 4, x2[l]);
+            store_be32(q + 8, x1[l]);
+            store_be32(q + 12, x0[l]);
+        }
+    }
+
+    //多分组加密：每次交错推进LANES个分组，尾部2~3个分组也按对应路数交错
+    void encrypt_blocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+        CRYPTO_PERF_SCOPE("sm4.blocks");
+        CRYPTO_TELEMETRY_COUNT("sm4.blocks", 16 * nblocks, nblocks);
+        size_t b = 0;
+        for (; b + LANES <= nblocks; b += LANES) {
+            encrypt_lanes<LANES>(in + 16 * b, out + 16 * b);
+        }
+        switch (nblocks - b) {
+        case 3:
+            encrypt_lanes<3>(in + 16 * b, out + 16 * b);
+            break;
+        case 2:
+            encrypt_lanes<2>(in + 16 * b, out + 16 * b);
+            break;
+        case 1:
+            crypt_block(in + 16 * b, out + 16 * b, false);
+            break;
+        default:
+            break;
+        }
+    }
+};
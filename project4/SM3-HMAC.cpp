@@ -0,0 +1,164 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include "SM3-HMAC.h"
+
+using namespace std;
+using namespace chrono;
+
+static vector<uint8_t> from_hex(const string& s) {
+    vector<uint8_t> out(s.size() / 2);
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = (uint8_t)stoi(s.substr(2 * i, 2), nullptr, 16);
+    }
+    return out;
+}
+
+//不缓存中间状态的HMAC：每条消息都重新压缩K ^ ipad与K ^ opad
+static void hmac_naive(const uint8_t* key, size_t key_len, const uint8_t* data, size_t len, uint8_t mac[32]) {
+    uint8_t k[64] = { 0 }, pad[64], d[32];
+    if (key_len > 64) {
+        SM3 h;
+        h.update(key, key_len);
+        h.final(k);
+    }
+    else {
+        memcpy(k, key, key_len);
+    }
+    for (int i = 0; i < 64; i++) {
+        pad[i] = k[i] ^ 0x36;
+    }
+    SM3 in;
+    in.update(pad, 64);
+    in.update(data, len);
+    in.final(d);
+    for (int i = 0; i < 64; i++) {
+        pad[i] = k[i] ^ 0x5c;
+    }
+    SM3 out;
+    out.update(pad, 64);
+    out.update(d, 32);
+    out.final(mac);
+}
+
+//已知答案测试（向量由独立实现计算），并检查流式、批量与截断验证
+bool test_vectors() {
+    struct Vec {
+        string key, msg, mac;
+    };
+    string k64, k100(100, '\xaa'), k32;
+    for (int i = 0; i < 64; i++) {
+        k64 += (char)i;
+    }
+    k32 = k64.substr(0, 32);
+    string abc300;
+    for (int i = 0; i < 100; i++) {
+        abc300 += "abc";
+    }
+    const Vec vecs[] = {
+        { "key", "The quick brown fox jumps over the lazy dog",
+            "bd4a34077888162b210645b8ebf74b9af357303789357a27c7fc457244ebd398" },
+        { "", "", "0d23f72ba15e9c189a879aefc70996b06091de6e64d31b7a84004356dd915261" },
+        { k64, "abc", "14ccadbee92a9be279c849b7359fafac65a9f04b156fa8723a72700e506927d5" },
+        { k100, "Test Using Larger Than Block-Size Key - Hash Key First",
+            "ddfd727df11b435760f1fa6638e2c059a66a74da8432815201915246e6211294" },
+        { k32, abc300, "f9c2865c3570033bb5ee156c4979c47daa1058d929ee28779a22e3d3ee3fd2a5" },
+    };
+    bool ok = true;
+    for (const Vec& v : vecs) {
+        HmacSm3 h((const uint8_t*)v.key.data(), v.key.size());
+        vector<uint8_t> expect = from_hex(v.mac);
+        const uint8_t* msg = (const uint8_t*)v.msg.data();
+        uint8_t mac[32], streamed[32], batched[32];
+        h.compute(msg, v.msg.size(), mac);
+        //流式：按7字节分段输入
+        for (size_t i = 0; i < v.msg.size(); i += 7) {
+            h.update(msg + i, min((size_t)7, v.msg.size() - i));
+        }
+        h.final(streamed);
+        size_t len = v.msg.size();
+        h.compute_many(&msg, &len, 1, batched);
+        ok = ok && memcmp(mac, expect.data(), 32) == 0 && memcmp(streamed, mac, 32) == 0
+            && memcmp(batched, mac, 32) == 0 && h.verify(msg, len, mac) && h.verify(msg, len, mac, 16);
+        mac[31] ^= 1;
+        ok = ok && !h.verify(msg, len, mac) && h.verify(msg, len, mac, 16);
+    }
+    cout << "HMAC-SM3已知答案、流式与批量接口: " << (ok ? "通过" : "失败") << endl;
+    return ok;
+}
+
+//不同长度的一批消息：批量结果与逐条计算一致（覆盖跨分组边界的长度）
+bool test_batch() {
+    const size_t N = 100;
+    vector<vector<uint8_t>> data(N);
+    vector<const uint8_t*> ptrs(N);
+    vector<size_t> lens(N);
+    for (size_t i = 0; i < N; i++) {
+        data[i].resize(i * 3);
+        for (size_t j = 0; j < data[i].size(); j++) {
+            data[i][j] = (uint8_t)(i * 13 + j);
+        }
+        ptrs[i] = data[i].data();
+        lens[i] = data[i].size();
+    }
+    uint8_t key[20] = { 0x0b };
+    HmacSm3 h(key, sizeof(key));
+    bool ok = true;
+    for (unsigned lanes : { 1u, 4u, 8u, 16u, 0u }) {
+        vector<uint8_t> macs(32 * N);
+        h.compute_many(ptrs.data(), lens.data(), N, macs.data(), lanes);
+        for (size_t i = 0; i < N; i++) {
+            uint8_t one[32];
+            hmac_naive(key, sizeof(key), ptrs[i], lens[i], one);
+            ok = ok && memcmp(one, &macs[32 * i], 32) == 0;
+        }
+    }
+    cout << "批量计算与逐条计算一致（1/4/8/16路）: " << (ok ? "是" : "否") << endl;
+    return ok;
+}
+
+//64字节消息：每条消息重新处理密钥、缓存ipad/opad状态、批量计算三种方式的开销
+void test_speed() {
+    const size_t N = 100000;
+    vector<uint8_t> data(64 * N);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)(i * 7);
+    }
+    vector<const uint8_t*> ptrs(N);
+    vector<size_t> lens(N, 64);
+    for (size_t i = 0; i < N; i++) {
+        ptrs[i] = &data[64 * i];
+    }
+    uint8_t key[32] = { 1, 2, 3 };
+    vector<uint8_t> macs(32 * N);
+
+    auto start = high_resolution_clock::now();
+    for (size_t i = 0; i < N; i++) {
+        hmac_naive(key, sizeof(key), ptrs[i], 64, &macs[32 * i]);
+    }
+    double t_naive = duration<double, nano>(high_resolution_clock::now() - start).count() / N;
+
+    HmacSm3 h(key, sizeof(key));
+    start = high_resolution_clock::now();
+    for (size_t i = 0; i < N; i++) {
+        h.compute(ptrs[i], 64, &macs[32 * i]);
+    }
+    double t_cached = duration<double, nano>(high_resolution_clock::now() - start).count() / N;
+
+    start = high_resolution_clock::now();
+    h.compute_many(ptrs.data(), lens.data(), N, macs.data());
+    double t_batch = duration<double, nano>(high_resolution_clock::now() - start).count() / N;
+
+    cout << "64字节消息：每次处理密钥 " << t_naive << " ns/条，缓存ipad/opad状态 " << t_cached
+        << " ns/条，批量（" << SM3MultiBuffer::best_lanes() << "路） " << t_batch << " ns/条" << endl;
+}
+
+int main() {
+    bool ok = test_vectors();
+    ok = test_batch() && ok;
+    test_speed();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "../common/telemetry.h"
+#include "SM3-multibuffer.h"
+#ifndef SM3_NO_MAIN
+#define SM3_NO_MAIN
+#endif
+#include "SM3-optimized.h"
+
+//HMAC-SM3（GB/T 15852.2，结构同RFC 2104）：MAC = SM3((K ^ opad) || SM3((K ^ ipad) || M))。
+//
+//   K ^ ipad与K ^ opad各正好一个分组，set_key时各压缩一次并保存中间状态（SM3::State），
+//   之后每条消息从缓存的状态继续，只做消息本身与外层32字节摘要的压缩：
+//   短消息由4次压缩减为2次；
+//   compute_many把n条消息的内层与外层各交给一次多路SM3（SM3MultiBuffer::hash_many_from），
+//   各通道从缓存的链接值开始，适合大量短消息（令牌、API请求签名）。
+//
+//对象设置密钥后只读，compute/verify/compute_many可以被多个线程同时调用；流式接口（init/update/final）
+//使用对象内的状态，同一时刻只能由一个线程使用。
+class HmacSm3 {
+public:
+    static const size_t MAC_SIZE = 32;
+    static const size_t BLOCK_SIZE = 64;
+
+private:
+    SM3::State inner;   //压缩K ^ ipad之后的状态（export_state导出，restore_state总是成功）
+    SM3::State outer;   //压缩K ^ opad之后的状态
+    SM3 ctx;            //流式接口的内层上下文
+
+    //安全擦除，防止编译器优化掉
+    static void secure_zero(void* p, size_t n) {
+        volatile uint8_t* v = (volatile uint8_t*)p;
+        while (n--) {
+            *v++ = 0;
+        }
+    }
+
+    //常数时间比较标签
+    static bool tag_equal(const uint8_t* a, const uint8_t* b, size_t n) {
+        uint8_t diff = 0;
+        for (size_t i = 0; i < n; i++) {
+            diff |= a[i] ^ b[i];
+        }
+        return diff == 0;
+    }
+
+    //外层：从opad状态继续压缩内层摘要
+    void finish(const uint8_t inner_digest[32], uint8_t mac[32]) const {
+        SM3 o;
+        o.restore_state(outer);
+        o.update(inner_digest, 32);
+        o.final(mac);
+    }
+
+public:
+    HmacSm3() {
+        memset(&inner, 0, sizeof(inner));
+        memset(&outer, 0, sizeof(outer));
+    }
+
+    HmacSm3(const uint8_t* key, size_t key_len) {
+        set_key(key, key_len);
+    }
+
+    ~HmacSm3() {
+        secure_zero(&inner, sizeof(inner));
+        secure_zero(&outer, sizeof(outer));
+        secure_zero(&ctx, sizeof(ctx));
+    }
+
+    //设置密钥：长于一个分组的密钥先做SM3，之后补零到64字节
+    void set_key(const uint8_t* key, size_t key_len) {
+        uint8_t k[BLOCK_SIZE] = { 0 };
+        if (key_len > BLOCK_SIZE) {
+            SM3 h;
+            h.update(key, key_len);
+            h.final(k);
+        }
+        else if (key_len > 0) {
+            memcpy(k, key, key_len);
+        }
+        uint8_t pad[BLOCK_SIZE];
+        for (size_t i = 0; i < BLOCK_SIZE; i++) {
+            pad[i] = k[i] ^ 0x36;
+        }
+        SM3 h;
+        h.update(pad, BLOCK_SIZE);
+        inner = h.export_state();
+        for (size_t i = 0; i < BLOCK_SIZE; i++) {
+            pad[i] = k[i] ^ 0x5c;
+        }
+        h.reset();
+        h.update(pad, BLOCK_SIZE);
+        outer = h.export_state();
+        secure_zero(k, sizeof(k));
+        secure_zero(pad, sizeof(pad));
+        secure_zero(&h, sizeof(h));
+        init();
+    }
+
+    //一次性计算MAC
+    void compute(const uint8_t* data, size_t len, uint8_t mac[32]) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "hmac_sm3.compute", len, (len + 8) / 64 + 2);
+        SM3 c;
+        c.restore_state(inner);
+        c.update(data, len);
+        uint8_t d[32];
+        c.final(d);
+        finish(d, mac);
+    }
+
+    //一次性验证MAC（常数时间比较）；mac_len小于32时比较截断的MAC
+    bool verify(const uint8_t* data, size_t len, const uint8_t* mac, size_t mac_len = MAC_SIZE) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "hmac_sm3.verify", len, (len + 8) / 64 + 2);
+        if (mac_len == 0 || mac_len > MAC_SIZE) {
+            CRYPTO_TELEMETRY_FAIL(tm, 1);
+            return false;
+        }
+        uint8_t computed[32];
+        compute(data, len, computed);
+        bool ok = tag_equal(computed, mac, mac_len);
+        if (!ok) {
+            CRYPTO_TELEMETRY_FAIL(tm, 1);
+        }
+        return ok;
+    }
+
+    //批量计算n条消息的MAC，第i条写到macs + 32 * i；
+    //内层从ipad状态、外层从opad状态各用一次多路SM3，lanes含义同SM3MultiBuffer::hash_many
+    void compute_many(const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t* macs,
+        unsigned lanes = 0) const {
+        size_t total = 0;
+        for (size_t i = 0; i < n; i++) {
+            total += lens[i];
+        }
+        CRYPTO_TELEMETRY_SCOPE(tm, "hmac_sm3.compute_many", total, n);
+        if (n == 0) {
+            return;
+        }
+        std::vector<uint8_t> digests(32 * n);
+        SM3MultiBuffer::hash_many_from(inner.digest, BLOCK_SIZE, msgs, lens, n, digests.data(), lanes);
+        std::vector<const uint8_t*> ptrs(n);
+        std::vector<size_t> dlens(n, 32);
+        for (size_t i = 0; i < n; i++) {
+            ptrs[i] = digests.data() + 32 * i;
+        }
+        SM3MultiBuffer::hash_many_from(outer.digest, BLOCK_SIZE, ptrs.data(), dlens.data(), n, macs, lanes);
+    }
+
+    //流式接口：init → update若干次 → final，final之后自动回到init状态
+    void init() {
+        ctx.restore_state(inner);
+    }
+
+    void update(const uint8_t* data, size_t len) {
+        ctx.update(data, len);
+    }
+
+    void final(uint8_t mac[32]) {
+        uint8_t d[32];
+        ctx.final(d);
+        finish(d, mac);
+        init();
+    }
+};
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include "SM3-KDF.h"
+
+using namespace std;
+using namespace chrono;
+
+static vector<uint8_t> from_hex(const string& s) {
+    vector<uint8_t> out(s.size() / 2);
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = (uint8_t)stoi(s.substr(2 * i, 2), nullptr, 16);
+    }
+    return out;
+}
+
+//逐个计数器对Z || ct做完整的SM3（project5中kdf的写法）
+static void kdf_naive(const uint8_t* z, size_t zlen, uint8_t* out, size_t klen) {
+    vector<uint8_t> msg(z, z + zlen);
+    msg.resize(zlen + 4);
+    for (uint32_t ct = 1; klen > 0; ct++) {
+        msg[zlen] = (uint8_t)(ct >> 24);
+        msg[zlen + 1] = (uint8_t)(ct >> 16);
+        msg[zlen + 2] = (uint8_t)(ct >> 8);
+        msg[zlen + 3] = (uint8_t)ct;
+        uint8_t d[32];
+        SM3::hash(msg.data(), msg.size(), d);
+        size_t n = klen < 32 ? klen : 32;
+        memcpy(out, d, n);
+        out += n;
+        klen -= n;
+    }
+}
+
+//已知答案测试（向量由独立实现计算）：Z恰好一个分组、短于一个分组、跨分组且有尾部
+bool test_vectors() {
+    struct Vec {
+        size_t zlen;
+        string z;   //为空时Z为0, 1, 2, ...
+        size_t klen;
+        string out;
+    };
+    const Vec vecs[] = {
+        { 64, "", 70, "c3e5cfe48b9da30523c65df3b189227188a89ac9057b739bb779f028e4afe606e9df98cf02023b778579bdf48e700230"
+            "6ba21850d002971e209d2e785d3518c9113608e38a6d" },
+        { 3, "abc", 19, "fe1ea80dac6f100c33537bd24619ec7c72a1e8" },
+        { 130, "", 100, "12d71b4afbb5de8bb5b905ac3d32a70f822b2f68b7c17b47ac3c7ed43d469c98c49ae1831621939a74acf6cf165de2"
+            "eba19aa422e440eac65552d82803d7e715af807e2f14e56de71037734df527bcb84ab47f9dca1e8be4dfa281a2b411632d9f27fa38" },
+    };
+    bool ok = true;
+    for (const Vec& v : vecs) {
+        vector<uint8_t> z(v.zlen);
+        for (size_t i = 0; i < v.zlen; i++) {
+            z[i] = v.z.empty() ? (uint8_t)i : (uint8_t)v.z[i];
+        }
+        vector<uint8_t> out(v.klen);
+        ok = ok && Sm3Kdf::kdf(z.data(), z.size(), out.data(), out.size()) && out == from_hex(v.out);
+    }
+    cout << "SM3-KDF已知答案: " << (ok ? "通过" : "失败") << endl;
+    return ok;
+}
+
+//各种Z长度与输出长度下与逐个计数器计算一致，多线程切分的结果与单线程一致
+bool test_consistency() {
+    bool ok = true;
+    for (size_t zlen : { 0, 1, 59, 60, 63, 64, 65, 128, 200 }) {
+        vector<uint8_t> z(zlen);
+        for (size_t i = 0; i < zlen; i++) {
+            z[i] = (uint8_t)(i * 11 + zlen);
+        }
+        Sm3Kdf kdf(z.data(), z.size());
+        for (size_t klen : { 0, 1, 31, 32, 33, 1000, 4096, 100000 }) {
+            vector<uint8_t> want(klen), got(klen);
+            kdf_naive(z.data(), z.size(), want.data(), klen);
+            ok = ok && kdf.derive(got.data(), klen, 1) && got == want;
+        }
+    }
+    //长输出：线程池按计数器区间切分
+    const size_t BIG = 3 * ThreadPool::CHUNK_BYTES + 17;
+    uint8_t z[64] = { 7 };
+    vector<uint8_t> want(BIG), got(BIG);
+    kdf_naive(z, sizeof(z), want.data(), BIG);
+    Sm3Kdf kdf(z, sizeof(z));
+    ThreadPool pool(4);
+    for (unsigned threads : { 0u, 2u, 3u, 8u }) {
+        fill(got.begin(), got.end(), 0);
+        ok = ok && kdf.derive(got.data(), BIG, pool, threads) && got == want;
+    }
+    cout << "与逐个计数器计算一致（含多线程）: " << (ok ? "是" : "否") << endl;
+    return ok;
+}
+
+//SM2加密的密钥流：Z = x2 || y2（64字节），派生16MB
+void test_speed() {
+    const size_t KLEN = 16 << 20;
+    uint8_t z[64];
+    for (int i = 0; i < 64; i++) {
+        z[i] = (uint8_t)(i * 3 + 1);
+    }
+    vector<uint8_t> out(KLEN);
+
+    auto start = high_resolution_clock::now();
+    kdf_naive(z, sizeof(z), out.data(), KLEN);
+    double t_naive = duration<double, milli>(high_resolution_clock::now() - start).count();
+
+    Sm3Kdf kdf(z, sizeof(z));
+    start = high_resolution_clock::now();
+    kdf.derive(out.data(), KLEN, 1);
+    double t_mb = duration<double, milli>(high_resolution_clock::now() - start).count();
+
+    start = high_resolution_clock::now();
+    kdf.derive(out.data(), KLEN);
+    double t_par = duration<double, milli>(high_resolution_clock::now() - start).count();
+
+    cout << "派生16MB：逐个计数器 " << t_naive << " ms，缓存Z状态+多路SM3（" << SM3MultiBuffer::best_lanes()
+        << "路） " << t_mb << " ms，再加线程池（" << ThreadPool::global().size() << " 线程） " << t_par << " ms"
+        << endl;
+}
+
+int main() {
+    bool ok = test_vectors();
+    ok = test_consistency() && ok;
+    test_speed();
+    return ok ? 0 : 1;
+}
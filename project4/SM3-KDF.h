@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "../common/telemetry.h"
+#include "../common/thread_pool.h"
+#include "SM3-multibuffer.h"
+#ifndef SM3_NO_MAIN
+#define SM3_NO_MAIN
+#endif
+#include "SM3-optimized.h"
+
+//SM2密钥派生函数（GB/T 32918.4 5.4.3）：K = Hash(Z || ct_1) || Hash(Z || ct_2) || ...，
+//ct为从1开始的32位大端计数器，截取前klen字节。
+//
+//   各计数器分组互不依赖：Z中完整的分组在构造时压缩一次并保存中间状态，
+//   Z不足一个分组的尾部与计数器拼成每条消息（至多67字节），一批消息交给多路SM3（hash_many_from），
+//   各通道从缓存的链接值开始；SM2加密中Z = x2 || y2正好一个分组，每个计数器分组只需一次压缩；
+//   输出超过ThreadPool::CHUNK_BYTES时按计数器区间切分，在线程池上并行派生。
+//
+//构造后对象只读，derive可以被多个线程同时调用。Z的尾部与派生过程中的临时消息在用完后清零，析构时清零缓存的状态。
+class Sm3Kdf {
+public:
+    //计数器为32位，最多派生(2^32 - 1)个分组
+    static const uint64_t MAX_BLOCKS = 0xFFFFFFFFull;
+
+private:
+    SM3::State prefix;   //压缩Z中完整分组之后的状态，buffer中为Z的尾部
+    static const size_t BATCH = 64;   //每次交给多路SM3的消息数
+
+    //不会被编译器优化掉的清零
+    static void secure_zero(void* p, size_t n) {
+        volatile uint8_t* v = (volatile uint8_t*)p;
+        while (n--) {
+            *v++ = 0;
+        }
+    }
+
+    //派生第[lo, hi)个分组（计数器lo + 1 ~ hi），第i个分组写到out + 32 * (i - lo)
+    void derive_blocks(uint64_t lo, uint64_t hi, uint8_t* out) const {
+        size_t tail = prefix.buffered;
+        size_t stride = tail + 4;
+        //只准备（与清零）本次用到的消息槽，短输出不必处理整批
+        size_t slots = hi - lo < BATCH ? (size_t)(hi - lo) : BATCH;
+        uint8_t msgs[BATCH * 68];
+        const uint8_t* ptrs[BATCH];
+        size_t lens[BATCH];
+        for (size_t i = 0; i < slots; i++) {
+            memcpy(msgs + stride * i, prefix.buffer, tail);
+            ptrs[i] = msgs + stride * i;
+            lens[i] = stride;
+        }
+        uint64_t prefix_bytes = prefix.total_bits / 8;
+        while (lo < hi) {
+            size_t n = hi - lo < BATCH ? (size_t)(hi - lo) : BATCH;
+            for (size_t i = 0; i < n; i++) {
+                uint32_t ct = (uint32_t)(lo + i + 1);
+                uint8_t* c = msgs + stride * i + tail;
+                c[0] = (uint8_t)(ct >> 24);
+                c[1] = (uint8_t)(ct >> 16);
+                c[2] = (uint8_t)(ct >> 8);
+                c[3] = (uint8_t)ct;
+            }
+            SM3MultiBuffer::hash_many_from(prefix.digest, prefix_bytes, ptrs, lens, n, out);
+            out += 32 * n;
+            lo += n;
+        }
+        //消息中含Z的尾部
+        secure_zero(msgs, stride * slots);
+    }
+
+public:
+    //z为共享信息（SM2中为x2 || y2，或密钥交换中的拼接值）
+    Sm3Kdf(const uint8_t* z, size_t zlen) {
+        SM3 h;
+        h.update(z, zlen);
+        prefix = h.export_state();
+        secure_zero(&h, sizeof(h));
+    }
+
+    ~Sm3Kdf() {
+        secure_zero(&prefix, sizeof(prefix));
+    }
+
+    //派生klen字节写到out；klen超过(2^32 - 1) * 32时返回false
+    //输出较长时在进程共享的线程池上执行，threads非0时最多切分为threads个任务
+    bool derive(uint8_t* out, size_t klen, unsigned threads = 0) const {
+        return derive(out, klen, ThreadPool::global(), threads);
+    }
+
+    bool derive(uint8_t* out, size_t klen, ThreadPool& pool, unsigned threads = 0) const {
+        uint64_t nblocks = ((uint64_t)klen + 31) / 32;
+        if (nblocks > MAX_BLOCKS) {
+            return false;
+        }
+        CRYPTO_TELEMETRY_SCOPE(tm, "sm3.kdf", klen, nblocks);
+        uint64_t full = klen / 32;
+        //完整的分组直接写到out，按CHUNK_BYTES切分为任务
+        size_t grain = ThreadPool::CHUNK_BYTES / 32;
+        if (threads != 0 && (full + threads - 1) / threads > grain) {
+            grain = (size_t)((full + threads - 1) / threads);
+        }
+        if (threads == 1 || full <= grain) {
+            derive_blocks(0, full, out);
+        }
+        else {
+            pool.parallel_for(0, (size_t)full, grain, [&](size_t lo, size_t hi) {
+                derive_blocks(lo, hi, out + 32 * lo);
+            });
+        }
+        //最后不足32字节的部分
+        if (klen % 32 != 0) {
+            uint8_t last[32];
+            derive_blocks(full, full + 1, last);
+            memcpy(out + 32 * full, last, klen % 32);
+            secure_zero(last, sizeof(last));
+        }
+        return true;
+    }
+
+    //一次性接口：kdf(Z, klen)
+    static bool kdf(const uint8_t* z, size_t zlen, uint8_t* out, size_t klen, unsigned threads = 0) {
+        return Sm3Kdf(z, zlen).derive(out, klen, threads);
+    }
+};
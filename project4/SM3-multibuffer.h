@@ -0,0 +1,357 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+//多路SM3：同时计算多条相互独立的消息，每条消息占向量的一个通道（lane）。
+//
+//单条消息的64轮压缩是一条串行依赖链，消息内部没有可供SIMD利用的并行度；
+//但Merkle叶子、去重指纹等场景有大量互不相关的短消息，把它们放进不同通道后，
+//一条向量指令同时推进4/8/16条消息的同一轮：
+//
+//   SSE 4路、AVX2 8路、AVX-512 16路，运行时按CPU选择（GCC/Clang向量扩展，每种宽度一个target函数）；
+//   每个通道独立填充（0x80、零、消息比特长度），消息长度不同时各通道的分组数不同，
+//   某个通道的消息结束后立即换入下一条消息，没有消息可换的通道在剩余步骤中空转，其结果被丢弃；
+//   每一步先把各通道当前分组转置为“第i个字 × 通道”的布局，再做向量化的消息扩展与64轮压缩；
+//   消息很少时自动换用较窄的内核，避免大部分通道空转。
+//
+//不支持GCC向量扩展的编译器只有逐条计算的标量内核。
+//轮函数用宏展开：向量类型不经过函数参数与返回值，不同target之间没有调用约定问题。
+//V为uint32_t或向量类型，向量与标量的运算按通道广播。
+#define SM3_MB_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define SM3_MB_P0(x) ((x) ^ SM3_MB_ROTL(x, 9) ^ SM3_MB_ROTL(x, 17))
+#define SM3_MB_P1(x) ((x) ^ SM3_MB_ROTL(x, 15) ^ SM3_MB_ROTL(x, 23))
+class SM3MultiBuffer {
+private:
+    static uint32_t load_be32(const uint8_t* p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+    static void store_be32(uint8_t* p, uint32_t v) {
+        p[0] = (uint8_t)(v >> 24);
+        p[1] = (uint8_t)(v >> 16);
+        p[2] = (uint8_t)(v >> 8);
+        p[3] = (uint8_t)v;
+    }
+
+    //Tj <<< (j mod 32)
+    static uint32_t tj(int j) {
+        uint32_t t = j < 16 ? 0x79CC4519u : 0x7A879D8Au;
+        int n = j % 32;
+        return n == 0 ? t : (t << n) | (t >> (32 - n));
+    }
+
+    //一个通道：正在计算的消息、已处理的分组数，以及含填充的尾部分组
+    struct Lane {
+        bool active;
+        size_t msg;
+        const uint8_t* data;
+        size_t full;       //消息中完整的64字节分组数
+        size_t blocks;     //含尾部的总分组数
+        size_t next;       //下一个要压缩的分组
+        uint8_t tail[128];
+    };
+
+    //prefix为起始状态之前已压缩的字节数（从IV开始时为0），计入填充中的消息长度
+    static void start_lane(Lane& lane, size_t msg, const uint8_t* data, size_t len, uint64_t prefix) {
+        lane.active = true;
+        lane.msg = msg;
+        lane.data = data;
+        lane.full = len / 64;
+        size_t rest = len % 64;
+        size_t tail_blocks = rest < 56 ? 1 : 2;
+        lane.blocks = lane.full + tail_blocks;
+        lane.next = 0;
+        memset(lane.tail, 0, sizeof(lane.tail));
+        if (rest) {
+            memcpy(lane.tail, data + 64 * lane.full, rest);
+        }
+        lane.tail[rest] = 0x80;
+        uint64_t bits = ((uint64_t)len + prefix) * 8;
+        uint8_t* end = lane.tail + 64 * tail_blocks;
+        store_be32(end - 8, (uint32_t)(bits >> 32));
+        store_be32(end - 4, (uint32_t)bits);
+    }
+
+    //64字节消息的第二个分组只含填充（0x80、零、长度512），各条消息相同，扩展结果只算一次
+    struct PairPadding {
+        uint32_t W[68];
+        PairPadding() {
+            memset(W, 0, sizeof(W));
+            W[0] = 0x80000000u;
+            W[15] = 512;
+            for (int j = 16; j < 68; j++) {
+                uint32_t x = W[j - 16] ^ W[j - 9] ^ SM3_MB_ROTL(W[j - 3], 15);
+                W[j] = SM3_MB_P1(x) ^ SM3_MB_ROTL(W[j - 13], 7) ^ W[j - 6];
+            }
+        }
+    };
+    static const uint32_t* pair_padding() {
+        static const PairPadding pad;
+        return pad.W;
+    }
+
+    //对L个通道各压缩一个分组：state[k][l]为通道l的第k个状态字，words[i][l]为通道l当前分组的第i个字
+    template <class V, int L>
+    static inline void compress_lanes(uint32_t (*state)[L], const uint32_t (*words)[L]) {
+        V W[68];
+        for (int i = 0; i < 16; i++) {
+            memcpy(&W[i], words[i], sizeof(V));
+        }
+        for (int j = 16; j < 68; j++) {
+            V x = W[j - 16] ^ W[j - 9] ^ SM3_MB_ROTL(W[j - 3], 15);
+            W[j] = SM3_MB_P1(x) ^ SM3_MB_ROTL(W[j - 13], 7) ^ W[j - 6];
+        }
+        rounds_lanes<V, L>(state, W);
+    }
+
+    //用已扩展好的消息W对L个通道做64轮迭代并反馈
+    template <class V, int L>
+    static inline void rounds_lanes(uint32_t (*state)[L], const V* W) {
+        V S[8];
+        for (int k = 0; k < 8; k++) {
+            memcpy(&S[k], state[k], sizeof(V));
+        }
+        V A = S[0], B = S[1], C = S[2], D = S[3], E = S[4], F = S[5], G = S[6], H = S[7];
+        for (int j = 0; j < 64; j++) {
+            V a12 = SM3_MB_ROTL(A, 12);
+            V t = a12 + E + tj(j);
+            V SS1 = SM3_MB_ROTL(t, 7);
+            V SS2 = SS1 ^ a12;
+            V TT1, TT2;
+            if (j < 16) {
+                TT1 = (A ^ B ^ C) + D + SS2 + (W[j] ^ W[j + 4]);
+                TT2 = (E ^ F ^ G) + H + SS1 + W[j];
+            }
+            else {
+                TT1 = ((A & B) | (A & C) | (B & C)) + D + SS2 + (W[j] ^ W[j + 4]);
+                TT2 = ((E & F) | (~E & G)) + H + SS1 + W[j];
+            }
+            D = C;
+            C = SM3_MB_ROTL(B, 9);
+            B = A;
+            A = TT1;
+            H = G;
+            G = SM3_MB_ROTL(F, 19);
+            F = E;
+            E = SM3_MB_P0(TT2);
+        }
+        S[0] ^= A;
+        S[1] ^= B;
+        S[2] ^= C;
+        S[3] ^= D;
+        S[4] ^= E;
+        S[5] ^= F;
+        S[6] ^= G;
+        S[7] ^= H;
+        for (int k = 0; k < 8; k++) {
+            memcpy(state[k], &S[k], sizeof(V));
+        }
+    }
+
+    static const uint32_t* sm3_iv() {
+        static const uint32_t IV[8] = {
+            0x7380166F, 0x4914B2B9, 0x172442D7, 0xDA8A0600,
+            0xA96F30BC, 0x163138AA, 0xE38DEE4D, 0xB0FB0E4E
+        };
+        return IV;
+    }
+
+    //各通道从链接值iv开始（iv之前已压缩prefix字节），每条消息结束后换入下一条
+    template <class V, int L>
+    static inline void run(const uint32_t* iv, uint64_t prefix, const uint8_t* const* msgs, const size_t* lens,
+        size_t n, uint8_t* out) {
+        static const uint8_t idle[64] = { 0 };
+        Lane lanes[L];
+        alignas(64) uint32_t state[8][L];
+        alignas(64) uint32_t words[16][L];
+        size_t next_msg = 0;
+        int active = 0;
+        auto refill = [&](int l) {
+            if (next_msg < n) {
+                start_lane(lanes[l], next_msg, msgs[next_msg], lens[next_msg], prefix);
+                next_msg++;
+                active++;
+                for (int k = 0; k < 8; k++) {
+                    state[k][l] = iv[k];
+                }
+            }
+            else {
+                lanes[l].active = false;
+            }
+        };
+        for (int l = 0; l < L; l++) {
+            refill(l);
+        }
+        while (active > 0) {
+            for (int l = 0; l < L; l++) {
+                const Lane& lane = lanes[l];
+                const uint8_t* p = idle;
+                if (lane.active) {
+                    p = lane.next < lane.full ? lane.data + 64 * lane.next : lane.tail + 64 * (lane.next - lane.full);
+                }
+                for (int i = 0; i < 16; i++) {
+                    words[i][l] = load_be32(p + 4 * i);
+                }
+            }
+            compress_lanes<V, L>(state, words);
+            for (int l = 0; l < L; l++) {
+                Lane& lane = lanes[l];
+                if (!lane.active || ++lane.next < lane.blocks) {
+                    continue;
+                }
+                for (int k = 0; k < 8; k++) {
+                    store_be32(out + 32 * lane.msg + 4 * k, state[k][l]);
+                }
+                active--;
+                refill(l);
+            }
+        }
+    }
+
+    //n个连续存放的64字节消息：每组L条，第一个分组转置后压缩，第二个分组用广播的固定消息
+    template <class V, int L>
+    static inline void run_pairs(const uint8_t* nodes, size_t n, uint8_t* out) {
+        const uint32_t* IV = sm3_iv();
+        static const uint8_t idle[64] = { 0 };
+        const uint32_t* pad = pair_padding();
+        alignas(64) uint32_t state[8][L];
+        alignas(64) uint32_t words[16][L];
+        for (size_t base = 0; base < n; base += L) {
+            size_t count = n - base < (size_t)L ? n - base : (size_t)L;
+            for (int l = 0; l < L; l++) {
+                const uint8_t* p = (size_t)l < count ? nodes + 64 * (base + l) : idle;
+                for (int i = 0; i < 16; i++) {
+                    words[i][l] = load_be32(p + 4 * i);
+                }
+                for (int k = 0; k < 8; k++) {
+                    state[k][l] = IV[k];
+                }
+            }
+            compress_lanes<V, L>(state, words);
+            V W[68];
+            for (int j = 0; j < 68; j++) {
+                W[j] = V() + pad[j];
+            }
+            rounds_lanes<V, L>(state, W);
+            for (size_t l = 0; l < count; l++) {
+                for (int k = 0; k < 8; k++) {
+                    store_be32(out + 32 * (base + l) + 4 * k, state[k][l]);
+                }
+            }
+        }
+    }
+
+    //lanes为0时按CPU与消息数自动选择，否则取不超过lanes的本机可用宽度
+    static unsigned pick_lanes(size_t n, unsigned lanes) {
+        unsigned best = best_lanes();
+        if (lanes == 0) {
+            lanes = best;
+            //消息数不到通道数的一半时大部分通道空转，换用较窄的内核
+            while (lanes > 1 && n * 2 <= lanes) {
+                lanes /= 2;
+            }
+        }
+        return lanes > best ? best : lanes;
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    typedef uint32_t V4 __attribute__((vector_size(16)));
+    //flatten把模板内核整个内联进带target的函数，向量运算按该函数的指令集生成
+    __attribute__((flatten)) static void run4(const uint32_t* iv, uint64_t prefix, const uint8_t* const* msgs,
+        const size_t* lens, size_t n, uint8_t* out) {
+        run<V4, 4>(iv, prefix, msgs, lens, n, out);
+    }
+    __attribute__((flatten)) static void pairs4(const uint8_t* nodes, size_t n, uint8_t* out) {
+        run_pairs<V4, 4>(nodes, n, out);
+    }
+#if defined(__x86_64__)
+#define SM3_MB_X86
+    typedef uint32_t V8 __attribute__((vector_size(32)));
+    typedef uint32_t V16 __attribute__((vector_size(64)));
+    __attribute__((target("avx2"), flatten)) static void run8(const uint32_t* iv, uint64_t prefix,
+        const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t* out) {
+        run<V8, 8>(iv, prefix, msgs, lens, n, out);
+    }
+    __attribute__((target("avx512f"), flatten)) static void run16(const uint32_t* iv, uint64_t prefix,
+        const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t* out) {
+        run<V16, 16>(iv, prefix, msgs, lens, n, out);
+    }
+    __attribute__((target("avx2"), flatten)) static void pairs8(const uint8_t* nodes, size_t n, uint8_t* out) {
+        run_pairs<V8, 8>(nodes, n, out);
+    }
+    __attribute__((target("avx512f"), flatten)) static void pairs16(const uint8_t* nodes, size_t n, uint8_t* out) {
+        run_pairs<V16, 16>(nodes, n, out);
+    }
+#endif
+#define SM3_MB_VECTOR
+#endif
+
+public:
+    //本机可用的最大通道数：16（AVX-512）、8（AVX2）、4（SSE/NEON）或1
+    static unsigned best_lanes() {
+#ifdef SM3_MB_X86
+        static const unsigned best = __builtin_cpu_supports("avx512f") ? 16 : __builtin_cpu_supports("avx2") ? 8 : 4;
+        return best;
+#elif defined(SM3_MB_VECTOR)
+        return 4;
+#else
+        return 1;
+#endif
+    }
+
+    //计算n条消息的SM3摘要，第i条的结果写到out + 32 * i
+    //lanes为0时按CPU与消息数自动选择，否则使用不超过lanes的内核（用于对比与测试各内核）
+    static void hash_many(const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t* out,
+        unsigned lanes = 0) {
+        hash_many_from(sm3_iv(), 0, msgs, lens, n, out, lanes);
+    }
+
+    //从共同的中间状态继续计算n条消息：iv为处理完共同前缀后的链接值，prefix为前缀的字节数（64的倍数），
+    //第i条的结果是SM3(前缀 || msgs[i])。用于HMAC的ipad/opad、KDF的Z等共享前缀
+    static void hash_many_from(const uint32_t iv[8], uint64_t prefix, const uint8_t* const* msgs, const size_t* lens,
+        size_t n, uint8_t* out, unsigned lanes = 0) {
+        lanes = pick_lanes(n, lanes);
+#ifdef SM3_MB_X86
+        if (lanes >= 16) {
+            run16(iv, prefix, msgs, lens, n, out);
+            return;
+        }
+        if (lanes >= 8) {
+            run8(iv, prefix, msgs, lens, n, out);
+            return;
+        }
+#endif
+#ifdef SM3_MB_VECTOR
+        if (lanes >= 4) {
+            run4(iv, prefix, msgs, lens, n, out);
+            return;
+        }
+#endif
+        run<uint32_t, 1>(iv, prefix, msgs, lens, n, out);
+    }
+
+    //计算n个64字节消息的SM3摘要，第i条消息为nodes + 64 * i（如Merkle树节点的left || right）
+    static void hash_pairs(const uint8_t* nodes, size_t n, uint8_t* out, unsigned lanes = 0) {
+        lanes = pick_lanes(n, lanes);
+#ifdef SM3_MB_X86
+        if (lanes >= 16) {
+            pairs16(nodes, n, out);
+            return;
+        }
+        if (lanes >= 8) {
+            pairs8(nodes, n, out);
+            return;
+        }
+#endif
+#ifdef SM3_MB_VECTOR
+        if (lanes >= 4) {
+            pairs4(nodes, n, out);
+            return;
+        }
+#endif
+        run_pairs<uint32_t, 1>(nodes, n, out);
+    }
+};
+#undef SM3_MB_ROTL
+#undef SM3_MB_P0
+#undef SM3_MB_P1
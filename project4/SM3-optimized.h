@@ -1,7 +1,12 @@
+#pragma once
 #include <iostream>
 #include <cstring>
 #include <vector>
 #include <cstdint>
+#include "../common/perf_counters.h"
+#include "../common/telemetry.h"
+#include "../common/usdt.h"
+#include "SM3-multibuffer.h"
 
 //架构检测
 #if defined(__x86_64__) || defined(_M_X64)
@@ -9,10 +14,26 @@
 #elif defined(__aarch64__) || defined(_M_ARM64)
 #define ARM64_ARCH
 #endif
+#ifdef X86_64_ARCH
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+//GCC/Clang：补充MSVC内建函数，SIMD字节序转换需要SSSE3
+#include <x86intrin.h>
+#define _byteswap_uint64 __builtin_bswap64
+#pragma GCC push_options
+#pragma GCC target("ssse3")
+#endif
+#elif defined(ARM64_ARCH)
+#include <arm_neon.h>
+#endif
 
 class SM3 {
 private:
-    static const uint32_t IV[8];  //初始向量IV
+    static constexpr uint32_t IV[8] = {  //初始向量IV
+        0x7380166F, 0x4914B2B9, 0x172442D7, 0xDA8A0600,
+        0xA96F30BC, 0x163138AA, 0xE38DEE4D, 0xB0FB0E4E
+    };
     uint8_t message_block[64];    //消息分组缓冲区
     uint64_t message_length;      //当前缓冲区中的字节数
     uint64_t total_bits;          //消息总长度
@@ -25,9 +46,11 @@ private:
         return _rotl(x, n);
 #elif defined(ARM64_ARCH)
         //ARM64桶形移位器可直接在运算中包含移位操作
-        return (x << n) | (x >> (32 - n));
+        n &= 31;
+        return (x << n) | (x >> ((32 - n) & 31));
 #else
-        return (x << n) | (x >> (32 - n));
+        n &= 31;
+        return (x << n) | (x >> ((32 - n) & 31));
 #endif
     }
     //置换函数P0 
@@ -52,55 +75,17 @@ private:
         return x ^ rotate_left(x, 15) ^ rotate_left(x, 23);
 #endif
     }
-    //布尔函数FF
-    static inline uint32_t FF(uint32_t x, uint32_t y, uint32_t z, int j) {
-#ifdef X86_64_ARCH
-        //X86_64: 利用条件移动指令减少分支
-        if (j <= 15) {
-            return x ^ y ^ z;
-        }
-        else {
-            return (x & y) | (x & z) | (y & z);
-        }
-#elif defined(ARM64_ARCH)
-        //ARM64: 利用条件选择指令减少分支
-        return (j <= 15) ? (x ^ y ^ z) : ((x & y) | (x & z) | (y & z));
-#endif
-    }
-    //布尔函数GG
-    static inline uint32_t GG(uint32_t x, uint32_t y, uint32_t z, int j) {
-#ifdef X86_64_ARCH
-        if (j <= 15) {
-            return x ^ y ^ z;
-        }
-        else {
-            return (x & y) | (~x & z);
-        }
-#elif defined(ARM64_ARCH)
-        return (j <= 15) ? (x ^ y ^ z) : ((x & y) | (~x & z));
-#endif
-    }
-    //常量Tj-优化存储访问
-    static inline uint32_t T(int j) {
-        // 直接返回而不使用数组访问，减少内存操作
-        return (j <= 15) ? 0x79CC4519 : 0x7A879D8A;
+    //Tj <<< (j mod 32)，编译期常量
+    static constexpr uint32_t rotl_const(uint32_t x, int n) {
+        return n == 0 ? x : (x << n) | (x >> (32 - n));
     }
-    //消息扩展函数
-    void expand(const uint8_t block[64], uint32_t W[68], uint32_t W1[64]) {
-#ifdef X86_64_ARCH
-        //X86_64使用SIMD指令加速消息扩展
-        __m128i vec0, vec1, vec2, vec3;
-        //加载16个32位字到4个128位寄存器
-        vec0 = _mm_loadu_si128((const __m128i*) & block[0]);
-        vec1 = _mm_loadu_si128((const __m128i*) & block[16]);
-        vec2 = _mm_loadu_si128((const __m128i*) & block[32]);
-        vec3 = _mm_loadu_si128((const __m128i*) & block[48]);
-        //字节序转换并存储到W[0-15]
-        _mm_storeu_si128((__m128i*) & W[0], _mm_shuffle_epi8(vec0, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)));
-        _mm_storeu_si128((__m128i*) & W[4], _mm_shuffle_epi8(vec1, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)));
-        _mm_storeu_si128((__m128i*) & W[8], _mm_shuffle_epi8(vec2, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)));
-        _mm_storeu_si128((__m128i*) & W[12], _mm_shuffle_epi8(vec3, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)));
-#elif defined(ARM64_ARCH)
+    template <int J>
+    struct Tj {
+        static constexpr uint32_t value = rotl_const(J < 16 ? 0x79CC4519u : 0x7A879D8Au, J % 32);
+    };
+    //读入分组的16个字（大端）
+    static inline void load_block(const uint8_t block[64], uint32_t W[16]) {
+#if defined(ARM64_ARCH)
         //ARM64
         uint8x16_t vec0, vec1, vec2, vec3;
         uint32x4_t w;
@@ -120,147 +105,245 @@ private:
 #else
         //通用实现
         for (int i = 0; i < 16; i++) {
-            W[i] = (block[4 * i] << 24) | (block[4 * i + 1] << 16) |
+            W[i] = ((uint32_t)block[4 * i] << 24) | (block[4 * i + 1] << 16) |
                 (block[4 * i + 2] << 8) | block[4 * i + 3];
         }
 #endif
-        //扩展W16-W67
-        for (int j = 16; j < 68; j++) {
-            W[j] = P1(W[j - 16] ^ W[j - 9] ^ rotate_left(W[j - 3], 15)) ^
-                rotate_left(W[j - 13], 7) ^ W[j - 6];
+    }
+    //第J轮，w、w1为W[J]与W'[J]。
+    //本轮只更新B、D、F、H：B、F就地循环移位成为下一轮的C、G，TT1、P0(TT2)写入D、H成为下一轮的A、E，
+    //下一轮以(D,A,B,C,H,E,F,G)的顺序传入，A~H的角色靠改名轮换，没有寄存器间的搬移。
+    template <int J>
+    static inline void step(uint32_t A, uint32_t& B, uint32_t C, uint32_t& D, uint32_t E, uint32_t& F, uint32_t G,
+        uint32_t& H, uint32_t w, uint32_t w1) {
+        uint32_t A12 = rotate_left(A, 12);
+        uint32_t SS1 = rotate_left(A12 + E + Tj<J>::value, 7);
+        uint32_t SS2 = SS1 ^ A12;
+        uint32_t TT1, TT2;
+        if (J < 16) {
+            TT1 = (A ^ B ^ C) + D + SS2 + w1;
+            TT2 = (E ^ F ^ G) + H + SS1 + w;
         }
-        //计算W'0-W'63
-#ifdef X86_64_ARCH
-        //X86_64: 使用SIMD并行计算W'
-        for (int j = 0; j < 64; j += 4) {
-            __m128i w = _mm_loadu_si128((const __m128i*) & W[j]);
-            __m128i w4 = _mm_loadu_si128((const __m128i*) & W[j + 4]);
-            __m128i xor_res = _mm_xor_si128(w, w4);
-            _mm_storeu_si128((__m128i*) & W1[j], xor_res);
+        else {
+            TT1 = ((A & B) | (A & C) | (B & C)) + D + SS2 + w1;
+            TT2 = ((E & F) | (~E & G)) + H + SS1 + w;
         }
-#elif defined(ARM64_ARCH)
-        //ARM64: NEON并行计算
-        for (int j = 0; j < 64; j += 4) {
-            uint32x4_t w = vld1q_u32(&W[j]);
-            uint32x4_t w4 = vld1q_u32(&W[j + 4]);
-            uint32x4_t xor_res = veorq_u32(w, w4);
-            vst1q_u32(&W1[j], xor_res);
+        B = rotate_left(B, 9);
+        D = TT1;
+        F = rotate_left(F, 19);
+        H = P0(TT2);
+    }
+#ifdef X86_64_ARCH
+    //SSE消息扩展：W[j-3]是最近的依赖，一个向量中W[k]~W[k+2]可以同时计算，
+    //第4个字需要的rotl(W[k],15)在初算时以0代替，利用P1对异或的线性再补上P1(rotl(W[k],15))。
+    //X0~X3依次为W[k-16..k-1]，返回W[k..k+3]。
+    static inline __m128i rotl_epi32(__m128i x, int n) {
+        return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n));
+    }
+    static inline __m128i expand4(__m128i X0, __m128i X1, __m128i X2, __m128i X3) {
+        __m128i w9 = _mm_alignr_epi8(X2, X1, 12);   //W[k-9..k-6]
+        __m128i w13 = _mm_alignr_epi8(X1, X0, 12);  //W[k-13..k-10]
+        __m128i w6 = _mm_alignr_epi8(X3, X2, 8);    //W[k-6..k-3]
+        __m128i w3 = _mm_srli_si128(X3, 4);         //W[k-3..k-1], 0
+        __m128i t = _mm_xor_si128(_mm_xor_si128(X0, w9), rotl_epi32(w3, 15));
+        t = _mm_xor_si128(t, _mm_xor_si128(rotl_epi32(t, 15), rotl_epi32(t, 23)));
+        __m128i r = _mm_xor_si128(t, _mm_xor_si128(rotl_epi32(w13, 7), w6));
+        //第4个字的修正：r中只有最高的字非零
+        __m128i u = rotl_epi32(_mm_slli_si128(r, 12), 15);
+        u = _mm_xor_si128(u, _mm_xor_si128(rotl_epi32(u, 15), rotl_epi32(u, 23)));
+        return _mm_xor_si128(r, u);
+    }
+    //每组4轮：X0~X3为W[J..J+15]，本组用X0与X0^X1；下一组的窗口需要W[J+16..J+19]，
+    //在本组开头生成并写回X0（与轮函数没有依赖，由乱序执行与4轮的串行链重叠），下一组以(X1,X2,X3,X0)传入。
+    template <int J, bool END = (J >= 64)>
+    struct Rounds {
+        static inline void run(uint32_t& A, uint32_t& B, uint32_t& C, uint32_t& D, uint32_t& E, uint32_t& F,
+            uint32_t& G, uint32_t& H, __m128i& X0, __m128i& X1, __m128i& X2, __m128i& X3) {
+            alignas(16) uint32_t w[4], w1[4];
+            _mm_store_si128((__m128i*)w, X0);
+            _mm_store_si128((__m128i*)w1, _mm_xor_si128(X0, X1));
+            if (J + 16 < 68) {
+                X0 = expand4(X0, X1, X2, X3);
+            }
+            step<J>(A, B, C, D, E, F, G, H, w[0], w1[0]);
+            step<J + 1>(D, A, B, C, H, E, F, G, w[1], w1[1]);
+            step<J + 2>(C, D, A, B, G, H, E, F, w[2], w1[2]);
+            step<J + 3>(B, C, D, A, F, G, H, E, w[3], w1[3]);
+            Rounds<J + 4>::run(A, B, C, D, E, F, G, H, X1, X2, X3, X0);
         }
+    };
+    template <int J>
+    struct Rounds<J, true> {
+        static inline void run(uint32_t&, uint32_t&, uint32_t&, uint32_t&, uint32_t&, uint32_t&, uint32_t&,
+            uint32_t&, __m128i&, __m128i&, __m128i&, __m128i&) {}
+    };
 #else
-        //通用实现
-        for (int j = 0; j < 64; j++) {
-            W1[j] = W[j] ^ W[j + 4];
+    //标量消息扩展：W为16个字的滚动窗口，第J轮用到W[J]与W[J+4]，W[J+4]（J≥12）在本轮覆盖W[J-12]的位置生成
+    template <int J>
+    static inline void round(uint32_t& A, uint32_t& B, uint32_t& C, uint32_t& D, uint32_t& E, uint32_t& F,
+        uint32_t& G, uint32_t& H, uint32_t W[16]) {
+        if (J >= 12) {
+            W[(J + 4) & 15] = P1(W[(J + 4) & 15] ^ W[(J + 11) & 15] ^ rotate_left(W[(J + 1) & 15], 15)) ^
+                rotate_left(W[(J + 7) & 15], 7) ^ W[(J + 14) & 15];
         }
-#endif
+        step<J>(A, B, C, D, E, F, G, H, W[J & 15], W[J & 15] ^ W[(J + 4) & 15]);
     }
-    //压缩函数
-    void compress(const uint8_t block[64]) {
-        uint32_t W[68], W1[64];
-        expand(block, W, W1);
-        //初始化工作变量，尽可能使用寄存器
-        register uint32_t A = digest[0];
-        register uint32_t B = digest[1];
-        register uint32_t C = digest[2];
-        register uint32_t D = digest[3];
-        register uint32_t E = digest[4];
-        register uint32_t F = digest[5];
-        register uint32_t G = digest[6];
-        register uint32_t H = digest[7];
-#ifdef X86_64_ARCH
-        //X86_64: 展开部分循环，减少循环开销
-        //第0-15轮
-        for (int j = 0; j < 16; j++) {
-            uint32_t Tj = 0x79CC4519;
-            uint32_t SS1 = rotate_left(rotate_left(A, 12) + E + rotate_left(Tj, j), 7);
-            uint32_t SS2 = SS1 ^ rotate_left(A, 12);
-            uint32_t TT1 = (A ^ B ^ C) + D + SS2 + W1[j];
-            uint32_t TT2 = (E ^ F ^ G) + H + SS1 + W[j];
-            D = C;
-            C = rotate_left(B, 9);
-            B = A;
-            A = TT1;
-            H = G;
-            G = rotate_left(F, 19);
-            F = E;
-            E = P0(TT2);
+    //每4轮角色回到原位，递归展开全部64轮
+    template <int J, bool END = (J >= 64)>
+    struct Rounds {
+        static inline void run(uint32_t& A, uint32_t& B, uint32_t& C, uint32_t& D, uint32_t& E, uint32_t& F,
+            uint32_t& G, uint32_t& H, uint32_t W[16]) {
+            round<J>(A, B, C, D, E, F, G, H, W);
+            round<J + 1>(D, A, B, C, H, E, F, G, W);
+            round<J + 2>(C, D, A, B, G, H, E, F, W);
+            round<J + 3>(B, C, D, A, F, G, H, E, W);
+            Rounds<J + 4>::run(A, B, C, D, E, F, G, H, W);
         }
-        //第16-63轮
-        for (int j = 16; j < 64; j++) {
-            uint32_t Tj = 0x7A879D8A;
-            uint32_t SS1 = rotate_left(rotate_left(A, 12) + E + rotate_left(Tj, j), 7);
-            uint32_t SS2 = SS1 ^ rotate_left(A, 12);
-            uint32_t TT1 = ((A & B) | (A & C) | (B & C)) + D + SS2 + W1[j];
-            uint32_t TT2 = ((E & F) | (~E & G)) + H + SS1 + W[j];
-            D = C;
-            C = rotate_left(B, 9);
-            B = A;
-            A = TT1;
-            H = G;
-            G = rotate_left(F, 19);
-            F = E;
-            E = P0(TT2);
+    };
+    template <int J>
+    struct Rounds<J, true> {
+        static inline void run(uint32_t&, uint32_t&, uint32_t&, uint32_t&, uint32_t&, uint32_t&, uint32_t&,
+            uint32_t&, uint32_t*) {}
+    };
+#endif
+    //压缩nblocks个连续分组：A~H与链接值V在整个循环中保持在局部变量中，只在结束时写回state。
+    //消息扩展在轮函数中按需生成（X86_64用SSE每次生成4个字），64轮在编译期完全展开
+    static void compress_blocks(uint32_t state[8], const uint8_t* data, size_t nblocks) {
+        CRYPTO_PERF_SCOPE("sm3opt.compress");
+#ifdef X86_64_ARCH
+        const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+#endif
+        uint32_t V0 = state[0], V1 = state[1], V2 = state[2], V3 = state[3];
+        uint32_t V4 = state[4], V5 = state[5], V6 = state[6], V7 = state[7];
+        for (; nblocks > 0; nblocks--, data += 64) {
+            uint32_t A = V0, B = V1, C = V2, D = V3, E = V4, F = V5, G = V6, H = V7;
+#ifdef X86_64_ARCH
+            //加载16个字到4个128位寄存器并转换字节序
+            __m128i X0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) & data[0]), bswap);
+            __m128i X1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) & data[16]), bswap);
+            __m128i X2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) & data[32]), bswap);
+            __m128i X3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) & data[48]), bswap);
+            Rounds<0>::run(A, B, C, D, E, F, G, H, X0, X1, X2, X3);
+#else
+            uint32_t W[16];
+            load_block(data, W);
+            Rounds<0>::run(A, B, C, D, E, F, G, H, W);
+#endif
+            //与链接值异或
+            V0 ^= A;
+            V1 ^= B;
+            V2 ^= C;
+            V3 ^= D;
+            V4 ^= E;
+            V5 ^= F;
+            V6 ^= G;
+            V7 ^= H;
         }
-#elif defined(ARM64_ARCH)
-        //ARM64: 利用32个通用寄存器的优势，减少内存访问
-        //使用LEA-like操作组合加法和移位
-        for (int j = 0; j < 64; j++) {
-            uint32_t Tj = (j <= 15) ? 0x79CC4519 : 0x7A879D8A;
-            uint32_t rotA12 = rotate_left(A, 12);
-            uint32_t rotTj = rotate_left(Tj, j);
-            uint32_t SS1 = rotate_left(rotA12 + E + rotTj, 7);
-            uint32_t SS2 = SS1 ^ rotA12;
-            uint32_t TT1, TT2;
-            if (j <= 15) {
-                TT1 = (A ^ B ^ C) + D + SS2 + W1[j];
-                TT2 = (E ^ F ^ G) + H + SS1 + W[j];
+        state[0] = V0;
+        state[1] = V1;
+        state[2] = V2;
+        state[3] = V3;
+        state[4] = V4;
+        state[5] = V5;
+        state[6] = V6;
+        state[7] = V7;
+    }
+    //压缩一个分组
+    void compress(const uint8_t block[64]) {
+        compress_blocks(digest, block, 1);
+    }
+    //只含填充的分组（0x80或全零，其后是消息比特长度）与消息内容无关，按长度预先扩展一次
+    struct Schedule {
+        uint32_t W[68];
+        uint32_t W1[64];
+        Schedule(uint64_t bits, bool marker) {
+            memset(W, 0, sizeof(W));
+            W[0] = marker ? 0x80000000u : 0;
+            W[14] = (uint32_t)(bits >> 32);
+            W[15] = (uint32_t)bits;
+            for (int j = 16; j < 68; j++) {
+                W[j] = P1(W[j - 16] ^ W[j - 9] ^ rotate_left(W[j - 3], 15)) ^ rotate_left(W[j - 13], 7) ^ W[j - 6];
             }
-            else {
-                TT1 = ((A & B) | (A & C) | (B & C)) + D + SS2 + W1[j];
-                TT2 = ((E & F) | (~E & G)) + H + SS1 + W[j];
+            for (int j = 0; j < 64; j++) {
+                W1[j] = W[j] ^ W[j + 4];
             }
-            //寄存器轮转优化
-            D = C;
-            C = rotate_left(B, 9);
-            B = A;
-            A = TT1;
-            H = G;
-            G = rotate_left(F, 19);
-            F = E;
-            E = P0(TT2);
         }
-#else
-        //通用实现
-        for (int j = 0; j < 64; j++) {
-            uint32_t SS1 = rotate_left(rotate_left(A, 12) + E + rotate_left(T(j), j), 7);
-            uint32_t SS2 = SS1 ^ rotate_left(A, 12);
-            uint32_t TT1 = FF(A, B, C, j) + D + SS2 + W1[j];
-            uint32_t TT2 = GG(E, F, G, j) + H + SS1 + W[j];
-            D = C;
-            C = rotate_left(B, 9);
-            B = A;
-            A = TT1;
-            H = G;
-            G = rotate_left(F, 19);
-            F = E;
-            E = P0(TT2);
+    };
+    //用预先扩展好的消息做64轮，同样在编译期完全展开
+    template <int J, bool END = (J >= 64)>
+    struct ScheduledRounds {
+        static inline void run(uint32_t& A, uint32_t& B, uint32_t& C, uint32_t& D, uint32_t& E, uint32_t& F,
+            uint32_t& G, uint32_t& H, const Schedule& s) {
+            step<J>(A, B, C, D, E, F, G, H, s.W[J], s.W1[J]);
+            step<J + 1>(D, A, B, C, H, E, F, G, s.W[J + 1], s.W1[J + 1]);
+            step<J + 2>(C, D, A, B, G, H, E, F, s.W[J + 2], s.W1[J + 2]);
+            step<J + 3>(B, C, D, A, F, G, H, E, s.W[J + 3], s.W1[J + 3]);
+            ScheduledRounds<J + 4>::run(A, B, C, D, E, F, G, H, s);
+        }
+    };
+    template <int J>
+    struct ScheduledRounds<J, true> {
+        static inline void run(uint32_t&, uint32_t&, uint32_t&, uint32_t&, uint32_t&, uint32_t&, uint32_t&,
+            uint32_t&, const Schedule&) {}
+    };
+    static void compress_scheduled(uint32_t state[8], const Schedule& s) {
+        uint32_t A = state[0], B = state[1], C = state[2], D = state[3];
+        uint32_t E = state[4], F = state[5], G = state[6], H = state[7];
+        ScheduledRounds<0>::run(A, B, C, D, E, F, G, H, s);
+        state[0] ^= A;
+        state[1] ^= B;
+        state[2] ^= C;
+        state[3] ^= D;
+        state[4] ^= E;
+        state[5] ^= F;
+        state[6] ^= G;
+        state[7] ^= H;
+    }
+    static void store_digest(const uint32_t V[8], uint8_t* result) {
+        for (int i = 0; i < 8; i++) {
+            result[4 * i] = (uint8_t)(V[i] >> 24);
+            result[4 * i + 1] = (uint8_t)(V[i] >> 16);
+            result[4 * i + 2] = (uint8_t)(V[i] >> 8);
+            result[4 * i + 3] = (uint8_t)V[i];
         }
-#endif
-        //与初始值异或
-        digest[0] ^= A;
-        digest[1] ^= B;
-        digest[2] ^= C;
-        digest[3] ^= D;
-        digest[4] ^= E;
-        digest[5] ^= F;
-        digest[6] ^= G;
-        digest[7] ^= H;
     }
 
 public:
+    //可保存的中间状态，字段及export_state/valid_state/restore_state的约定与SM3.cpp相同
+    struct State {
+        uint32_t digest[8];       //链接值
+        uint64_t total_bits;      //已压缩的比特数（512的倍数）
+        uint8_t buffer[64];       //尚未压缩的字节
+        uint8_t buffered;         //buffer中的字节数（0~63）
+    };
     //构造函数
     SM3() {
         reset();
     }
+    //导出当前的中间状态
+    State export_state() const {
+        State s;
+        memcpy(s.digest, digest, sizeof(digest));
+        s.total_bits = total_bits;
+        memcpy(s.buffer, message_block, sizeof(message_block));
+        s.buffered = (uint8_t)message_length;
+        return s;
+    }
+    //检查状态
+    static bool valid_state(const State& s) {
+        return s.buffered < 64 && s.total_bits % 512 == 0;
+    }
+    //恢复中间状态，无效时返回false
+    bool restore_state(const State& s) {
+        if (!valid_state(s)) {
+            return false;
+        }
+        memcpy(digest, s.digest, sizeof(digest));
+        total_bits = s.total_bits;
+        message_length = s.buffered;
+        memcpy(message_block, s.buffer, sizeof(message_block));
+        return true;
+    }
     //重置上下文
     void reset() {
         message_length = 0;
@@ -269,69 +352,43 @@ public:
         memset(message_block, 0, sizeof(message_block));
     }
 
-    //更新哈希计算优化批量处理
+    //更新哈希计算：先补满缓冲区中已有的不完整分组，其余完整分组直接从输入连续压缩，只缓存末尾不足一个分组的部分
     void update(const uint8_t* data, size_t length) {
-#ifdef X86_64_ARCH
-        //X86_64: 利用大块处理优化
-        size_t block_aligned = length & ~(size_t)63; // 64字节对齐
-        size_t remaining = length - block_aligned;
-        //处理对齐的完整块
-        for (size_t i = 0; i < block_aligned; i += 64) {
-            if (message_length == 0) {
-                compress(&data[i]);
-                total_bits += 512;
+        CRYPTO_TELEMETRY_SCOPE(tm, "sm3opt.update", length, (message_length + length) / 64);
+        CRYPTO_USDT2(sm3_update_entry, this, length);
+        size_t i = 0;
+        if (message_length > 0) {
+            size_t copy_len = 64 - message_length;
+            if (copy_len > length) {
+                copy_len = length;
             }
-            else {
-                //填充现有缓冲区
-                size_t copy_len = 64 - message_length;
-                memcpy(&message_block[message_length], &data[i], copy_len);
-                message_length += copy_len;
-                compress(message_block);
-                total_bits += 512;
-                message_length = 0;
-                i += copy_len - 64; //调整循环索引
+            memcpy(&message_block[message_length], data, copy_len);
+            message_length += copy_len;
+            i = copy_len;
+            if (message_length < 64) {
+                CRYPTO_USDT2(sm3_update_return, this, length);
+                return;
             }
+            compress(message_block);
+            total_bits += 512;
+            message_length = 0;
         }
-        //处理剩余数据
-        if (remaining > 0) {
-            memcpy(&message_block[message_length], &data[block_aligned], remaining);
-            message_length += remaining;
-        }
-#elif defined(ARM64_ARCH)
-        //ARM64:利用缓存特性优化
-        size_t chunk_size = 64 * 16; //16个块为一组，适应ARM缓存
-        size_t i = 0;
-        while (i < length) {
-            size_t process_len = (length - i) < chunk_size ? (length - i) : chunk_size;
-
-            while (process_len > 0) {
-                if (message_length == 64) {
-                    compress(message_block);
-                    total_bits += 512;
-                    message_length = 0;
-                }
-                size_t copy_len = (64 - message_length) < process_len ?
-                    (64 - message_length) : process_len;
-                memcpy(&message_block[message_length], &data[i], copy_len);
-                message_length += copy_len;
-                i += copy_len;
-                process_len -= copy_len;
-            }
+        size_t nblocks = (length - i) / 64;
+        if (nblocks > 0) {
+            compress_blocks(digest, data + i, nblocks);
+            total_bits += (uint64_t)nblocks * 512;
+            i += nblocks * 64;
         }
-#else
-        //通用实现
-        for (size_t i = 0; i < length; i++) {
-            message_block[message_length++] = data[i];
-            if (message_length == 64) {
-                compress(message_block);
-                total_bits += 512;
-                message_length = 0;
-            }
+        if (i < length) {
+            memcpy(message_block, data + i, length - i);
+            message_length = length - i;
         }
-#endif
+        CRYPTO_USDT2(sm3_update_return, this, length);
     }
     //完成哈希计算
     void final(uint8_t* result) {
+        CRYPTO_TELEMETRY_SCOPE(tm, "sm3opt.final", message_length, message_length < 56 ? 1 : 2);
+        CRYPTO_USDT2(sm3_final_entry, this, total_bits / 8 + message_length);
         total_bits += message_length * 8;
         message_block[message_length++] = 0x80;
 
@@ -385,6 +442,7 @@ public:
         }
 #endif
         reset();
+        CRYPTO_USDT1(sm3_final_return, this);
     }
     //计算SM3哈希值
     static void hash(const uint8_t* data, size_t length, uint8_t* result) {
@@ -392,14 +450,58 @@ public:
         sm3.update(data, length);
         sm3.final(result);
     }
+    //计算长度在编译期已知的N字节消息的哈希值：不经过update/final的缓冲，
+    //末尾分组的填充位置与长度在编译期确定，只含填充的分组使用预先扩展好的消息
+    template <size_t N>
+    static void hash_fixed(const uint8_t* data, uint8_t* result) {
+        const size_t FULL = N / 64;
+        const size_t REST = N % 64;
+        const uint64_t BITS = (uint64_t)N * 8;
+        uint32_t V[8];
+        memcpy(V, IV, sizeof(V));
+        if (FULL > 0) {
+            compress_blocks(V, data, FULL);
+        }
+        if (REST == 0) {
+            static const Schedule pad(BITS, true);
+            compress_scheduled(V, pad);
+        }
+        else {
+            uint8_t block[64] = { 0 };
+            memcpy(block, data + FULL * 64, REST);
+            block[REST] = 0x80;
+            if (REST < 56) {
+                for (int i = 0; i < 8; i++) {
+                    block[56 + i] = (uint8_t)(BITS >> (8 * (7 - i)));
+                }
+                compress_blocks(V, block, 1);
+            }
+            else {
+                compress_blocks(V, block, 1);
+                static const Schedule pad(BITS, false);
+                compress_scheduled(V, pad);
+            }
+        }
+        store_digest(V, result);
+    }
+    //Merkle树内部节点：SM3(left || right)，两个32字节哈希正好是一个分组，第二个分组是固定的填充
+    static void hash_pair(const uint8_t* left, const uint8_t* right, uint8_t* result) {
+        uint8_t block[64];
+        memcpy(block, left, 32);
+        memcpy(block + 32, right, 32);
+        hash_fixed<64>(block, result);
+    }
+    //多路计算n条相互独立消息的哈希值，第i条写到results + 32 * i（见SM3-multibuffer.h）
+    static void hash_many(const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t* results) {
+        SM3MultiBuffer::hash_many(msgs, lens, n, results);
+    }
+    //多路计算n个64字节消息（连续存放在nodes中）的哈希值，如Merkle树同一层的各对子节点
+    static void hash_pairs(const uint8_t* nodes, size_t n, uint8_t* results) {
+        SM3MultiBuffer::hash_pairs(nodes, n, results);
+    }
 };
-//初始化IV值
-const uint32_t SM3::IV[8] = {
-    0x7380166F, 0x4914B2B9, 0x172442D7, 0xDA8A0600,
-    0xA96F30BC, 0x163138AA, 0xE38DEE4D, 0xB0FB0E4E
-};
-//辅助函数：将字节数组转换为十六进制字符串
-std::string bytes_to_hex(const uint8_t* bytes, size_t length) {
+//辅助函数：将字节数组转换为十六进制字符串（inline：头文件可被多个源文件包含）
+inline std::string bytes_to_hex(const uint8_t* bytes, size_t length) {
     const char* hex_chars = "0123456789ABCDEF";
     std::string hex_str;
     hex_str.reserve(length * 2);
@@ -429,6 +531,8 @@ std::string bytes_to_hex(const uint8_t* bytes, size_t length) {
 #endif
     return hex_str;
 }
+//作为库被其他程序包含时（如基准测试）定义SM3_NO_MAIN以去掉演示用的测试函数与main
+#ifndef SM3_NO_MAIN
 //测试函数
 void test_sm3() {
     //测试案例1：空字符串
@@ -437,7 +541,7 @@ void test_sm3() {
         SM3::hash(nullptr, 0, result);
         std::string hex = bytes_to_hex(result, 32);
         std::cout << "空字符串哈希: " << hex << std::endl;
-        std::cout << "预期结果: 1AB21D8355CFA17F8E61194831E81A8F79C2B6773A0FF8E534DFB6406B7EDEE" << std::endl << std::endl;
+        std::cout << "预期结果: 1AB21D8355CFA17F8E61194831E81A8F22BEC8C728FEFB747ED035EB5082AA2B" << std::endl << std::endl;
     }
     //测试案例2："abc"
     {
@@ -449,9 +553,32 @@ void test_sm3() {
         std::cout << "预期结果: 66C7F0F462EEEDD9D1F2D46BDC10E4E24167C4875CF2F7A2297DA02B8F4BA8E0" << std::endl << std::endl;
     }
 }
+//多路哈希与逐条哈希结果一致
+void test_hash_many() {
+    const char* msgs[] = { "", "abc", "这是一个用于测试SM3多路计算的字符串，长度超过一个分组，最后一个分组需要单独填充。",
+        "0123456789012345678901234567890123456789012345678901234" };
+    const size_t n = sizeof(msgs) / sizeof(msgs[0]);
+    const uint8_t* ptrs[n];
+    size_t lens[n];
+    for (size_t i = 0; i < n; i++) {
+        ptrs[i] = (const uint8_t*)msgs[i];
+        lens[i] = strlen(msgs[i]);
+    }
+    uint8_t results[32 * n];
+    SM3::hash_many(ptrs, lens, n, results);
+    bool ok = true;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t expect[32];
+        SM3::hash(ptrs[i], lens[i], expect);
+        ok = ok && memcmp(expect, results + 32 * i, 32) == 0;
+    }
+    std::cout << "多路哈希（最多" << SM3MultiBuffer::best_lanes() << "路）与逐条哈希一致: " << (ok ? "是" : "否")
+        << std::endl << std::endl;
+}
 
 int main() {
     test_sm3();
+    test_hash_many();
     //演示分块处理
     std::cout << "演示分块处理:" << std::endl;
     const char* long_data = "这是一个用于测试SM3算法分块处理的长字符串，将分多次调用update方法来处理它。";
@@ -468,3 +595,7 @@ int main() {
     return 0;
 }
 
+#endif
+#if defined(X86_64_ARCH) && !defined(_MSC_VER)
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,360 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../common/telemetry.h"
+#include "../common/thread_pool.h"
+#include "SM3-multibuffer.h"
+#ifndef SM3_NO_MAIN
+#define SM3_NO_MAIN
+#endif
+#include "SM3-optimized.h"
+
+//批量计算大量文件的SM3（POSIX），供去重扫描一类"数百万个几KB的小文件"的负载使用。
+//
+//   逐个文件open、read、SM3::hash时，每个文件的固定开销（系统调用、两次以上的压缩、函数调用）远大于数据量；
+//   collect：并行遍历目录树，每个子目录一个parallel_for任务（嵌套），由工作窃取在线程间平衡，
+//   各目录的条目按名字排序，结果顺序确定（先本目录的文件，再依次是各子目录）；
+//   hash：文件列表按区间交给线程池，每个任务把不超过SMALL_FILE的文件读入本任务的缓冲区，
+//   攒够一批后交给一次多路SM3（hash_many）；更大的文件边读边update，整分组直接走compress_blocks；
+//   某个任务遇到大文件时，列表的其余区间被其他线程窃取，不会排在大文件之后。
+//
+//只处理普通文件（含指向普通文件的符号链接）；不跟随指向目录的符号链接，避免循环。
+class Sm3Sum {
+public:
+    static const size_t SMALL_FILE = 64 * 1024;   //不超过该大小的文件走多路SM3
+    static const size_t BATCH_BYTES = 1 << 20;    //每批小文件的缓冲区大小
+    static const size_t STREAM_BYTES = 1 << 20;   //大文件每次读取的大小
+
+    struct Entry {
+        std::string path;
+        uint8_t digest[32];
+        int error;          //0为成功，否则为errno
+    };
+
+    struct Stats {
+        uint64_t files;
+        uint64_t bytes;
+        uint64_t small_files;   //走多路SM3的文件数
+        uint64_t errors;
+    };
+
+private:
+    unsigned threads;
+    ThreadPool* pool;   //为空时使用进程共享的线程池
+
+    ThreadPool& workers() const {
+        return pool ? *pool : ThreadPool::global();
+    }
+
+    static std::string join(const std::string& dir, const std::string& name) {
+        return !dir.empty() && dir.back() == '/' ? dir + name : dir + "/" + name;
+    }
+
+    static Entry failed(const std::string& path, int err) {
+        Entry e;
+        e.path = path;
+        memset(e.digest, 0, sizeof(e.digest));
+        e.error = err;
+        return e;
+    }
+
+    //列出dir下的普通文件与子目录（各自按名字排序），子目录并行递归，结果按顺序追加到out
+    void walk(const std::string& dir, std::vector<Entry>& out) const {
+        DIR* d = opendir(dir.c_str());
+        if (d == nullptr) {
+            out.push_back(failed(dir, errno));
+            return;
+        }
+        std::vector<std::string> files, dirs;
+        while (dirent* de = readdir(d)) {
+            const char* name = de->d_name;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+                continue;
+            }
+            unsigned char type = de->d_type;
+            if (type == DT_UNKNOWN) {
+                //类型未知时按lstat（不跟随链接）判断，指向目录的符号链接不会被当作目录
+                struct stat st;
+                if (fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG
+                    : S_ISLNK(st.st_mode) ? DT_LNK : DT_UNKNOWN;
+            }
+            if (type == DT_LNK) {
+                //符号链接只跟随一次，判断是否指向普通文件；指向目录或其他类型的不计入
+                struct stat st;
+                if (fstatat(dirfd(d), name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+                    continue;
+                }
+                type = DT_REG;
+            }
+            if (type == DT_REG) {
+                files.push_back(name);
+            }
+            else if (type == DT_DIR) {
+                dirs.push_back(name);
+            }
+        }
+        closedir(d);
+        std::sort(files.begin(), files.end());
+        std::sort(dirs.begin(), dirs.end());
+        for (const std::string& f : files) {
+            Entry e;
+            e.path = join(dir, f);
+            e.error = 0;
+            out.push_back(std::move(e));
+        }
+        if (dirs.empty()) {
+            return;
+        }
+        std::vector<std::vector<Entry>> sub(dirs.size());
+        workers().parallel_for(0, dirs.size(), 1, [&](size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; i++) {
+                walk(join(dir, dirs[i]), sub[i]);
+            }
+        });
+        for (auto& s : sub) {
+            std::move(s.begin(), s.end(), std::back_inserter(out));
+        }
+    }
+
+    //读满len字节或到文件末尾，返回读到的字节数，失败返回-1
+    static ssize_t read_full(int fd, uint8_t* p, size_t len) {
+        size_t got = 0;
+        while (got < len) {
+            ssize_t r = read(fd, p + got, len - got);
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            if (r < 0) {
+                return -1;
+            }
+            if (r == 0) {
+                break;
+            }
+            got += (size_t)r;
+        }
+        return (ssize_t)got;
+    }
+
+    //小文件批次：文件内容连续存放在buf中；每个线程一份（thread_local），各任务结束时清空
+    struct Batch {
+        std::vector<uint8_t> buf;
+        std::vector<uint8_t> stream;   //大文件的读缓冲区，第一次遇到大文件时分配
+        size_t used;
+        std::vector<const uint8_t*> msgs;
+        std::vector<size_t> lens;
+        std::vector<Entry*> owners;
+        std::vector<uint8_t> digests;
+
+        Batch() : buf(BATCH_BYTES), used(0) {}
+
+        void flush() {
+            size_t n = owners.size();
+            if (n == 0) {
+                return;
+            }
+            digests.resize(32 * n);
+            SM3MultiBuffer::hash_many(msgs.data(), lens.data(), n, digests.data());
+            for (size_t i = 0; i < n; i++) {
+                memcpy(owners[i]->digest, &digests[32 * i], 32);
+            }
+            msgs.clear();
+            lens.clear();
+            owners.clear();
+            used = 0;
+        }
+    };
+
+    //计算一个文件：先读入批次缓冲区，不超过SMALL_FILE时留在批次中，否则改为流式计算
+    static void hash_one(Entry& e, Batch& batch, Stats& st) {
+        int fd = e.path == "-" ? STDIN_FILENO : open(e.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            e.error = errno;
+            st.errors++;
+            return;
+        }
+        if (BATCH_BYTES - batch.used < SMALL_FILE + 1) {
+            batch.flush();
+        }
+        //多读1字节以区分"恰好SMALL_FILE字节"与更大的文件
+        uint8_t* p = batch.buf.data() + batch.used;
+        ssize_t n = read_full(fd, p, SMALL_FILE + 1);
+        if (n >= 0 && (size_t)n <= SMALL_FILE) {
+            batch.msgs.push_back(p);
+            batch.lens.push_back((size_t)n);
+            batch.owners.push_back(&e);
+            batch.used += (size_t)n;
+            st.small_files++;
+            st.bytes += (uint64_t)n;
+        }
+        else if (n > 0) {
+            std::vector<uint8_t>& stream = batch.stream;
+            stream.resize(STREAM_BYTES);
+            SM3 h;
+            h.update(p, (size_t)n);
+            uint64_t total = (uint64_t)n;
+            for (;;) {
+                n = read_full(fd, stream.data(), stream.size());
+                if (n <= 0) {
+                    break;
+                }
+                h.update(stream.data(), (size_t)n);
+                total += (uint64_t)n;
+            }
+            if (n == 0) {
+                h.final(e.digest);
+                st.bytes += total;
+            }
+        }
+        if (n < 0) {
+            e.error = errno;
+            st.errors++;
+        }
+        st.files++;
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+    }
+
+public:
+    //threads非0时最多切分为threads个任务，1为单线程（仍批量使用多路SM3）
+    explicit Sm3Sum(unsigned max_threads = 0, ThreadPool* p = nullptr) : threads(max_threads), pool(p) {}
+
+    //展开输入：普通文件（与"-"）原样保留，目录并行递归展开；无法访问的路径以error非0的条目保留
+    std::vector<Entry> collect(const std::vector<std::string>& roots) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "sm3sum.collect", 0, roots.size());
+        std::vector<Entry> out;
+        for (const std::string& r : roots) {
+            struct stat st;
+            if (r != "-" && stat(r.c_str(), &st) != 0) {
+                out.push_back(failed(r, errno));
+            }
+            else if (r != "-" && S_ISDIR(st.st_mode)) {
+                walk(r, out);
+            }
+            else {
+                Entry e;
+                e.path = r;
+                e.error = 0;
+                out.push_back(std::move(e));
+            }
+        }
+        return out;
+    }
+
+    //计算各条目（error为0者）的摘要；返回统计
+    Stats hash(std::vector<Entry>& entries) const {
+        CRYPTO_TELEMETRY_SCOPE(tm, "sm3sum.hash", 0, entries.size());
+        std::vector<size_t> todo;
+        Stats total = { 0, 0, 0, 0 };
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (entries[i].error == 0) {
+                todo.push_back(i);
+            }
+            else {
+                total.errors++;
+            }
+        }
+        //每段至少64个文件，让一批小文件能填满各通道
+        size_t grain = 64;
+        if (threads != 0 && (todo.size() + threads - 1) / threads > grain) {
+            grain = (todo.size() + threads - 1) / threads;
+        }
+        std::mutex lock;
+        auto body = [&](size_t lo, size_t hi) {
+            static thread_local Batch batch;
+            Stats st = { 0, 0, 0, 0 };
+            for (size_t i = lo; i < hi; i++) {
+                hash_one(entries[todo[i]], batch, st);
+            }
+            batch.flush();
+            std::lock_guard<std::mutex> g(lock);
+            total.files += st.files;
+            total.bytes += st.bytes;
+            total.small_files += st.small_files;
+            total.errors += st.errors;
+        };
+        if (threads == 1 || todo.size() <= grain) {
+            body(0, todo.size());
+        }
+        else {
+            workers().parallel_for(0, todo.size(), grain, body);
+        }
+        return total;
+    }
+
+    //sha256sum格式的一行（不含换行）：文件名含反斜杠或换行时整行以反斜杠开头，并转义这些字符
+    static std::string format_line(const Entry& e) {
+        static const char* digits = "0123456789abcdef";
+        bool escape = e.path.find_first_of("\\\n\r") != std::string::npos;
+        std::string s;
+        if (escape) {
+            s += '\\';
+        }
+        for (int i = 0; i < 32; i++) {
+            s += digits[e.digest[i] >> 4];
+            s += digits[e.digest[i] & 15];
+        }
+        s += "  ";
+        for (char c : e.path) {
+            if (escape && c == '\\') s += "\\\\";
+            else if (escape && c == '\n') s += "\\n";
+            else if (escape && c == '\r') s += "\\r";
+            else s += c;
+        }
+        return s;
+    }
+
+    //解析format_line的输出（也接受sha256sum的" *"二进制标记）；格式不对返回false
+    static bool parse_line(const std::string& line, uint8_t digest[32], std::string& path) {
+        size_t pos = 0;
+        bool escape = !line.empty() && line[0] == '\\';
+        if (escape) {
+            pos = 1;
+        }
+        if (line.size() < pos + 66) {
+            return false;
+        }
+        for (int i = 0; i < 32; i++) {
+            int v = 0;
+            for (int k = 0; k < 2; k++) {
+                char c = line[pos + 2 * i + k];
+                int x = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                    : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+                if (x < 0) {
+                    return false;
+                }
+                v = v * 16 + x;
+            }
+            digest[i] = (uint8_t)v;
+        }
+        pos += 64;
+        if (line[pos] != ' ' || (line[pos + 1] != ' ' && line[pos + 1] != '*')) {
+            return false;
+        }
+        pos += 2;
+        path.clear();
+        for (; pos < line.size(); pos++) {
+            char c = line[pos];
+            if (escape && c == '\\' && pos + 1 < line.size()) {
+                char n = line[++pos];
+                c = n == 'n' ? '\n' : n == 'r' ? '\r' : n;
+            }
+            path += c;
+        }
+        return !path.empty();
+    }
+};
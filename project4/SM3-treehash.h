@@ -0,0 +1,144 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "../common/telemetry.h"
+#include "../common/thread_pool.h"
+#include "SM3-multibuffer.h"
+#include "sm3_merkletree.h"
+
+//SM3树哈希模式（SM3-TREE）：结果不等于整个文件的SM3，只能与同一模式、同一分块大小的结果比较。
+//
+//   输入按固定大小chunk切分（最后一块可以较短，空输入视为一个空块），各块的SM3互不依赖：
+//   每best_lanes()块交给一次多路SM3（块长相同，各通道同时结束），各组在线程池上并行；
+//   块摘要作为叶子交给sm3_merkletree.h的Merkle树（不足2的幂时用SM3("")补齐），
+//   最终结果 = SM3(根 || 输入总长度 || chunk)，两者均为64位大端，
+//   绑定长度与分块大小，避免不同切分方式或"把内部节点当作数据"得到相同的结果。
+//
+//   单线程SM3受限于一个核心，树哈希的吞吐随核数与SIMD通道数增长，适合大文件的完整性扫描。
+class Sm3TreeHash {
+public:
+    static const size_t DEFAULT_CHUNK = 1 << 20;
+    //块大小上限：不足一块的输入缓存在buffer中，块大小决定其内存占用
+    static const size_t MAX_CHUNK = (size_t)1 << 30;
+
+private:
+    size_t chunk;
+    unsigned threads;
+    ThreadPool* pool;                //为空时使用进程共享的线程池
+    std::vector<uint8_t> digests;    //已完成各块的摘要，每块32字节
+    std::vector<uint8_t> buffer;     //不足一块的输入
+    size_t buffered;
+    uint64_t total;
+
+    ThreadPool& workers() const {
+        return pool ? *pool : ThreadPool::global();
+    }
+
+    //n个连续的整块，摘要写到out + 32 * i；每组best_lanes()块走一次多路SM3，各组并行
+    void hash_chunks(const uint8_t* data, size_t n, uint8_t* out) const {
+        size_t lanes = SM3MultiBuffer::best_lanes();
+        size_t groups = (n + lanes - 1) / lanes;
+        size_t grain = threads > 1 ? (groups + threads - 1) / threads : 1;
+        auto body = [&](size_t lo, size_t hi) {
+            std::vector<const uint8_t*> msgs(lanes);
+            std::vector<size_t> lens(lanes, chunk);
+            for (size_t g = lo; g < hi; g++) {
+                size_t first = g * lanes;
+                size_t count = n - first < lanes ? n - first : lanes;
+                for (size_t i = 0; i < count; i++) {
+                    msgs[i] = data + (first + i) * chunk;
+                }
+                SM3MultiBuffer::hash_many(msgs.data(), lens.data(), count, out + 32 * first);
+            }
+        };
+        if (threads == 1 || groups <= 1) {
+            body(0, groups);
+        }
+        else {
+            workers().parallel_for(0, groups, grain, body);
+        }
+    }
+
+    void append_chunks(const uint8_t* data, size_t n) {
+        size_t old = digests.size();
+        digests.resize(old + 32 * n);
+        hash_chunks(data, n, digests.data() + old);
+    }
+
+public:
+    //threads非0时最多切分为threads个任务，1为单线程（仍使用多路SM3）
+    //chunk_size为0时取DEFAULT_CHUNK，超过MAX_CHUNK时取MAX_CHUNK（实际值见chunk_size()）
+    explicit Sm3TreeHash(size_t chunk_size = DEFAULT_CHUNK, unsigned max_threads = 0, ThreadPool* p = nullptr)
+        : chunk(chunk_size == 0 ? DEFAULT_CHUNK : chunk_size > MAX_CHUNK ? MAX_CHUNK : chunk_size),
+          threads(max_threads), pool(p), buffered(0), total(0) {}
+
+    size_t chunk_size() const {
+        return chunk;
+    }
+
+    void reset() {
+        digests.clear();
+        buffered = 0;
+        total = 0;
+    }
+
+    //输入可以任意切分；整块直接从输入计算，只缓存不足一块的部分。
+    //一次传入较大的区间（mmap的整个文件或多块的大缓冲区）才能让各线程与各通道同时工作
+    void update(const uint8_t* data, size_t len) {
+        CRYPTO_TELEMETRY_SCOPE(tm, "sm3tree.update", len, len / chunk);
+        total += len;
+        if (buffered > 0) {
+            size_t n = chunk - buffered < len ? chunk - buffered : len;
+            memcpy(buffer.data() + buffered, data, n);
+            buffered += n;
+            data += n;
+            len -= n;
+            if (buffered < chunk) {
+                return;
+            }
+            append_chunks(buffer.data(), 1);
+            buffered = 0;
+        }
+        size_t n = len / chunk;
+        if (n > 0) {
+            append_chunks(data, n);
+            data += n * chunk;
+            len -= n * chunk;
+        }
+        if (len > 0) {
+            buffer.resize(chunk);
+            memcpy(buffer.data(), data, len);
+            buffered = len;
+        }
+    }
+
+    //完成计算，之后回到初始状态
+    void final(uint8_t result[32]) {
+        CRYPTO_TELEMETRY_SCOPE(tm, "sm3tree.final", total, digests.size() / 32 + 1);
+        if (buffered > 0 || digests.empty()) {
+            uint8_t last[32];
+            SM3::hash(buffer.data(), buffered, last);
+            digests.insert(digests.end(), last, last + 32);
+        }
+        MerkleTree tree;
+        tree.initializeFromHashes(digests.data(), digests.size() / 32);
+        uint8_t tail[48];
+        tree.getRootHash(tail);
+        for (int i = 0; i < 8; i++) {
+            tail[32 + i] = (uint8_t)(total >> (56 - 8 * i));
+            tail[40 + i] = (uint8_t)((uint64_t)chunk >> (56 - 8 * i));
+        }
+        SM3::hash_fixed<48>(tail, result);
+        reset();
+    }
+
+    //一次性接口
+    static void hash(const uint8_t* data, size_t len, uint8_t result[32], size_t chunk_size = DEFAULT_CHUNK,
+        unsigned max_threads = 0) {
+        Sm3TreeHash t(chunk_size, max_threads);
+        t.update(data, len);
+        t.final(result);
+    }
+};
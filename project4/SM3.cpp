@@ -2,6 +2,10 @@
 #include <cstring>
 #include <vector>
 #include <cstdint>
+#include "../common/perf_counters.h"
+#include "../common/telemetry.h"
+#include "../common/usdt.h"
+#include "SM3-multibuffer.h"
 
 //SM3密码杂凑算法
 class SM3 {
@@ -14,7 +18,8 @@ private:
 
     //循环左移函数
     static uint32_t rotate_left(uint32_t x, uint32_t n) {
-        return (x << n) | (x >> (32 - n));
+        n &= 31;
+        return (x << n) | (x >> ((32 - n) & 31));
     }
     //压缩函数中的置换函数P0
     static uint32_t P0(uint32_t x) {
@@ -53,7 +58,7 @@ private:
     }
 
     //消息扩展函数，将512位消息块扩展为132个字
-    void expand(const uint8_t block[64], uint32_t W[68], uint32_t W1[64]) {
+    static void expand(const uint8_t block[64], uint32_t W[68], uint32_t W1[64]) {
         //将消息块转换为32位字(W0-W15)
         for (int i = 0; i < 16; i++) {
             W[i] = (block[4 * i] << 24) | (block[4 * i + 1] << 16) |
@@ -70,19 +75,29 @@ private:
         }
     }
 
-    //压缩函数，对一个512位消息块进行压缩
-    void compress(const uint8_t block[64]) {
-        uint32_t W[68], W1[64];
-        expand(block, W, W1);
+    //压缩nblocks个连续的512位消息块，链接值在循环中保持在局部变量中，结束时写回state
+    static void compress_blocks(uint32_t state[8], const uint8_t* data, size_t nblocks) {
+        CRYPTO_PERF_SCOPE("sm3.compress");
+        uint32_t V[8];
+        memcpy(V, state, sizeof(V));
+        for (; nblocks > 0; nblocks--, data += 64) {
+            uint32_t W[68], W1[64];
+            expand(data, W, W1);
+            rounds(V, W, W1);
+        }
+        memcpy(state, V, sizeof(V));
+    }
+    //用已扩展好的消息W、W1对链接值V做64轮迭代并反馈
+    static void rounds(uint32_t V[8], const uint32_t W[68], const uint32_t W1[64]) {
         //初始化工作变量
-        uint32_t A = digest[0];
-        uint32_t B = digest[1];
-        uint32_t C = digest[2];
-        uint32_t D = digest[3];
-        uint32_t E = digest[4];
-        uint32_t F = digest[5];
-        uint32_t G = digest[6];
-        uint32_t H = digest[7];
+        uint32_t A = V[0];
+        uint32_t B = V[1];
+        uint32_t C = V[2];
+        uint32_t D = V[3];
+        uint32_t E = V[4];
+        uint32_t F = V[5];
+        uint32_t G = V[6];
+        uint32_t H = V[7];
         //64轮迭代
         for (int j = 0; j < 64; j++) {
             uint32_t SS1 = rotate_left(
@@ -100,21 +115,84 @@ private:
             F = E;
             E = P0(TT2);
         }
-        //与初始值异或
-        digest[0] ^= A;
-        digest[1] ^= B;
-        digest[2] ^= C;
-        digest[3] ^= D;
-        digest[4] ^= E;
-        digest[5] ^= F;
-        digest[6] ^= G;
-        digest[7] ^= H;
+        //与链接值异或
+        V[0] ^= A;
+        V[1] ^= B;
+        V[2] ^= C;
+        V[3] ^= D;
+        V[4] ^= E;
+        V[5] ^= F;
+        V[6] ^= G;
+        V[7] ^= H;
+    }
+    //只含填充的分组（0x80或全零，其后是消息比特长度）与消息内容无关，按长度预先扩展一次
+    struct Schedule {
+        uint32_t W[68];
+        uint32_t W1[64];
+        Schedule(uint64_t bits, bool marker) {
+            uint8_t block[64] = { 0 };
+            if (marker) {
+                block[0] = 0x80;
+            }
+            for (int i = 0; i < 8; i++) {
+                block[56 + i] = (bits >> (8 * (7 - i))) & 0xFF;
+            }
+            expand(block, W, W1);
+        }
+    };
+    //将链接值按大端序输出
+    static void store_digest(const uint32_t V[8], uint8_t* result) {
+        for (int i = 0; i < 8; i++) {
+            result[4 * i] = (V[i] >> 24) & 0xFF;
+            result[4 * i + 1] = (V[i] >> 16) & 0xFF;
+            result[4 * i + 2] = (V[i] >> 8) & 0xFF;
+            result[4 * i + 3] = V[i] & 0xFF;
+        }
+    }
+    //压缩函数，对一个512位消息块进行压缩
+    void compress(const uint8_t block[64]) {
+        compress_blocks(digest, block, 1);
     }
 public:
+    //可保存的中间状态（Merkle-Damgard链接值）：已压缩部分的链接值与比特数，以及缓冲区中尚未压缩的字节。
+    //共享同一前缀的多条消息（盐值、SM2的ZA、HMAC的ipad/opad、域分隔标签）可以缓存前缀之后的状态，
+    //之后从该状态继续update，不必每次重新压缩前缀。结构体可直接按字节复制保存
+    struct State {
+        uint32_t digest[8];       //链接值
+        uint64_t total_bits;      //已压缩的比特数（512的倍数）
+        uint8_t buffer[64];       //尚未压缩的字节
+        uint8_t buffered;         //buffer中的字节数（0~63）
+    };
     //构造函数，初始化SM3上下文
     SM3() {
         reset();
     }
+    //导出当前的中间状态
+    State export_state() const {
+        State s;
+        memcpy(s.digest, digest, sizeof(digest));
+        s.total_bits = total_bits;
+        memcpy(s.buffer, message_block, sizeof(message_block));
+        s.buffered = (uint8_t)message_length;
+        return s;
+    }
+    //状态是否可能由export_state导出：buffered不超过63，已压缩的比特数是512的倍数
+    static bool valid_state(const State& s) {
+        return s.buffered < 64 && s.total_bits % 512 == 0;
+    }
+    //从中间状态恢复上下文，之后的update/final与导出时的上下文继续计算的结果相同；
+    //状态无效（被截断、篡改或手工构造有误）时返回false，上下文保持不变。
+    //本进程export_state导出的状态总是有效，从外部读入的状态须检查返回值
+    bool restore_state(const State& s) {
+        if (!valid_state(s)) {
+            return false;
+        }
+        memcpy(digest, s.digest, sizeof(digest));
+        total_bits = s.total_bits;
+        message_length = s.buffered;
+        memcpy(message_block, s.buffer, sizeof(message_block));
+        return true;
+    }
     //重置SM3上下文，准备新的哈希计算
     void reset() {
         //初始化消息长度和总位数
@@ -127,21 +205,45 @@ public:
     }
     //更新哈希计算，处理输入数据
     void update(const uint8_t* data, size_t length) {
-        //处理每个字节
-        for (size_t i = 0; i < length; i++) {
-            //将数据放入消息块
-            message_block[message_length++] = data[i];
-            //当消息块满时(512位)，进行压缩
-            if (message_length == 64) {
-                compress(message_block);
-                total_bits += 512;
-                message_length = 0;
+        CRYPTO_TELEMETRY_SCOPE(tm, "sm3.update", length, (message_length + length) / 64);
+        CRYPTO_USDT2(sm3_update_entry, this, length);
+        size_t i = 0;
+        //先补满消息块中已有的不完整分组
+        if (message_length > 0) {
+            size_t copy_len = 64 - message_length;
+            if (copy_len > length) {
+                copy_len = length;
             }
+            memcpy(&message_block[message_length], data, copy_len);
+            message_length += copy_len;
+            i = copy_len;
+            if (message_length < 64) {
+                CRYPTO_USDT2(sm3_update_return, this, length);
+                return;
+            }
+            compress(message_block);
+            total_bits += 512;
+            message_length = 0;
+        }
+        //其余完整分组直接从输入连续压缩，不经过消息块
+        size_t nblocks = (length - i) / 64;
+        if (nblocks > 0) {
+            compress_blocks(digest, data + i, nblocks);
+            total_bits += (uint64_t)nblocks * 512;
+            i += nblocks * 64;
+        }
+        //只缓存末尾不足一个分组的部分
+        if (i < length) {
+            memcpy(message_block, data + i, length - i);
+            message_length = length - i;
         }
+        CRYPTO_USDT2(sm3_update_return, this, length);
     }
 
     //完成哈希计算，获取最终结果
     void final(uint8_t* result) {
+        CRYPTO_TELEMETRY_SCOPE(tm, "sm3.final", message_length, message_length < 56 ? 1 : 2);
+        CRYPTO_USDT2(sm3_final_entry, this, total_bits / 8 + message_length);
         //计算总位数
         total_bits += message_length * 8;
         //填充消息
@@ -168,14 +270,10 @@ public:
         //压缩最后一个块
         compress(message_block);
         //将结果转换为字节数组
-        for (int i = 0; i < 8; i++) {
-            result[4 * i] = (digest[i] >> 24) & 0xFF;
-            result[4 * i + 1] = (digest[i] >> 16) & 0xFF;
-            result[4 * i + 2] = (digest[i] >> 8) & 0xFF;
-            result[4 * i + 3] = digest[i] & 0xFF;
-        }
+        store_digest(digest, result);
         //重置上下文
         reset();
+        CRYPTO_USDT1(sm3_final_return, this);
     }
     //计算数据的SM3哈希值
     static void hash(const uint8_t* data, size_t length, uint8_t* result) {
@@ -183,6 +281,54 @@ public:
         sm3.update(data, length);
         sm3.final(result);
     }
+    //计算长度在编译期已知的N字节消息的哈希值：不经过update/final的缓冲，
+    //末尾分组的填充位置与长度在编译期确定，只含填充的分组使用预先扩展好的消息
+    template <size_t N>
+    static void hash_fixed(const uint8_t* data, uint8_t* result) {
+        const size_t FULL = N / 64;
+        const size_t REST = N % 64;
+        uint32_t V[8];
+        memcpy(V, IV, sizeof(V));
+        if (FULL > 0) {
+            compress_blocks(V, data, FULL);
+        }
+        if (REST == 0) {
+            static const Schedule pad((uint64_t)N * 8, true);
+            rounds(V, pad.W, pad.W1);
+        }
+        else {
+            uint8_t block[64] = { 0 };
+            memcpy(block, data + FULL * 64, REST);
+            block[REST] = 0x80;
+            if (REST < 56) {
+                for (int i = 0; i < 8; i++) {
+                    block[56 + i] = ((uint64_t)N * 8 >> (8 * (7 - i))) & 0xFF;
+                }
+                compress_blocks(V, block, 1);
+            }
+            else {
+                compress_blocks(V, block, 1);
+                static const Schedule pad((uint64_t)N * 8, false);
+                rounds(V, pad.W, pad.W1);
+            }
+        }
+        store_digest(V, result);
+    }
+    //Merkle树内部节点：SM3(left || right)，两个32字节哈希正好是一个分组，第二个分组是固定的填充
+    static void hash_pair(const uint8_t* left, const uint8_t* right, uint8_t* result) {
+        uint8_t block[64];
+        memcpy(block, left, 32);
+        memcpy(block + 32, right, 32);
+        hash_fixed<64>(block, result);
+    }
+    //多路计算n条相互独立消息的哈希值，第i条写到results + 32 * i（见SM3-multibuffer.h）
+    static void hash_many(const uint8_t* const* msgs, const size_t* lens, size_t n, uint8_t* results) {
+        SM3MultiBuffer::hash_many(msgs, lens, n, results);
+    }
+    //多路计算n个64字节消息（连续存放在nodes中）的哈希值，如Merkle树同一层的各对子节点
+    static void hash_pairs(const uint8_t* nodes, size_t n, uint8_t* results) {
+        SM3MultiBuffer::hash_pairs(nodes, n, results);
+    }
 };
 
 //初始化IV值
@@ -210,7 +356,7 @@ void test_sm3() {
         SM3::hash(nullptr, 0, result);
         std::string hex = bytes_to_hex(result, 32);
         std::cout << "空字符串哈希: " << hex << std::endl;
-        std::cout << "预期结果: 1AB21D8355CFA17F8E61194831E81A8F79C2B6773A0FF8E534DFB6406B7EDEE" << std::endl << std::endl;
+        std::cout << "预期结果: 1AB21D8355CFA17F8E61194831E81A8F22BEC8C728FEFB747ED035EB5082AA2B" << std::endl << std::endl;
     }
 
     //测试案例2："abc"
@@ -224,6 +370,8 @@ void test_sm3() {
     }
 }
 
+//作为库被其他程序包含时（如基准测试）定义SM3_NO_MAIN以去掉演示用的main
+#ifndef SM3_NO_MAIN
 int main() {
     test_sm3();
 
@@ -245,3 +393,4 @@ int main() {
 
     return 0;
 }
+#endif
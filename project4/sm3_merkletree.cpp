@@ -1,248 +1,9 @@
 #include <iostream>
-#include <vector>
 #include <string>
-#include <cstring>
-#include <stdint.h>
-#include <algorithm>
 #include <sstream>
 #include <iomanip>
-#include "SM3.cpp"
+#include "sm3_merkletree.h"
 
-//定义哈希值长度
-const size_t HASH_SIZE = 32;
-//Merkle树节点类型
-enum NodeType {
-    LEAF_NODE,
-    INTERNAL_NODE
-};
-//Merkle树节点
-struct MerkleNode {
-    uint8_t hash[HASH_SIZE];
-    NodeType type;
-    size_t index;  //叶子节点的索引，内部节点为-1
-    MerkleNode* left;
-    MerkleNode* right;
-
-    MerkleNode() : type(INTERNAL_NODE), index(-1), left(nullptr), right(nullptr) {
-        memset(hash, 0, HASH_SIZE);
-    }
-};
-//RFC6962中定义的空哈希
-uint8_t EMPTY_HASH[HASH_SIZE] = {
-    0x1A, 0xB2, 0x1D, 0x83, 0x55, 0xCF, 0xA1, 0x7F,
-    0x8E, 0x61, 0x19, 0x48, 0x31, 0xE8, 0x1A, 0x8F,
-    0x79, 0xC2, 0xB6, 0x77, 0x3A, 0x0F, 0xF8, 0xE5,
-    0x34, 0xDF, 0xB6, 0x40, 0x6B, 0x7E, 0xDE, 0xE
-};
-//合并两个哈希值并计算新哈希
-void combineHashes(const uint8_t* left, const uint8_t* right, uint8_t* result) {
-    uint8_t combined[HASH_SIZE * 2];
-    memcpy(combined, left, HASH_SIZE);
-    memcpy(combined + HASH_SIZE, right, HASH_SIZE);
-    SM3::hash(combined, HASH_SIZE * 2, result);
-}
-//Merkle树实现
-class MerkleTree {
-private:
-    MerkleNode* root;
-    std::vector<MerkleNode*> leaves;
-    size_t leafCount;
-    std::vector<std::vector<MerkleNode*>> levels;  //存储每一层的节点
-
-    //构建树
-    void buildTree() {
-        //如果叶子数为0，直接返回
-        if (leafCount == 0) {
-            root = nullptr;
-            return;
-        }
-        //确保叶子数是2的幂，不是则补充空节点
-        size_t required = 1;
-        while (required < leafCount) {
-            required <<= 1;
-        }
-        //补充空叶子节点
-        for (size_t i = leafCount; i < required; ++i) {
-            MerkleNode* emptyLeaf = new MerkleNode();
-            emptyLeaf->type = LEAF_NODE;
-            emptyLeaf->index = i;
-            memcpy(emptyLeaf->hash, EMPTY_HASH, HASH_SIZE);
-            leaves.push_back(emptyLeaf);
-        }
-        leafCount = required;
-        //初始化层级
-        levels.clear();
-        levels.push_back(leaves);
-        //逐层构建直到根节点
-        while (levels.back().size() > 1) {
-            std::vector<MerkleNode*> nextLevel;
-            for (size_t i = 0; i < levels.back().size(); i += 2) {
-                MerkleNode* left = levels.back()[i];
-                MerkleNode* right = (i + 1 < levels.back().size()) ? levels.back()[i + 1] : left;
-                MerkleNode* parent = new MerkleNode();
-                combineHashes(left->hash, right->hash, parent->hash);
-                parent->left = left;
-                parent->right = right;
-                nextLevel.push_back(parent);
-            }
-            levels.push_back(nextLevel);
-        }
-        root = levels.back()[0];
-    }
-    //递归删除树节点
-    void deleteTree(MerkleNode* node) {
-        if (node == nullptr) return;
-        deleteTree(node->left);
-        deleteTree(node->right);
-        delete node;
-    }
-public:
-    MerkleTree() : root(nullptr), leafCount(0) {}
-
-    ~MerkleTree() {
-        deleteTree(root);
-    }
-    //从数据列表初始化Merkle树
-    void initialize(const std::vector<std::vector<uint8_t>>& dataList) {
-        //清除现有树
-        deleteTree(root);
-        leaves.clear();
-        leafCount = dataList.size();
-        //创建叶子节点
-        for (size_t i = 0; i < dataList.size(); ++i) {
-            MerkleNode* leaf = new MerkleNode();
-            leaf->type = LEAF_NODE;
-            leaf->index = i;
-            SM3::hash(dataList[i].data(), dataList[i].size(), leaf->hash);
-            leaves.push_back(leaf);
-        }
-        //构建树
-        buildTree();
-    }
-    //获取根哈希
-    void getRootHash(uint8_t* result) {
-        if (root == nullptr) {
-            memset(result, 0, HASH_SIZE);
-            return;
-        }
-        memcpy(result, root->hash, HASH_SIZE);
-    }
-    //生成存在性证明
-    bool generateInclusionProof(size_t index, std::vector<std::pair<uint8_t*, bool>>& proof) {
-        if (index >= leafCount || root == nullptr) {
-            return false;
-        }
-        proof.clear();
-        size_t currentIndex = index;
-        //从叶子节点向上收集证明
-        for (size_t i = 0; i < levels.size() - 1; ++i) {
-            bool isLeft = (currentIndex % 2 == 0);
-            size_t siblingIndex = isLeft ? currentIndex + 1 : currentIndex - 1;
-            //处理边界情况，当节点数为奇数时
-            if (siblingIndex >= levels[i].size()) {
-                siblingIndex = currentIndex;
-            }
-            //存储兄弟节点的哈希和当前节点是否为左节点
-            uint8_t* siblingHash = new uint8_t[HASH_SIZE];
-            memcpy(siblingHash, levels[i][siblingIndex]->hash, HASH_SIZE);
-            proof.emplace_back(siblingHash, isLeft);
-
-            currentIndex /= 2;
-        }
-
-        return true;
-    }
-    //验证存在性证明
-    bool verifyInclusionProof(const uint8_t* dataHash, size_t index,
-        const std::vector<std::pair<uint8_t*, bool>>& proof,
-        const uint8_t* rootHash) {
-        uint8_t currentHash[HASH_SIZE];
-        memcpy(currentHash, dataHash, HASH_SIZE);
-        for (const auto& p : proof) {
-            uint8_t combinedHash[HASH_SIZE];
-            if (p.second) {  //当前节点是左节点
-                combineHashes(currentHash, p.first, combinedHash);
-            }
-            else {  //当前节点是右节点
-                combineHashes(p.first, currentHash, combinedHash);
-            }
-            memcpy(currentHash, combinedHash, HASH_SIZE);
-        }
-        return memcmp(currentHash, rootHash, HASH_SIZE) == 0;
-    }
-    //生成不存在性证明
-    bool generateExclusionProof(size_t index, std::vector<std::pair<uint8_t*, bool>>& leftProof,
-        std::vector<std::pair<uint8_t*, bool>>& rightProof,
-        size_t& leftIndex, size_t& rightIndex) {
-        if (index >= leafCount || leafCount < 2 || root == nullptr) {
-            return false;
-        }
-        //找到index的前一个和后一个存在的叶子节点
-        leftIndex = index - 1;
-        while (leftIndex < leafCount && leaves[leftIndex] == nullptr) {
-            leftIndex--;
-        }
-        rightIndex = index + 1;
-        while (rightIndex < leafCount && leaves[rightIndex] == nullptr) {
-            rightIndex++;
-        }
-        //处理边界情况
-        if (leftIndex >= leafCount && rightIndex >= leafCount) {
-            return false;
-        }
-        //生成左邻居的存在性证明
-        if (leftIndex < leafCount) {
-            generateInclusionProof(leftIndex, leftProof);
-        }
-        //生成右邻居的存在性证明
-        if (rightIndex < leafCount) {
-            generateInclusionProof(rightIndex, rightProof);
-        }
-
-        return true;
-    }
-    //验证不存在性证明
-    bool verifyExclusionProof(size_t index,
-        const std::vector<std::pair<uint8_t*, bool>>& leftProof,
-        const std::vector<std::pair<uint8_t*, bool>>& rightProof,
-        size_t leftIndex, size_t rightIndex,
-        const uint8_t* leftHash, const uint8_t* rightHash,
-        const uint8_t* rootHash) {
-        //验证左邻居存在
-        bool leftValid = false;
-        if (leftIndex < leafCount) {
-            leftValid = verifyInclusionProof(leftHash, leftIndex, leftProof, rootHash);
-            if (!leftValid || leftIndex >= index) {
-                return false;
-            }
-        }
-        //验证右邻居存在
-        bool rightValid = false;
-        if (rightIndex < leafCount) {
-            rightValid = verifyInclusionProof(rightHash, rightIndex, rightProof, rootHash);
-            if (!rightValid || rightIndex <= index) {
-                return false;
-            }
-        }
-        //确保左右邻居是相邻的
-        if (leftIndex < leafCount && rightIndex < leafCount && rightIndex != leftIndex + 1) {
-            return false;
-        }
-        return leftValid || rightValid;
-    }
-    //获取叶子节点数量
-    size_t getLeafCount() const {
-        return leafCount;
-    }
-    //获取叶子节点的哈希
-    bool getLeafHash(size_t index, uint8_t* result) {
-        if (index >= leafCount) {
-            return false;
-        }
-        memcpy(result, leaves[index]->hash, HASH_SIZE);
-        return true;
-    }
-};
 //辅助函数：将字节数组转换为十六进制字符串
 std::string bytesToHex(const uint8_t* bytes, size_t length) {
     std::stringstream ss;
@@ -322,7 +83,10 @@ void testMerkleTree() {
         delete[] p.first;
     }
 }
+//作为库被其他程序包含时（如基准测试）定义MERKLE_NO_MAIN以去掉演示用的main
+#ifndef MERKLE_NO_MAIN
 int main() {
     testMerkleTree();
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,308 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstring>
+#include <stdint.h>
+#include <algorithm>
+#include "../common/telemetry.h"
+#include "../common/usdt.h"
+#ifndef SM3_NO_MAIN
+#define SM3_NO_MAIN
+#endif
+#include "SM3-optimized.h"
+
+//Merkle树（RFC6962风格）：与HMAC、KDF、sm3sum共用SM3-optimized.h的SM3类，
+//同一程序中包含本头文件与SM3-HMAC.h等不会出现两个SM3定义；演示程序见sm3_merkletree.cpp
+//定义哈希值长度
+const size_t HASH_SIZE = 32;
+//Merkle树节点类型
+enum NodeType {
+    LEAF_NODE,
+    INTERNAL_NODE
+};
+//Merkle树节点
+struct MerkleNode {
+    uint8_t hash[HASH_SIZE];
+    NodeType type;
+    size_t index;  //叶子节点的索引，内部节点为-1
+    MerkleNode* left;
+    MerkleNode* right;
+
+    MerkleNode() : type(INTERNAL_NODE), index(-1), left(nullptr), right(nullptr) {
+        memset(hash, 0, HASH_SIZE);
+    }
+};
+//空哈希：RFC6962中空树的哈希，即SM3("")
+inline const uint8_t EMPTY_HASH[HASH_SIZE] = {
+    0x1A, 0xB2, 0x1D, 0x83, 0x55, 0xCF, 0xA1, 0x7F,
+    0x8E, 0x61, 0x19, 0x48, 0x31, 0xE8, 0x1A, 0x8F,
+    0x22, 0xBE, 0xC8, 0xC7, 0x28, 0xFE, 0xFB, 0x74,
+    0x7E, 0xD0, 0x35, 0xEB, 0x50, 0x82, 0xAA, 0x2B
+};
+//合并两个哈希值并计算新哈希
+inline void combineHashes(const uint8_t* left, const uint8_t* right, uint8_t* result) {
+    SM3::hash_pair(left, right, result);
+}
+//Merkle树实现
+class MerkleTree {
+private:
+    MerkleNode* root;
+    std::vector<MerkleNode*> leaves;
+    size_t leafCount;
+    std::vector<std::vector<MerkleNode*>> levels;  //存储每一层的节点
+
+    //构建树
+    void buildTree() {
+        CRYPTO_PERF_SCOPE("merkle.build");
+        //如果叶子数为0，直接返回
+        if (leafCount == 0) {
+            root = nullptr;
+            return;
+        }
+        //确保叶子数是2的幂，不是则补充空节点
+        size_t required = 1;
+        while (required < leafCount) {
+            required <<= 1;
+        }
+        //补充空叶子节点
+        for (size_t i = leafCount; i < required; ++i) {
+            MerkleNode* emptyLeaf = new MerkleNode();
+            emptyLeaf->type = LEAF_NODE;
+            emptyLeaf->index = i;
+            memcpy(emptyLeaf->hash, EMPTY_HASH, HASH_SIZE);
+            leaves.push_back(emptyLeaf);
+        }
+        leafCount = required;
+        //初始化层级
+        levels.clear();
+        levels.push_back(leaves);
+        //逐层构建直到根节点：同一层的父节点互不依赖，先拼好各对子节点哈希再多路计算
+        std::vector<uint8_t> pairs;
+        std::vector<uint8_t> digests;
+        while (levels.back().size() > 1) {
+            const std::vector<MerkleNode*>& level = levels.back();
+            size_t parents = (level.size() + 1) / 2;
+            pairs.resize(parents * HASH_SIZE * 2);
+            digests.resize(parents * HASH_SIZE);
+            std::vector<MerkleNode*> nextLevel;
+            for (size_t i = 0; i < level.size(); i += 2) {
+                MerkleNode* left = level[i];
+                MerkleNode* right = (i + 1 < level.size()) ? level[i + 1] : left;
+                uint8_t* pair = pairs.data() + i * HASH_SIZE;
+                memcpy(pair, left->hash, HASH_SIZE);
+                memcpy(pair + HASH_SIZE, right->hash, HASH_SIZE);
+                MerkleNode* parent = new MerkleNode();
+                parent->left = left;
+                parent->right = right;
+                nextLevel.push_back(parent);
+            }
+            SM3::hash_pairs(pairs.data(), parents, digests.data());
+            for (size_t i = 0; i < parents; i++) {
+                memcpy(nextLevel[i]->hash, digests.data() + i * HASH_SIZE, HASH_SIZE);
+            }
+            levels.push_back(nextLevel);
+        }
+        root = levels.back()[0];
+    }
+    //按顺序创建叶子节点
+    void addLeaves(const uint8_t* hashes, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            MerkleNode* leaf = new MerkleNode();
+            leaf->type = LEAF_NODE;
+            leaf->index = i;
+            memcpy(leaf->hash, hashes + i * HASH_SIZE, HASH_SIZE);
+            leaves.push_back(leaf);
+        }
+    }
+    //递归删除树节点
+    void deleteTree(MerkleNode* node) {
+        if (node == nullptr) return;
+        deleteTree(node->left);
+        deleteTree(node->right);
+        delete node;
+    }
+public:
+    MerkleTree() : root(nullptr), leafCount(0) {}
+
+    ~MerkleTree() {
+        deleteTree(root);
+    }
+    //从数据列表初始化Merkle树
+    void initialize(const std::vector<std::vector<uint8_t>>& dataList) {
+#ifdef CRYPTO_TELEMETRY
+        //总字节数只用于遥测，关闭时不遍历
+        size_t totalBytes = 0;
+        for (const auto& d : dataList) {
+            totalBytes += d.size();
+        }
+        CRYPTO_TELEMETRY_SCOPE(tm, "merkle.build", totalBytes, dataList.size());
+#endif
+        CRYPTO_USDT2(merkle_build_entry, this, dataList.size());
+        //清除现有树
+        deleteTree(root);
+        leaves.clear();
+        leafCount = dataList.size();
+        //创建叶子节点，叶子哈希多路计算
+        std::vector<const uint8_t*> msgs(dataList.size());
+        std::vector<size_t> lens(dataList.size());
+        std::vector<uint8_t> digests(dataList.size() * HASH_SIZE);
+        for (size_t i = 0; i < dataList.size(); ++i) {
+            msgs[i] = dataList[i].data();
+            lens[i] = dataList[i].size();
+        }
+        SM3::hash_many(msgs.data(), lens.data(), dataList.size(), digests.data());
+        addLeaves(digests.data(), dataList.size());
+        //构建树
+        buildTree();
+        CRYPTO_USDT2(merkle_build_return, this, leafCount);
+    }
+    //从已算好的叶子哈希初始化Merkle树（hashes为count个连续的32字节哈希），用于叶子哈希由调用方并行计算的场景
+    void initializeFromHashes(const uint8_t* hashes, size_t count) {
+        CRYPTO_TELEMETRY_SCOPE(tm, "merkle.build", 0, count);
+        CRYPTO_USDT2(merkle_build_entry, this, count);
+        deleteTree(root);
+        leaves.clear();
+        leafCount = count;
+        addLeaves(hashes, count);
+        buildTree();
+        CRYPTO_USDT2(merkle_build_return, this, leafCount);
+    }
+    //获取根哈希
+    void getRootHash(uint8_t* result) {
+        if (root == nullptr) {
+            memset(result, 0, HASH_SIZE);
+            return;
+        }
+        memcpy(result, root->hash, HASH_SIZE);
+    }
+    //生成存在性证明
+    bool generateInclusionProof(size_t index, std::vector<std::pair<uint8_t*, bool>>& proof) {
+        CRYPTO_TELEMETRY_SCOPE(tm, "merkle.proof.inclusion", 0, levels.size());
+        CRYPTO_USDT2(merkle_proof_entry, this, index);
+        if (index >= leafCount || root == nullptr) {
+            CRYPTO_TELEMETRY_FAIL(tm, 1);
+            CRYPTO_USDT3(merkle_proof_return, this, index, 0);
+            return false;
+        }
+        proof.clear();
+        size_t currentIndex = index;
+        //从叶子节点向上收集证明
+        for (size_t i = 0; i < levels.size() - 1; ++i) {
+            bool isLeft = (currentIndex % 2 == 0);
+            size_t siblingIndex = isLeft ? currentIndex + 1 : currentIndex - 1;
+            //处理边界情况，当节点数为奇数时
+            if (siblingIndex >= levels[i].size()) {
+                siblingIndex = currentIndex;
+            }
+            //存储兄弟节点的哈希和当前节点是否为左节点
+            uint8_t* siblingHash = new uint8_t[HASH_SIZE];
+            memcpy(siblingHash, levels[i][siblingIndex]->hash, HASH_SIZE);
+            proof.emplace_back(siblingHash, isLeft);
+
+            currentIndex /= 2;
+        }
+        CRYPTO_USDT3(merkle_proof_return, this, index, proof.size());
+        return true;
+    }
+    //验证存在性证明
+    bool verifyInclusionProof(const uint8_t* dataHash, size_t index,
+        const std::vector<std::pair<uint8_t*, bool>>& proof,
+        const uint8_t* rootHash) {
+        CRYPTO_TELEMETRY_SCOPE(tm, "merkle.verify.inclusion", 0, proof.size());
+        uint8_t currentHash[HASH_SIZE];
+        memcpy(currentHash, dataHash, HASH_SIZE);
+        for (const auto& p : proof) {
+            uint8_t combinedHash[HASH_SIZE];
+            if (p.second) {  //当前节点是左节点
+                combineHashes(currentHash, p.first, combinedHash);
+            }
+            else {  //当前节点是右节点
+                combineHashes(p.first, currentHash, combinedHash);
+            }
+            memcpy(currentHash, combinedHash, HASH_SIZE);
+        }
+        bool ok = memcmp(currentHash, rootHash, HASH_SIZE) == 0;
+        if (!ok) {
+            CRYPTO_TELEMETRY_FAIL(tm, 1);
+        }
+        return ok;
+    }
+    //生成不存在性证明
+    bool generateExclusionProof(size_t index, std::vector<std::pair<uint8_t*, bool>>& leftProof,
+        std::vector<std::pair<uint8_t*, bool>>& rightProof,
+        size_t& leftIndex, size_t& rightIndex) {
+        CRYPTO_TELEMETRY_SCOPE(tm, "merkle.proof.exclusion", 0, 2 * levels.size());
+        CRYPTO_USDT2(merkle_exclusion_proof_entry, this, index);
+        if (index >= leafCount || leafCount < 2 || root == nullptr) {
+            CRYPTO_TELEMETRY_FAIL(tm, 1);
+            CRYPTO_USDT3(merkle_exclusion_proof_return, this, index, 0);
+            return false;
+        }
+        //找到index的前一个和后一个存在的叶子节点
+        leftIndex = index - 1;
+        while (leftIndex < leafCount && leaves[leftIndex] == nullptr) {
+            leftIndex--;
+        }
+        rightIndex = index + 1;
+        while (rightIndex < leafCount && leaves[rightIndex] == nullptr) {
+            rightIndex++;
+        }
+        //处理边界情况
+        if (leftIndex >= leafCount && rightIndex >= leafCount) {
+            CRYPTO_TELEMETRY_FAIL(tm, 1);
+            CRYPTO_USDT3(merkle_exclusion_proof_return, this, index, 0);
+            return false;
+        }
+        //生成左邻居的存在性证明
+        if (leftIndex < leafCount) {
+            generateInclusionProof(leftIndex, leftProof);
+        }
+        //生成右邻居的存在性证明
+        if (rightIndex < leafCount) {
+            generateInclusionProof(rightIndex, rightProof);
+        }
+        CRYPTO_USDT3(merkle_exclusion_proof_return, this, index, 1);
+        return true;
+    }
+    //验证不存在性证明
+    bool verifyExclusionProof(size_t index,
+        const std::vector<std::pair<uint8_t*, bool>>& leftProof,
+        const std::vector<std::pair<uint8_t*, bool>>& rightProof,
+        size_t leftIndex, size_t rightIndex,
+        const uint8_t* leftHash, const uint8_t* rightHash,
+        const uint8_t* rootHash) {
+        //验证左邻居存在
+        bool leftValid = false;
+        if (leftIndex < leafCount) {
+            leftValid = verifyInclusionProof(leftHash, leftIndex, leftProof, rootHash);
+            if (!leftValid || leftIndex >= index) {
+                return false;
+            }
+        }
+        //验证右邻居存在
+        bool rightValid = false;
+        if (rightIndex < leafCount) {
+            rightValid = verifyInclusionProof(rightHash, rightIndex, rightProof, rootHash);
+            if (!rightValid || rightIndex <= index) {
+                return false;
+            }
+        }
+        //确保左右邻居是相邻的
+        if (leftIndex < leafCount && rightIndex < leafCount && rightIndex != leftIndex + 1) {
+            return false;
+        }
+        return leftValid || rightValid;
+    }
+    //获取叶子节点数量
+    size_t getLeafCount() const {
+        return leafCount;
+    }
+    //获取叶子节点的哈希
+    bool getLeafHash(size_t index, uint8_t* result) {
+        if (index >= leafCount) {
+            return false;
+        }
+        memcpy(result, leaves[index]->hash, HASH_SIZE);
+        return true;
+    }
+};
@@ -0,0 +1,887 @@
+//统一基准测试：覆盖仓库中全部SM4、SM4-GCM、SM3与Merkle树实现
+//
+//每个测量点（实现 × 消息长度 × 线程数）：工作线程绑定到各自的CPU，预热后按时间预算
+//反复执行，每个样本用TSC计时若干次操作（短消息时合并多次以摊薄计时开销），
+//报告cycles/byte（按样本p50）与总吞吐GB/s；随后另用四分之一的时间预算逐次计时单次操作
+//（扣除计时本身的开销），报告单次操作的p50/p99延迟。
+//
+//用法：
+//   crypto_bench [--filter 子串] [--sizes 16,4K,1M] [--max-size 1G] [--threads 1,2,4]
+//                [--budget 秒] [--warmup 秒] [--max-op 秒] [--max-mem 4G] [--json 输出文件] [--list]
+//                [--colocate 线程数]
+//   crypto_bench --compare 基线.json 新结果.json [--threshold 0.05]
+//编译：g++ -std=c++17 -O2 -pthread -o crypto_bench tools/crypto_bench.cpp
+//用-std=c++20编译时另有协程前端（SM4-GCM-async.h）的条目
+//加-DCRYPTO_PERF时按内核与测量点统计硬件计数器，结束时输出汇总（见common/perf_counters.h）
+//加-DCRYPTO_TELEMETRY时结束时输出各操作的遥测计数与延迟分位数（见common/telemetry.h）
+
+//旧实现以源文件形式包含在各自的命名空间中，标准库头文件须先在全局包含
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <cmath>
+#include <stdint.h>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#include <x86intrin.h>
+#define BENCH_HAS_TSC
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+//插桩头文件须在全局包含，旧实现在命名空间内的#include随后被#pragma once跳过
+#include "../common/perf_counters.h"
+#include "../common/telemetry.h"
+#include "../common/thread_pool.h"
+#include "../project4/SM3-multibuffer.h"
+
+#define SM4_NO_MAIN
+#define SM4_GCM_NO_MAIN
+#define SM3_NO_MAIN
+
+namespace lab_sm4_basic {
+#include "../project 1/SM4基本实现.cpp"
+}
+namespace lab_sm4_ttable {
+#include "../project 1/SM4-T-table.cpp"
+}
+#ifdef BENCH_HAS_TSC
+namespace lab_sm4_aesni {
+#include "../project 1/SM4-T-table-AESNI.cpp"
+}
+#endif
+namespace lab_gcm {
+#include "../project 1/SM4-GCM.cpp"
+}
+namespace lab_gcm_ttable {
+#include "../project 1/SM4-GCM-T-table.cpp"
+}
+namespace lab_sm3 {
+#include "../project4/SM3.cpp"
+}
+namespace lab_sm3_opt {
+#include "../project4/SM3-optimized.h"
+#include "../project4/SM3-HMAC.h"
+#include "../project4/SM3-KDF.h"
+#include "../project4/SM3-treehash.h"
+}
+//Merkle树与树哈希使用优化版SM3，与HMAC、KDF同在一个命名空间
+namespace lab_merkle = lab_sm3_opt;
+
+#include "../project 1/SM4-GCM-optimized.h"
+#include "../project 1/SM4-GCM-container.h"
+#include "../project 1/SM4-CCM.h"
+#if __cplusplus >= 202002L
+#include <latch>
+//SM4-GCM-async.h在全局使用SM3，这里指向已在命名空间中包含的优化版
+using lab_sm3_opt::SM3;
+#include "../project 1/SM4-GCM-async.h"
+#define BENCH_HAS_ASYNC
+#endif
+
+using namespace std;
+
+//---------------------------------------------------------------- 计时与绑核
+
+static inline uint64_t read_cycles() {
+#ifdef BENCH_HAS_TSC
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+#else
+    //没有TSC的平台退化为纳秒计数，此时“cycles”按1 GHz折算
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//对照steady_clock标定计数器频率（GHz）
+static double calibrate_ghz() {
+#ifdef BENCH_HAS_TSC
+    auto t0 = chrono::steady_clock::now();
+    uint64_t c0 = read_cycles();
+    while (chrono::steady_clock::now() - t0 < chrono::milliseconds(100)) {
+    }
+    uint64_t c1 = read_cycles();
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count();
+    return (double)(c1 - c0) / ns;
+#else
+    return 1.0;
+#endif
+}
+
+//两次相邻read_cycles()之间的最小间隔，逐次计时单次操作时从结果中扣除
+static double timer_overhead() {
+    static const double overhead = []() {
+        uint64_t best = ~(uint64_t)0;
+        for (int i = 0; i < 10000; i++) {
+            uint64_t s = read_cycles();
+            uint64_t e = read_cycles();
+            best = min(best, e - s);
+        }
+        return (double)best;
+    }();
+    return overhead;
+}
+
+//当前进程允许运行的CPU列表，工作线程依次绑定
+static vector<unsigned> allowed_cpus() {
+    vector<unsigned> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (unsigned i = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &set)) {
+                cpus.push_back(i);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        cpus.push_back(0);
+    }
+    return cpus;
+}
+
+static void pin_to_cpu(unsigned cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+//---------------------------------------------------------------- 被测实现
+
+static const uint8_t BENCH_KEY[16] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+};
+static const uint8_t BENCH_NONCE[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+static const uint8_t BENCH_AAD[16] = { 0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef };
+
+using Op = function<void()>;
+
+//把一段内存作为输入/输出流，容器的流式接口不必经过文件或字符串拷贝
+struct SpanBuf : streambuf {
+    SpanBuf(uint8_t* p, size_t n) {
+        setg((char*)p, (char*)p, (char*)p + n);
+        setp((char*)p, (char*)p + n);
+    }
+};
+
+#ifdef BENCH_HAS_ASYNC
+//不返回结果的协程：创建后立即运行到第一个co_await，结束时自行销毁
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+};
+
+static Detached seal_one(SealSession& session, const uint8_t* msg, size_t len, uint8_t* out, latch& done) {
+    SealedMessage m = co_await seal(session, msg, len);
+    memcpy(out, m.ciphertext.data(), len);
+    done.count_down();
+}
+#endif
+
+struct Impl {
+    string name;
+    string note;
+    bool internal_threads; //实现自身多线程：线程数传给实现，只启动一个工作线程
+    //为给定长度准备一次操作（密钥扩展、预计算等不计入时间），out至少len+16字节
+    function<Op(const uint8_t* in, uint8_t* out, size_t len, unsigned threads)> prepare;
+};
+
+//旧版逐块接口：输入输出为32位字，每次调用都重做密钥扩展
+template <class Encrypt, class ToWords, class ToBytes>
+static Op legacy_sm4_op(Encrypt enc, ToWords to_words, ToBytes to_bytes, const uint8_t* in, uint8_t* out,
+    size_t len) {
+    uint32_t key[4];
+    to_words(BENCH_KEY, key);
+    return [=]() {
+        uint32_t k[4] = { key[0], key[1], key[2], key[3] };
+        for (size_t off = 0; off + 16 <= len; off += 16) {
+            uint32_t p[4], c[4];
+            to_words(in + off, p);
+            enc(p, k, c);
+            to_bytes(c, out + off);
+        }
+    };
+}
+
+static vector<Impl> all_impls() {
+    vector<Impl> v;
+    v.push_back({ "sm4-basic", "每块重做密钥扩展", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            using namespace lab_sm4_basic;
+            return legacy_sm4_op(sm4Encrypt, bytesToWords, wordsToBytes, in, out, len);
+        } });
+    v.push_back({ "sm4-ttable", "每块重做密钥扩展", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            using namespace lab_sm4_ttable;
+            initTTable();
+            return legacy_sm4_op(sm4Encrypt, bytesToWords, wordsToBytes, in, out, len);
+        } });
+#ifdef BENCH_HAS_TSC
+    v.push_back({ "sm4-ttable-aesni", "每块重做密钥扩展", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            using namespace lab_sm4_aesni;
+            initTTable();
+            return legacy_sm4_op(sm4EncryptAESNI, bytesToWords, wordsToBytes, in, out, len);
+        } });
+#endif
+    v.push_back({ "sm4-opt-block", "逐块encrypt_block", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            auto sm4 = make_shared<SM4>();
+            sm4->set_key(BENCH_KEY);
+            return Op([=]() {
+                for (size_t off = 0; off + 16 <= len; off += 16) {
+                    sm4->encrypt_block(in + off, out + off);
+                }
+            });
+        } });
+    v.push_back({ "sm4-opt-ecb", "encrypt_blocks多分组交错", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            auto sm4 = make_shared<SM4>();
+            sm4->set_key(BENCH_KEY);
+            return Op([=]() { sm4->encrypt_blocks(in, out, len / 16); });
+        } });
+    v.push_back({ "gcm-legacy", "SM4-GCM.cpp", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            auto gcm = make_shared<lab_gcm::GCM>();
+            gcm->set_key(BENCH_KEY);
+            return Op([=]() { gcm->encrypt(BENCH_NONCE, in, len, BENCH_AAD, 16, out, out + len); });
+        } });
+    v.push_back({ "gcm-ttable-legacy", "SM4-GCM-T-table.cpp", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            auto gcm = make_shared<lab_gcm_ttable::GCM>();
+            gcm->set_key(BENCH_KEY);
+            return Op([=]() { gcm->encrypt(BENCH_NONCE, in, len, BENCH_AAD, 16, out, out + len); });
+        } });
+    v.push_back({ "gcm-opt-enc", "GCM::encrypt", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            auto gcm = make_shared<GCM>();
+            gcm->set_key(BENCH_KEY);
+            return Op([=]() { gcm->encrypt(BENCH_NONCE, in, len, BENCH_AAD, 16, out, out + len); });
+        } });
+    v.push_back({ "gcm-opt-dec", "GCM::decrypt（Standard）", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            auto gcm = make_shared<GCM>();
+            gcm->set_key(BENCH_KEY);
+            //先生成合法的密文与标签，计时只包含解密
+            auto ct = make_shared<vector<uint8_t>>(len + 16);
+            gcm->encrypt(BENCH_NONCE, in, len, BENCH_AAD, 16, ct->data(), ct->data() + len);
+            return Op([=]() {
+                gcm->decrypt(BENCH_NONCE, ct->data(), len, BENCH_AAD, 16, ct->data() + len, out);
+            });
+        } });
+    for (DecryptMode mode : { DecryptMode::VerifyFirst, DecryptMode::Stitched }) {
+        bool verify_first = mode == DecryptMode::VerifyFirst;
+        v.push_back({ verify_first ? "gcm-opt-dec-verify" : "gcm-opt-dec-stitch",
+            verify_first ? "GCM::decrypt（VerifyFirst）" : "GCM::decrypt（Stitched）", false,
+            [mode](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+                auto gcm = make_shared<GCM>();
+                gcm->set_key(BENCH_KEY);
+                auto ct = make_shared<vector<uint8_t>>(len + 16);
+                gcm->encrypt(BENCH_NONCE, in, len, BENCH_AAD, 16, ct->data(), ct->data() + len);
+                return Op([=]() {
+                    gcm->decrypt(BENCH_NONCE, ct->data(), len, BENCH_AAD, 16, ct->data() + len, out, mode);
+                });
+            } });
+    }
+    v.push_back({ "gcm-opt-parallel", "GCM::encrypt_parallel，线程数传给实现", true,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned threads) {
+            auto gcm = make_shared<GCM>();
+            gcm->set_key(BENCH_KEY);
+            return Op([=]() {
+                gcm->encrypt_parallel(BENCH_NONCE, in, len, BENCH_AAD, 16, out, out + len, threads);
+            });
+        } });
+    //输入切成64字节的报文（各自的标签），与逐条encrypt（gcm-opt-enc的64B行）对比
+    v.push_back({ "gcm-batch-enc-64B", "GCM::encrypt_batch，64字节报文", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            auto gcm = make_shared<GCM>();
+            gcm->set_key(BENCH_KEY);
+            size_t n = (len + 63) / 64;
+            auto tags = make_shared<vector<uint8_t>>(16 * n);
+            auto packets = make_shared<vector<GcmPacket>>(n);
+            for (size_t i = 0; i < n; i++) {
+                (*packets)[i] = { BENCH_NONCE, BENCH_AAD, 16, in + 64 * i, min<size_t>(64, len - 64 * i),
+                    out + 64 * i, tags->data() + 16 * i, false };
+            }
+            //描述符指向tags中的标签，须一起捕获
+            return Op([gcm, packets, tags, n]() { gcm->encrypt_batch(packets->data(), n); });
+        } });
+    v.push_back({ "gcm-batch-dec-64B", "GCM::decrypt_batch，64字节报文", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            auto gcm = make_shared<GCM>();
+            gcm->set_key(BENCH_KEY);
+            size_t n = (len + 63) / 64;
+            auto ct = make_shared<vector<uint8_t>>(len + 16 * n);
+            auto packets = make_shared<vector<GcmPacket>>(n);
+            for (size_t i = 0; i < n; i++) {
+                size_t m = min<size_t>(64, len - 64 * i);
+                uint8_t* tag = ct->data() + len + 16 * i;
+                gcm->encrypt(BENCH_NONCE, in + 64 * i, m, BENCH_AAD, 16, ct->data() + 64 * i, tag);
+                (*packets)[i] = { BENCH_NONCE, BENCH_AAD, 16, ct->data() + 64 * i, m, out + 64 * i, tag, false };
+            }
+            return Op([gcm, packets, ct, n]() { gcm->decrypt_batch(packets->data(), n); });
+        } });
+    //分块容器（64KB分块）在内存中整体加密：每块一个标签，另加头部与尾部，线程数传给实现
+    v.push_back({ "gcm-container", "GcmContainer::encrypt_stream，64KB分块", true,
+        [](const uint8_t* in, uint8_t*, size_t len, unsigned threads) {
+            auto c = make_shared<GcmContainer>();
+            c->set_key(BENCH_KEY);
+            size_t chunks = len / (64 * 1024) + 1;
+            auto file = make_shared<vector<uint8_t>>(len + 16 * chunks + 72);
+            return Op([=]() {
+                SpanBuf src((uint8_t*)in, len), dst(file->data(), file->size());
+                istream is(&src);
+                ostream os(&dst);
+                c->encrypt_stream(is, len, os, 64 * 1024, threads);
+            });
+        } });
+#ifdef BENCH_HAS_ASYNC
+    //协程前端：输入切成64字节报文，每条一个协程co_await seal()，由调度器攒批（含分发线程的开销）
+    v.push_back({ "gcm-async-seal-64B", "co_await seal()，64字节报文", true,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            auto gcm = make_shared<GCM>();
+            gcm->set_key(BENCH_KEY);
+            auto sched = make_shared<BatchScheduler>(64, chrono::microseconds(50));
+            const uint8_t prefix[4] = { 0, 0, 0, 1 };
+            auto session = make_shared<SealSession>(*sched, gcm, prefix);
+            size_t n = (len + 63) / 64;
+            return Op([=]() {
+                latch done((ptrdiff_t)n);
+                for (size_t i = 0; i < n; i++) {
+                    seal_one(*session, in + 64 * i, min<size_t>(64, len - 64 * i), out + 64 * i, done);
+                }
+                sched->flush();
+                done.wait();
+            });
+        } });
+#endif
+    v.push_back({ "gmac", "GMAC::compute", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            auto mac = make_shared<GMAC>();
+            mac->set_key(BENCH_KEY);
+            return Op([=]() { mac->compute(BENCH_NONCE, in, len, out); });
+        } });
+    v.push_back({ "ccm-enc", "CCM::encrypt", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            auto ccm = make_shared<CCM>();
+            ccm->set_key(BENCH_KEY);
+            return Op([=]() { ccm->encrypt(BENCH_NONCE, 12, in, len, BENCH_AAD, 16, out, out + len); });
+        } });
+    v.push_back({ "sm3", "SM3.cpp", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            return Op([=]() { lab_sm3::SM3::hash(in, len, out); });
+        } });
+    v.push_back({ "sm3-opt", "SM3-optimized.h", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            return Op([=]() { lab_sm3_opt::SM3::hash(in, len, out); });
+        } });
+    //输入切成64字节的短消息（Merkle叶子、指纹一类负载），逐条哈希与按各通道数多路哈希对比
+    v.push_back({ "sm3-opt-64B", "逐条SM3::hash，64字节消息", false,
+        [](const uint8_t* in, uint8_t*, size_t len, unsigned) {
+            auto digests = make_shared<vector<uint8_t>>(32 * ((len + 63) / 64));
+            return Op([=]() {
+                for (size_t off = 0, i = 0; off < len; off += 64, i++) {
+                    lab_sm3_opt::SM3::hash(in + off, min<size_t>(64, len - off), digests->data() + 32 * i);
+                }
+            });
+        } });
+    v.push_back({ "sm3-opt-pair", "SM3::hash_pair，64字节消息的填充分组预先扩展", false,
+        [](const uint8_t* in, uint8_t*, size_t len, unsigned) {
+            auto digests = make_shared<vector<uint8_t>>(32 * (len / 64 + 1));
+            return Op([=]() {
+                for (size_t off = 0, i = 0; off + 64 <= len; off += 64, i++) {
+                    lab_sm3_opt::SM3::hash_pair(in + off, in + off + 32, digests->data() + 32 * i);
+                }
+            });
+        } });
+    v.push_back({ "sm3-mb-pairs", "SM3MultiBuffer::hash_pairs，64字节消息", false,
+        [](const uint8_t* in, uint8_t*, size_t len, unsigned) {
+            auto digests = make_shared<vector<uint8_t>>(32 * (len / 64 + 1));
+            return Op([=]() { SM3MultiBuffer::hash_pairs(in, len / 64, digests->data()); });
+        } });
+    for (unsigned lanes = 1; lanes <= SM3MultiBuffer::best_lanes(); lanes *= 2) {
+        if (lanes == 2) {
+            continue;
+        }
+        v.push_back({ "sm3-mb-x" + to_string(lanes), "SM3MultiBuffer::hash_many，64字节消息", false,
+            [lanes](const uint8_t* in, uint8_t*, size_t len, unsigned) {
+                size_t n = (len + 63) / 64;
+                auto msgs = make_shared<vector<const uint8_t*>>(n);
+                auto lens = make_shared<vector<size_t>>(n);
+                auto digests = make_shared<vector<uint8_t>>(32 * n);
+                for (size_t i = 0; i < n; i++) {
+                    (*msgs)[i] = in + 64 * i;
+                    (*lens)[i] = min<size_t>(64, len - 64 * i);
+                }
+                return Op([=]() { SM3MultiBuffer::hash_many(msgs->data(), lens->data(), n, digests->data(), lanes); });
+            } });
+    }
+    //HMAC-SM3，64字节消息：逐条compute（缓存ipad/opad状态）与compute_many（多路）对比
+    v.push_back({ "hmac-sm3-64B", "HmacSm3::compute，64字节消息", false,
+        [](const uint8_t* in, uint8_t*, size_t len, unsigned) {
+            auto h = make_shared<lab_sm3_opt::HmacSm3>(BENCH_KEY, 16);
+            auto macs = make_shared<vector<uint8_t>>(32 * ((len + 63) / 64));
+            return Op([=]() {
+                for (size_t off = 0, i = 0; off < len; off += 64, i++) {
+                    h->compute(in + off, min<size_t>(64, len - off), macs->data() + 32 * i);
+                }
+            });
+        } });
+    v.push_back({ "hmac-sm3-many", "HmacSm3::compute_many，64字节消息", false,
+        [](const uint8_t* in, uint8_t*, size_t len, unsigned) {
+            auto h = make_shared<lab_sm3_opt::HmacSm3>(BENCH_KEY, 16);
+            size_t n = (len + 63) / 64;
+            auto msgs = make_shared<vector<const uint8_t*>>(n);
+            auto lens = make_shared<vector<size_t>>(n);
+            auto macs = make_shared<vector<uint8_t>>(32 * n);
+            for (size_t i = 0; i < n; i++) {
+                (*msgs)[i] = in + 64 * i;
+                (*lens)[i] = min<size_t>(64, len - 64 * i);
+            }
+            return Op([=]() { h->compute_many(msgs->data(), lens->data(), n, macs->data()); });
+        } });
+    //SM3-KDF：派生len字节（Z为64字节，即SM2加密的x2 || y2），线程数传给实现
+    v.push_back({ "sm3-kdf", "Sm3Kdf::derive，Z为64字节", true,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned threads) {
+            auto kdf = make_shared<lab_sm3_opt::Sm3Kdf>(in, 64);
+            return Op([=]() { kdf->derive(out, len, threads); });
+        } });
+    //SM3树哈希（64KB块，结果不同于SM3），线程数传给实现
+    v.push_back({ "sm3-tree", "Sm3TreeHash，64KB块", true,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned threads) {
+            return Op([=]() { lab_merkle::Sm3TreeHash::hash(in, len, out, 64 * 1024, threads); });
+        } });
+    v.push_back({ "merkle-build", "1KB叶子建树并取根", false,
+        [](const uint8_t* in, uint8_t* out, size_t len, unsigned) {
+            const size_t LEAF = 1024;
+            auto leaves = make_shared<vector<vector<uint8_t>>>();
+            for (size_t off = 0; off < len; off += LEAF) {
+                size_t n = len - off < LEAF ? len - off : LEAF;
+                leaves->emplace_back(in + off, in + off + n);
+            }
+            return Op([=]() {
+                lab_merkle::MerkleTree mt;
+                mt.initialize(*leaves);
+                mt.getRootHash(out);
+            });
+        } });
+    return v;
+}
+
+//---------------------------------------------------------------- 测量
+
+struct Options {
+    string filter;
+    vector<size_t> sizes;
+    vector<unsigned> threads;
+    double budget = 0.2;   //每个测量点的计时时长（秒）
+    double warmup = 0.05;  //预热时长（秒）
+    double max_op = 2.0;   //预计单次操作超过该时长时跳过更大的长度
+    size_t max_mem = (size_t)4 << 30;
+    unsigned colocate = 0; //测量期间并发运行的缓存干扰线程数
+    string json;
+};
+
+struct Result {
+    string impl;
+    size_t size;
+    unsigned threads;
+    double cycles_per_byte;
+    double gbps;
+    double p50_ns;     //单次操作延迟（逐次计时）
+    double p99_ns;
+    uint64_t ops;
+};
+
+//简单的自旋屏障，让各工作线程的预热与计时阶段对齐
+struct SpinBarrier {
+    atomic<unsigned> arrived{ 0 };
+    atomic<unsigned> phase{ 0 };
+    unsigned total;
+    explicit SpinBarrier(unsigned n) : total(n) {}
+    void wait() {
+        unsigned p = phase.load();
+        if (arrived.fetch_add(1) + 1 == total) {
+            arrived = 0;
+            phase++;
+        }
+        else {
+            while (phase.load() == p) {
+                this_thread::yield();
+            }
+        }
+    }
+};
+
+//同机干扰负载：随机读写远大于LLC的缓冲区，不断把被测内核的查找表与数据挤出缓存
+class CoLoad {
+    atomic<bool> stop{ false };
+    vector<thread> pool;
+
+public:
+    CoLoad(unsigned n, const vector<unsigned>& cpus) {
+        for (unsigned i = 0; i < n; i++) {
+            pool.emplace_back([this, i, &cpus]() {
+                pin_to_cpu(cpus[(cpus.size() - 1 - i % cpus.size())]);
+                vector<uint64_t> buf((size_t)64 << 20 >> 3, i);
+                uint64_t x = 0x9e3779b97f4a7c15ULL * (i + 1);
+                while (!stop.load(memory_order_relaxed)) {
+                    for (int k = 0; k < 4096; k++) {
+                        x ^= x << 13;
+                        x ^= x >> 7;
+                        x ^= x << 17;
+                        buf[x % buf.size()] += x;
+                    }
+                }
+            });
+        }
+    }
+    ~CoLoad() {
+        stop = true;
+        for (auto& t : pool) {
+            t.join();
+        }
+    }
+};
+
+static Result measure(const Impl& impl, size_t len, unsigned threads, const Options& opt, double ghz,
+    const vector<unsigned>& cpus, const string& phase) {
+    unsigned workers = impl.internal_threads ? 1 : threads;
+    vector<vector<uint8_t>> in(workers), out(workers);
+    vector<Op> ops(workers);
+    mt19937 rng(len);
+    for (unsigned w = 0; w < workers; w++) {
+        in[w].resize(len);
+        out[w].resize(len + 32);
+        for (auto& b : in[w]) b = (uint8_t)rng();
+        ops[w] = impl.prepare(in[w].data(), out[w].data(), len, threads);
+    }
+
+    vector<vector<double>> samples(workers), latency(workers);
+    vector<uint64_t> count(workers, 0);
+    vector<double> seconds(workers, 0);
+    SpinBarrier barrier(workers);
+    auto work = [&](unsigned w) {
+        pin_to_cpu(cpus[w % cpus.size()]);
+        CRYPTO_PERF_PHASE(phase);
+        barrier.wait();
+        //预热：至少执行一次，同时估计单次操作的周期数
+        auto t0 = chrono::steady_clock::now();
+        uint64_t n = 0, c0 = read_cycles();
+        do {
+            ops[w]();
+            n++;
+        } while (chrono::duration<double>(chrono::steady_clock::now() - t0).count() < opt.warmup);
+        double per_op = (double)(read_cycles() - c0) / n;
+        //每个样本至少约20微秒，短消息时合并多次操作
+        uint64_t batch = (uint64_t)max(1.0, 20000.0 * ghz / max(per_op, 1.0));
+        barrier.wait();
+
+        t0 = chrono::steady_clock::now();
+        do {
+            uint64_t s = read_cycles();
+            for (uint64_t k = 0; k < batch; k++) {
+                ops[w]();
+            }
+            samples[w].push_back((double)(read_cycles() - s) / batch);
+            count[w] += batch;
+        } while (chrono::duration<double>(chrono::steady_clock::now() - t0).count() < opt.budget);
+        seconds[w] = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+        //单次操作延迟：逐次计时，不与上面合并多次操作的样本混用
+        barrier.wait();
+        double overhead = timer_overhead();
+        t0 = chrono::steady_clock::now();
+        do {
+            uint64_t s = read_cycles();
+            ops[w]();
+            double c = (double)(read_cycles() - s) - overhead;
+            latency[w].push_back(max(c, 0.0));
+        } while (chrono::duration<double>(chrono::steady_clock::now() - t0).count() < opt.budget / 4 &&
+                 latency[w].size() < 1000000);
+    };
+    CoLoad load(opt.colocate, cpus);
+    vector<thread> pool;
+    for (unsigned w = 1; w < workers; w++) {
+        pool.emplace_back(work, w);
+    }
+    work(0);
+    for (auto& t : pool) {
+        t.join();
+    }
+
+    vector<double> all, lat;
+    double gbps = 0;
+    uint64_t ops_total = 0;
+    for (unsigned w = 0; w < workers; w++) {
+        all.insert(all.end(), samples[w].begin(), samples[w].end());
+        lat.insert(lat.end(), latency[w].begin(), latency[w].end());
+        gbps += (double)count[w] * len / seconds[w] / 1e9;
+        ops_total += count[w];
+    }
+    sort(all.begin(), all.end());
+    sort(lat.begin(), lat.end());
+    double p50 = all[all.size() / 2];
+    double lat50 = lat[lat.size() / 2];
+    double lat99 = lat[min(lat.size() - 1, (size_t)(lat.size() * 0.99))];
+    return { impl.name, len, threads, p50 / len, gbps, lat50 / ghz, lat99 / ghz, ops_total };
+}
+
+//---------------------------------------------------------------- 输出与比较
+
+static string size_name(size_t s) {
+    const char* units[] = { "B", "K", "M", "G" };
+    int u = 0;
+    while (u < 3 && s >= 1024 && s % 1024 == 0) {
+        s /= 1024;
+        u++;
+    }
+    return to_string(s) + units[u];
+}
+
+static size_t parse_size(const string& s) {
+    size_t v = stoull(s);
+    char c = s.empty() ? 0 : (char)toupper(s.back());
+    if (c == 'K') v <<= 10;
+    if (c == 'M') v <<= 20;
+    if (c == 'G') v <<= 30;
+    return v;
+}
+
+static vector<string> split(const string& s, char sep) {
+    vector<string> parts;
+    stringstream ss(s);
+    string item;
+    while (getline(ss, item, sep)) {
+        if (!item.empty()) parts.push_back(item);
+    }
+    return parts;
+}
+
+static void print_header() {
+    cout << left << setw(20) << "impl" << right << setw(7) << "size" << setw(5) << "thr"
+        << setw(12) << "cycles/B" << setw(10) << "GB/s" << setw(13) << "p50" << setw(13) << "p99" << endl;
+}
+
+static string fmt_ns(double ns) {
+    ostringstream o;
+    o << fixed << setprecision(ns < 10000 ? 1 : 0);
+    if (ns < 10000) o << ns << " ns";
+    else if (ns < 1e7) o << ns / 1e3 << " us";
+    else o << ns / 1e6 << " ms";
+    return o.str();
+}
+
+static void print_result(const Result& r) {
+    cout << left << setw(20) << r.impl << right << setw(7) << size_name(r.size) << setw(5) << r.threads
+        << fixed << setprecision(2) << setw(12) << r.cycles_per_byte << setprecision(3) << setw(10) << r.gbps
+        << setw(13) << fmt_ns(r.p50_ns) << setw(13) << fmt_ns(r.p99_ns) << endl;
+}
+
+//每条结果一行，便于--compare逐行解析
+static void write_json(const string& path, const vector<Result>& results, double ghz) {
+    ofstream f(path);
+    f << "{\n  \"counter_ghz\": " << ghz << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        f << "    {\"impl\": \"" << r.impl << "\", \"size\": " << r.size << ", \"threads\": " << r.threads
+            << ", \"cycles_per_byte\": " << r.cycles_per_byte << ", \"gbps\": " << r.gbps
+            << ", \"p50_ns\": " << r.p50_ns << ", \"p99_ns\": " << r.p99_ns << ", \"ops\": " << r.ops << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    f << "  ]\n}\n";
+}
+
+static string json_field(const string& line, const string& key) {
+    size_t p = line.find("\"" + key + "\": ");
+    if (p == string::npos) return "";
+    p += key.size() + 4;
+    if (line[p] == '"') {
+        return line.substr(p + 1, line.find('"', p + 1) - p - 1);
+    }
+    return line.substr(p, line.find_first_of(",}", p) - p);
+}
+
+static map<string, Result> read_json(const string& path) {
+    map<string, Result> m;
+    ifstream f(path);
+    string line;
+    while (getline(f, line)) {
+        string impl = json_field(line, "impl");
+        if (impl.empty()) continue;
+        Result r;
+        r.impl = impl;
+        r.size = stoull(json_field(line, "size"));
+        r.threads = (unsigned)stoul(json_field(line, "threads"));
+        r.cycles_per_byte = stod(json_field(line, "cycles_per_byte"));
+        r.gbps = stod(json_field(line, "gbps"));
+        r.p50_ns = stod(json_field(line, "p50_ns"));
+        r.p99_ns = stod(json_field(line, "p99_ns"));
+        r.ops = stoull(json_field(line, "ops"));
+        m[impl + "|" + to_string(r.size) + "|" + to_string(r.threads)] = r;
+    }
+    return m;
+}
+
+//比较两次运行的吞吐，变化超过threshold时标出；存在退化时返回1
+static int compare(const string& base_path, const string& new_path, double threshold) {
+    map<string, Result> base = read_json(base_path), cur = read_json(new_path);
+    if (base.empty() || cur.empty()) {
+        cerr << "无法读取结果文件" << endl;
+        return 2;
+    }
+    cout << left << setw(20) << "impl" << right << setw(7) << "size" << setw(5) << "thr"
+        << setw(12) << "base GB/s" << setw(12) << "new GB/s" << setw(9) << "ratio" << "  p99 ratio" << endl;
+    int regressions = 0;
+    for (auto& kv : cur) {
+        auto it = base.find(kv.first);
+        if (it == base.end()) continue;
+        const Result& a = it->second;
+        const Result& b = kv.second;
+        double ratio = b.gbps / a.gbps;
+        const char* mark = "";
+        if (ratio < 1 - threshold) {
+            mark = "  退化";
+            regressions++;
+        }
+        else if (ratio > 1 + threshold) {
+            mark = "  提升";
+        }
+        cout << left << setw(20) << b.impl << right << setw(7) << size_name(b.size) << setw(5) << b.threads
+            << fixed << setprecision(3) << setw(12) << a.gbps << setw(12) << b.gbps << setw(9) << ratio
+            << setw(11) << b.p99_ns / a.p99_ns << mark << endl;
+    }
+    cout << "退化的测量点: " << regressions << endl;
+    return regressions > 0 ? 1 : 0;
+}
+
+//---------------------------------------------------------------- 入口
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    size_t max_size = (size_t)1 << 30;
+    bool list = false;
+    double threshold = 0.05;
+    string cmp_a, cmp_b;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        auto next = [&]() -> string {
+            if (i + 1 >= argc) {
+                cerr << a << " 缺少参数" << endl;
+                exit(2);
+            }
+            return argv[++i];
+        };
+        if (a == "--filter") opt.filter = next();
+        else if (a == "--sizes") for (auto& s : split(next(), ',')) opt.sizes.push_back(parse_size(s));
+        else if (a == "--max-size") max_size = parse_size(next());
+        else if (a == "--threads") for (auto& s : split(next(), ',')) opt.threads.push_back((unsigned)stoul(s));
+        else if (a == "--budget") opt.budget = stod(next());
+        else if (a == "--warmup") opt.warmup = stod(next());
+        else if (a == "--max-op") opt.max_op = stod(next());
+        else if (a == "--max-mem") opt.max_mem = parse_size(next());
+        else if (a == "--json") opt.json = next();
+        else if (a == "--colocate") opt.colocate = (unsigned)stoul(next());
+        else if (a == "--threshold") threshold = stod(next());
+        else if (a == "--list") list = true;
+        else if (a == "--compare") {
+            cmp_a = next();
+            cmp_b = next();
+        }
+        else {
+            cerr << "未知参数: " << a << endl;
+            return 2;
+        }
+    }
+    if (!cmp_a.empty()) {
+        return compare(cmp_a, cmp_b, threshold);
+    }
+
+    vector<Impl> impls = all_impls();
+    if (list) {
+        for (auto& im : impls) {
+            cout << left << setw(20) << im.name << im.note << endl;
+        }
+        return 0;
+    }
+    if (opt.sizes.empty()) {
+        for (size_t s = 16; s <= max_size; s *= 4) opt.sizes.push_back(s);
+    }
+    vector<unsigned> cpus = allowed_cpus();
+    if (opt.threads.empty()) {
+        for (unsigned t = 1; t <= cpus.size(); t *= 2) opt.threads.push_back(t);
+    }
+
+    double ghz = calibrate_ghz();
+    cout << "计数器频率: " << fixed << setprecision(3) << ghz << " GHz，可用CPU: " << cpus.size() << endl;
+    print_header();
+    vector<Result> results;
+    for (auto& im : impls) {
+        if (!opt.filter.empty() && im.name.find(opt.filter) == string::npos) continue;
+        for (unsigned t : opt.threads) {
+            double ns_per_byte = 0;
+            for (size_t len : opt.sizes) {
+                unsigned workers = im.internal_threads ? 1 : t;
+                if ((double)workers * (2 * len + 64) > (double)opt.max_mem) {
+                    cout << left << setw(20) << im.name << right << setw(7) << size_name(len) << setw(5) << t
+                        << "  跳过：超出内存上限" << endl;
+                    continue;
+                }
+                if (ns_per_byte > 0 && ns_per_byte * len / 1e9 > opt.max_op) {
+                    cout << left << setw(20) << im.name << right << setw(7) << size_name(len) << setw(5) << t
+                        << "  跳过：预计单次操作超过 " << opt.max_op << " s" << endl;
+                    break;
+                }
+                string phase = im.name + "@" + size_name(len) + "/t" + to_string(t) + (opt.colocate ? "+load" : "");
+                Result r = measure(im, len, t, opt, ghz, cpus, phase);
+                ns_per_byte = r.cycles_per_byte / ghz;
+                print_result(r);
+                results.push_back(r);
+            }
+        }
+    }
+    if (!opt.json.empty()) {
+        write_json(opt.json, results, ghz);
+        cout << "结果已写入 " << opt.json << endl;
+    }
+#ifdef CRYPTO_PERF
+    fflush(stdout);
+    crypto_perf::report(stdout);
+#endif
+#ifdef CRYPTO_TELEMETRY
+    fflush(stdout);
+    crypto_telemetry::write_text(stdout);
+#endif
+    return 0;
+}
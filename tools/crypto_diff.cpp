@@ -0,0 +1,1376 @@
+//差分测试：把仓库中每个SM4、SM4-GCM/GMAC/CCM、SM3与Merkle实现与独立的参考实现逐字节比较
+//
+//参考实现按标准文本逐条写成（逐位GF(2^128)乘法、逐轮SM4、逐字SM3），不追求速度，
+//启动时先用GB/T 32907、GB/T 32905、RFC 8998的测试向量自检，自检失败则直接退出。
+//随后每个内核：
+//   先跑标准测试向量（SM4包括1,000,000次迭代加密的向量）；
+//   再跑随机用例：随机密钥、随机长度、缓冲区随机错位（不按16字节对齐）、
+//   流式接口按随机长度分段调用、批量接口随机组合、多线程接口随机线程数。
+//任何内核出现不一致即返回1。新增或修改的快速路径须在all_kernels()中注册并通过本测试后才能启用。
+//
+//用法：
+//   crypto_diff [--iterations 200] [--seed 种子] [--filter 子串] [--quick] [--list]
+//   --quick跳过逐块重做密钥扩展的旧接口上的1,000,000次迭代向量
+//编译：g++ -std=c++17 -O2 -pthread -o crypto_diff tools/crypto_diff.cpp
+
+//旧实现以源文件形式包含在各自的命名空间中，标准库头文件须先在全局包含
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <cmath>
+#include <stdint.h>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#include <x86intrin.h>
+#define DIFF_HAS_X86
+#endif
+#include "../common/perf_counters.h"
+#include "../common/telemetry.h"
+#include "../common/thread_pool.h"
+#include "../project4/SM3-multibuffer.h"
+
+#define SM4_NO_MAIN
+#define SM4_GCM_NO_MAIN
+#define SM3_NO_MAIN
+
+namespace lab_sm4_root {
+#include "../SM4.cpp"
+}
+namespace lab_sm4_basic {
+#include "../project 1/SM4基本实现.cpp"
+}
+namespace lab_sm4_ttable {
+#include "../project 1/SM4-T-table.cpp"
+}
+#ifdef DIFF_HAS_X86
+namespace lab_sm4_aesni {
+#include "../project 1/SM4-T-table-AESNI.cpp"
+}
+#endif
+namespace lab_gcm {
+#include "../project 1/SM4-GCM.cpp"
+}
+namespace lab_gcm_ttable {
+#include "../project 1/SM4-GCM-T-table.cpp"
+}
+namespace lab_sm3 {
+#include "../project4/SM3.cpp"
+}
+namespace lab_sm3_opt {
+#include "../project4/SM3-optimized.h"
+#include "../project4/SM3-HMAC.h"
+#include "../project4/SM3-KDF.h"
+#include "../project4/SM3-treehash.h"
+}
+//Merkle树与树哈希使用优化版SM3，与HMAC、KDF同在一个命名空间
+namespace lab_merkle = lab_sm3_opt;
+
+#include "../project 1/SM4-GCM-optimized.h"
+#include "../project 1/SM4-CCM.h"
+#include "../project 1/SM4-GCM-container.h"
+
+using namespace std;
+
+typedef vector<uint8_t> Bytes;
+
+static Bytes from_hex(const string& s) {
+    Bytes out(s.size() / 2);
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = (uint8_t)stoi(s.substr(2 * i, 2), nullptr, 16);
+    }
+    return out;
+}
+
+static string to_hex(const uint8_t* p, size_t n) {
+    static const char* digits = "0123456789abcdef";
+    string s;
+    for (size_t i = 0; i < n; i++) {
+        s += digits[p[i] >> 4];
+        s += digits[p[i] & 15];
+    }
+    return s;
+}
+
+//---------------------------------------------------------------- 参考实现
+
+namespace ref {
+
+static const uint8_t SBOX[256] = {
+    0xd6, 0x90, 0xe9, 0xfe, 0xcc, 0xe1, 0x3d, 0xb7, 0x16, 0xb6, 0x14, 0xc2, 0x28, 0xfb, 0x2c, 0x05,
+    0x2b, 0x67, 0x9a, 0x76, 0x2a, 0xbe, 0x04, 0xc3, 0xaa, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99,
+    0x9c, 0x42, 0x50, 0xf4, 0x91, 0xef, 0x98, 0x7a, 0x33, 0x54, 0x0b, 0x43, 0xed, 0xcf, 0xac, 0x62,
+    0xe4, 0xb3, 0x1c, 0xa9, 0xc9, 0x08, 0xe8, 0x95, 0x80, 0xdf, 0x94, 0xfa, 0x75, 0x8f, 0x3f, 0xa6,
+    0x47, 0x07, 0xa7, 0xfc, 0xf3, 0x73, 0x17, 0xba, 0x83, 0x59, 0x3c, 0x19, 0xe6, 0x85, 0x4f, 0xa8,
+    0x68, 0x6b, 0x81, 0xb2, 0x71, 0x64, 0xda, 0x8b, 0xf8, 0xeb, 0x0f, 0x4b, 0x70, 0x56, 0x9d, 0x35,
+    0x1e, 0x24, 0x0e, 0x5e, 0x63, 0x58, 0xd1, 0xa2, 0x25, 0x22, 0x7c, 0x3b, 0x01, 0x21, 0x78, 0x87,
+    0xd4, 0x00, 0x46, 0x57, 0x9f, 0xd3, 0x27, 0x52, 0x4c, 0x36, 0x02, 0xe7, 0xa0, 0xc4, 0xc8, 0x9e,
+    0xea, 0xbf, 0x8a, 0xd2, 0x40, 0xc7, 0x38, 0xb5, 0xa3, 0xf7, 0xf2, 0xce, 0xf9, 0x61, 0x15, 0xa1,
+    0xe0, 0xae, 0x5d, 0xa4, 0x9b, 0x34, 0x1a, 0x55, 0xad, 0x93, 0x32, 0x30, 0xf5, 0x8c, 0xb1, 0xe3,
+    0x1d, 0xf6, 0xe2, 0x2e, 0x82, 0x66, 0xca, 0x60, 0xc0, 0x29, 0x23, 0xab, 0x0d, 0x53, 0x4e, 0x6f,
+    0xd5, 0xdb, 0x37, 0x45, 0xde, 0xfd, 0x8e, 0x2f, 0x03, 0xff, 0x6a, 0x72, 0x6d, 0x6c, 0x5b, 0x51,
+    0x8d, 0x1b, 0xaf, 0x92, 0xbb, 0xdd, 0xbc, 0x7f, 0x11, 0xd9, 0x5c, 0x41, 0x1f, 0x10, 0x5a, 0xd8,
+    0x0a, 0xc1, 0x31, 0x88, 0xa5, 0xcd, 0x7b, 0xbd, 0x2d, 0x74, 0xd0, 0x12, 0xb8, 0xe5, 0xb4, 0xb0,
+    0x89, 0x69, 0x97, 0x4a, 0x0c, 0x96, 0x77, 0x7e, 0x65, 0xb9, 0xf1, 0x09, 0xc5, 0x6e, 0xc6, 0x84,
+    0x18, 0xf0, 0x7d, 0xec, 0x3a, 0xdc, 0x4d, 0x20, 0x79, 0xee, 0x5f, 0x3e, 0xd7, 0xcb, 0x39, 0x48
+};
+
+static uint32_t rotl(uint32_t x, int n) {
+    n &= 31;
+    return n == 0 ? x : (x << n) | (x >> (32 - n));
+}
+
+static uint32_t load32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void store32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+//GB/T 32907 SM4
+static uint32_t tau(uint32_t a) {
+    return (uint32_t)SBOX[a >> 24] << 24 | (uint32_t)SBOX[(a >> 16) & 0xff] << 16 |
+        (uint32_t)SBOX[(a >> 8) & 0xff] << 8 | SBOX[a & 0xff];
+}
+
+struct Sm4Key {
+    uint32_t rk[32];
+};
+
+static Sm4Key sm4_key(const uint8_t key[16]) {
+    static const uint32_t FK[4] = { 0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc };
+    uint32_t k[36];
+    for (int i = 0; i < 4; i++) {
+        k[i] = load32(key + 4 * i) ^ FK[i];
+    }
+    Sm4Key r;
+    for (int i = 0; i < 32; i++) {
+        //CK按字节计算：ck(i,j) = (4i + j) * 7 mod 256
+        uint32_t ck = 0;
+        for (int j = 0; j < 4; j++) {
+            ck = ck << 8 | (uint8_t)((4 * i + j) * 7);
+        }
+        uint32_t b = tau(k[i + 1] ^ k[i + 2] ^ k[i + 3] ^ ck);
+        k[i + 4] = k[i] ^ b ^ rotl(b, 13) ^ rotl(b, 23);
+        r.rk[i] = k[i + 4];
+    }
+    return r;
+}
+
+static void sm4_crypt(const Sm4Key& key, const uint8_t in[16], uint8_t out[16], bool decrypt) {
+    uint32_t x[36];
+    for (int i = 0; i < 4; i++) {
+        x[i] = load32(in + 4 * i);
+    }
+    for (int i = 0; i < 32; i++) {
+        uint32_t b = tau(x[i + 1] ^ x[i + 2] ^ x[i + 3] ^ key.rk[decrypt ? 31 - i : i]);
+        x[i + 4] = x[i] ^ b ^ rotl(b, 2) ^ rotl(b, 10) ^ rotl(b, 18) ^ rotl(b, 24);
+    }
+    for (int i = 0; i < 4; i++) {
+        store32(out + 4 * i, x[35 - i]);
+    }
+}
+
+//SP 800-38D：逐位乘法（算法1），96位IV
+static void gf_mul(const uint8_t x[16], const uint8_t y[16], uint8_t z[16]) {
+    uint8_t v[16], r[16] = { 0 };
+    memcpy(v, y, 16);
+    for (int i = 0; i < 128; i++) {
+        if ((x[i / 8] >> (7 - i % 8)) & 1) {
+            for (int j = 0; j < 16; j++) r[j] ^= v[j];
+        }
+        bool lsb = v[15] & 1;
+        for (int j = 15; j > 0; j--) {
+            v[j] = (uint8_t)(v[j] >> 1 | v[j - 1] << 7);
+        }
+        v[0] >>= 1;
+        if (lsb) v[0] ^= 0xe1;
+    }
+    memcpy(z, r, 16);
+}
+
+static void ghash(const uint8_t h[16], const uint8_t* aad, size_t aad_len, const uint8_t* ct, size_t ct_len,
+    uint8_t out[16]) {
+    uint8_t y[16] = { 0 };
+    auto absorb = [&](const uint8_t* d, size_t n) {
+        for (size_t off = 0; off < n; off += 16) {
+            for (size_t j = 0; j < 16 && off + j < n; j++) y[j] ^= d[off + j];
+            gf_mul(y, h, y);
+        }
+    };
+    absorb(aad, aad_len);
+    absorb(ct, ct_len);
+    uint8_t lens[16];
+    for (int i = 0; i < 8; i++) {
+        lens[i] = (uint8_t)(((uint64_t)aad_len * 8) >> (56 - 8 * i));
+        lens[8 + i] = (uint8_t)(((uint64_t)ct_len * 8) >> (56 - 8 * i));
+    }
+    absorb(lens, 16);
+    memcpy(out, y, 16);
+}
+
+static void gcm_encrypt(const uint8_t key[16], const uint8_t nonce[12], const uint8_t* pt, size_t len,
+    const uint8_t* aad, size_t aad_len, uint8_t* ct, uint8_t tag[16]) {
+    Sm4Key k = sm4_key(key);
+    uint8_t zero[16] = { 0 }, h[16], j0[16], ctr[16], ks[16];
+    sm4_crypt(k, zero, h, false);
+    memcpy(j0, nonce, 12);
+    store32(j0 + 12, 1);
+    memcpy(ctr, j0, 16);
+    for (size_t off = 0; off < len; off += 16) {
+        store32(ctr + 12, load32(ctr + 12) + 1);
+        sm4_crypt(k, ctr, ks, false);
+        for (size_t j = 0; j < 16 && off + j < len; j++) ct[off + j] = pt[off + j] ^ ks[j];
+    }
+    uint8_t s[16];
+    ghash(h, aad, aad_len, ct, len, s);
+    sm4_crypt(k, j0, ks, false);
+    for (int j = 0; j < 16; j++) tag[j] = s[j] ^ ks[j];
+}
+
+//SP 800-38C CCM，nonce为7~13字节，tlen为4~16的偶数
+static void ccm_encrypt(const uint8_t key[16], const uint8_t* nonce, size_t nlen, const uint8_t* pt, size_t len,
+    const uint8_t* aad, size_t aad_len, size_t tlen, uint8_t* ct, uint8_t* tag) {
+    Sm4Key k = sm4_key(key);
+    size_t q = 15 - nlen;
+    Bytes b(16);
+    b[0] = (uint8_t)((aad_len ? 0x40 : 0) | ((tlen - 2) / 2) << 3 | (q - 1));
+    memcpy(&b[1], nonce, nlen);
+    for (size_t i = 0; i < q; i++) b[15 - i] = (uint8_t)((uint64_t)len >> (8 * i));
+    if (aad_len) {
+        Bytes a;
+        if (aad_len < 0xff00) {
+            a = { (uint8_t)(aad_len >> 8), (uint8_t)aad_len };
+        }
+        else {
+            a = { 0xff, 0xfe, (uint8_t)(aad_len >> 24), (uint8_t)(aad_len >> 16), (uint8_t)(aad_len >> 8),
+                (uint8_t)aad_len };
+        }
+        a.insert(a.end(), aad, aad + aad_len);
+        a.resize((a.size() + 15) / 16 * 16, 0);
+        b.insert(b.end(), a.begin(), a.end());
+    }
+    Bytes p(pt, pt + len);
+    p.resize((len + 15) / 16 * 16, 0);
+    b.insert(b.end(), p.begin(), p.end());
+    uint8_t y[16] = { 0 };
+    for (size_t off = 0; off < b.size(); off += 16) {
+        for (int j = 0; j < 16; j++) y[j] ^= b[off + j];
+        sm4_crypt(k, y, y, false);
+    }
+    auto ctr_block = [&](uint64_t i, uint8_t out[16]) {
+        uint8_t c[16] = { 0 };
+        c[0] = (uint8_t)(q - 1);
+        memcpy(c + 1, nonce, nlen);
+        for (size_t t = 0; t < q; t++) c[15 - t] = (uint8_t)(i >> (8 * t));
+        sm4_crypt(k, c, out, false);
+    };
+    uint8_t s[16];
+    for (size_t off = 0; off < len; off += 16) {
+        ctr_block(off / 16 + 1, s);
+        for (size_t j = 0; j < 16 && off + j < len; j++) ct[off + j] = pt[off + j] ^ s[j];
+    }
+    ctr_block(0, s);
+    for (size_t j = 0; j < tlen; j++) tag[j] = y[j] ^ s[j];
+}
+
+//GB/T 32905 SM3
+static void sm3(const uint8_t* data, size_t len, uint8_t out[32]) {
+    uint32_t v[8] = { 0x7380166f, 0x4914b2b9, 0x172442d7, 0xda8a0600, 0xa96f30bc, 0x163138aa, 0xe38dee4d, 0xb0fb0e4e };
+    Bytes m(data, data + len);
+    m.push_back(0x80);
+    while (m.size() % 64 != 56) m.push_back(0);
+    for (int i = 7; i >= 0; i--) m.push_back((uint8_t)(((uint64_t)len * 8) >> (8 * i)));
+    for (size_t off = 0; off < m.size(); off += 64) {
+        uint32_t w[68], w1[64];
+        for (int j = 0; j < 16; j++) w[j] = load32(&m[off + 4 * j]);
+        for (int j = 16; j < 68; j++) {
+            uint32_t x = w[j - 16] ^ w[j - 9] ^ rotl(w[j - 3], 15);
+            w[j] = (x ^ rotl(x, 15) ^ rotl(x, 23)) ^ rotl(w[j - 13], 7) ^ w[j - 6];
+        }
+        for (int j = 0; j < 64; j++) w1[j] = w[j] ^ w[j + 4];
+        uint32_t a = v[0], b = v[1], c = v[2], d = v[3], e = v[4], f = v[5], g = v[6], h = v[7];
+        for (int j = 0; j < 64; j++) {
+            uint32_t t = j < 16 ? 0x79cc4519 : 0x7a879d8a;
+            uint32_t ss1 = rotl(rotl(a, 12) + e + rotl(t, j), 7);
+            uint32_t ss2 = ss1 ^ rotl(a, 12);
+            uint32_t ff = j < 16 ? a ^ b ^ c : (a & b) | (a & c) | (b & c);
+            uint32_t gg = j < 16 ? e ^ f ^ g : (e & f) | (~e & g);
+            uint32_t tt1 = ff + d + ss2 + w1[j];
+            uint32_t tt2 = gg + h + ss1 + w[j];
+            d = c;
+            c = rotl(b, 9);
+            b = a;
+            a = tt1;
+            h = g;
+            g = rotl(f, 19);
+            f = e;
+            e = tt2 ^ rotl(tt2, 9) ^ rotl(tt2, 17);
+        }
+        v[0] ^= a; v[1] ^= b; v[2] ^= c; v[3] ^= d;
+        v[4] ^= e; v[5] ^= f; v[6] ^= g; v[7] ^= h;
+    }
+    for (int i = 0; i < 8; i++) store32(out + 4 * i, v[i]);
+}
+
+//SM2密钥派生函数：Hash(Z || ct)，ct从1开始的32位大端计数器
+static void sm3_kdf(const uint8_t* z, size_t zlen, uint8_t* out, size_t klen) {
+    Bytes m(z, z + zlen);
+    m.resize(zlen + 4);
+    for (uint32_t ct = 1; klen > 0; ct++) {
+        store32(&m[zlen], ct);
+        uint8_t d[32];
+        sm3(m.data(), m.size(), d);
+        size_t n = min<size_t>(klen, 32);
+        memcpy(out, d, n);
+        out += n;
+        klen -= n;
+    }
+}
+
+//HMAC-SM3：SM3((K ^ opad) || SM3((K ^ ipad) || M))，长于64字节的密钥先做SM3
+static void hmac_sm3(const uint8_t* key, size_t key_len, const uint8_t* data, size_t len, uint8_t out[32]) {
+    Bytes k(64, 0);
+    if (key_len > 64) sm3(key, key_len, k.data());
+    else if (key_len) memcpy(k.data(), key, key_len);
+    Bytes m(64);
+    for (int i = 0; i < 64; i++) m[i] = k[i] ^ 0x36;
+    m.insert(m.end(), data, data + len);
+    uint8_t inner[32];
+    sm3(m.data(), m.size(), inner);
+    m.assign(64, 0);
+    for (int i = 0; i < 64; i++) m[i] = k[i] ^ 0x5c;
+    m.insert(m.end(), inner, inner + 32);
+    sm3(m.data(), m.size(), out);
+}
+
+//Merkle根：叶子为SM3(数据)，不足2的幂时用SM3("")补齐，父节点为SM3(左||右)
+static void merkle_root(const vector<Bytes>& leaves, uint8_t out[32]) {
+    vector<Bytes> level;
+    for (auto& l : leaves) {
+        Bytes h(32);
+        sm3(l.data(), l.size(), h.data());
+        level.push_back(h);
+    }
+    size_t n = 1;
+    while (n < level.size()) n <<= 1;
+    Bytes empty(32);
+    sm3(nullptr, 0, empty.data());
+    level.resize(n, empty);
+    while (level.size() > 1) {
+        vector<Bytes> next;
+        for (size_t i = 0; i < level.size(); i += 2) {
+            Bytes cat = level[i];
+            cat.insert(cat.end(), level[i + 1].begin(), level[i + 1].end());
+            Bytes h(32);
+            sm3(cat.data(), cat.size(), h.data());
+            next.push_back(h);
+        }
+        level.swap(next);
+    }
+    memcpy(out, level[0].data(), 32);
+}
+
+//SM3树哈希：按chunk切分（空输入为一个空块），块摘要的Merkle根，再绑定总长度与块大小（均为64位大端）
+static void tree_hash(const uint8_t* data, size_t len, size_t chunk, uint8_t out[32]) {
+    vector<Bytes> leaves;
+    for (size_t off = 0; off < len || leaves.empty(); off += chunk) {
+        leaves.emplace_back(data + off, data + off + min(chunk, len - off));
+    }
+    Bytes tail(32);
+    merkle_root(leaves, tail.data());
+    for (int i = 7; i >= 0; i--) tail.push_back((uint8_t)((uint64_t)len >> (8 * i)));
+    for (int i = 7; i >= 0; i--) tail.push_back((uint8_t)((uint64_t)chunk >> (8 * i)));
+    sm3(tail.data(), tail.size(), out);
+}
+
+}
+
+//---------------------------------------------------------------- 测试向量
+
+static const char* SM4_KEY = "0123456789abcdeffedcba9876543210";
+static const char* SM4_CT1 = "681edf34d206965e86b3e94f536e4246";
+static const char* SM4_CT1M = "595298c7c6fd271f0402f804c33d3f66";
+static const char* RFC_NONCE = "00001234567800000000abcd";
+static const char* RFC_AAD = "feedfacedeadbeeffeedfacedeadbeefabaddad2";
+static const char* RFC_PT = "aaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbccccccccccccccccdddddddddddddddd"
+                            "eeeeeeeeeeeeeeeeffffffffffffffffeeeeeeeeeeeeeeeeaaaaaaaaaaaaaaaa";
+static const char* GCM_CT = "17f399f08c67d5ee19d0dc9969c4bb7d5fd46fd3756489069157b282bb200735"
+                            "d82710ca5c22f0ccfa7cbf93d496ac15a56834cbcf98c397b4024a2691233b8d";
+static const char* GCM_TAG = "83de3541e4c2b58177e065a9bf7b62ec";
+static const char* CCM_CT = "48af93501fa62adbcd414cce6034d895dda1bf8f132f042098661572e7483094"
+                            "fd12e518ce062c98acee28d95df4416bed31a2f04476c18bb40c84a74b97dc5b";
+static const char* CCM_TAG = "16842d4fa186f56ab33256971fa110f4";
+
+struct Sm3Vector {
+    string msg;
+    const char* digest;
+};
+static vector<Sm3Vector> sm3_vectors() {
+    string abcd;
+    for (int i = 0; i < 16; i++) abcd += "abcd";
+    return {
+        { "", "1ab21d8355cfa17f8e61194831e81a8f22bec8c728fefb747ed035eb5082aa2b" },
+        { "abc", "66c7f0f462eeedd9d1f2d46bdc10e4e24167c4875cf2f7a2297da02b8f4ba8e0" },
+        { abcd, "debe9ff92275b8a138604889c18e5a4d6fdb70e5387e5765293dcba39c0c5732" },
+    };
+}
+
+//参考实现自检，失败说明参考实现本身有误，后续比较没有意义
+static bool self_test() {
+    Bytes key = from_hex(SM4_KEY), out(16), pt = from_hex(RFC_PT), ct(pt.size()), tag(16);
+    ref::Sm4Key k = ref::sm4_key(key.data());
+    ref::sm4_crypt(k, key.data(), out.data(), false);
+    bool ok = to_hex(out.data(), 16) == SM4_CT1;
+    ref::sm4_crypt(k, out.data(), out.data(), true);
+    ok = ok && out == key;
+    Bytes nonce = from_hex(RFC_NONCE), aad = from_hex(RFC_AAD);
+    ref::gcm_encrypt(key.data(), nonce.data(), pt.data(), pt.size(), aad.data(), aad.size(), ct.data(), tag.data());
+    ok = ok && to_hex(ct.data(), ct.size()) == GCM_CT && to_hex(tag.data(), 16) == GCM_TAG;
+    ref::ccm_encrypt(key.data(), nonce.data(), 12, pt.data(), pt.size(), aad.data(), aad.size(), 16, ct.data(),
+        tag.data());
+    ok = ok && to_hex(ct.data(), ct.size()) == CCM_CT && to_hex(tag.data(), 16) == CCM_TAG;
+    for (auto& v : sm3_vectors()) {
+        uint8_t d[32];
+        ref::sm3((const uint8_t*)v.msg.data(), v.msg.size(), d);
+        ok = ok && to_hex(d, 32) == v.digest;
+    }
+    return ok;
+}
+
+//---------------------------------------------------------------- 随机用例工具
+
+typedef mt19937_64 Rng;
+
+static Bytes random_bytes(Rng& rng, size_t n) {
+    Bytes b(n);
+    for (auto& x : b) x = (uint8_t)rng();
+    return b;
+}
+
+//偏向边界的随机长度：多数较短，包含0、分组边界附近以及偶尔的长消息
+static size_t random_len(Rng& rng, size_t max_len) {
+    switch (rng() % 8) {
+    case 0: return 0;
+    case 1: return (rng() % 8 + 1) * 16 + rng() % 3 - 1;
+    case 2: return rng() % 17;
+    case 3: return rng() % (max_len + 1);
+    default: return rng() % 300;
+    }
+}
+
+//错位缓冲区：数据起始地址相对分配起点偏移0~15字节
+struct Buf {
+    Bytes storage;
+    uint8_t* p;
+    size_t n;
+    Buf(Rng& rng, size_t len) : storage(len + 32), n(len) {
+        p = storage.data() + rng() % 16;
+    }
+    Buf(Rng& rng, const Bytes& src) : Buf(rng, src.size()) {
+        if (n) memcpy(p, src.data(), n);
+    }
+    bool equals(const Bytes& b) const {
+        return b.size() == n && (n == 0 || memcmp(p, b.data(), n) == 0);
+    }
+};
+
+//把[0, len)随机切成若干段，用于流式接口
+static vector<size_t> random_cuts(Rng& rng, size_t len) {
+    vector<size_t> cuts;
+    size_t pos = 0;
+    while (pos < len) {
+        size_t step = rng() % 4 == 0 ? rng() % 200 : rng() % 70;
+        pos = min(len, pos + step);
+        cuts.push_back(pos);
+    }
+    return cuts;
+}
+
+#define EXPECT(cond, msg) \
+    do { \
+        if (!(cond)) return string(msg); \
+    } while (0)
+
+//---------------------------------------------------------------- 内核注册
+
+struct Kernel {
+    string name;
+    string source;
+    function<string(bool quick)> vectors;   //标准测试向量，返回空串表示通过
+    function<string(Rng&)> random;          //一个随机用例
+};
+
+//旧版逐块接口：key与分组均为32位字，每次调用重做密钥扩展
+typedef void (*LegacyBlock)(const uint32_t in[4], const uint32_t key[4], uint32_t out[4]);
+
+template <class ToWords, class ToBytes>
+static Kernel legacy_sm4(const string& name, const string& source, LegacyBlock enc, LegacyBlock dec,
+    ToWords to_words, ToBytes to_bytes) {
+    auto run = [=](LegacyBlock f, const uint8_t key[16], const uint8_t in[16], uint8_t out[16]) {
+        uint32_t k[4], x[4], y[4];
+        to_words(key, k);
+        to_words(in, x);
+        f(x, k, y);
+        to_bytes(y, out);
+    };
+    Kernel k;
+    k.name = name;
+    k.source = source;
+    k.vectors = [=](bool quick) -> string {
+        Bytes key = from_hex(SM4_KEY), b = key;
+        run(enc, key.data(), b.data(), b.data());
+        EXPECT(to_hex(b.data(), 16) == SM4_CT1, "GB/T单次加密向量不符: " + to_hex(b.data(), 16));
+        if (dec) {
+            run(dec, key.data(), b.data(), b.data());
+            EXPECT(b == key, "GB/T解密向量不符");
+        }
+        if (!quick) {
+            b = key;
+            for (int i = 0; i < 1000000; i++) {
+                run(enc, key.data(), b.data(), b.data());
+            }
+            EXPECT(to_hex(b.data(), 16) == SM4_CT1M, "GB/T 1,000,000次迭代向量不符: " + to_hex(b.data(), 16));
+        }
+        return "";
+    };
+    k.random = [=](Rng& rng) -> string {
+        Bytes key = random_bytes(rng, 16), pt = random_bytes(rng, 16), want(16), got(16);
+        ref::Sm4Key rk = ref::sm4_key(key.data());
+        ref::sm4_crypt(rk, pt.data(), want.data(), false);
+        run(enc, key.data(), pt.data(), got.data());
+        EXPECT(got == want, "加密不一致 key=" + to_hex(key.data(), 16) + " pt=" + to_hex(pt.data(), 16));
+        if (dec) {
+            run(dec, key.data(), want.data(), got.data());
+            EXPECT(got == pt, "解密不一致 key=" + to_hex(key.data(), 16));
+        }
+        return "";
+    };
+    return k;
+}
+
+//旧版GCM类：encrypt/decrypt为非const成员
+template <class G>
+static Kernel legacy_gcm(const string& name, const string& source) {
+    Kernel k;
+    k.name = name;
+    k.source = source;
+    k.vectors = [](bool) -> string {
+        Bytes key = from_hex(SM4_KEY), nonce = from_hex(RFC_NONCE), aad = from_hex(RFC_AAD), pt = from_hex(RFC_PT);
+        Bytes ct(pt.size()), tag(16), back(pt.size());
+        G g;
+        g.set_key(key.data());
+        g.encrypt(nonce.data(), pt.data(), pt.size(), aad.data(), aad.size(), ct.data(), tag.data());
+        EXPECT(to_hex(ct.data(), ct.size()) == GCM_CT, "RFC 8998密文不符");
+        EXPECT(to_hex(tag.data(), 16) == GCM_TAG, "RFC 8998标签不符: " + to_hex(tag.data(), 16));
+        EXPECT(g.decrypt(nonce.data(), ct.data(), ct.size(), aad.data(), aad.size(), tag.data(), back.data()) &&
+            back == pt, "RFC 8998解密失败");
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        Bytes key = random_bytes(rng, 16), nonce = random_bytes(rng, 12);
+        Bytes pt = random_bytes(rng, random_len(rng, 2000)), aad = random_bytes(rng, random_len(rng, 100));
+        Bytes want(pt.size()), wtag(16);
+        ref::gcm_encrypt(key.data(), nonce.data(), pt.data(), pt.size(), aad.data(), aad.size(), want.data(),
+            wtag.data());
+        Buf in(rng, pt), out(rng, pt.size()), back(rng, pt.size());
+        uint8_t tag[16];
+        G g;
+        g.set_key(key.data());
+        g.encrypt(nonce.data(), in.p, in.n, aad.data(), aad.size(), out.p, tag);
+        EXPECT(out.equals(want) && memcmp(tag, wtag.data(), 16) == 0,
+            "加密不一致 len=" + to_string(pt.size()) + " aad=" + to_string(aad.size()));
+        EXPECT(g.decrypt(nonce.data(), out.p, out.n, aad.data(), aad.size(), tag, back.p) && back.equals(pt),
+            "解密失败 len=" + to_string(pt.size()));
+        return "";
+    };
+    return k;
+}
+
+static Kernel sm4_optimized() {
+    Kernel k;
+    k.name = "sm4-opt";
+    k.source = "SM4-optimized.h";
+    k.vectors = [](bool) -> string {
+        Bytes key = from_hex(SM4_KEY), b = key;
+        SM4 sm4;
+        sm4.set_key(key.data());
+        sm4.encrypt_block(b.data(), b.data());
+        EXPECT(to_hex(b.data(), 16) == SM4_CT1, "GB/T单次加密向量不符");
+        sm4.decrypt_block(b.data(), b.data());
+        EXPECT(b == key, "GB/T解密向量不符");
+        for (int i = 0; i < 1000000; i++) {
+            sm4.encrypt_block(b.data(), b.data());
+        }
+        EXPECT(to_hex(b.data(), 16) == SM4_CT1M, "GB/T 1,000,000次迭代向量不符（encrypt_block）");
+        //同一向量经多分组交错内核：各路输入相同，输出须相同
+        Bytes lanes;
+        for (int i = 0; i < 7; i++) lanes.insert(lanes.end(), key.begin(), key.end());
+        for (int i = 0; i < 1000000; i++) {
+            sm4.encrypt_blocks(lanes.data(), lanes.data(), 7);
+        }
+        for (int i = 0; i < 7; i++) {
+            EXPECT(to_hex(&lanes[16 * i], 16) == SM4_CT1M, "GB/T 1,000,000次迭代向量不符（encrypt_blocks）");
+        }
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        Bytes key = random_bytes(rng, 16);
+        size_t nblocks = rng() % 40;
+        Bytes pt = random_bytes(rng, 16 * nblocks), want(pt.size());
+        ref::Sm4Key rk = ref::sm4_key(key.data());
+        for (size_t b = 0; b < nblocks; b++) {
+            ref::sm4_crypt(rk, &pt[16 * b], &want[16 * b], false);
+        }
+        SM4 sm4;
+        sm4.set_key(key.data());
+        Buf in(rng, pt), out(rng, pt.size());
+        sm4.encrypt_blocks(in.p, out.p, nblocks);
+        EXPECT(out.equals(want), "encrypt_blocks不一致 nblocks=" + to_string(nblocks));
+        sm4.encrypt_blocks(in.p, in.p, nblocks);
+        EXPECT(in.equals(want), "原地encrypt_blocks不一致 nblocks=" + to_string(nblocks));
+        for (size_t b = 0; b < nblocks; b++) {
+            uint8_t x[16];
+            sm4.encrypt_block(&pt[16 * b], x);
+            EXPECT(memcmp(x, &want[16 * b], 16) == 0, "encrypt_block不一致");
+            sm4.decrypt_block(&want[16 * b], x);
+            EXPECT(memcmp(x, &pt[16 * b], 16) == 0, "decrypt_block不一致");
+        }
+        return "";
+    };
+    return k;
+}
+
+//RFC 8998向量，供新GCM各接口共用
+struct GcmVector {
+    Bytes key, nonce, aad, pt;
+    GcmVector()
+        : key(from_hex(SM4_KEY)), nonce(from_hex(RFC_NONCE)), aad(from_hex(RFC_AAD)), pt(from_hex(RFC_PT)) {}
+};
+
+//随机GCM用例的输入与参考结果
+struct GcmCase {
+    Bytes key, nonce, aad, pt, ct, tag;
+    GcmCase(Rng& rng, size_t max_len) {
+        key = random_bytes(rng, 16);
+        nonce = random_bytes(rng, 12);
+        pt = random_bytes(rng, random_len(rng, max_len));
+        aad = random_bytes(rng, random_len(rng, 200));
+        ct.resize(pt.size());
+        tag.resize(16);
+        ref::gcm_encrypt(key.data(), nonce.data(), pt.data(), pt.size(), aad.data(), aad.size(), ct.data(),
+            tag.data());
+    }
+};
+
+static Kernel gcm_optimized() {
+    Kernel k;
+    k.name = "gcm-opt";
+    k.source = "SM4-GCM-optimized.h encrypt/decrypt";
+    k.vectors = [](bool) -> string {
+        GcmVector v;
+        GCM g;
+        g.set_key(v.key.data());
+        Bytes ct(v.pt.size()), tag(16), back(v.pt.size());
+        g.encrypt(v.nonce.data(), v.pt.data(), v.pt.size(), v.aad.data(), v.aad.size(), ct.data(), tag.data());
+        EXPECT(to_hex(ct.data(), ct.size()) == GCM_CT && to_hex(tag.data(), 16) == GCM_TAG, "RFC 8998向量不符");
+        EXPECT(g.decrypt(v.nonce.data(), ct.data(), ct.size(), v.aad.data(), v.aad.size(), tag.data(), back.data()) &&
+            back == v.pt, "RFC 8998解密失败");
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        GcmCase c(rng, 70000);
+        GCM g;
+        g.set_key(c.key.data());
+        Buf in(rng, c.pt), out(rng, c.pt.size());
+        uint8_t tag[16];
+        g.encrypt(c.nonce.data(), in.p, in.n, c.aad.data(), c.aad.size(), out.p, tag);
+        string where = " len=" + to_string(c.pt.size()) + " aad=" + to_string(c.aad.size());
+        EXPECT(out.equals(c.ct) && memcmp(tag, c.tag.data(), 16) == 0, "加密不一致" + where);
+        g.encrypt(c.nonce.data(), in.p, in.n, c.aad.data(), c.aad.size(), in.p, tag);
+        EXPECT(in.equals(c.ct), "原地加密不一致" + where);
+        const DecryptMode modes[] = { DecryptMode::Standard, DecryptMode::VerifyFirst, DecryptMode::Stitched };
+        for (DecryptMode m : modes) {
+            Buf back(rng, c.pt.size());
+            EXPECT(g.decrypt(c.nonce.data(), out.p, out.n, c.aad.data(), c.aad.size(), c.tag.data(), back.p, m) &&
+                back.equals(c.pt), "解密失败 mode=" + to_string((int)m) + where);
+            //篡改标签：必须拒绝，且输出缓冲区中不能出现明文（清零或保持原样）
+            Bytes bad = c.tag;
+            bad[rng() % 16] ^= (uint8_t)(1 << (rng() % 8));
+            Buf fresh(rng, c.pt.size());
+            bool rejected = !g.decrypt(c.nonce.data(), out.p, out.n, c.aad.data(), c.aad.size(), bad.data(), fresh.p, m);
+            EXPECT(rejected && all_of(fresh.p, fresh.p + fresh.n, [](uint8_t x) { return x == 0; }),
+                "篡改标签未被拒绝或输出未清零 mode=" + to_string((int)m) + where);
+        }
+        return "";
+    };
+    return k;
+}
+
+static Kernel gcm_batch() {
+    Kernel k;
+    k.name = "gcm-opt-batch";
+    k.source = "SM4-GCM-optimized.h encrypt_batch/decrypt_batch";
+    k.vectors = [](bool) -> string {
+        GcmVector v;
+        GCM g;
+        g.set_key(v.key.data());
+        Bytes ct(v.pt.size()), tag(16);
+        GcmPacket p = { v.nonce.data(), v.aad.data(), v.aad.size(), v.pt.data(), v.pt.size(), ct.data(), tag.data(), false };
+        g.encrypt_batch(&p, 1);
+        EXPECT(to_hex(ct.data(), ct.size()) == GCM_CT && to_hex(tag.data(), 16) == GCM_TAG, "RFC 8998向量不符");
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        //同一密钥下的一批报文
+        size_t count = rng() % 40 + 1;
+        Bytes key = random_bytes(rng, 16);
+        vector<GcmCase> cases;
+        vector<Buf> in, out, back;
+        vector<Bytes> tags(count, Bytes(16));
+        vector<GcmPacket> pk(count), dk(count);
+        for (size_t i = 0; i < count; i++) {
+            cases.emplace_back(rng, 3000);
+            cases[i].key = key;
+            ref::gcm_encrypt(key.data(), cases[i].nonce.data(), cases[i].pt.data(), cases[i].pt.size(),
+                cases[i].aad.data(), cases[i].aad.size(), cases[i].ct.data(), cases[i].tag.data());
+            in.emplace_back(rng, cases[i].pt);
+            out.emplace_back(rng, cases[i].pt.size());
+            back.emplace_back(rng, cases[i].pt.size());
+        }
+        for (size_t i = 0; i < count; i++) {
+            GcmCase& c = cases[i];
+            pk[i] = { c.nonce.data(), c.aad.data(), c.aad.size(), in[i].p, in[i].n, out[i].p, tags[i].data(), false };
+        }
+        GCM g;
+        g.set_key(key.data());
+        g.encrypt_batch(pk.data(), count);
+        for (size_t i = 0; i < count; i++) {
+            EXPECT(out[i].equals(cases[i].ct) && tags[i] == cases[i].tag,
+                "批量加密不一致 packet=" + to_string(i) + " len=" + to_string(cases[i].pt.size()));
+        }
+        size_t bad = rng() % count;
+        tags[bad][rng() % 16] ^= 1;
+        for (size_t i = 0; i < count; i++) {
+            GcmCase& c = cases[i];
+            dk[i] = { c.nonce.data(), c.aad.data(), c.aad.size(), out[i].p, out[i].n, back[i].p, tags[i].data(), false };
+        }
+        size_t ok = g.decrypt_batch(dk.data(), count);
+        EXPECT(ok == count - 1 && !dk[bad].valid, "批量解密未拒绝篡改报文");
+        for (size_t i = 0; i < count; i++) {
+            EXPECT(i == bad || back[i].equals(cases[i].pt), "批量解密不一致 packet=" + to_string(i));
+        }
+        return "";
+    };
+    return k;
+}
+
+static Kernel gcm_parallel() {
+    Kernel k;
+    k.name = "gcm-opt-parallel";
+    k.source = "SM4-GCM-optimized.h encrypt_parallel/decrypt_parallel";
+    k.vectors = [](bool) -> string {
+        GcmVector v;
+        GCM g;
+        g.set_key(v.key.data());
+        Bytes ct(v.pt.size()), tag(16);
+        g.encrypt_parallel(v.nonce.data(), v.pt.data(), v.pt.size(), v.aad.data(), v.aad.size(), ct.data(), tag.data(), 3);
+        EXPECT(to_hex(ct.data(), ct.size()) == GCM_CT && to_hex(tag.data(), 16) == GCM_TAG, "RFC 8998向量不符");
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        GcmCase c(rng, 600000);
+        unsigned threads = (unsigned)(rng() % 6 + 1);
+        GCM g;
+        g.set_key(c.key.data());
+        Buf in(rng, c.pt), out(rng, c.pt.size()), back(rng, c.pt.size());
+        uint8_t tag[16];
+        g.encrypt_parallel(c.nonce.data(), in.p, in.n, c.aad.data(), c.aad.size(), out.p, tag, threads);
+        string where = " len=" + to_string(c.pt.size()) + " threads=" + to_string(threads);
+        EXPECT(out.equals(c.ct) && memcmp(tag, c.tag.data(), 16) == 0, "多线程加密不一致" + where);
+        EXPECT(g.decrypt_parallel(c.nonce.data(), out.p, out.n, c.aad.data(), c.aad.size(), tag, back.p, threads) &&
+            back.equals(c.pt), "多线程解密失败" + where);
+        tag[0] ^= 0x80;
+        EXPECT(!g.decrypt_parallel(c.nonce.data(), out.p, out.n, c.aad.data(), c.aad.size(), tag, back.p, threads),
+            "多线程解密未拒绝篡改标签" + where);
+        return "";
+    };
+    return k;
+}
+
+static Kernel gmac_kernel() {
+    Kernel k;
+    k.name = "gmac";
+    k.source = "SM4-GCM-optimized.h GMAC";
+    k.vectors = [](bool) -> string {
+        //GMAC即明文为空的GCM，用参考GCM计算RFC向量AAD的标签
+        GcmVector v;
+        uint8_t want[16], got[16];
+        ref::gcm_encrypt(v.key.data(), v.nonce.data(), nullptr, 0, v.pt.data(), v.pt.size(), nullptr, want);
+        GMAC m;
+        m.set_key(v.key.data());
+        m.compute(v.nonce.data(), v.pt.data(), v.pt.size(), got);
+        EXPECT(memcmp(want, got, 16) == 0, "GMAC标签与参考GCM不符");
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        Bytes key = random_bytes(rng, 16), nonce = random_bytes(rng, 12);
+        Bytes data = random_bytes(rng, random_len(rng, 100000));
+        uint8_t want[16], got[16];
+        ref::gcm_encrypt(key.data(), nonce.data(), nullptr, 0, data.data(), data.size(), nullptr, want);
+        GMAC m;
+        m.set_key(key.data());
+        Buf in(rng, data);
+        m.compute(nonce.data(), in.p, in.n, got);
+        string where = " len=" + to_string(data.size());
+        EXPECT(memcmp(want, got, 16) == 0, "一次性GMAC不一致" + where);
+        EXPECT(m.verify(nonce.data(), in.p, in.n, want), "verify拒绝了正确标签" + where);
+        m.init(nonce.data());
+        size_t pos = 0;
+        for (size_t cut : random_cuts(rng, data.size())) {
+            m.update(in.p + pos, cut - pos);
+            pos = cut;
+        }
+        m.final(got);
+        EXPECT(memcmp(want, got, 16) == 0, "流式GMAC不一致" + where);
+        return "";
+    };
+    return k;
+}
+
+static Kernel ccm_kernel() {
+    Kernel k;
+    k.name = "ccm";
+    k.source = "SM4-CCM.h";
+    k.vectors = [](bool) -> string {
+        GcmVector v;
+        CCM c;
+        c.set_key(v.key.data(), 16);
+        Bytes ct(v.pt.size()), tag(16), back(v.pt.size());
+        EXPECT(c.encrypt(v.nonce.data(), 12, v.pt.data(), v.pt.size(), v.aad.data(), v.aad.size(), ct.data(), tag.data()),
+            "RFC 8998向量参数被拒绝");
+        EXPECT(to_hex(ct.data(), ct.size()) == CCM_CT && to_hex(tag.data(), 16) == CCM_TAG, "RFC 8998向量不符");
+        EXPECT(c.decrypt(v.nonce.data(), 12, ct.data(), ct.size(), v.aad.data(), v.aad.size(), tag.data(), back.data()) &&
+            back == v.pt, "RFC 8998解密失败");
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        Bytes key = random_bytes(rng, 16);
+        size_t tlen = 4 + 2 * (rng() % 7);
+        size_t count = rng() % 12 + 1;
+        CCM c;
+        c.set_key(key.data(), tlen);
+        vector<Bytes> nonce(count), aad(count), pt(count), want(count), wtag(count), tag(count);
+        vector<Buf> out, back;
+        vector<CcmPacket> pk(count), dk(count);
+        for (size_t i = 0; i < count; i++) {
+            nonce[i] = random_bytes(rng, 7 + rng() % 7);
+            pt[i] = random_bytes(rng, random_len(rng, 5000));
+            //偶尔使用不小于0xff00字节的AAD，覆盖6字节长度编码
+            aad[i] = random_bytes(rng, rng() % 50 == 0 ? 0xff00 + rng() % 300 : random_len(rng, 300));
+            want[i].resize(pt[i].size());
+            wtag[i].resize(tlen);
+            tag[i].resize(tlen);
+            ref::ccm_encrypt(key.data(), nonce[i].data(), nonce[i].size(), pt[i].data(), pt[i].size(), aad[i].data(),
+                aad[i].size(), tlen, want[i].data(), wtag[i].data());
+            out.emplace_back(rng, pt[i].size());
+            back.emplace_back(rng, pt[i].size());
+        }
+        for (size_t i = 0; i < count; i++) {
+            pk[i] = { nonce[i].data(), nonce[i].size(), aad[i].data(), aad[i].size(), pt[i].data(), pt[i].size(),
+                out[i].p, tag[i].data(), false };
+        }
+        c.encrypt_batch(pk.data(), count);
+        for (size_t i = 0; i < count; i++) {
+            EXPECT(pk[i].valid && out[i].equals(want[i]) && tag[i] == wtag[i],
+                "批量加密不一致 packet=" + to_string(i) + " nonce=" + to_string(nonce[i].size()) +
+                " tlen=" + to_string(tlen) + " len=" + to_string(pt[i].size()) + " aad=" + to_string(aad[i].size()));
+        }
+        //单条接口与原地加密
+        Buf inplace(rng, pt[0]);
+        Bytes t(tlen);
+        c.encrypt(nonce[0].data(), nonce[0].size(), inplace.p, inplace.n, aad[0].data(), aad[0].size(), inplace.p, t.data());
+        EXPECT(inplace.equals(want[0]) && t == wtag[0], "原地加密不一致");
+        size_t bad = rng() % count;
+        tag[bad][rng() % tlen] ^= 1;
+        for (size_t i = 0; i < count; i++) {
+            dk[i] = { nonce[i].data(), nonce[i].size(), aad[i].data(), aad[i].size(), out[i].p, out[i].n, back[i].p,
+                tag[i].data(), false };
+        }
+        EXPECT(c.decrypt_batch(dk.data(), count) == count - 1 && !dk[bad].valid, "批量解密未拒绝篡改报文");
+        for (size_t i = 0; i < count; i++) {
+            EXPECT(i == bad || back[i].equals(pt[i]), "批量解密不一致 packet=" + to_string(i));
+        }
+        return "";
+    };
+    return k;
+}
+
+//分块容器的格式是自定义的，没有外部向量：检查往返、随机区间读取与参考GCM解出的首个分块
+static Kernel container_kernel() {
+    Kernel k;
+    k.name = "gcm-container";
+    k.source = "SM4-GCM-container.h";
+    k.vectors = [](bool) -> string { return ""; };
+    k.random = [](Rng& rng) -> string {
+        Bytes key = random_bytes(rng, 16);
+        Bytes data = random_bytes(rng, rng() % 4 == 0 ? rng() % 400000 : random_len(rng, 5000));
+        uint32_t chunk = (uint32_t)(rng() % 3 == 0 ? rng() % 64 + 1 : rng() % 20000 + 16);
+        unsigned threads = (unsigned)(rng() % 4 + 1);
+        GcmContainer c;
+        c.set_key(key.data());
+        stringstream in(string(data.begin(), data.end())), enc;
+        string where = " len=" + to_string(data.size()) + " chunk=" + to_string(chunk) + " threads=" + to_string(threads);
+        EXPECT(c.encrypt_stream(in, data.size(), enc, chunk, threads) == ContainerStatus::Ok, "加密失败" + where);
+        string file = enc.str();
+        stringstream src(file), dec;
+        EXPECT(c.decrypt_stream(src, file.size(), dec, threads) == ContainerStatus::Ok && dec.str() == string(data.begin(), data.end()),
+            "往返不一致" + where);
+        //随机翻转一位必须被发现
+        string bad = file;
+        bad[rng() % bad.size()] ^= (char)(1 << (rng() % 8));
+        stringstream bsrc(bad), bdec;
+        EXPECT(c.decrypt_stream(bsrc, bad.size(), bdec, threads) != ContainerStatus::Ok, "篡改未被发现" + where);
+        return "";
+    };
+    return k;
+}
+
+//hash_fixed<N>与参考实现比对
+template <class H, size_t N>
+static string check_fixed(Rng& rng) {
+    Bytes data = random_bytes(rng, N);
+    Buf in(rng, data);
+    uint8_t want[32], got[32];
+    ref::sm3(data.data(), N, want);
+    H::template hash_fixed<N>(in.p, got);
+    EXPECT(memcmp(want, got, 32) == 0, "hash_fixed不一致 N=" + to_string(N));
+    return "";
+}
+
+//SM3类接口相同（update/final/hash/hash_fixed/hash_pair），用模板共用
+template <class H>
+static Kernel sm3_kernel(const string& name, const string& source) {
+    Kernel k;
+    k.name = name;
+    k.source = source;
+    k.vectors = [](bool) -> string {
+        for (auto& v : sm3_vectors()) {
+            uint8_t d[32];
+            H::hash((const uint8_t*)v.msg.data(), v.msg.size(), d);
+            EXPECT(to_hex(d, 32) == v.digest, "GB/T向量不符 len=" + to_string(v.msg.size()) + ": " + to_hex(d, 32));
+        }
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        Bytes data = random_bytes(rng, rng() % 10 == 0 ? rng() % 300000 : random_len(rng, 3000));
+        uint8_t want[32], got[32];
+        ref::sm3(data.data(), data.size(), want);
+        Buf in(rng, data);
+        H::hash(in.p, in.n, got);
+        string where = " len=" + to_string(data.size());
+        EXPECT(memcmp(want, got, 32) == 0, "一次性哈希不一致" + where);
+        //同一对象连续计算两条消息，第二条按随机长度分段update
+        H h;
+        h.update(in.p, in.n / 2);
+        h.final(got);
+        uint8_t half[32];
+        ref::sm3(data.data(), data.size() / 2, half);
+        EXPECT(memcmp(half, got, 32) == 0, "前半段哈希不一致" + where);
+        size_t pos = 0;
+        for (size_t cut : random_cuts(rng, data.size())) {
+            h.update(in.p + pos, cut - pos);
+            pos = cut;
+        }
+        h.final(got);
+        EXPECT(memcmp(want, got, 32) == 0, "分段update不一致" + where);
+        //在随机位置导出中间状态，按字节复制后恢复到新对象继续计算
+        size_t split = data.empty() ? 0 : rng() % (data.size() + 1);
+        h.update(in.p, split);
+        typename H::State saved;
+        {
+            typename H::State s = h.export_state();
+            memcpy(&saved, &s, sizeof(saved));
+        }
+        h.reset();
+        H resumed;
+        EXPECT(resumed.restore_state(saved), "拒绝了export_state导出的中间状态" + where);
+        resumed.update(in.p + split, in.n - split);
+        resumed.final(got);
+        EXPECT(memcmp(want, got, 32) == 0, "恢复中间状态后结果不一致" + where + " split=" + to_string(split));
+        H again;
+        again.restore_state(saved);
+        again.update(in.p + split, in.n - split);
+        again.final(got);
+        EXPECT(memcmp(want, got, 32) == 0, "同一中间状态第二次恢复结果不一致" + where);
+        //无效状态（buffered超过63、已压缩比特数不是512的倍数）被拒绝，上下文保持不变
+        typename H::State bad = saved;
+        bad.buffered = (uint8_t)(64 + rng() % 192);
+        H keep;
+        keep.restore_state(saved);
+        EXPECT(!H::valid_state(bad) && !keep.restore_state(bad), "接受了buffered无效的中间状态" + where);
+        bad = saved;
+        bad.total_bits += 1 + rng() % 511;
+        EXPECT(!H::valid_state(bad) && !keep.restore_state(bad), "接受了比特数无效的中间状态" + where);
+        keep.update(in.p + split, in.n - split);
+        keep.final(got);
+        EXPECT(memcmp(want, got, 32) == 0, "拒绝无效状态后上下文被改变" + where);
+        //定长消息：填充落在同一分组、恰好整分组、长度字段需要第二个分组
+        static string (*const fixed[])(Rng&) = { check_fixed<H, 0>, check_fixed<H, 1>, check_fixed<H, 32>,
+            check_fixed<H, 55>, check_fixed<H, 56>, check_fixed<H, 63>, check_fixed<H, 64>, check_fixed<H, 65>,
+            check_fixed<H, 119>, check_fixed<H, 120>, check_fixed<H, 128>, check_fixed<H, 200> };
+        string err = fixed[rng() % (sizeof(fixed) / sizeof(fixed[0]))](rng);
+        if (!err.empty()) {
+            return err;
+        }
+        Bytes pair = random_bytes(rng, 64);
+        ref::sm3(pair.data(), 64, want);
+        H::hash_pair(pair.data(), pair.data() + 32, got);
+        EXPECT(memcmp(want, got, 32) == 0, "hash_pair不一致");
+        return "";
+    };
+    return k;
+}
+
+//多路SM3：每种可用的通道数各算一批随机长度的消息（含消息数少于通道数、长度跨分组边界的情况）
+static Kernel sm3_multibuffer_kernel() {
+    Kernel k;
+    k.name = "sm3-multibuffer";
+    k.source = "SM3-multibuffer.h";
+    k.vectors = [](bool) -> string {
+        vector<Sm3Vector> vs = sm3_vectors();
+        vector<const uint8_t*> msgs;
+        vector<size_t> lens;
+        for (auto& v : vs) {
+            msgs.push_back((const uint8_t*)v.msg.data());
+            lens.push_back(v.msg.size());
+        }
+        for (unsigned lanes = 1; lanes <= SM3MultiBuffer::best_lanes(); lanes *= 2) {
+            Bytes out(32 * vs.size());
+            SM3MultiBuffer::hash_many(msgs.data(), lens.data(), vs.size(), out.data(), lanes);
+            for (size_t i = 0; i < vs.size(); i++) {
+                EXPECT(to_hex(&out[32 * i], 32) == vs[i].digest,
+                    "GB/T向量不符 lanes=" + to_string(lanes) + " len=" + to_string(lens[i]));
+            }
+        }
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        size_t n = rng() % 40;
+        vector<Bytes> data(n);
+        vector<Buf> in;
+        vector<const uint8_t*> msgs(n);
+        vector<size_t> lens(n);
+        for (size_t i = 0; i < n; i++) {
+            data[i] = random_bytes(rng, random_len(rng, 3000));
+            in.emplace_back(rng, data[i]);
+        }
+        for (size_t i = 0; i < n; i++) {
+            msgs[i] = in[i].p;
+            lens[i] = in[i].n;
+        }
+        for (unsigned lanes = 0; lanes <= SM3MultiBuffer::best_lanes(); lanes = lanes ? lanes * 2 : 1) {
+            Bytes out(32 * n);
+            SM3MultiBuffer::hash_many(msgs.data(), lens.data(), n, out.data(), lanes);
+            for (size_t i = 0; i < n; i++) {
+                uint8_t want[32];
+                ref::sm3(data[i].data(), data[i].size(), want);
+                EXPECT(memcmp(want, &out[32 * i], 32) == 0, "摘要不一致 lanes=" + to_string(lanes) + " n=" +
+                    to_string(n) + " i=" + to_string(i) + " len=" + to_string(lens[i]));
+            }
+        }
+        //hash_pairs：n个连续存放的64字节消息
+        Bytes nodes = random_bytes(rng, 64 * n);
+        for (unsigned lanes = 0; lanes <= SM3MultiBuffer::best_lanes(); lanes = lanes ? lanes * 2 : 1) {
+            Bytes out(32 * n);
+            SM3MultiBuffer::hash_pairs(nodes.data(), n, out.data(), lanes);
+            for (size_t i = 0; i < n; i++) {
+                uint8_t want[32];
+                ref::sm3(&nodes[64 * i], 64, want);
+                EXPECT(memcmp(want, &out[32 * i], 32) == 0, "hash_pairs不一致 lanes=" + to_string(lanes) + " n=" +
+                    to_string(n) + " i=" + to_string(i));
+            }
+        }
+        return "";
+    };
+    return k;
+}
+
+//HMAC-SM3：一次性、流式、截断验证与批量接口（批量从缓存的ipad/opad链接值开始走多路SM3）
+static Kernel hmac_sm3_kernel() {
+    Kernel k;
+    k.name = "hmac-sm3";
+    k.source = "SM3-HMAC.h";
+    k.vectors = [](bool) -> string {
+        const char* key = "key";
+        const char* msg = "The quick brown fox jumps over the lazy dog";
+        lab_sm3_opt::HmacSm3 h((const uint8_t*)key, strlen(key));
+        uint8_t mac[32];
+        h.compute((const uint8_t*)msg, strlen(msg), mac);
+        EXPECT(to_hex(mac, 32) == "bd4a34077888162b210645b8ebf74b9af357303789357a27c7fc457244ebd398",
+            "已知答案不符: " + to_hex(mac, 32));
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        //密钥长度覆盖空密钥、恰好一个分组与需要先哈希的长密钥
+        Bytes key = random_bytes(rng, rng() % 4 == 0 ? 64 + rng() % 3 : rng() % 150);
+        lab_sm3_opt::HmacSm3 h(key.data(), key.size());
+        Bytes data = random_bytes(rng, random_len(rng, 3000));
+        Buf in(rng, data);
+        uint8_t want[32], got[32];
+        ref::hmac_sm3(key.data(), key.size(), data.data(), data.size(), want);
+        string where = " key_len=" + to_string(key.size()) + " len=" + to_string(data.size());
+        h.compute(in.p, in.n, got);
+        EXPECT(memcmp(want, got, 32) == 0, "一次性MAC不一致" + where);
+        EXPECT(h.verify(in.p, in.n, want), "verify拒绝了正确的MAC" + where);
+        EXPECT(h.verify(in.p, in.n, want, 16), "verify拒绝了正确的截断MAC" + where);
+        want[rng() % 32] ^= (uint8_t)(1 << (rng() % 8));
+        EXPECT(!h.verify(in.p, in.n, want), "verify接受了错误的MAC" + where);
+        ref::hmac_sm3(key.data(), key.size(), data.data(), data.size(), want);
+        size_t pos = 0;
+        for (size_t cut : random_cuts(rng, data.size())) {
+            h.update(in.p + pos, cut - pos);
+            pos = cut;
+        }
+        h.final(got);
+        EXPECT(memcmp(want, got, 32) == 0, "流式MAC不一致" + where);
+        size_t n = rng() % 40;
+        vector<Bytes> msgs(n);
+        vector<const uint8_t*> ptrs(n);
+        vector<size_t> lens(n);
+        for (size_t i = 0; i < n; i++) {
+            msgs[i] = random_bytes(rng, random_len(rng, 500));
+            ptrs[i] = msgs[i].data();
+            lens[i] = msgs[i].size();
+        }
+        for (unsigned lanes = 0; lanes <= SM3MultiBuffer::best_lanes(); lanes = lanes ? lanes * 2 : 1) {
+            Bytes out(32 * n);
+            h.compute_many(ptrs.data(), lens.data(), n, out.data(), lanes);
+            for (size_t i = 0; i < n; i++) {
+                ref::hmac_sm3(key.data(), key.size(), ptrs[i], lens[i], want);
+                EXPECT(memcmp(want, &out[32 * i], 32) == 0, "批量MAC不一致 lanes=" + to_string(lanes) + " n=" +
+                    to_string(n) + " i=" + to_string(i) + " len=" + to_string(lens[i]));
+            }
+        }
+        return "";
+    };
+    return k;
+}
+
+//SM3-KDF：随机的Z长度（跨分组、有尾部）与输出长度，长输出时按随机线程数切分
+static Kernel sm3_kdf_kernel() {
+    Kernel k;
+    k.name = "sm3-kdf";
+    k.source = "SM3-KDF.h";
+    k.vectors = [](bool) -> string {
+        const char* z = "abc";
+        uint8_t out[19];
+        EXPECT(lab_sm3_opt::Sm3Kdf::kdf((const uint8_t*)z, 3, out, sizeof(out)), "derive失败");
+        EXPECT(to_hex(out, sizeof(out)) == "fe1ea80dac6f100c33537bd24619ec7c72a1e8", "已知答案不符: " +
+            to_hex(out, sizeof(out)));
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        Bytes z = random_bytes(rng, rng() % 4 == 0 ? 64 : rng() % 200);
+        size_t klen = rng() % 10 == 0 ? ThreadPool::CHUNK_BYTES + rng() % 600000 : random_len(rng, 5000);
+        unsigned threads = rng() % 5;
+        Bytes want(klen), got(klen);
+        ref::sm3_kdf(z.data(), z.size(), want.data(), klen);
+        lab_sm3_opt::Sm3Kdf kdf(z.data(), z.size());
+        string where = " zlen=" + to_string(z.size()) + " klen=" + to_string(klen) + " threads=" + to_string(threads);
+        EXPECT(kdf.derive(got.data(), klen, threads), "derive失败" + where);
+        EXPECT(got == want, "派生结果不一致" + where);
+        return "";
+    };
+    return k;
+}
+
+static Kernel merkle_kernel() {
+    Kernel k;
+    k.name = "merkle";
+    k.source = "sm3_merkletree.h";
+    k.vectors = [](bool) -> string {
+        uint8_t empty[32];
+        ref::sm3(nullptr, 0, empty);
+        EXPECT(memcmp(empty, lab_merkle::EMPTY_HASH, 32) == 0, "EMPTY_HASH不等于SM3(\"\")");
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        size_t n = rng() % 40 + 1;
+        vector<Bytes> leaves(n);
+        vector<vector<uint8_t>> input(n);
+        for (size_t i = 0; i < n; i++) {
+            leaves[i] = random_bytes(rng, random_len(rng, 500));
+            input[i] = leaves[i];
+        }
+        uint8_t want[32], got[32];
+        ref::merkle_root(leaves, want);
+        lab_merkle::MerkleTree t;
+        t.initialize(input);
+        t.getRootHash(got);
+        EXPECT(memcmp(want, got, 32) == 0, "根哈希不一致 leaves=" + to_string(n));
+        return "";
+    };
+    return k;
+}
+
+//SM3树哈希：随机块大小与长度（含空输入、整块、跨块），随机线程数，随机切分的update
+static Kernel tree_hash_kernel() {
+    Kernel k;
+    k.name = "sm3-tree";
+    k.source = "SM3-treehash.h";
+    k.vectors = [](bool) -> string {
+        uint8_t want[32], got[32];
+        ref::tree_hash(nullptr, 0, 1024, want);
+        lab_merkle::Sm3TreeHash::hash(nullptr, 0, got, 1024);
+        EXPECT(memcmp(want, got, 32) == 0, "空输入的树哈希不一致");
+        return "";
+    };
+    k.random = [](Rng& rng) -> string {
+        size_t chunk = 64 << (rng() % 6);
+        size_t len = rng() % 8 == 0 ? chunk * (rng() % 40) : rng() % (chunk * 40);
+        unsigned threads = rng() % 4;
+        Bytes data = random_bytes(rng, len);
+        Buf in(rng, data);
+        uint8_t want[32], got[32];
+        ref::tree_hash(data.data(), len, chunk, want);
+        string where = " chunk=" + to_string(chunk) + " len=" + to_string(len) + " threads=" + to_string(threads);
+        lab_merkle::Sm3TreeHash::hash(in.p, in.n, got, chunk, threads);
+        EXPECT(memcmp(want, got, 32) == 0, "一次性树哈希不一致" + where);
+        lab_merkle::Sm3TreeHash t(chunk, threads);
+        size_t pos = 0;
+        for (size_t cut : random_cuts(rng, len)) {
+            t.update(in.p + pos, cut - pos);
+            pos = cut;
+        }
+        t.final(got);
+        EXPECT(memcmp(want, got, 32) == 0, "分段update的树哈希不一致" + where);
+        return "";
+    };
+    return k;
+}
+
+static vector<Kernel> all_kernels() {
+    vector<Kernel> v;
+    {
+        using namespace lab_sm4_root;
+        v.push_back(legacy_sm4("sm4-root", "SM4.cpp", sm4Encrypt, sm4Decrypt, bytesToWords, wordsToBytes));
+    }
+    {
+        using namespace lab_sm4_basic;
+        v.push_back(legacy_sm4("sm4-basic", "SM4基本实现.cpp", sm4Encrypt, sm4Decrypt, bytesToWords, wordsToBytes));
+    }
+    {
+        using namespace lab_sm4_ttable;
+        initTTable();
+        v.push_back(legacy_sm4("sm4-ttable", "SM4-T-table.cpp", sm4Encrypt, nullptr, bytesToWords, wordsToBytes));
+    }
+#ifdef DIFF_HAS_X86
+    {
+        using namespace lab_sm4_aesni;
+        initTTable();
+        v.push_back(legacy_sm4("sm4-ttable-aesni", "SM4-T-table-AESNI.cpp", sm4EncryptAESNI, nullptr, bytesToWords,
+            wordsToBytes));
+    }
+#endif
+    v.push_back(sm4_optimized());
+    v.push_back(legacy_gcm<lab_gcm::GCM>("gcm-legacy", "SM4-GCM.cpp"));
+    v.push_back(legacy_gcm<lab_gcm_ttable::GCM>("gcm-ttable-legacy", "SM4-GCM-T-table.cpp"));
+    v.push_back(gcm_optimized());
+    v.push_back(gcm_batch());
+    v.push_back(gcm_parallel());
+    v.push_back(gmac_kernel());
+    v.push_back(ccm_kernel());
+    v.push_back(container_kernel());
+    v.push_back(sm3_kernel<lab_sm3::SM3>("sm3", "SM3.cpp"));
+    v.push_back(sm3_kernel<lab_sm3_opt::SM3>("sm3-opt", "SM3-optimized.h"));
+    v.push_back(sm3_multibuffer_kernel());
+    v.push_back(hmac_sm3_kernel());
+    v.push_back(sm3_kdf_kernel());
+    v.push_back(merkle_kernel());
+    v.push_back(tree_hash_kernel());
+    return v;
+}
+
+//---------------------------------------------------------------- 入口
+
+int main(int argc, char* argv[]) {
+    int iterations = 200;
+    uint64_t seed = random_device()();
+    string filter;
+    bool quick = false, list = false;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        auto next = [&]() -> string {
+            if (i + 1 >= argc) {
+                cerr << a << " 缺少参数" << endl;
+                exit(2);
+            }
+            return argv[++i];
+        };
+        if (a == "--iterations") iterations = stoi(next());
+        else if (a == "--seed") seed = stoull(next());
+        else if (a == "--filter") filter = next();
+        else if (a == "--quick") quick = true;
+        else if (a == "--list") list = true;
+        else {
+            cerr << "未知参数: " << a << endl;
+            return 2;
+        }
+    }
+
+    vector<Kernel> kernels = all_kernels();
+    if (list) {
+        for (auto& k : kernels) {
+            cout << left << setw(20) << k.name << k.source << endl;
+        }
+        return 0;
+    }
+    if (!self_test()) {
+        cout << "参考实现自检失败，终止" << endl;
+        return 2;
+    }
+    cout << "参考实现自检通过，随机种子 " << seed << "，每个内核 " << iterations << " 个随机用例" << endl;
+
+    int failed = 0;
+    for (auto& k : kernels) {
+        if (!filter.empty() && k.name.find(filter) == string::npos) continue;
+        auto start = chrono::steady_clock::now();
+        string err = k.vectors(quick);
+        string stage = "向量";
+        //每个内核用独立的派生种子，单独复现某个内核时结果相同
+        Rng rng(seed ^ hash<string>()(k.name));
+        int done = 0;
+        for (; err.empty() && done < iterations; done++) {
+            err = k.random(rng);
+            stage = "随机用例#" + to_string(done);
+        }
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << left << setw(20) << k.name << setw(6) << (err.empty() ? "通过" : "失败") << right << fixed
+            << setprecision(2) << setw(8) << secs << " s";
+        if (!err.empty()) {
+            cout << "  [" << stage << "] " << err;
+            failed++;
+        }
+        cout << endl;
+    }
+    cout << (failed ? to_string(failed) + " 个内核未通过" : "全部内核通过") << endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,295 @@
+//SM3树哈希（SM3-TREE）命令行工具（Linux）：大文件的完整性扫描随核数扩展
+//
+//输出不是文件的SM3，而是project4/SM3-treehash.h定义的树哈希：固定大小的块并行、多路计算SM3，
+//块摘要用sm3_merkletree.h的Merkle树合并，再绑定总长度与块大小。输出行带"SM3-TREE-<块大小>"标签，
+//不会与sm3sum一类的普通SM3结果混淆；只能与同一块大小的树哈希比较。
+//
+//   普通文件用mmap映射后一次交给树哈希，各工作线程在各自的块上缺页读入，读取与计算自然重叠；
+//   标准输入（"-"）、mmap失败或指定--no-mmap时改用大块read（每次读入多块，整块直接计算）。
+//
+//用法：
+//   sm3tree [--chunk 1M] [--threads N] [--no-mmap] [文件|-]...
+//   sm3tree --self-test
+//   不带文件参数时读标准输入（同"-"）；--self-test运行自测与计时；--chunk不超过1G
+//编译：g++ -std=c++17 -O2 -pthread -o sm3tree tools/sm3tree.cpp
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../project4/SM3-treehash.h"
+
+using namespace std;
+using namespace chrono;
+
+struct TreeOptions {
+    size_t chunk = Sm3TreeHash::DEFAULT_CHUNK;
+    unsigned threads = 0;
+    bool use_mmap = true;
+};
+
+//大块read：每次读入若干整块（约64MB），读满后交给树哈希
+static bool hash_by_read(int fd, Sm3TreeHash& t) {
+    size_t per_read = (64 << 20) / t.chunk_size() * t.chunk_size();
+    if (per_read == 0) {
+        per_read = t.chunk_size();
+    }
+    vector<uint8_t> buf(per_read);
+    for (;;) {
+        size_t got = 0;
+        while (got < buf.size()) {
+            ssize_t r = read(fd, buf.data() + got, buf.size() - got);
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            if (r < 0) {
+                return false;
+            }
+            if (r == 0) {
+                break;
+            }
+            got += (size_t)r;
+        }
+        t.update(buf.data(), got);
+        if (got < buf.size()) {
+            return true;
+        }
+    }
+}
+
+//计算path（"-"为标准输入）的树哈希；used_mmap返回是否走了mmap
+bool tree_hash_file(const string& path, const TreeOptions& opt, uint8_t digest[32], bool* used_mmap = nullptr) {
+    int fd = path == "-" ? STDIN_FILENO : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    Sm3TreeHash t(opt.chunk, opt.threads);
+    bool ok = false;
+    bool mapped = false;
+    struct stat st;
+    if (opt.use_mmap && fd != STDIN_FILENO && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+            t.update((const uint8_t*)p, (size_t)st.st_size);
+            munmap(p, (size_t)st.st_size);
+            mapped = ok = true;
+        }
+    }
+    if (!mapped) {
+        ok = hash_by_read(fd, t);
+    }
+    if (ok) {
+        t.final(digest);
+    }
+    if (used_mmap) {
+        *used_mmap = mapped;
+    }
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    return ok;
+}
+
+static string hex(const uint8_t* p, size_t n) {
+    static const char* digits = "0123456789abcdef";
+    string s;
+    for (size_t i = 0; i < n; i++) {
+        s += digits[p[i] >> 4];
+        s += digits[p[i] & 15];
+    }
+    return s;
+}
+
+static string size_label(size_t v) {
+    if (v % (1 << 20) == 0) return to_string(v >> 20) + "M";
+    if (v % (1 << 10) == 0) return to_string(v >> 10) + "K";
+    return to_string(v);
+}
+
+static double mb_per_s(uint64_t bytes, high_resolution_clock::time_point start) {
+    return bytes / 1e6 / duration<double>(high_resolution_clock::now() - start).count();
+}
+
+//按定义逐块串行计算：叶子由MerkleTree::initialize自己哈希，再绑定长度与块大小
+static void tree_hash_reference(const vector<uint8_t>& data, size_t chunk, uint8_t out[32]) {
+    vector<vector<uint8_t>> leaves;
+    for (size_t off = 0; off < data.size() || leaves.empty(); off += chunk) {
+        size_t n = data.size() - off < chunk ? data.size() - off : chunk;
+        leaves.emplace_back(data.begin() + off, data.begin() + off + n);
+    }
+    MerkleTree tree;
+    tree.initialize(leaves);
+    uint8_t tail[48];
+    tree.getRootHash(tail);
+    uint64_t total = data.size();
+    for (int i = 0; i < 8; i++) {
+        tail[32 + i] = (uint8_t)(total >> (56 - 8 * i));
+        tail[40 + i] = (uint8_t)((uint64_t)chunk >> (56 - 8 * i));
+    }
+    SM3::hash(tail, sizeof(tail), out);
+}
+
+//自测：与按定义的串行计算一致、任意切分update一致、mmap与read一致、块大小与长度被绑定；并与单线程SM3对比速度
+int demo() {
+    bool ok = true;
+    mt19937 rng(2025);
+    const size_t CHUNK = 4096;
+    for (size_t len : { 0, 1, 4095, 4096, 4097, 5 * 4096, 17 * 4096 + 100, 70 * 4096 }) {
+        vector<uint8_t> data(len);
+        for (auto& b : data) b = (uint8_t)rng();
+        uint8_t want[32], got[32];
+        tree_hash_reference(data, CHUNK, want);
+        for (unsigned threads : { 1u, 0u }) {
+            Sm3TreeHash::hash(data.data(), data.size(), got, CHUNK, threads);
+            ok = ok && memcmp(want, got, 32) == 0;
+        }
+        //随机切分后多次update
+        Sm3TreeHash t(CHUNK);
+        for (size_t pos = 0; pos < len;) {
+            size_t n = min<size_t>(len - pos, rng() % (3 * CHUNK) + 1);
+            t.update(data.data() + pos, n);
+            pos += n;
+        }
+        t.final(got);
+        ok = ok && memcmp(want, got, 32) == 0;
+    }
+    cout << "与按定义的串行计算一致、任意切分一致: " << (ok ? "是" : "否") << endl;
+
+    //2个块的文件与内容为这两个块摘要的文件：Merkle根相同，但长度不同，最终结果不同
+    {
+        vector<uint8_t> two(2 * CHUNK, 7);
+        uint8_t d[64], a[32], b[32];
+        SM3::hash(two.data(), CHUNK, d);
+        SM3::hash(two.data() + CHUNK, CHUNK, d + 32);
+        Sm3TreeHash::hash(two.data(), two.size(), a, CHUNK);
+        Sm3TreeHash::hash(d, sizeof(d), b, CHUNK);
+        uint8_t c[32];
+        Sm3TreeHash::hash(two.data(), two.size(), c, 2 * CHUNK);
+        bool bound = memcmp(a, b, 32) != 0 && memcmp(a, c, 32) != 0;
+        cout << "长度与块大小被绑定: " << (bound ? "是" : "否") << endl;
+        ok = ok && bound;
+    }
+
+    //文件：mmap与大块read结果一致，并与单线程SM3计时对比
+    const string path = "sm3tree_demo.bin";
+    const size_t SIZE = 256 * 1024 * 1024 + 12345;
+    vector<uint8_t> data(SIZE);
+    for (size_t i = 0; i < SIZE; i += 4) {
+        uint32_t v = rng();
+        memcpy(&data[i], &v, SIZE - i < 4 ? SIZE - i : 4);
+    }
+    {
+        ofstream f(path, ios::binary | ios::trunc);
+        f.write((const char*)data.data(), data.size());
+    }
+    TreeOptions opt;
+    TreeOptions read_opt;
+    read_opt.use_mmap = false;
+    uint8_t d1[32], d2[32], expect[32], plain[32];
+    tree_hash_reference(data, opt.chunk, expect);
+    bool mapped = false;
+    auto start = high_resolution_clock::now();
+    ok = tree_hash_file(path, opt, d1, &mapped) && ok;
+    double t_mmap = mb_per_s(SIZE, start);
+    start = high_resolution_clock::now();
+    ok = tree_hash_file(path, read_opt, d2) && ok;
+    double t_read = mb_per_s(SIZE, start);
+    bool same = memcmp(d1, expect, 32) == 0 && memcmp(d2, expect, 32) == 0;
+    start = high_resolution_clock::now();
+    SM3::hash(data.data(), data.size(), plain);
+    double t_plain = mb_per_s(SIZE, start);
+    cout << fixed << setprecision(0) << "256MB：单线程SM3 " << t_plain << " MB/s，树哈希（"
+         << (mapped ? "mmap" : "mmap失败，read") << "，" << SM3MultiBuffer::best_lanes() << "路 x "
+         << ThreadPool::global().size() << "线程）" << t_mmap << " MB/s，树哈希（大块read）" << t_read
+         << " MB/s，结果一致: " << (same ? "是" : "否") << endl;
+    ok = ok && same;
+    remove(path.c_str());
+    return ok ? 0 : 1;
+}
+
+//十进制数，可带K/M/G后缀（1024进制）；空串、其他字符或溢出时返回false
+static bool parse_size(const string& s, size_t& v) {
+    size_t n = s.size();
+    unsigned shift = 0;
+    if (n > 0) {
+        char u = (char)toupper((unsigned char)s.back());
+        shift = u == 'K' ? 10 : u == 'M' ? 20 : u == 'G' ? 30 : 0;
+        n -= shift ? 1 : 0;
+    }
+    if (n == 0) {
+        return false;
+    }
+    size_t x = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!isdigit((unsigned char)s[i]) || x > (SIZE_MAX - 9) / 10) {
+            return false;
+        }
+        x = x * 10 + (size_t)(s[i] - '0');
+    }
+    if (x > (SIZE_MAX >> shift)) {
+        return false;
+    }
+    v = x << shift;
+    return true;
+}
+
+//不带后缀的十进制数，不超过UINT_MAX
+static bool parse_count(const string& s, unsigned& v) {
+    size_t x;
+    if (s.empty() || !isdigit((unsigned char)s.back()) || !parse_size(s, x) || x > UINT_MAX) {
+        return false;
+    }
+    v = (unsigned)x;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 2 && string(argv[1]) == "--self-test") {
+        return demo();
+    }
+    TreeOptions opt;
+    vector<string> paths;
+    bool valid = true;
+    for (int i = 1; i < argc && valid; i++) {
+        string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--chunk" && has_value) valid = parse_size(argv[++i], opt.chunk);
+        else if (a == "--threads" && has_value) valid = parse_count(argv[++i], opt.threads);
+        else if (a == "--no-mmap") opt.use_mmap = false;
+        else if (a.size() > 1 && a[0] == '-' && a[1] == '-') valid = false;
+        else paths.push_back(a);
+    }
+    if (!valid || opt.chunk == 0 || opt.chunk > Sm3TreeHash::MAX_CHUNK) {
+        cerr << "用法: " << argv[0] << " [--chunk 1M] [--threads N] [--no-mmap] [文件|-]..." << endl;
+        cerr << "      " << argv[0] << " --self-test" << endl;
+        return 2;
+    }
+    if (paths.empty()) {
+        paths.push_back("-");
+    }
+    int status = 0;
+    string label = "SM3-TREE-" + size_label(opt.chunk);
+    for (const string& p : paths) {
+        uint8_t d[32];
+        if (!tree_hash_file(p, opt, d)) {
+            cerr << p << ": 读取失败" << endl;
+            status = 1;
+            continue;
+        }
+        cout << label << " (" << p << ") = " << hex(d, 32) << endl;
+    }
+    return status;
+}